@@ -0,0 +1,576 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * mmcli -- Control modem status & access information from the command line
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#define _LIBMM_INSIDE_MMCLI
+#include <libmm-glib.h>
+
+#include "mmcli.h"
+#include "mmcli-common.h"
+#include "mmcli-output.h"
+
+/* In batch mode, commands are read from stdin, one per line, and all of them
+ * are run using the same bus connection and the same object manager client,
+ * so that reads can be served from the already loaded object cache.
+ *
+ * Commands run concurrently: a command is started as soon as it is read, and
+ * its result is printed as soon as it is available, so results may not come
+ * in the same order as the commands. Each result is printed as a block of
+ * keyvalue pairs, with the 'batch.id' key giving the line number of the
+ * command, and terminated by an empty line. */
+
+/* Context */
+typedef struct {
+    MMManager    *manager;
+    GCancellable *cancellable;
+    GIOChannel   *input;
+    GIOFlags      input_flags;
+    guint         input_watch_id;
+    gboolean      input_eof;
+    guint         n_lines;
+    guint         n_pending;
+    /* sim path -> MMSim */
+    GHashTable   *sims;
+    /* Commands read before the manager is available */
+    GQueue       *queued;
+} Context;
+static Context *ctx;
+
+typedef struct {
+    guint   id;
+    gchar  *line;
+    gchar **argv;
+} Command;
+
+/*****************************************************************************/
+
+static void
+command_free (Command *command)
+{
+    g_strfreev (command->argv);
+    g_free (command->line);
+    g_slice_free (Command, command);
+}
+
+static void
+check_done (void)
+{
+    if (ctx->input_eof && !ctx->n_pending && g_queue_is_empty (ctx->queued))
+        mmcli_async_operation_done ();
+}
+
+static void
+print_result (Command      *command,
+              const GError *error)
+{
+    g_print ("batch.id      : %u\n", command->id);
+    g_print ("batch.command : %s\n", command->line);
+    if (error) {
+        g_print ("batch.status  : error\n");
+        g_print ("batch.error   : %s\n", error->message);
+    } else
+        g_print ("batch.status  : ok\n");
+    mmcli_output_dump ();
+    g_print ("\n");
+    fflush (stdout);
+}
+
+static void
+command_complete (Command      *command,
+                  const GError *error)
+{
+    print_result (command, error);
+    command_free (command);
+}
+
+static void
+command_complete_async (Command      *command,
+                        const GError *error)
+{
+    command_complete (command, error);
+    g_assert (ctx->n_pending > 0);
+    ctx->n_pending--;
+    check_done ();
+}
+
+/*****************************************************************************/
+/* Object lookup, only from the object manager cache */
+
+static MMObject *
+find_modem (const gchar  *str,
+            GError      **error)
+{
+    GDBusObject *object = NULL;
+    gchar       *path = NULL;
+    GList       *modems;
+    GList       *l;
+
+    if (!str) {
+        g_set_error (error, MM_CORE_ERROR, MM_CORE_ERROR_INVALID_ARGS, "no modem was specified");
+        return NULL;
+    }
+
+    /* Full path, index or uid, same as the -m option */
+    if (g_str_has_prefix (str, MM_DBUS_MODEM_PREFIX))
+        path = g_strdup (str);
+    else if (str[0] && strspn (str, "0123456789") == strlen (str))
+        path = g_strdup_printf (MM_DBUS_MODEM_PREFIX "/%s", str);
+
+    if (path) {
+        object = g_dbus_object_manager_get_object (G_DBUS_OBJECT_MANAGER (ctx->manager), path);
+        g_free (path);
+    } else {
+        modems = g_dbus_object_manager_get_objects (G_DBUS_OBJECT_MANAGER (ctx->manager));
+        for (l = modems; l && !object; l = g_list_next (l)) {
+            MMModem *modem;
+
+            modem = mm_object_peek_modem (MM_OBJECT (l->data));
+            if (modem && g_strcmp0 (mm_modem_get_device (modem), str) == 0)
+                object = g_object_ref (l->data);
+        }
+        g_list_free_full (modems, g_object_unref);
+    }
+
+    if (!object)
+        g_set_error (error, MM_CORE_ERROR, MM_CORE_ERROR_NOT_FOUND, "couldn't find modem '%s'", str);
+    return (MMObject *) object;
+}
+
+/*****************************************************************************/
+/* list */
+
+static void
+command_list (Command *command)
+{
+    GList *modems;
+    GList *l;
+    GPtrArray *paths;
+
+    paths = g_ptr_array_new ();
+    modems = g_dbus_object_manager_get_objects (G_DBUS_OBJECT_MANAGER (ctx->manager));
+    for (l = modems; l; l = g_list_next (l))
+        g_ptr_array_add (paths, (gpointer) mm_object_get_path (MM_OBJECT (l->data)));
+    g_ptr_array_add (paths, NULL);
+
+    mmcli_output_string_array (MMC_F_MODEM_LIST_DBUS_PATH, (const gchar **) paths->pdata, TRUE);
+    command_complete (command, NULL);
+
+    g_ptr_array_unref (paths);
+    g_list_free_full (modems, g_object_unref);
+}
+
+/*****************************************************************************/
+/* status [MODEM] */
+
+static void
+command_status (Command *command)
+{
+    MMFleetSnapshot       *snapshot;
+    const MMModemSnapshot *modem;
+    MMObject              *object;
+    GError                *error = NULL;
+    guint                  i;
+
+    snapshot = mm_manager_get_fleet_snapshot (ctx->manager);
+
+    /* No modem given, report all of them, one result block per modem */
+    if (!command->argv[1]) {
+        for (i = 0; i < mm_fleet_snapshot_get_n_modems (snapshot); i++) {
+            mmcli_output_modem_snapshot (mm_fleet_snapshot_peek_modem (snapshot, i));
+            print_result (command, NULL);
+        }
+        if (!i)
+            print_result (command, NULL);
+        command_free (command);
+        mm_fleet_snapshot_unref (snapshot);
+        return;
+    }
+
+    object = find_modem (command->argv[1], &error);
+    if (object) {
+        modem = mm_fleet_snapshot_lookup_modem (snapshot, mm_object_get_path (object));
+        if (modem)
+            mmcli_output_modem_snapshot (modem);
+        else
+            error = g_error_new (MM_CORE_ERROR, MM_CORE_ERROR_NOT_FOUND, "modem '%s' not available", command->argv[1]);
+        g_object_unref (object);
+    }
+    command_complete (command, error);
+    g_clear_error (&error);
+    mm_fleet_snapshot_unref (snapshot);
+}
+
+/*****************************************************************************/
+/* sim MODEM */
+
+static void
+output_sim (MMSim *sim)
+{
+    mmcli_output_string (MMC_F_SIM_GENERAL_DBUS_PATH,        mm_sim_get_path (sim));
+    mmcli_output_string (MMC_F_SIM_PROPERTIES_IMSI,          mm_sim_get_imsi (sim));
+    mmcli_output_string (MMC_F_SIM_PROPERTIES_ICCID,         mm_sim_get_identifier (sim));
+    mmcli_output_string (MMC_F_SIM_PROPERTIES_OPERATOR_ID,   mm_sim_get_operator_identifier (sim));
+    mmcli_output_string (MMC_F_SIM_PROPERTIES_OPERATOR_NAME, mm_sim_get_operator_name (sim));
+}
+
+static void
+get_sim_ready (MMModem      *modem,
+               GAsyncResult *res,
+               Command      *command)
+{
+    MMSim  *sim;
+    GError *error = NULL;
+
+    sim = mm_modem_get_sim_finish (modem, res, &error);
+    if (sim) {
+        /* Keep the proxy around, its properties are kept up to date by
+         * the property change signals */
+        g_hash_table_insert (ctx->sims, g_strdup (mm_sim_get_path (sim)), g_object_ref (sim));
+        output_sim (sim);
+        g_object_unref (sim);
+    }
+    command_complete_async (command, error);
+    g_clear_error (&error);
+}
+
+static void
+command_sim (Command *command)
+{
+    MMObject    *object;
+    MMModem     *modem;
+    MMSim       *sim;
+    const gchar *sim_path;
+    GError      *error = NULL;
+
+    object = find_modem (command->argv[1], &error);
+    if (!object) {
+        command_complete (command, error);
+        g_error_free (error);
+        return;
+    }
+
+    modem = mm_object_peek_modem (object);
+    sim_path = modem ? mm_modem_get_sim_path (modem) : NULL;
+    if (!sim_path || g_str_equal (sim_path, "/")) {
+        error = g_error_new (MM_CORE_ERROR, MM_CORE_ERROR_NOT_FOUND, "modem has no SIM");
+        command_complete (command, error);
+        g_error_free (error);
+        g_object_unref (object);
+        return;
+    }
+
+    sim = g_hash_table_lookup (ctx->sims, sim_path);
+    if (sim) {
+        output_sim (sim);
+        command_complete (command, NULL);
+        g_object_unref (object);
+        return;
+    }
+
+    ctx->n_pending++;
+    mm_modem_get_sim (modem,
+                      ctx->cancellable,
+                      (GAsyncReadyCallback) get_sim_ready,
+                      command);
+    g_object_unref (object);
+}
+
+/*****************************************************************************/
+/* enable/disable/reset MODEM */
+
+static void
+enable_ready (MMModem      *modem,
+              GAsyncResult *res,
+              Command      *command)
+{
+    GError *error = NULL;
+
+    mm_modem_enable_finish (modem, res, &error);
+    command_complete_async (command, error);
+    g_clear_error (&error);
+}
+
+static void
+disable_ready (MMModem      *modem,
+               GAsyncResult *res,
+               Command      *command)
+{
+    GError *error = NULL;
+
+    mm_modem_disable_finish (modem, res, &error);
+    command_complete_async (command, error);
+    g_clear_error (&error);
+}
+
+static void
+reset_ready (MMModem      *modem,
+             GAsyncResult *res,
+             Command      *command)
+{
+    GError *error = NULL;
+
+    mm_modem_reset_finish (modem, res, &error);
+    command_complete_async (command, error);
+    g_clear_error (&error);
+}
+
+static void
+command_modem_method (Command *command)
+{
+    MMObject *object;
+    MMModem  *modem;
+    GError   *error = NULL;
+
+    object = find_modem (command->argv[1], &error);
+    if (!object) {
+        command_complete (command, error);
+        g_error_free (error);
+        return;
+    }
+
+    modem = mm_object_peek_modem (object);
+    mmcli_force_operation_timeout (G_DBUS_PROXY (modem));
+
+    ctx->n_pending++;
+    if (g_str_equal (command->argv[0], "enable"))
+        mm_modem_enable (modem, ctx->cancellable, (GAsyncReadyCallback) enable_ready, command);
+    else if (g_str_equal (command->argv[0], "disable"))
+        mm_modem_disable (modem, ctx->cancellable, (GAsyncReadyCallback) disable_ready, command);
+    else if (g_str_equal (command->argv[0], "reset"))
+        mm_modem_reset (modem, ctx->cancellable, (GAsyncReadyCallback) reset_ready, command);
+    else
+        g_assert_not_reached ();
+
+    g_object_unref (object);
+}
+
+/*****************************************************************************/
+
+static const struct {
+    const gchar *name;
+    guint        min_args;
+    guint        max_args;
+    void       (*run) (Command *command);
+} commands[] = {
+    { "list",    0, 0, command_list         },
+    { "status",  0, 1, command_status       },
+    { "sim",     1, 1, command_sim          },
+    { "enable",  1, 1, command_modem_method },
+    { "disable", 1, 1, command_modem_method },
+    { "reset",   1, 1, command_modem_method },
+};
+
+static void
+command_run (Command *command)
+{
+    GError *error = NULL;
+    guint   n_args;
+    guint   i;
+
+    n_args = g_strv_length (command->argv) - 1;
+    for (i = 0; i < G_N_ELEMENTS (commands); i++) {
+        if (!g_str_equal (command->argv[0], commands[i].name))
+            continue;
+        if (n_args < commands[i].min_args || n_args > commands[i].max_args) {
+            error = g_error_new (MM_CORE_ERROR, MM_CORE_ERROR_INVALID_ARGS,
+                                 "wrong number of arguments for '%s'", commands[i].name);
+            break;
+        }
+        commands[i].run (command);
+        return;
+    }
+
+    if (!error)
+        error = g_error_new (MM_CORE_ERROR, MM_CORE_ERROR_UNSUPPORTED,
+                             "unknown command '%s'", command->argv[0]);
+    command_complete (command, error);
+    g_error_free (error);
+}
+
+static void
+process_line (const gchar *line,
+              gsize        length)
+{
+    Command  *command;
+    gchar   **argv = NULL;
+    GError   *error = NULL;
+
+    ctx->n_lines++;
+
+    /* Commands must be valid UTF-8; report the line escaped */
+    if (!g_utf8_validate (line, length, NULL)) {
+        command = g_slice_new0 (Command);
+        command->id = ctx->n_lines;
+        command->line = g_strescape (line, NULL);
+        error = g_error_new (MM_CORE_ERROR, MM_CORE_ERROR_INVALID_ARGS, "command is not valid UTF-8");
+        command_complete (command, error);
+        g_error_free (error);
+        return;
+    }
+
+    /* Skip empty lines and comments */
+    while (g_ascii_isspace (*line))
+        line++;
+    if (!line[0] || line[0] == '#')
+        return;
+
+    command = g_slice_new0 (Command);
+    command->id = ctx->n_lines;
+    command->line = g_strdup (line);
+
+    if (!g_shell_parse_argv (line, NULL, &argv, &error)) {
+        command_complete (command, error);
+        g_error_free (error);
+        return;
+    }
+    command->argv = argv;
+
+    if (!ctx->manager) {
+        g_queue_push_tail (ctx->queued, command);
+        return;
+    }
+    command_run (command);
+}
+
+static gboolean
+input_ready (GIOChannel   *channel,
+             GIOCondition  condition,
+             gpointer      none)
+{
+    GIOStatus  status;
+    GError    *error = NULL;
+
+    /* Process all the complete lines available. The input is non-blocking, so
+     * a partial line is kept in the channel buffer until the rest of it
+     * arrives; at EOF it is processed as it is. */
+    do {
+        gchar *line = NULL;
+        gsize  terminator = 0;
+
+        status = g_io_channel_read_line (channel, &line, NULL, &terminator, &error);
+        if (status == G_IO_STATUS_NORMAL) {
+            line[terminator] = '\0';
+            process_line (line, terminator);
+            g_free (line);
+        }
+    } while (status == G_IO_STATUS_NORMAL);
+
+    if (status == G_IO_STATUS_AGAIN)
+        return G_SOURCE_CONTINUE;
+
+    if (status == G_IO_STATUS_ERROR) {
+        g_printerr ("error: couldn't read commands: %s\n", error->message);
+        g_error_free (error);
+    }
+
+    ctx->input_eof = TRUE;
+    ctx->input_watch_id = 0;
+    check_done ();
+    return G_SOURCE_REMOVE;
+}
+
+static void
+cancelled (GCancellable *cancellable)
+{
+    mmcli_async_operation_done ();
+}
+
+static void
+get_manager_ready (GObject      *source,
+                   GAsyncResult *result,
+                   gpointer      none)
+{
+    Command *command;
+
+    ctx->manager = mmcli_get_manager_finish (result);
+    mmcli_force_operation_timeout (mm_manager_peek_proxy (ctx->manager));
+
+    while ((command = g_queue_pop_head (ctx->queued)) != NULL)
+        command_run (command);
+    check_done ();
+}
+
+/*****************************************************************************/
+
+void
+mmcli_batch_run (GDBusConnection *connection,
+                 GCancellable    *cancellable)
+{
+    ctx = g_new0 (Context, 1);
+    if (cancellable)
+        ctx->cancellable = g_object_ref (cancellable);
+    ctx->sims = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+    ctx->queued = g_queue_new ();
+
+    /* Start reading commands right away; those read before the manager is
+     * ready will be queued */
+    ctx->input = g_io_channel_unix_new (STDIN_FILENO);
+    g_io_channel_set_close_on_unref (ctx->input, FALSE);
+    /* Raw bytes, each line is validated as UTF-8 on its own */
+    g_io_channel_set_encoding (ctx->input, NULL, NULL);
+    /* Never block waiting for the end of a line; the original flags are
+     * restored on shutdown, as stdin may be shared with other processes */
+    ctx->input_flags = g_io_channel_get_flags (ctx->input);
+    g_io_channel_set_flags (ctx->input, ctx->input_flags | G_IO_FLAG_NONBLOCK, NULL);
+    ctx->input_watch_id = g_io_add_watch (ctx->input,
+                                          G_IO_IN | G_IO_HUP | G_IO_ERR,
+                                          (GIOFunc) input_ready,
+                                          NULL);
+
+    /* If we get cancelled, operation done */
+    g_cancellable_connect (ctx->cancellable,
+                           G_CALLBACK (cancelled),
+                           NULL,
+                           NULL);
+
+    mmcli_get_manager (connection,
+                       cancellable,
+                       (GAsyncReadyCallback) get_manager_ready,
+                       NULL);
+}
+
+void
+mmcli_batch_shutdown (void)
+{
+    if (!ctx)
+        return;
+
+    if (ctx->input_watch_id)
+        g_source_remove (ctx->input_watch_id);
+    g_io_channel_set_flags (ctx->input, ctx->input_flags, NULL);
+    g_io_channel_unref (ctx->input);
+    g_queue_free_full (ctx->queued, (GDestroyNotify) command_free);
+    g_hash_table_unref (ctx->sims);
+    if (ctx->manager)
+        g_object_unref (ctx->manager);
+    if (ctx->cancellable)
+        g_object_unref (ctx->cancellable);
+    g_free (ctx);
+    ctx = NULL;
+}
@@ -53,6 +53,7 @@ static Context *ctx;
 /* Options */
 static gboolean get_daemon_version_flag;
 static gboolean list_modems_flag;
+static gboolean all_modems_flag;
 static gboolean monitor_modems_flag;
 static gboolean scan_modems_flag;
 static gchar *set_logging_str;
@@ -76,6 +77,10 @@ static GOptionEntry entries[] = {
       "List available modems",
       NULL
     },
+    { "all-modems", 0, 0, G_OPTION_ARG_NONE, &all_modems_flag,
+      "Show status of all available modems",
+      NULL
+    },
     { "monitor-modems", 'M', 0, G_OPTION_ARG_NONE, &monitor_modems_flag,
       "List available modems and monitor additions and removals",
       NULL
@@ -128,6 +133,7 @@ mmcli_manager_options_enabled (void)
 
     n_actions = (get_daemon_version_flag +
                  list_modems_flag +
+                 all_modems_flag +
                  monitor_modems_flag +
                  scan_modems_flag +
                  !!set_logging_str +
@@ -151,6 +157,11 @@ mmcli_manager_options_enabled (void)
             exit (EXIT_FAILURE);
         }
         mmcli_force_async_operation ();
+    } else if (all_modems_flag) {
+        if (mmcli_output_get () == MMC_OUTPUT_TYPE_JSON) {
+            g_printerr ("error: status of all modems not available in json output\n");
+            exit (EXIT_FAILURE);
+        }
     } else if (inhibit_device_str)
         mmcli_force_async_operation ();
 
@@ -373,6 +384,28 @@ list_current_modems (MMManager *manager)
     mmcli_output_list_dump (MMC_F_MODEM_LIST_DBUS_PATH);
 }
 
+static void
+output_all_modems (MMManager *manager)
+{
+    MMFleetSnapshot *snapshot;
+    guint            n_modems;
+    guint            i;
+
+    /* All values come from the object manager cache, so no per-modem
+     * round trip to the daemon is needed */
+    snapshot = mm_manager_get_fleet_snapshot (manager);
+    n_modems = mm_fleet_snapshot_get_n_modems (snapshot);
+    if (!n_modems && mmcli_output_get () == MMC_OUTPUT_TYPE_HUMAN)
+        g_print ("No modems were found\n");
+    for (i = 0; i < n_modems; i++) {
+        if (i > 0 && mmcli_output_get () == MMC_OUTPUT_TYPE_HUMAN)
+            g_print ("\n");
+        mmcli_output_modem_snapshot (mm_fleet_snapshot_peek_modem (snapshot, i));
+        mmcli_output_dump ();
+    }
+    mm_fleet_snapshot_unref (snapshot);
+}
+
 static void
 cancelled (GCancellable *cancellable)
 {
@@ -505,6 +538,13 @@ get_manager_ready (GObject      *source,
         return;
     }
 
+    /* Request to show all modems? */
+    if (all_modems_flag) {
+        output_all_modems (ctx->manager);
+        mmcli_async_operation_done ();
+        return;
+    }
+
     /* Request to inhibit device? */
     if (inhibit_device_str) {
         mm_manager_inhibit_device (ctx->manager,
@@ -607,5 +647,11 @@ mmcli_manager_run_synchronous (GDBusConnection *connection)
         return;
     }
 
+    /* Request to show all modems? */
+    if (all_modems_flag) {
+        output_all_modems (ctx->manager);
+        return;
+    }
+
     g_warn_if_reached ();
 }
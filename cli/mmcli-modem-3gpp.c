@@ -48,6 +48,7 @@ static Context *ctx;
 
 /* Options */
 static gboolean scan_flag;
+static gboolean monitor_scan_flag;
 static gboolean register_home_flag;
 static gchar *register_in_operator_str;
 static gchar *set_eps_ue_mode_operation_str;
@@ -62,6 +63,10 @@ static GOptionEntry entries[] = {
       "Scan for available networks in a given modem.",
       NULL
     },
+    { "3gpp-monitor-scan", 0, 0, G_OPTION_ARG_NONE, &monitor_scan_flag,
+      "Monitor network scan results reported by a given modem.",
+      NULL
+    },
     { "3gpp-register-home", 0, 0, G_OPTION_ARG_NONE, &register_home_flag,
       "Request a given modem to register in its home network",
       NULL
@@ -122,6 +127,7 @@ mmcli_modem_3gpp_options_enabled (void)
         return !!n_actions;
 
     n_actions = (scan_flag +
+                 monitor_scan_flag +
                  register_home_flag +
                  !!register_in_operator_str +
                  !!set_eps_ue_mode_operation_str +
@@ -141,6 +147,10 @@ mmcli_modem_3gpp_options_enabled (void)
     if (scan_flag)
         mmcli_force_async_operation ();
 
+    /* Monitoring is always asynchronous */
+    if (monitor_scan_flag)
+        mmcli_force_async_operation ();
+
     /* USSD initiate and respond will wait for URCs to get finished, so
      * these are truly async. */
     if (ussd_initiate_str || ussd_respond_str)
@@ -240,6 +250,25 @@ scan_ready (MMModem3gpp  *modem_3gpp,
     mmcli_async_operation_done ();
 }
 
+static void
+scan_updated (MMModem3gpp *modem_3gpp,
+              GVariant    *results)
+{
+    GList *networks;
+
+    networks = mm_modem_3gpp_network_list_from_variant (results);
+    mmcli_output_scan_networks (networks);
+    mmcli_output_dump ();
+
+    g_list_free_full (networks, (GDestroyNotify) mm_modem_3gpp_network_free);
+}
+
+static void
+monitor_scan_cancelled (GCancellable *cancellable)
+{
+    mmcli_async_operation_done ();
+}
+
 static void
 register_process_reply (gboolean result,
                         const GError *error)
@@ -458,6 +487,21 @@ get_modem_ready (GObject      *source,
         return;
     }
 
+    /* Request to monitor network scan results? */
+    if (monitor_scan_flag) {
+        g_signal_connect (ctx->modem_3gpp,
+                          "scan-updated",
+                          G_CALLBACK (scan_updated),
+                          NULL);
+
+        /* If we get cancelled, operation done */
+        g_cancellable_connect (ctx->cancellable,
+                               G_CALLBACK (monitor_scan_cancelled),
+                               NULL,
+                               NULL);
+        return;
+    }
+
     /* Request to register the modem? */
     if (register_in_operator_str || register_home_flag) {
         g_debug ("Asynchronously registering the modem...");
@@ -585,7 +629,7 @@ mmcli_modem_3gpp_run_synchronous (GDBusConnection *connection)
 
     ensure_modem_3gpp ();
 
-    if (scan_flag)
+    if (scan_flag || monitor_scan_flag)
         g_assert_not_reached ();
     if (ussd_initiate_str)
         g_assert_not_reached ();
@@ -64,6 +64,7 @@ static gchar *set_allowed_modes_str;
 static gchar *set_preferred_mode_str;
 static gchar *set_current_bands_str;
 static gboolean inhibit_flag;
+static gboolean port_stats_flag;
 
 static GOptionEntry entries[] = {
     { "monitor-state", 'w', 0, G_OPTION_ARG_NONE, &monitor_state_flag,
@@ -130,6 +131,10 @@ static GOptionEntry entries[] = {
       "Inhibit the modem",
       NULL
     },
+    { "port-stats", 0, 0, G_OPTION_ARG_NONE, &port_stats_flag,
+      "Show command latency statistics of the modem ports",
+      NULL
+    },
     { NULL }
 };
 
@@ -173,7 +178,8 @@ mmcli_modem_options_enabled (void)
                  !!set_allowed_modes_str +
                  !!set_preferred_mode_str +
                  !!set_current_bands_str +
-                 inhibit_flag);
+                 inhibit_flag +
+                 port_stats_flag);
 
     if (n_actions == 0 && mmcli_get_common_modem_string ()) {
         /* default to info */
@@ -197,7 +203,7 @@ mmcli_modem_options_enabled (void)
     if (monitor_state_flag || inhibit_flag)
         mmcli_force_async_operation ();
 
-    if (info_flag)
+    if (info_flag || port_stats_flag)
         mmcli_force_sync_operation ();
 
     checked = TRUE;
@@ -275,6 +281,236 @@ cancelled (GCancellable *cancellable)
     mmcli_async_operation_done ();
 }
 
+/* Estimate the upper limit of the bucket where the given percentile falls */
+static guint
+histogram_get_percentile (GVariant     *histogram,
+                          const guint  *limits,
+                          gsize         n_limits,
+                          guint         percentile,
+                          guint64      *n_samples_out)
+{
+    const guint32 *buckets;
+    gsize          n_buckets;
+    guint64        n_samples = 0;
+    guint64        threshold;
+    guint64        accumulated = 0;
+    gsize          i;
+
+    buckets = g_variant_get_fixed_array (histogram, &n_buckets, sizeof (guint32));
+    for (i = 0; i < n_buckets; i++)
+        n_samples += buckets[i];
+    *n_samples_out = n_samples;
+    if (!n_samples)
+        return 0;
+
+    threshold = (n_samples * percentile + 99) / 100;
+    for (i = 0; i < n_buckets && i < n_limits; i++) {
+        accumulated += buckets[i];
+        if (accumulated >= threshold)
+            return limits[i];
+    }
+    return G_MAXUINT;
+}
+
+static void
+print_port_stats_phase (GVariantDict *command,
+                        const gchar  *phase,
+                        const guint  *limits,
+                        gsize         n_limits)
+{
+    GVariant *histogram;
+    gchar    *key;
+    guint64   total_us = 0;
+    guint64   max_us = 0;
+    guint64   n_samples;
+    guint     p50;
+    guint     p95;
+
+    histogram = g_variant_dict_lookup_value (command, phase, G_VARIANT_TYPE ("au"));
+    if (!histogram)
+        return;
+
+    key = g_strdup_printf ("%s-total-us", phase);
+    g_variant_dict_lookup (command, key, "t", &total_us);
+    g_free (key);
+    key = g_strdup_printf ("%s-max-us", phase);
+    g_variant_dict_lookup (command, key, "t", &max_us);
+    g_free (key);
+
+    p50 = histogram_get_percentile (histogram, limits, n_limits, 50, &n_samples);
+    p95 = histogram_get_percentile (histogram, limits, n_limits, 95, &n_samples);
+    g_variant_unref (histogram);
+
+    if (!n_samples)
+        return;
+
+    g_print ("  %12s: %" G_GUINT64_FORMAT " samples, avg %.3f ms, max %.3f ms",
+             phase, n_samples,
+             (gdouble) total_us / (gdouble) n_samples / 1000.0,
+             (gdouble) max_us / 1000.0);
+    if (p50 == G_MAXUINT)
+        g_print (", p50 > %u ms", limits[n_limits - 2]);
+    else
+        g_print (", p50 <= %u ms", p50);
+    if (p95 == G_MAXUINT)
+        g_print (", p95 > %u ms\n", limits[n_limits - 2]);
+    else
+        g_print (", p95 <= %u ms\n", p95);
+}
+
+static void
+print_port_stats (void)
+{
+    MmGdbusModemStats *stats;
+    GVariant          *buckets;
+    GVariant          *ports = NULL;
+    GVariant          *monitor;
+    GVariant          *polls = NULL;
+    const guint32     *limits = NULL;
+    gsize              n_limits = 0;
+    GVariantIter       ports_iter;
+    GVariant          *port;
+    GError            *error = NULL;
+
+    stats = mm_gdbus_object_get_modem_stats (MM_GDBUS_OBJECT (ctx->object));
+    if (!stats) {
+        g_printerr ("error: modem has no statistics support\n");
+        exit (EXIT_FAILURE);
+    }
+    mmcli_force_operation_timeout (G_DBUS_PROXY (stats));
+
+    if (!mm_gdbus_modem_stats_call_get_port_stats_sync (stats, &ports, NULL, &error)) {
+        g_printerr ("error: couldn't get port statistics: '%s'\n",
+                    error ? error->message : "unknown error");
+        exit (EXIT_FAILURE);
+    }
+
+    buckets = mm_gdbus_modem_stats_dup_histogram_buckets (stats);
+    if (buckets)
+        limits = g_variant_get_fixed_array (buckets, &n_limits, sizeof (guint32));
+    if (n_limits < 2) {
+        g_printerr ("error: invalid histogram buckets reported\n");
+        exit (EXIT_FAILURE);
+    }
+
+    g_variant_iter_init (&ports_iter, ports);
+    while ((port = g_variant_iter_next_value (&ports_iter)) != NULL) {
+        GVariantDict  port_dict;
+        const gchar  *name = NULL;
+        guint32       port_type = MM_MODEM_PORT_TYPE_UNKNOWN;
+        guint32       queue_depth = 0;
+        guint32       queue_depth_max = 0;
+        GVariant     *commands;
+        GVariant     *events;
+
+        g_variant_dict_init (&port_dict, port);
+        g_variant_dict_lookup (&port_dict, "port", "&s", &name);
+        g_variant_dict_lookup (&port_dict, "port-type", "u", &port_type);
+        g_variant_dict_lookup (&port_dict, "queue-depth", "u", &queue_depth);
+        g_variant_dict_lookup (&port_dict, "queue-depth-max", "u", &queue_depth_max);
+
+        g_print ("%s (%s): queue depth %u (max %u)\n",
+                 name ? name : "unknown",
+                 mm_modem_port_type_get_string (port_type),
+                 queue_depth, queue_depth_max);
+
+        commands = g_variant_dict_lookup_value (&port_dict, "commands", G_VARIANT_TYPE ("aa{sv}"));
+        if (commands) {
+            GVariantIter  commands_iter;
+            GVariant     *command;
+
+            g_variant_iter_init (&commands_iter, commands);
+            while ((command = g_variant_iter_next_value (&commands_iter)) != NULL) {
+                GVariantDict  command_dict;
+                const gchar  *key = NULL;
+                guint32       n_ok = 0;
+                guint32       n_errors = 0;
+                guint32       n_timeouts = 0;
+
+                g_variant_dict_init (&command_dict, command);
+                g_variant_dict_lookup (&command_dict, "key", "&s", &key);
+                g_variant_dict_lookup (&command_dict, "ok", "u", &n_ok);
+                g_variant_dict_lookup (&command_dict, "errors", "u", &n_errors);
+                g_variant_dict_lookup (&command_dict, "timeouts", "u", &n_timeouts);
+
+                g_print (" %s: %u ok, %u errors, %u timeouts\n",
+                         key ? key : "unknown", n_ok, n_errors, n_timeouts);
+                print_port_stats_phase (&command_dict, "queue-wait", limits, n_limits);
+                print_port_stats_phase (&command_dict, "send",       limits, n_limits);
+                print_port_stats_phase (&command_dict, "response",   limits, n_limits);
+
+                g_variant_dict_clear (&command_dict);
+                g_variant_unref (command);
+            }
+            g_variant_unref (commands);
+        }
+
+        events = g_variant_dict_lookup_value (&port_dict, "events", G_VARIANT_TYPE ("a{sv}"));
+        if (events) {
+            GVariantIter  events_iter;
+            const gchar  *event;
+            GVariant     *value;
+
+            g_variant_iter_init (&events_iter, events);
+            while (g_variant_iter_next (&events_iter, "{&sv}", &event, &value)) {
+                if (g_variant_is_of_type (value, G_VARIANT_TYPE_UINT32))
+                    g_print (" %s: %u\n", event, g_variant_get_uint32 (value));
+                g_variant_unref (value);
+            }
+            g_variant_unref (events);
+        }
+
+        g_variant_dict_clear (&port_dict);
+        g_variant_unref (port);
+    }
+
+    monitor = mm_gdbus_modem_stats_get_bearer_monitor (stats);
+    if (monitor) {
+        GVariantDict monitor_dict;
+        guint32      poll_disconnects = 0;
+        guint32      netlink_disconnects = 0;
+        guint32      netlink_checks = 0;
+
+        g_variant_dict_init (&monitor_dict, monitor);
+        g_variant_dict_lookup (&monitor_dict, "poll-disconnects", "u", &poll_disconnects);
+        g_variant_dict_lookup (&monitor_dict, "netlink-disconnects", "u", &netlink_disconnects);
+        g_variant_dict_lookup (&monitor_dict, "netlink-checks", "u", &netlink_checks);
+        g_print ("bearer monitor: %u disconnects detected polling, %u via netlink (%u netlink-triggered checks)\n",
+                 poll_disconnects, netlink_disconnects, netlink_checks);
+        g_variant_dict_clear (&monitor_dict);
+    }
+
+    if (!mm_gdbus_modem_stats_call_get_poll_stats_sync (stats, &polls, NULL, &error)) {
+        g_printerr ("error: couldn't get poll statistics: '%s'\n",
+                    error ? error->message : "unknown error");
+        g_clear_error (&error);
+    } else {
+        GVariantDict polls_dict;
+        guint32      budget = 0;
+        guint32      n_polls = 0;
+        guint32      n_deferred_busy = 0;
+        guint32      n_deferred_load = 0;
+        guint32      n_skipped_fresh = 0;
+
+        g_variant_dict_init (&polls_dict, polls);
+        if (g_variant_dict_lookup (&polls_dict, "budget", "u", &budget)) {
+            g_variant_dict_lookup (&polls_dict, "polls", "u", &n_polls);
+            g_variant_dict_lookup (&polls_dict, "deferred-busy", "u", &n_deferred_busy);
+            g_variant_dict_lookup (&polls_dict, "deferred-load", "u", &n_deferred_load);
+            g_variant_dict_lookup (&polls_dict, "skipped-fresh", "u", &n_skipped_fresh);
+            g_print ("periodic queries: %u run (budget %u/s), %u deferred while busy, %u deferred by budget, %u skipped with fresh data\n",
+                     n_polls, budget, n_deferred_busy, n_deferred_load, n_skipped_fresh);
+        }
+        g_variant_dict_clear (&polls_dict);
+        g_variant_unref (polls);
+    }
+
+    if (buckets)
+        g_variant_unref (buckets);
+    g_variant_unref (ports);
+    g_object_unref (stats);
+}
+
 static void
 print_bearer_short_info (MMBearer *bearer)
 {
@@ -933,7 +1169,7 @@ get_modem_ready (GObject      *source,
     if (ctx->modem_cdma)
         mmcli_force_operation_timeout (G_DBUS_PROXY (ctx->modem_cdma));
 
-    if (info_flag)
+    if (info_flag || port_stats_flag)
         g_assert_not_reached ();
 
     /* Request to monitor modems? */
@@ -1198,6 +1434,13 @@ mmcli_modem_run_synchronous (GDBusConnection *connection)
         return;
     }
 
+    /* Request to get port statistics from modem? */
+    if (port_stats_flag) {
+        g_debug ("Printing modem port statistics...");
+        print_port_stats ();
+        return;
+    }
+
     /* Request to enable the modem? */
     if (enable_flag) {
         gboolean result;
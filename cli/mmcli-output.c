@@ -747,6 +747,47 @@ mmcli_output_pco_list (GList *pco_list)
     output_item_new_take_multiple (MMC_F_3GPP_PCO, (gchar **) g_ptr_array_free (aux, FALSE), TRUE);
 }
 
+/******************************************************************************/
+/* (Custom) Modem snapshot output */
+
+static gchar *
+build_signal_value_string (gdouble value)
+{
+    return (value != MM_SIGNAL_UNKNOWN) ? g_strdup_printf ("%.2lf", value) : NULL;
+}
+
+void
+mmcli_output_modem_snapshot (const MMModemSnapshot *snapshot)
+{
+    mmcli_output_string            (MMC_F_GENERAL_DBUS_PATH,          snapshot->path);
+    mmcli_output_string            (MMC_F_HARDWARE_MANUFACTURER,      snapshot->manufacturer);
+    mmcli_output_string            (MMC_F_HARDWARE_MODEL,             snapshot->model);
+    mmcli_output_string            (MMC_F_HARDWARE_REVISION,          snapshot->revision);
+    mmcli_output_string            (MMC_F_HARDWARE_EQUIPMENT_ID,      snapshot->equipment_identifier);
+    mmcli_output_string            (MMC_F_SYSTEM_DEVICE,              snapshot->device);
+    mmcli_output_string            (MMC_F_SYSTEM_PLUGIN,              snapshot->plugin);
+    mmcli_output_string            (MMC_F_SYSTEM_PRIMARY_PORT,        snapshot->primary_port);
+    mmcli_output_string            (MMC_F_STATUS_LOCK,                mm_modem_lock_get_string (snapshot->unlock_required));
+    mmcli_output_state             (snapshot->state, snapshot->state_failed_reason);
+    mmcli_output_string            (MMC_F_STATUS_POWER_STATE,         mm_modem_power_state_get_string (snapshot->power_state));
+    mmcli_output_string_list_take  (MMC_F_STATUS_ACCESS_TECH,         mm_modem_access_technology_build_string_from_mask (snapshot->access_technologies));
+    mmcli_output_signal_quality    (snapshot->signal_quality, snapshot->signal_quality_recent);
+    mmcli_output_string            (MMC_F_3GPP_IMEI,                  snapshot->imei);
+    mmcli_output_string            (MMC_F_3GPP_OPERATOR_ID,           snapshot->operator_code);
+    mmcli_output_string            (MMC_F_3GPP_OPERATOR_NAME,         snapshot->operator_name);
+    mmcli_output_string            (MMC_F_3GPP_REGISTRATION,          mm_modem_3gpp_registration_state_get_string (snapshot->registration_state));
+    mmcli_output_string            (MMC_F_SIM_PATH,                   snapshot->sim_path);
+    mmcli_output_string_array      (MMC_F_BEARER_PATHS,               snapshot->bearer_paths[0] ? (const gchar **) snapshot->bearer_paths : NULL, TRUE);
+    mmcli_output_string_take_typed (MMC_F_SIGNAL_REFRESH_RATE,        snapshot->signal_rate ? g_strdup_printf ("%u", snapshot->signal_rate) : NULL, "seconds");
+    mmcli_output_string_take_typed (MMC_F_SIGNAL_GSM_RSSI,            build_signal_value_string (snapshot->gsm_rssi),  "dBm");
+    mmcli_output_string_take_typed (MMC_F_SIGNAL_UMTS_RSSI,           build_signal_value_string (snapshot->umts_rssi), "dBm");
+    mmcli_output_string_take_typed (MMC_F_SIGNAL_UMTS_ECIO,           build_signal_value_string (snapshot->umts_ecio), "dB");
+    mmcli_output_string_take_typed (MMC_F_SIGNAL_LTE_RSSI,            build_signal_value_string (snapshot->lte_rssi),  "dBm");
+    mmcli_output_string_take_typed (MMC_F_SIGNAL_LTE_RSRQ,            build_signal_value_string (snapshot->lte_rsrq),  "dB");
+    mmcli_output_string_take_typed (MMC_F_SIGNAL_LTE_RSRP,            build_signal_value_string (snapshot->lte_rsrp),  "dBm");
+    mmcli_output_string_take_typed (MMC_F_SIGNAL_LTE_SNR,             build_signal_value_string (snapshot->lte_snr),   "dB");
+}
+
 /******************************************************************************/
 /* Human-friendly output */
 
@@ -331,6 +331,7 @@ void mmcli_output_scan_networks    (GList                    *network_list);
 void mmcli_output_firmware_list    (GList                    *firmware_list,
                                     MMFirmwareProperties     *selected);
 void mmcli_output_pco_list         (GList                    *pco_list);
+void mmcli_output_modem_snapshot   (const MMModemSnapshot    *snapshot);
 
 /******************************************************************************/
 /* Dump output */
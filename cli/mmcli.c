@@ -49,6 +49,7 @@ static gboolean output_json_flag;
 static gboolean verbose_flag;
 static gboolean version_flag;
 static gboolean async_flag;
+static gboolean batch_flag;
 static gint timeout = 30; /* by default, use 30s for all operations */
 
 static GOptionEntry main_entries[] = {
@@ -72,6 +73,10 @@ static GOptionEntry main_entries[] = {
       "Use asynchronous methods",
       NULL
     },
+    { "batch", 0, 0, G_OPTION_ARG_NONE, &batch_flag,
+      "Run commands read from stdin, one per line, with key-value output",
+      NULL
+    },
     { "timeout", 0, 0, G_OPTION_ARG_INT, &timeout,
       "Timeout for the operation",
       "[SECONDS]"
@@ -246,7 +251,7 @@ main (gint argc, gchar **argv)
         g_printerr ("error: only one output type supported at the same time\n");
         exit (EXIT_FAILURE);
     }
-    if (output_keyvalue_flag) {
+    if (output_keyvalue_flag || batch_flag) {
         if (verbose_flag) {
             g_printerr ("error: cannot set verbose output in keyvalue output type\n");
             exit (EXIT_FAILURE);
@@ -280,8 +285,25 @@ main (gint argc, gchar **argv)
     cancellable = g_cancellable_new ();
     loop = g_main_loop_new (NULL, FALSE);
 
+    /* Batch mode? */
+    if (batch_flag) {
+        /* Ensure no other action is requested */
+        if (output_json_flag ||
+            mmcli_manager_options_enabled () ||
+            mmcli_modem_options_enabled () ||
+            mmcli_sim_options_enabled () ||
+            mmcli_bearer_options_enabled () ||
+            mmcli_sms_options_enabled () ||
+            mmcli_call_options_enabled ()) {
+            g_printerr ("error: cannot use batch mode with other actions\n");
+            exit (EXIT_FAILURE);
+        }
+
+        mmcli_force_async_operation ();
+        mmcli_batch_run (connection, cancellable);
+    }
     /* Manager options? */
-    if (mmcli_manager_options_enabled ()) {
+    else if (mmcli_manager_options_enabled ()) {
         /* Ensure options from different groups are not enabled */
         if (mmcli_modem_options_enabled ()) {
             g_printerr ("error: cannot use manager and modem options "
@@ -412,7 +434,9 @@ main (gint argc, gchar **argv)
     if (async_flag)
         g_main_loop_run (loop);
 
-    if (mmcli_manager_options_enabled ()) {
+    if (batch_flag) {
+        mmcli_batch_shutdown ();
+    } else if (mmcli_manager_options_enabled ()) {
         mmcli_manager_shutdown ();
     } else if (mmcli_modem_3gpp_options_enabled ()) {
         mmcli_modem_3gpp_shutdown ();
@@ -29,6 +29,11 @@ void          mmcli_force_async_operation   (void);
 void          mmcli_force_sync_operation    (void);
 void          mmcli_force_operation_timeout (GDBusProxy *proxy);
 
+/* Batch mode */
+void          mmcli_batch_run      (GDBusConnection *connection,
+                                    GCancellable    *cancellable);
+void          mmcli_batch_shutdown (void);
+
 /* Manager group */
 GOptionGroup *mmcli_manager_get_option_group (void);
 gboolean      mmcli_manager_options_enabled  (void);
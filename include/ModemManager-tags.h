@@ -205,4 +205,15 @@
  */
 #define ID_MM_TTY_FLOW_CONTROL "ID_MM_TTY_FLOW_CONTROL"
 
+/**
+ * ID_MM_POLL_BUDGET:
+ *
+ * This is a device-specific tag that sets the maximum number of periodic
+ * queries (signal quality, registration status...) run per second on the
+ * modem, overriding the value given in the daemon command line.
+ *
+ * The value of the tag should be a positive integer, e.g. "2".
+ */
+#define ID_MM_POLL_BUDGET "ID_MM_POLL_BUDGET"
+
 #endif /* MM_TAGS_H */
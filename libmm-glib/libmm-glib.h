@@ -33,6 +33,7 @@
 #if !defined (_LIBMM_INSIDE_MM)
 /* This headers are not exported within ModemManager */
 # include <mm-manager.h>
+# include <mm-fleet-snapshot.h>
 # include <mm-object.h>
 # include <mm-sim.h>
 # include <mm-sms.h>
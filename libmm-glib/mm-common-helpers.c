@@ -1611,14 +1611,154 @@ mm_utils_hex2byte (const gchar *hex)
     return (a << 4) | b;
 }
 
+/* End from hostap */
+
+/* Hex encoding and decoding is done 8 hex digits (4 bytes) at a time, using
+ * 64-bit words as vectors of 8 lanes (SWAR); the remaining digits are
+ * processed one by one with the scalar helpers above. */
+
+#define SWAR_ONES  G_GUINT64_CONSTANT (0x0101010101010101)
+#define SWAR_HIGH  G_GUINT64_CONSTANT (0x8080808080808080)
+#define SWAR_LOW   G_GUINT64_CONSTANT (0x0F0F0F0F0F0F0F0F)
+
+/* Lanes with the high bit set if the (7-bit) value in the lane is >= n */
+#define SWAR_GE(v, n) ((v) + SWAR_ONES * (0x80 - (n)))
+/* Lanes with the high bit set if the (7-bit) value in the lane is > n */
+#define SWAR_GT(v, n) ((v) + SWAR_ONES * (0x7F - (n)))
+
+static inline gboolean
+hex_decode_word (const gchar *hex,
+                 guint8      *out)
+{
+    guint64 v;
+    guint64 l;
+    guint64 digit;
+    guint64 letter;
+    guint64 nibbles;
+    guint32 bytes;
+
+    memcpy (&v, hex, sizeof (v));
+    v = GUINT64_FROM_LE (v);
+
+    /* Non-ASCII chars are never valid; rejecting them first also ensures
+     * that the range checks below never carry between lanes */
+    if (v & SWAR_HIGH)
+        return FALSE;
+
+    digit  = SWAR_GE (v, '0') & ~SWAR_GT (v, '9');
+    l      = v | (SWAR_ONES * 0x20);
+    letter = SWAR_GE (l, 'a') & ~SWAR_GT (l, 'f');
+    if (((digit | letter) & SWAR_HIGH) != SWAR_HIGH)
+        return FALSE;
+
+    /* Both '1', 'a' and 'A' have 1 in the low nibble; add 9 to letters */
+    nibbles = (v & SWAR_LOW) + ((letter & SWAR_HIGH) >> 7) * 9;
+
+    /* Merge each pair of nibbles in the even lanes, and pack them */
+    nibbles = ((nibbles << 4) | (nibbles >> 8)) & G_GUINT64_CONSTANT (0x00FF00FF00FF00FF);
+    nibbles = (nibbles | (nibbles >> 8))  & G_GUINT64_CONSTANT (0x0000FFFF0000FFFF);
+    nibbles = (nibbles | (nibbles >> 16)) & G_GUINT64_CONSTANT (0x00000000FFFFFFFF);
+
+    bytes = GUINT32_TO_LE ((guint32) nibbles);
+    memcpy (out, &bytes, sizeof (bytes));
+    return TRUE;
+}
+
+static inline void
+hex_encode_word (const guint8 *bin,
+                 gchar        *out)
+{
+    guint32 bytes;
+    guint64 v;
+    guint64 nibbles;
+    guint64 letter;
+
+    memcpy (&bytes, bin, sizeof (bytes));
+    v = GUINT32_FROM_LE (bytes);
+
+    /* Spread the 4 bytes to the even lanes */
+    v = (v | (v << 16)) & G_GUINT64_CONSTANT (0x0000FFFF0000FFFF);
+    v = (v | (v << 8))  & G_GUINT64_CONSTANT (0x00FF00FF00FF00FF);
+
+    /* High nibble in the even lanes, low nibble in the odd lanes */
+    nibbles = ((v >> 4) & G_GUINT64_CONSTANT (0x000F000F000F000F)) |
+              ((v & G_GUINT64_CONSTANT (0x000F000F000F000F)) << 8);
+
+    /* Uppercase, 'A' is 7 chars after '9' + 1 */
+    letter  = (SWAR_GT (nibbles, 9) & SWAR_HIGH) >> 7;
+    nibbles = nibbles + SWAR_ONES * '0' + letter * 7;
+
+    nibbles = GUINT64_TO_LE (nibbles);
+    memcpy (out, &nibbles, sizeof (nibbles));
+}
+
+static gboolean
+hex_decode (const gchar *hex,
+            gsize        len,
+            guint8      *out)
+{
+    gsize i = 0;
+    gint  a;
+
+    /* Input is always read before the output is written, and the output is
+     * never ahead of the input, so this also works in place */
+    for (; i + 8 <= len; i += 8, out += 4) {
+        if (!hex_decode_word (hex + i, out))
+            return FALSE;
+    }
+    for (; i < len; i += 2) {
+        a = mm_utils_hex2byte (hex + i);
+        if (a < 0)
+            return FALSE;
+        *out++ = a;
+    }
+    return TRUE;
+}
+
+/* Decode @hex_len chars of @hex into the caller-provided @out buffer. Fails if
+ * @hex isn't a valid hex string or if @out isn't big enough. */
+gboolean
+mm_utils_hexstr2bin_buf (const gchar *hex,
+                         gsize        hex_len,
+                         guint8      *out,
+                         gsize        out_size,
+                         gsize       *out_len)
+{
+    g_return_val_if_fail (hex != NULL, FALSE);
+    g_return_val_if_fail (out != NULL || !hex_len, FALSE);
+
+    if ((hex_len % 2) != 0 || (hex_len / 2) > out_size)
+        return FALSE;
+    if (!hex_decode (hex, hex_len, out))
+        return FALSE;
+    if (out_len)
+        *out_len = hex_len / 2;
+    return TRUE;
+}
+
+/* Decode @hex in the same buffer; the binary data is NUL-terminated. If the
+ * decoding fails the contents of @hex are undefined. */
+gboolean
+mm_utils_hexstr2bin_inplace (gchar *hex,
+                             gsize *out_len)
+{
+    gsize len;
+
+    g_return_val_if_fail (hex != NULL, FALSE);
+
+    len = strlen (hex);
+    if ((len % 2) != 0 || !hex_decode (hex, len, (guint8 *) hex))
+        return FALSE;
+    hex[len / 2] = '\0';
+    if (out_len)
+        *out_len = len / 2;
+    return TRUE;
+}
+
 gchar *
 mm_utils_hexstr2bin (const gchar *hex, gsize *out_len)
 {
-    const gchar *ipos = hex;
-    gchar *buf = NULL;
-    gsize i;
-    gint a;
-    gchar *opos;
+    gchar *buf;
     gsize len;
 
     len = strlen (hex);
@@ -1626,59 +1766,73 @@ mm_utils_hexstr2bin (const gchar *hex, gsize *out_len)
     /* Length must be a multiple of 2 */
     g_return_val_if_fail ((len % 2) == 0, NULL);
 
-    opos = buf = g_malloc0 ((len / 2) + 1);
-    for (i = 0; i < len; i += 2) {
-        a = mm_utils_hex2byte (ipos);
-        if (a < 0) {
-            g_free (buf);
-            return NULL;
-        }
-        *opos++ = a;
-        ipos += 2;
+    buf = g_malloc ((len / 2) + 1);
+    if (!hex_decode (hex, len, (guint8 *) buf)) {
+        g_free (buf);
+        return NULL;
     }
+    buf[len / 2] = '\0';
     *out_len = len / 2;
     return buf;
 }
 
-/* End from hostap */
-
 gboolean
 mm_utils_ishexstr (const gchar *hex)
 {
-    gsize len;
-    gsize i;
+    guint8 scratch[4];
+    gsize  len;
+    gsize  i;
 
     /* Length not multiple of 2? */
     len = strlen (hex);
     if (len % 2 != 0)
         return FALSE;
 
-    for (i = 0; i < len; i++) {
+    for (i = 0; i + 8 <= len; i += 8) {
+        if (!hex_decode_word (hex + i, scratch))
+            return FALSE;
+    }
+    for (; i < len; i++) {
         /* Non-hex char? */
-        if (hex[i] >= '0' && hex[i] <= '9')
-            continue;
-        if (hex[i] >= 'a' && hex[i] <= 'f')
-            continue;
-        if (hex[i] >= 'A' && hex[i] <= 'F')
-            continue;
-        return FALSE;
+        if (hex2num (hex[i]) < 0)
+            return FALSE;
     }
 
     return TRUE;
 }
 
+/* Encode @bin in the caller-provided @out buffer, which must have room for at
+ * least 2 * @len + 1 chars. */
+void
+mm_utils_bin2hexstr_buf (const guint8 *bin,
+                         gsize         len,
+                         gchar        *out)
+{
+    static const gchar digits[] = "0123456789ABCDEF";
+    gsize i = 0;
+
+    g_return_if_fail (bin != NULL || !len);
+    g_return_if_fail (out != NULL);
+
+    for (; i + 4 <= len; i += 4, out += 8)
+        hex_encode_word (bin + i, out);
+    for (; i < len; i++) {
+        *out++ = digits[bin[i] >> 4];
+        *out++ = digits[bin[i] & 0x0F];
+    }
+    *out = '\0';
+}
+
 gchar *
 mm_utils_bin2hexstr (const guint8 *bin, gsize len)
 {
-    GString *ret;
-    gsize i;
+    gchar *ret;
 
     g_return_val_if_fail (bin != NULL, NULL);
 
-    ret = g_string_sized_new (len * 2 + 1);
-    for (i = 0; i < len; i++)
-        g_string_append_printf (ret, "%.2X", bin[i]);
-    return g_string_free (ret, FALSE);
+    ret = g_malloc (len * 2 + 1);
+    mm_utils_bin2hexstr_buf (bin, len, ret);
+    return ret;
 }
 
 gboolean
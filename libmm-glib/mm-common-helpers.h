@@ -179,6 +179,18 @@ gchar    *mm_utils_hexstr2bin (const gchar *hex, gsize *out_len);
 gchar    *mm_utils_bin2hexstr (const guint8 *bin, gsize len);
 gboolean  mm_utils_ishexstr   (const gchar *hex);
 
+/* Same as above, without allocating the output */
+gboolean  mm_utils_hexstr2bin_buf     (const gchar  *hex,
+                                       gsize         hex_len,
+                                       guint8       *out,
+                                       gsize         out_size,
+                                       gsize        *out_len);
+gboolean  mm_utils_hexstr2bin_inplace (gchar        *hex,
+                                       gsize        *out_len);
+void      mm_utils_bin2hexstr_buf     (const guint8 *bin,
+                                       gsize         len,
+                                       gchar        *out);
+
 gboolean  mm_utils_check_for_single_value (guint32 value);
 
 #if GLIB_CHECK_VERSION(2, 44, 0)
@@ -0,0 +1,320 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * libmm -- Access modem status & information from glib applications
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+#include <string.h>
+
+#include "mm-fleet-snapshot.h"
+#include "mm-object.h"
+#include "mm-modem.h"
+#include "mm-modem-3gpp.h"
+#include "mm-modem-signal.h"
+#include "mm-signal.h"
+
+/**
+ * SECTION: mm-fleet-snapshot
+ * @title: MMFleetSnapshot
+ * @short_description: Snapshot of all the modems known to the manager
+ *
+ * The #MMFleetSnapshot is a read-only copy of the properties of all the modem
+ * objects in the #MMManager object cache, taken in a single pass and without
+ * any additional DBus round trip.
+ *
+ * This object is retrieved with mm_manager_get_fleet_snapshot(), and it is
+ * the preferred way to monitor a large number of modems, as it avoids
+ * building per-interface objects and per-property allocations for each of
+ * them.
+ */
+
+struct _MMFleetSnapshot {
+    volatile gint  ref_count;
+    /* Array of MMModemSnapshot, sorted by path */
+    GArray        *modems;
+    /* All strings, deduplicated */
+    GStringChunk  *strings;
+};
+
+/*****************************************************************************/
+
+static const gchar *
+add_string (MMFleetSnapshot *self,
+            const gchar     *str)
+{
+    /* Empty strings are reported as unknown, same as the per-modem getters */
+    if (!str || !str[0])
+        return NULL;
+    return g_string_chunk_insert_const (self->strings, str);
+}
+
+static const gchar * const *
+add_strv (MMFleetSnapshot     *self,
+          const gchar * const *strv)
+{
+    const gchar **out;
+    guint         n;
+    guint         i;
+
+    n = strv ? g_strv_length ((gchar **) strv) : 0;
+    out = g_new0 (const gchar *, n + 1);
+    for (i = 0; i < n; i++)
+        out[i] = g_string_chunk_insert_const (self->strings, strv[i]);
+    return (const gchar * const *) out;
+}
+
+static void
+load_signal (MMSignal *signal,
+             gdouble  *rssi,
+             gdouble  *ecio,
+             gdouble  *rsrq,
+             gdouble  *rsrp,
+             gdouble  *snr)
+{
+    if (!signal)
+        return;
+    if (rssi)
+        *rssi = mm_signal_get_rssi (signal);
+    if (ecio)
+        *ecio = mm_signal_get_ecio (signal);
+    if (rsrq)
+        *rsrq = mm_signal_get_rsrq (signal);
+    if (rsrp)
+        *rsrp = mm_signal_get_rsrp (signal);
+    if (snr)
+        *snr = mm_signal_get_snr (signal);
+    g_object_unref (signal);
+}
+
+static gboolean
+load_modem (MMFleetSnapshot *self,
+            MMObject        *object,
+            MMModemSnapshot *snapshot)
+{
+    MMModem       *modem;
+    MMModem3gpp   *modem_3gpp;
+    MMModemSignal *modem_signal;
+
+    modem = mm_object_peek_modem (object);
+    if (!modem)
+        return FALSE;
+
+    memset (snapshot, 0, sizeof (MMModemSnapshot));
+
+    snapshot->path                 = add_string (self, mm_object_get_path (object));
+    snapshot->manufacturer         = add_string (self, mm_modem_get_manufacturer (modem));
+    snapshot->model                = add_string (self, mm_modem_get_model (modem));
+    snapshot->revision             = add_string (self, mm_modem_get_revision (modem));
+    snapshot->equipment_identifier = add_string (self, mm_modem_get_equipment_identifier (modem));
+    snapshot->device               = add_string (self, mm_modem_get_device (modem));
+    snapshot->plugin               = add_string (self, mm_modem_get_plugin (modem));
+    snapshot->primary_port         = add_string (self, mm_modem_get_primary_port (modem));
+    snapshot->sim_path             = add_string (self, mm_modem_get_sim_path (modem));
+    snapshot->bearer_paths         = add_strv   (self, mm_modem_get_bearer_paths (modem));
+    snapshot->state                = mm_modem_get_state (modem);
+    snapshot->state_failed_reason  = mm_modem_get_state_failed_reason (modem);
+    snapshot->power_state          = mm_modem_get_power_state (modem);
+    snapshot->unlock_required      = mm_modem_get_unlock_required (modem);
+    snapshot->access_technologies  = mm_modem_get_access_technologies (modem);
+    snapshot->signal_quality       = mm_modem_get_signal_quality (modem, &snapshot->signal_quality_recent);
+
+    /* The SIM path is reported as "/" when there is no SIM */
+    if (snapshot->sim_path && g_str_equal (snapshot->sim_path, "/"))
+        snapshot->sim_path = NULL;
+
+    snapshot->registration_state = MM_MODEM_3GPP_REGISTRATION_STATE_UNKNOWN;
+    modem_3gpp = mm_object_peek_modem_3gpp (object);
+    if (modem_3gpp) {
+        snapshot->imei               = add_string (self, mm_modem_3gpp_get_imei (modem_3gpp));
+        snapshot->registration_state = mm_modem_3gpp_get_registration_state (modem_3gpp);
+        snapshot->operator_code      = add_string (self, mm_modem_3gpp_get_operator_code (modem_3gpp));
+        snapshot->operator_name      = add_string (self, mm_modem_3gpp_get_operator_name (modem_3gpp));
+    }
+
+    snapshot->gsm_rssi  = MM_SIGNAL_UNKNOWN;
+    snapshot->umts_rssi = MM_SIGNAL_UNKNOWN;
+    snapshot->umts_ecio = MM_SIGNAL_UNKNOWN;
+    snapshot->lte_rssi  = MM_SIGNAL_UNKNOWN;
+    snapshot->lte_rsrq  = MM_SIGNAL_UNKNOWN;
+    snapshot->lte_rsrp  = MM_SIGNAL_UNKNOWN;
+    snapshot->lte_snr   = MM_SIGNAL_UNKNOWN;
+    modem_signal = mm_object_peek_modem_signal (object);
+    if (modem_signal) {
+        snapshot->signal_rate = mm_modem_signal_get_rate (modem_signal);
+        load_signal (mm_modem_signal_get_gsm (modem_signal),
+                     &snapshot->gsm_rssi, NULL, NULL, NULL, NULL);
+        load_signal (mm_modem_signal_get_umts (modem_signal),
+                     &snapshot->umts_rssi, &snapshot->umts_ecio, NULL, NULL, NULL);
+        load_signal (mm_modem_signal_get_lte (modem_signal),
+                     &snapshot->lte_rssi, NULL, &snapshot->lte_rsrq, &snapshot->lte_rsrp, &snapshot->lte_snr);
+    }
+
+    return TRUE;
+}
+
+static gint
+modem_snapshot_cmp (const MMModemSnapshot *a,
+                    const MMModemSnapshot *b)
+{
+    return g_strcmp0 (a->path, b->path);
+}
+
+MMFleetSnapshot *
+mm_fleet_snapshot_new_from_objects (GList *objects)
+{
+    MMFleetSnapshot *self;
+    GList           *l;
+
+    self = g_slice_new0 (MMFleetSnapshot);
+    self->ref_count = 1;
+    self->strings = g_string_chunk_new (1024);
+    self->modems = g_array_sized_new (FALSE, FALSE, sizeof (MMModemSnapshot), g_list_length (objects));
+
+    for (l = objects; l; l = g_list_next (l)) {
+        MMModemSnapshot snapshot;
+
+        if (MM_IS_OBJECT (l->data) && load_modem (self, MM_OBJECT (l->data), &snapshot))
+            g_array_append_val (self->modems, snapshot);
+    }
+
+    /* Sort by path, so that lookups can be done with a binary search */
+    g_array_sort (self->modems, (GCompareFunc) modem_snapshot_cmp);
+    return self;
+}
+
+/*****************************************************************************/
+
+/**
+ * mm_fleet_snapshot_get_n_modems:
+ * @self: A #MMFleetSnapshot.
+ *
+ * Gets the number of modems in the snapshot.
+ *
+ * Returns: the number of modems.
+ */
+guint
+mm_fleet_snapshot_get_n_modems (MMFleetSnapshot *self)
+{
+    g_return_val_if_fail (self != NULL, 0);
+
+    return self->modems->len;
+}
+
+/**
+ * mm_fleet_snapshot_peek_modem:
+ * @self: A #MMFleetSnapshot.
+ * @i: Index of the modem, lower than mm_fleet_snapshot_get_n_modems().
+ *
+ * Gets the information of the modem at index @i. Modems are sorted by DBus
+ * path.
+ *
+ * Returns: (transfer none): A #MMModemSnapshot, valid as long as @self is.
+ */
+const MMModemSnapshot *
+mm_fleet_snapshot_peek_modem (MMFleetSnapshot *self,
+                              guint            i)
+{
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (i < self->modems->len, NULL);
+
+    return &g_array_index (self->modems, MMModemSnapshot, i);
+}
+
+/**
+ * mm_fleet_snapshot_lookup_modem:
+ * @self: A #MMFleetSnapshot.
+ * @path: DBus path of the modem.
+ *
+ * Looks for the information of the modem with the given DBus path.
+ *
+ * Returns: (transfer none): A #MMModemSnapshot, valid as long as @self is, or
+ * %NULL if not found.
+ */
+const MMModemSnapshot *
+mm_fleet_snapshot_lookup_modem (MMFleetSnapshot *self,
+                                const gchar     *path)
+{
+    guint low;
+    guint high;
+
+    g_return_val_if_fail (self != NULL, NULL);
+    g_return_val_if_fail (path != NULL, NULL);
+
+    low = 0;
+    high = self->modems->len;
+    while (low < high) {
+        MMModemSnapshot *snapshot;
+        guint            mid;
+        gint             cmp;
+
+        mid = low + (high - low) / 2;
+        snapshot = &g_array_index (self->modems, MMModemSnapshot, mid);
+        cmp = g_strcmp0 (path, snapshot->path);
+        if (cmp == 0)
+            return snapshot;
+        if (cmp < 0)
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    return NULL;
+}
+
+/*****************************************************************************/
+
+/**
+ * mm_fleet_snapshot_ref:
+ * @self: A #MMFleetSnapshot.
+ *
+ * Atomically increments the reference count of @self by one.
+ *
+ * Returns: the passed in #MMFleetSnapshot.
+ */
+MMFleetSnapshot *
+mm_fleet_snapshot_ref (MMFleetSnapshot *self)
+{
+    g_return_val_if_fail (self != NULL, NULL);
+
+    g_atomic_int_inc (&self->ref_count);
+    return self;
+}
+
+/**
+ * mm_fleet_snapshot_unref:
+ * @self: A #MMFleetSnapshot.
+ *
+ * Atomically decrements the reference count of @self by one. If the
+ * reference count drops to 0, @self is completely disposed.
+ */
+void
+mm_fleet_snapshot_unref (MMFleetSnapshot *self)
+{
+    guint i;
+
+    g_return_if_fail (self != NULL);
+
+    if (!g_atomic_int_dec_and_test (&self->ref_count))
+        return;
+
+    for (i = 0; i < self->modems->len; i++)
+        g_free ((gpointer) g_array_index (self->modems, MMModemSnapshot, i).bearer_paths);
+    g_array_unref (self->modems);
+    g_string_chunk_free (self->strings);
+    g_slice_free (MMFleetSnapshot, self);
+}
@@ -0,0 +1,136 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * libmm -- Access modem status & information from glib applications
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+#ifndef _MM_FLEET_SNAPSHOT_H_
+#define _MM_FLEET_SNAPSHOT_H_
+
+#if !defined (__LIBMM_GLIB_H_INSIDE__) && !defined (LIBMM_GLIB_COMPILATION)
+#error "Only <libmm-glib.h> can be included directly."
+#endif
+
+#include <ModemManager.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/**
+ * MMModemSnapshot:
+ * @path: DBus path of the modem.
+ * @manufacturer: Manufacturer of the modem, or %NULL if unknown.
+ * @model: Model of the modem, or %NULL if unknown.
+ * @revision: Firmware revision of the modem, or %NULL if unknown.
+ * @equipment_identifier: Equipment identifier of the modem, or %NULL if unknown.
+ * @device: Physical device of the modem, or %NULL if unknown.
+ * @plugin: Plugin handling the modem, or %NULL if unknown.
+ * @primary_port: Primary port of the modem, or %NULL if unknown.
+ * @sim_path: DBus path of the SIM, or %NULL if there is no SIM.
+ * @bearer_paths: %NULL-terminated array of DBus paths of the bearers.
+ * @state: A #MMModemState value.
+ * @state_failed_reason: A #MMModemStateFailedReason value.
+ * @power_state: A #MMModemPowerState value.
+ * @unlock_required: A #MMModemLock value.
+ * @access_technologies: A mask of #MMModemAccessTechnology values.
+ * @signal_quality: Signal quality, in percentage.
+ * @signal_quality_recent: Whether @signal_quality was recently taken.
+ * @imei: IMEI of the modem, or %NULL if unknown or not a 3GPP modem.
+ * @registration_state: A #MMModem3gppRegistrationState value.
+ * @operator_code: MCCMNC of the current operator, or %NULL if unknown.
+ * @operator_name: Name of the current operator, or %NULL if unknown.
+ * @signal_rate: Extended signal refresh rate in seconds, or 0 if disabled.
+ * @gsm_rssi: GSM RSSI, in dBm.
+ * @umts_rssi: UMTS RSSI, in dBm.
+ * @umts_ecio: UMTS Ec/Io, in dB.
+ * @lte_rssi: LTE RSSI, in dBm.
+ * @lte_rsrq: LTE RSRQ, in dB.
+ * @lte_rsrp: LTE RSRP, in dBm.
+ * @lte_snr: LTE S/R ratio, in dB.
+ *
+ * Typed copy of the most relevant properties of a modem object, as found in
+ * the #MMManager object cache when the #MMFleetSnapshot was taken.
+ *
+ * All strings are owned by the #MMFleetSnapshot. The extended signal values
+ * are set to %MM_SIGNAL_UNKNOWN if not available.
+ */
+typedef struct _MMModemSnapshot MMModemSnapshot;
+struct _MMModemSnapshot {
+    const gchar                   *path;
+    const gchar                   *manufacturer;
+    const gchar                   *model;
+    const gchar                   *revision;
+    const gchar                   *equipment_identifier;
+    const gchar                   *device;
+    const gchar                   *plugin;
+    const gchar                   *primary_port;
+    const gchar                   *sim_path;
+    const gchar * const           *bearer_paths;
+    MMModemState                   state;
+    MMModemStateFailedReason       state_failed_reason;
+    MMModemPowerState              power_state;
+    MMModemLock                    unlock_required;
+    MMModemAccessTechnology        access_technologies;
+    guint                          signal_quality;
+    gboolean                       signal_quality_recent;
+    const gchar                   *imei;
+    MMModem3gppRegistrationState   registration_state;
+    const gchar                   *operator_code;
+    const gchar                   *operator_name;
+    guint                          signal_rate;
+    gdouble                        gsm_rssi;
+    gdouble                        umts_rssi;
+    gdouble                        umts_ecio;
+    gdouble                        lte_rssi;
+    gdouble                        lte_rsrq;
+    gdouble                        lte_rsrp;
+    gdouble                        lte_snr;
+};
+
+/**
+ * MMFleetSnapshot:
+ *
+ * The #MMFleetSnapshot structure contains private data and should only be
+ * accessed using the provided API.
+ */
+typedef struct _MMFleetSnapshot MMFleetSnapshot;
+
+MMFleetSnapshot       *mm_fleet_snapshot_ref          (MMFleetSnapshot *self);
+void                   mm_fleet_snapshot_unref        (MMFleetSnapshot *self);
+
+guint                  mm_fleet_snapshot_get_n_modems (MMFleetSnapshot *self);
+const MMModemSnapshot *mm_fleet_snapshot_peek_modem   (MMFleetSnapshot *self,
+                                                       guint            i);
+const MMModemSnapshot *mm_fleet_snapshot_lookup_modem (MMFleetSnapshot *self,
+                                                       const gchar     *path);
+
+/*****************************************************************************/
+/* ModemManager/libmm-glib/mmcli specific methods */
+
+#if defined (_LIBMM_INSIDE_MM) ||    \
+    defined (_LIBMM_INSIDE_MMCLI) || \
+    defined (LIBMM_GLIB_COMPILATION)
+
+MMFleetSnapshot *mm_fleet_snapshot_new_from_objects (GList *objects);
+
+#endif
+
+G_END_DECLS
+
+#endif /* _MM_FLEET_SNAPSHOT_H_ */
@@ -27,6 +27,7 @@
 #include "mm-errors-types.h"
 #include "mm-gdbus-manager.h"
 #include "mm-manager.h"
+#include "mm-fleet-snapshot.h"
 #include "mm-object.h"
 
 /**
@@ -77,6 +78,7 @@ get_proxy_type (GDBusObjectManagerClient *manager,
         g_hash_table_insert (lookup_hash, "org.freedesktop.ModemManager1.Modem.Modem3gpp",      GSIZE_TO_POINTER (MM_TYPE_MODEM_3GPP));
         g_hash_table_insert (lookup_hash, "org.freedesktop.ModemManager1.Modem.Modem3gpp.Ussd", GSIZE_TO_POINTER (MM_TYPE_MODEM_3GPP_USSD));
         g_hash_table_insert (lookup_hash, "org.freedesktop.ModemManager1.Modem.Simple",         GSIZE_TO_POINTER (MM_TYPE_MODEM_SIMPLE));
+        g_hash_table_insert (lookup_hash, "org.freedesktop.ModemManager1.Modem.Stats",          GSIZE_TO_POINTER (MM_GDBUS_TYPE_MODEM_STATS_PROXY));
         /* g_hash_table_insert (lookup_hash, "org.freedesktop.ModemManager1.Modem.Contacts",    GSIZE_TO_POINTER (MM_GDBUS_TYPE_MODEM_CONTACTS_PROXY)); */
         g_once_init_leave (&once_init_value, 1);
     }
@@ -302,6 +304,34 @@ mm_manager_get_version (MMManager *manager)
 
 /*****************************************************************************/
 
+/**
+ * mm_manager_get_fleet_snapshot:
+ * @manager: A #MMManager.
+ *
+ * Takes a snapshot of the properties of all the modems currently known to
+ * @manager.
+ *
+ * The snapshot is built from the object cache of @manager, so no DBus method
+ * call is performed; the values are the ones last announced by the daemon.
+ *
+ * Returns: (transfer full): A #MMFleetSnapshot that should be freed with mm_fleet_snapshot_unref().
+ */
+MMFleetSnapshot *
+mm_manager_get_fleet_snapshot (MMManager *manager)
+{
+    MMFleetSnapshot *snapshot;
+    GList           *objects;
+
+    g_return_val_if_fail (MM_IS_MANAGER (manager), NULL);
+
+    objects = g_dbus_object_manager_get_objects (G_DBUS_OBJECT_MANAGER (manager));
+    snapshot = mm_fleet_snapshot_new_from_objects (objects);
+    g_list_free_full (objects, g_object_unref);
+    return snapshot;
+}
+
+/*****************************************************************************/
+
 /**
  * mm_manager_set_logging_finish:
  * @manager: A #MMManager.
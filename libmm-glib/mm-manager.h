@@ -34,6 +34,7 @@
 
 #include "mm-gdbus-modem.h"
 #include "mm-kernel-event-properties.h"
+#include "mm-fleet-snapshot.h"
 
 G_BEGIN_DECLS
 
@@ -91,6 +92,8 @@ GDBusProxy *mm_manager_get_proxy  (MMManager *manager);
 
 const gchar *mm_manager_get_version (MMManager *manager);
 
+MMFleetSnapshot *mm_manager_get_fleet_snapshot (MMManager *manager);
+
 void mm_manager_set_logging (MMManager           *manager,
                              const gchar         *level,
                              GCancellable        *cancellable,
@@ -689,8 +689,21 @@ mm_modem_3gpp_peek_initial_eps_bearer_settings (MMModem3gpp *self)
 
 /*****************************************************************************/
 
-static GList *
-create_networks_list (GVariant *variant)
+/**
+ * mm_modem_3gpp_network_list_from_variant:
+ * @variant: A #GVariant of type aa{sv}, as given in the Scan() reply or in the
+ *  #MmGdbusModem3gpp::scan-updated signal.
+ *
+ * Builds the list of networks found in a network scan.
+ *
+ * Clients monitoring network scan results, e.g. those run in the background
+ * by the daemon, connect to the #MmGdbusModem3gpp::scan-updated signal of the
+ * #MMModem3gpp, and use this method to process the reported results.
+ *
+ * Returns: (transfer full) (element-type ModemManager.Modem3gppNetwork): a list of #MMModem3gppNetwork structs, or #NULL if none found. The returned value should be freed with g_list_free_full() using mm_modem_3gpp_network_free() as #GDestroyNotify function.
+ */
+GList *
+mm_modem_3gpp_network_list_from_variant (GVariant *variant)
 {
     GList *list = NULL;
     GVariantIter dict_iter;
@@ -757,7 +770,7 @@ mm_modem_3gpp_scan_finish (MMModem3gpp *self,
     if (!mm_gdbus_modem3gpp_call_scan_finish (MM_GDBUS_MODEM3GPP (self), &result, res, error))
         return NULL;
 
-    return create_networks_list (result);
+    return mm_modem_3gpp_network_list_from_variant (result);
 }
 
 /**
@@ -810,7 +823,7 @@ mm_modem_3gpp_scan_sync (MMModem3gpp *self,
     if (!mm_gdbus_modem3gpp_call_scan_sync (MM_GDBUS_MODEM3GPP (self), &result,cancellable, error))
         return NULL;
 
-    return create_networks_list (result);
+    return mm_modem_3gpp_network_list_from_variant (result);
 }
 
 /*****************************************************************************/
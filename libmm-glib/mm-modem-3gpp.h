@@ -122,6 +122,7 @@ const gchar                    *mm_modem_3gpp_network_get_operator_short    (con
 const gchar                    *mm_modem_3gpp_network_get_operator_code     (const MMModem3gppNetwork *network);
 MMModemAccessTechnology         mm_modem_3gpp_network_get_access_technology (const MMModem3gppNetwork *network);
 void                            mm_modem_3gpp_network_free                  (MMModem3gppNetwork *network);
+GList                          *mm_modem_3gpp_network_list_from_variant     (GVariant *variant);
 
 void   mm_modem_3gpp_scan        (MMModem3gpp *self,
                                   GCancellable *cancellable,
@@ -43,38 +43,266 @@
 
 G_DEFINE_TYPE (MMModem, mm_modem, MM_GDBUS_TYPE_MODEM_PROXY)
 
+/* Values derived from properties (e.g. the GArray of ports built from the
+ * "Ports" GVariant) are kept in immutable refcounted snapshots. A snapshot is
+ * built lazily the first time it's requested after the property changed, and
+ * is swapped in atomically, so that readers in other threads never take a lock
+ * nor wait for each other. When a snapshot is replaced, the writer waits for
+ * the readers that may still be taking a reference to the old one before
+ * releasing it; readers only stay in that section for a few instructions. */
+
+typedef enum {
+    SNAPSHOT_PORTS,
+    SNAPSHOT_UNLOCK_RETRIES,
+    SNAPSHOT_SUPPORTED_MODES,
+    SNAPSHOT_SUPPORTED_CAPABILITIES,
+    SNAPSHOT_SUPPORTED_BANDS,
+    SNAPSHOT_CURRENT_BANDS,
+    SNAPSHOT_LAST
+} SnapshotType;
+
+typedef struct {
+    volatile gint  refcount;
+    guint          generation;
+    SnapshotType   type;
+    /* GArray or MMUnlockRetries, NULL if property unset */
+    gpointer       data;
+} Snapshot;
+
+typedef struct {
+    Snapshot      *current;
+    volatile gint  readers;
+    volatile gint  generation;
+} SnapshotSlot;
+
 struct _MMModemPrivate {
-    /* Ports */
-    GMutex ports_mutex;
-    guint ports_id;
-    GArray *ports;
-
-    /* UnlockRetries */
-    GMutex unlock_retries_mutex;
-    guint unlock_retries_id;
-    MMUnlockRetries *unlock_retries;
-
-    /* Supported Modes */
-    GMutex supported_modes_mutex;
-    guint supported_modes_id;
-    GArray *supported_modes;
-
-    /* Supported Capabilities */
-    GMutex supported_capabilities_mutex;
-    guint supported_capabilities_id;
-    GArray *supported_capabilities;
-
-    /* Supported Bands */
-    GMutex supported_bands_mutex;
-    guint supported_bands_id;
-    GArray *supported_bands;
-
-    /* Current Bands */
-    GMutex current_bands_mutex;
-    guint current_bands_id;
-    GArray *current_bands;
+    SnapshotSlot snapshots[SNAPSHOT_LAST];
 };
 
+static gpointer
+build_ports (MMModem *self)
+{
+    GVariant *dictionary;
+    GArray   *array = NULL;
+
+    dictionary = mm_gdbus_modem_dup_ports (MM_GDBUS_MODEM (self));
+    if (dictionary) {
+        array = mm_common_ports_variant_to_garray (dictionary);
+        g_variant_unref (dictionary);
+    }
+    return array;
+}
+
+static gpointer
+build_unlock_retries (MMModem *self)
+{
+    GVariant        *dictionary;
+    MMUnlockRetries *unlock_retries = NULL;
+
+    dictionary = mm_gdbus_modem_dup_unlock_retries (MM_GDBUS_MODEM (self));
+    if (dictionary) {
+        unlock_retries = mm_unlock_retries_new_from_dictionary (dictionary);
+        g_variant_unref (dictionary);
+    }
+    return unlock_retries;
+}
+
+static gpointer
+build_supported_modes (MMModem *self)
+{
+    GVariant *dictionary;
+    GArray   *array = NULL;
+
+    dictionary = mm_gdbus_modem_dup_supported_modes (MM_GDBUS_MODEM (self));
+    if (dictionary) {
+        array = mm_common_mode_combinations_variant_to_garray (dictionary);
+        g_variant_unref (dictionary);
+    }
+    return array;
+}
+
+static gpointer
+build_supported_capabilities (MMModem *self)
+{
+    GVariant *dictionary;
+    GArray   *array = NULL;
+
+    dictionary = mm_gdbus_modem_dup_supported_capabilities (MM_GDBUS_MODEM (self));
+    if (dictionary) {
+        array = mm_common_capability_combinations_variant_to_garray (dictionary);
+        g_variant_unref (dictionary);
+    }
+    return array;
+}
+
+static gpointer
+build_supported_bands (MMModem *self)
+{
+    GVariant *dictionary;
+    GArray   *array = NULL;
+
+    dictionary = mm_gdbus_modem_dup_supported_bands (MM_GDBUS_MODEM (self));
+    if (dictionary) {
+        array = mm_common_bands_variant_to_garray (dictionary);
+        g_variant_unref (dictionary);
+    }
+    return array;
+}
+
+static gpointer
+build_current_bands (MMModem *self)
+{
+    GVariant *dictionary;
+    GArray   *array = NULL;
+
+    dictionary = mm_gdbus_modem_dup_current_bands (MM_GDBUS_MODEM (self));
+    if (dictionary) {
+        array = mm_common_bands_variant_to_garray (dictionary);
+        g_variant_unref (dictionary);
+    }
+    return array;
+}
+
+static const struct {
+    const gchar    *signal;
+    gpointer      (*build) (MMModem *self);
+    GDestroyNotify  free;
+} snapshot_info[SNAPSHOT_LAST] = {
+    [SNAPSHOT_PORTS]                  = { "notify::ports",                  build_ports,                  (GDestroyNotify) g_array_unref   },
+    [SNAPSHOT_UNLOCK_RETRIES]         = { "notify::unlock-retries",         build_unlock_retries,         (GDestroyNotify) g_object_unref  },
+    [SNAPSHOT_SUPPORTED_MODES]        = { "notify::supported-modes",        build_supported_modes,        (GDestroyNotify) g_array_unref   },
+    [SNAPSHOT_SUPPORTED_CAPABILITIES] = { "notify::supported-capabilities", build_supported_capabilities, (GDestroyNotify) g_array_unref   },
+    [SNAPSHOT_SUPPORTED_BANDS]        = { "notify::supported-bands",        build_supported_bands,        (GDestroyNotify) g_array_unref   },
+    [SNAPSHOT_CURRENT_BANDS]          = { "notify::current-bands",          build_current_bands,          (GDestroyNotify) g_array_unref   },
+};
+
+static void
+snapshot_unref (Snapshot *snapshot)
+{
+    if (g_atomic_int_dec_and_test (&snapshot->refcount)) {
+        if (snapshot->data)
+            snapshot_info[snapshot->type].free (snapshot->data);
+        g_slice_free (Snapshot, snapshot);
+    }
+}
+
+/* Releases the reference the slot held on a snapshot that is no longer
+ * installed; readers that loaded the pointer before it was replaced must have
+ * taken their own reference first. */
+static void
+snapshot_slot_retire (SnapshotSlot *slot,
+                      Snapshot     *snapshot)
+{
+    while (g_atomic_int_get (&slot->readers) > 0)
+        g_thread_yield ();
+    snapshot_unref (snapshot);
+}
+
+/* Returns a new reference to the up to date snapshot, building it if needed */
+static Snapshot *
+snapshot_acquire (MMModem      *self,
+                  SnapshotType  type)
+{
+    SnapshotSlot *slot = &self->priv->snapshots[type];
+
+    while (TRUE) {
+        Snapshot *snapshot;
+        Snapshot *built;
+        guint     generation;
+
+        generation = (guint) g_atomic_int_get (&slot->generation);
+
+        g_atomic_int_inc (&slot->readers);
+        snapshot = g_atomic_pointer_get (&slot->current);
+        if (snapshot)
+            g_atomic_int_inc (&snapshot->refcount);
+        g_atomic_int_add (&slot->readers, -1);
+
+        if (snapshot && snapshot->generation == generation)
+            return snapshot;
+
+        /* Missing or stale, build a new one; one reference for the slot and
+         * another one for the caller */
+        built = g_slice_new (Snapshot);
+        built->refcount = 2;
+        built->generation = generation;
+        built->type = type;
+        built->data = snapshot_info[type].build (self);
+
+        if (g_atomic_pointer_compare_and_exchange (&slot->current, snapshot, built)) {
+            if (snapshot) {
+                snapshot_slot_retire (slot, snapshot);
+                snapshot_unref (snapshot);
+            }
+            return built;
+        }
+
+        /* Someone else updated the slot in the meantime, retry */
+        built->refcount = 1;
+        snapshot_unref (built);
+        if (snapshot)
+            snapshot_unref (snapshot);
+    }
+}
+
+static void
+snapshot_invalidate (MMModem    *self,
+                     GParamSpec *pspec,
+                     gpointer    user_data)
+{
+    SnapshotSlot *slot = &self->priv->snapshots[GPOINTER_TO_UINT (user_data)];
+    Snapshot     *snapshot;
+
+    g_atomic_int_inc (&slot->generation);
+    do {
+        snapshot = g_atomic_pointer_get (&slot->current);
+    } while (!g_atomic_pointer_compare_and_exchange (&slot->current, snapshot, NULL));
+
+    if (snapshot)
+        snapshot_slot_retire (slot, snapshot);
+}
+
+/* Returns the snapshot data without keeping a reference; it is valid until the
+ * property changes. */
+static gpointer
+snapshot_peek (MMModem      *self,
+               SnapshotType  type)
+{
+    Snapshot *snapshot;
+    gpointer  data;
+
+    snapshot = snapshot_acquire (self, type);
+    data = snapshot->data;
+    snapshot_unref (snapshot);
+    return data;
+}
+
+/* Copies a snapshot holding a GArray of plain values */
+static gboolean
+snapshot_dup_array (MMModem       *self,
+                    SnapshotType   type,
+                    gpointer      *dup,
+                    guint         *dup_n)
+{
+    Snapshot *snapshot;
+    GArray   *array;
+    gboolean  ret = FALSE;
+
+    snapshot = snapshot_acquire (self, type);
+    array = snapshot->data;
+    if (array) {
+        ret = TRUE;
+        if (dup && dup_n) {
+            *dup_n = array->len;
+            *dup = (array->len > 0 ?
+                    g_memdup (array->data, g_array_get_element_size (array) * array->len) :
+                    NULL);
+        }
+    }
+    snapshot_unref (snapshot);
+    return ret;
+}
+
 /*****************************************************************************/
 
 /**
@@ -158,73 +386,6 @@ mm_modem_dup_sim_path (MMModem *self)
 
 /*****************************************************************************/
 
-static void
-supported_capabilities_updated (MMModem *self,
-                                GParamSpec *pspec)
-{
-    g_mutex_lock (&self->priv->supported_capabilities_mutex);
-    {
-        GVariant *dictionary;
-
-        if (self->priv->supported_capabilities)
-            g_array_unref (self->priv->supported_capabilities);
-
-        dictionary = mm_gdbus_modem_get_supported_capabilities (MM_GDBUS_MODEM (self));
-        self->priv->supported_capabilities = (dictionary ?
-                                              mm_common_capability_combinations_variant_to_garray (dictionary) :
-                                              NULL);
-    }
-    g_mutex_unlock (&self->priv->supported_capabilities_mutex);
-}
-
-static gboolean
-ensure_internal_supported_capabilities (MMModem *self,
-                                        MMModemCapability **dup_capabilities,
-                                        guint *dup_capabilities_n)
-{
-    gboolean ret;
-
-    g_mutex_lock (&self->priv->supported_capabilities_mutex);
-    {
-        /* If this is the first time ever asking for the array, setup the
-         * update listener and the initial array, if any. */
-        if (!self->priv->supported_capabilities_id) {
-            GVariant *dictionary;
-
-            dictionary = mm_gdbus_modem_dup_supported_capabilities (MM_GDBUS_MODEM (self));
-            if (dictionary) {
-                self->priv->supported_capabilities = mm_common_capability_combinations_variant_to_garray (dictionary);
-                g_variant_unref (dictionary);
-            }
-
-            /* No need to clear this signal connection when freeing self */
-            self->priv->supported_capabilities_id =
-                g_signal_connect (self,
-                                  "notify::supported-capabilities",
-                                  G_CALLBACK (supported_capabilities_updated),
-                                  NULL);
-        }
-
-        if (!self->priv->supported_capabilities)
-            ret = FALSE;
-        else {
-            ret = TRUE;
-
-            if (dup_capabilities && dup_capabilities_n) {
-                *dup_capabilities_n = self->priv->supported_capabilities->len;
-                if (self->priv->supported_capabilities->len > 0) {
-                    *dup_capabilities = g_malloc (sizeof (MMModemCapability) * self->priv->supported_capabilities->len);
-                    memcpy (*dup_capabilities, self->priv->supported_capabilities->data, sizeof (MMModemCapability) * self->priv->supported_capabilities->len);
-                } else
-                    *dup_capabilities = NULL;
-            }
-        }
-    }
-    g_mutex_unlock (&self->priv->supported_capabilities_mutex);
-
-    return ret;
-}
-
 /**
  * mm_modem_get_supported_capabilities:
  * @self: A #MMModem.
@@ -242,7 +403,7 @@ mm_modem_get_supported_capabilities (MMModem *self,
 {
     g_return_val_if_fail (MM_IS_MODEM (self), FALSE);
 
-    return ensure_internal_supported_capabilities (self, capabilities, n_capabilities);
+    return snapshot_dup_array (self, SNAPSHOT_SUPPORTED_CAPABILITIES, (gpointer *) capabilities, n_capabilities);
 }
 
 /**
@@ -260,15 +421,18 @@ mm_modem_peek_supported_capabilities (MMModem *self,
                                       const MMModemCapability **capabilities,
                                       guint *n_capabilities)
 {
+    GArray *array;
+
     g_return_val_if_fail (MM_IS_MODEM (self), FALSE);
     g_return_val_if_fail (capabilities != NULL, FALSE);
     g_return_val_if_fail (n_capabilities != NULL, FALSE);
 
-    if (!ensure_internal_supported_capabilities (self, NULL, NULL))
+    array = snapshot_peek (self, SNAPSHOT_SUPPORTED_CAPABILITIES);
+    if (!array)
         return FALSE;
 
-    *n_capabilities = self->priv->supported_capabilities->len;
-    *capabilities = (MMModemCapability *)self->priv->supported_capabilities->data;
+    *n_capabilities = array->len;
+    *capabilities = (MMModemCapability *)array->data;
     return TRUE;
 }
 
@@ -850,79 +1014,36 @@ mm_modem_dup_primary_port (MMModem *self)
 
 /*****************************************************************************/
 
-static void
-ports_updated (MMModem *self,
-               GParamSpec *pspec)
-{
-    g_mutex_lock (&self->priv->ports_mutex);
-    {
-        GVariant *dictionary;
-
-        if (self->priv->ports)
-            g_array_unref (self->priv->ports);
-
-        dictionary = mm_gdbus_modem_get_ports (MM_GDBUS_MODEM (self));
-        self->priv->ports = (dictionary ?
-                             mm_common_ports_variant_to_garray (dictionary) :
-                             NULL);
-    }
-    g_mutex_unlock (&self->priv->ports_mutex);
-}
-
 static gboolean
-ensure_internal_ports (MMModem *self,
-                       MMModemPortInfo **dup_ports,
-                       guint *dup_ports_n)
-{
-    gboolean ret;
-    guint i;
-
-    g_mutex_lock (&self->priv->ports_mutex);
-    {
-        /* If this is the first time ever asking for the array, setup the
-         * update listener and the initial array, if any. */
-        if (!self->priv->ports_id) {
-            GVariant *dictionary;
-
-            dictionary = mm_gdbus_modem_dup_ports (MM_GDBUS_MODEM (self));
-            if (dictionary) {
-                self->priv->ports = mm_common_ports_variant_to_garray (dictionary);
-                g_variant_unref (dictionary);
-            }
-
-            /* No need to clear this signal connection when freeing self */
-            self->priv->ports_id =
-                g_signal_connect (self,
-                                  "notify::ports",
-                                  G_CALLBACK (ports_updated),
-                                  NULL);
-        }
-
-        if (!self->priv->ports)
-            ret = FALSE;
-        else {
-            ret = TRUE;
-
-            if (dup_ports && dup_ports_n) {
-                *dup_ports_n = self->priv->ports->len;
-                if (self->priv->ports->len > 0) {
-                    *dup_ports = g_malloc (sizeof (MMModemPortInfo) * self->priv->ports->len);
-
-                    /* Deep-copy the array */
-                    for (i = 0; i < self->priv->ports->len; i++) {
-                        MMModemPortInfo *dst = &(*dup_ports)[i];
-                        MMModemPortInfo *src = &g_array_index (self->priv->ports, MMModemPortInfo, i);
-
-                        dst->name = g_strdup (src->name);
-                        dst->type = src->type;
-                    }
-                } else
-                    *dup_ports = NULL;
+dup_ports (MMModem          *self,
+           MMModemPortInfo **dup,
+           guint            *dup_n)
+{
+    Snapshot *snapshot;
+    GArray   *array;
+    gboolean  ret = FALSE;
+    guint     i;
+
+    snapshot = snapshot_acquire (self, SNAPSHOT_PORTS);
+    array = snapshot->data;
+    if (array) {
+        ret = TRUE;
+        *dup_n = array->len;
+        if (array->len > 0) {
+            *dup = g_malloc (sizeof (MMModemPortInfo) * array->len);
+
+            /* Deep-copy the array */
+            for (i = 0; i < array->len; i++) {
+                MMModemPortInfo *dst = &(*dup)[i];
+                MMModemPortInfo *src = &g_array_index (array, MMModemPortInfo, i);
+
+                dst->name = g_strdup (src->name);
+                dst->type = src->type;
             }
-        }
+        } else
+            *dup = NULL;
     }
-    g_mutex_unlock (&self->priv->ports_mutex);
-
+    snapshot_unref (snapshot);
     return ret;
 }
 
@@ -941,15 +1062,18 @@ mm_modem_peek_ports (MMModem *self,
                      const MMModemPortInfo **ports,
                      guint *n_ports)
 {
+    GArray *array;
+
     g_return_val_if_fail (MM_IS_MODEM (self), FALSE);
     g_return_val_if_fail (ports != NULL, FALSE);
     g_return_val_if_fail (n_ports != NULL, FALSE);
 
-    if (!ensure_internal_ports (self, NULL, NULL))
+    array = snapshot_peek (self, SNAPSHOT_PORTS);
+    if (!array)
         return FALSE;
 
-    *n_ports = self->priv->ports->len;
-    *ports = (MMModemPortInfo *)self->priv->ports->data;
+    *n_ports = array->len;
+    *ports = (MMModemPortInfo *)array->data;
     return TRUE;
 }
 
@@ -972,7 +1096,7 @@ mm_modem_get_ports (MMModem *self,
     g_return_val_if_fail (ports != NULL, FALSE);
     g_return_val_if_fail (n_ports != NULL, FALSE);
 
-    return ensure_internal_ports (self, ports, n_ports);
+    return dup_ports (self, ports, n_ports);
 }
 
 /*****************************************************************************/
@@ -1094,55 +1218,6 @@ mm_modem_get_unlock_required (MMModem *self)
 
 /*****************************************************************************/
 
-static void
-unlock_retries_updated (MMModem *self,
-                        GParamSpec *pspec)
-{
-    g_mutex_lock (&self->priv->unlock_retries_mutex);
-    {
-        GVariant *dictionary;
-
-        g_clear_object (&self->priv->unlock_retries);
-
-        /* TODO: update existing object instead of re-creating? */
-        dictionary = mm_gdbus_modem_get_unlock_retries (MM_GDBUS_MODEM (self));
-        if (dictionary)
-            self->priv->unlock_retries = mm_unlock_retries_new_from_dictionary (dictionary);
-    }
-    g_mutex_unlock (&self->priv->unlock_retries_mutex);
-}
-
-static void
-ensure_internal_unlock_retries (MMModem *self,
-                                MMUnlockRetries **dup)
-{
-    g_mutex_lock (&self->priv->unlock_retries_mutex);
-    {
-        /* If this is the first time ever asking for the object, setup the
-         * update listener and the initial object, if any. */
-        if (!self->priv->unlock_retries_id) {
-            GVariant *dictionary;
-
-            dictionary = mm_gdbus_modem_dup_unlock_retries (MM_GDBUS_MODEM (self));
-            if (dictionary) {
-                self->priv->unlock_retries = mm_unlock_retries_new_from_dictionary (dictionary);
-                g_variant_unref (dictionary);
-            }
-
-            /* No need to clear this signal connection when freeing self */
-            self->priv->unlock_retries_id =
-                g_signal_connect (self,
-                                  "notify::unlock-retries",
-                                  G_CALLBACK (unlock_retries_updated),
-                                  NULL);
-        }
-
-        if (dup && self->priv->unlock_retries)
-            *dup = g_object_ref (self->priv->unlock_retries);
-    }
-    g_mutex_unlock (&self->priv->unlock_retries_mutex);
-}
-
 /**
  * mm_modem_get_unlock_retries:
  * @self: A #MMModem.
@@ -1162,11 +1237,15 @@ ensure_internal_unlock_retries (MMModem *self,
 MMUnlockRetries *
 mm_modem_get_unlock_retries (MMModem *self)
 {
+    Snapshot        *snapshot;
     MMUnlockRetries *unlock_retries = NULL;
 
     g_return_val_if_fail (MM_IS_MODEM (self), NULL);
 
-    ensure_internal_unlock_retries (self, &unlock_retries);
+    snapshot = snapshot_acquire (self, SNAPSHOT_UNLOCK_RETRIES);
+    if (snapshot->data)
+        unlock_retries = g_object_ref (snapshot->data);
+    snapshot_unref (snapshot);
     return unlock_retries;
 }
 
@@ -1191,8 +1270,7 @@ mm_modem_peek_unlock_retries (MMModem *self)
 {
     g_return_val_if_fail (MM_IS_MODEM (self), NULL);
 
-    ensure_internal_unlock_retries (self, NULL);
-    return self->priv->unlock_retries;
+    return snapshot_peek (self, SNAPSHOT_UNLOCK_RETRIES);
 }
 
 /*****************************************************************************/
@@ -1308,73 +1386,6 @@ mm_modem_get_signal_quality (MMModem *self,
 
 /*****************************************************************************/
 
-static void
-supported_modes_updated (MMModem *self,
-                         GParamSpec *pspec)
-{
-    g_mutex_lock (&self->priv->supported_modes_mutex);
-    {
-        GVariant *dictionary;
-
-        if (self->priv->supported_modes)
-            g_array_unref (self->priv->supported_modes);
-
-        dictionary = mm_gdbus_modem_get_supported_modes (MM_GDBUS_MODEM (self));
-        self->priv->supported_modes = (dictionary ?
-                                       mm_common_mode_combinations_variant_to_garray (dictionary) :
-                                       NULL);
-    }
-    g_mutex_unlock (&self->priv->supported_modes_mutex);
-}
-
-static gboolean
-ensure_internal_supported_modes (MMModem *self,
-                                 MMModemModeCombination **dup_modes,
-                                 guint *dup_modes_n)
-{
-    gboolean ret;
-
-    g_mutex_lock (&self->priv->supported_modes_mutex);
-    {
-        /* If this is the first time ever asking for the array, setup the
-         * update listener and the initial array, if any. */
-        if (!self->priv->supported_modes_id) {
-            GVariant *dictionary;
-
-            dictionary = mm_gdbus_modem_dup_supported_modes (MM_GDBUS_MODEM (self));
-            if (dictionary) {
-                self->priv->supported_modes = mm_common_mode_combinations_variant_to_garray (dictionary);
-                g_variant_unref (dictionary);
-            }
-
-            /* No need to clear this signal connection when freeing self */
-            self->priv->supported_modes_id =
-                g_signal_connect (self,
-                                  "notify::supported-modes",
-                                  G_CALLBACK (supported_modes_updated),
-                                  NULL);
-        }
-
-        if (!self->priv->supported_modes)
-            ret = FALSE;
-        else {
-            ret = TRUE;
-
-            if (dup_modes && dup_modes_n) {
-                *dup_modes_n = self->priv->supported_modes->len;
-                if (self->priv->supported_modes->len > 0) {
-                    *dup_modes = g_malloc (sizeof (MMModemModeCombination) * self->priv->supported_modes->len);
-                    memcpy (*dup_modes, self->priv->supported_modes->data, sizeof (MMModemModeCombination) * self->priv->supported_modes->len);
-                } else
-                    *dup_modes = NULL;
-            }
-        }
-    }
-    g_mutex_unlock (&self->priv->supported_modes_mutex);
-
-    return ret;
-}
-
 /**
  * mm_modem_get_supported_modes:
  * @self: A #MMModem.
@@ -1394,7 +1405,7 @@ mm_modem_get_supported_modes (MMModem *self,
     g_return_val_if_fail (modes != NULL, FALSE);
     g_return_val_if_fail (n_modes != NULL, FALSE);
 
-    return ensure_internal_supported_modes (self, modes, n_modes);
+    return snapshot_dup_array (self, SNAPSHOT_SUPPORTED_MODES, (gpointer *) modes, n_modes);
 }
 
 /**
@@ -1412,15 +1423,18 @@ mm_modem_peek_supported_modes (MMModem *self,
                                const MMModemModeCombination **modes,
                                guint *n_modes)
 {
+    GArray *array;
+
     g_return_val_if_fail (MM_IS_MODEM (self), FALSE);
     g_return_val_if_fail (modes != NULL, FALSE);
     g_return_val_if_fail (n_modes != NULL, FALSE);
 
-    if (!ensure_internal_supported_modes (self, NULL, NULL))
+    array = snapshot_peek (self, SNAPSHOT_SUPPORTED_MODES);
+    if (!array)
         return FALSE;
 
-    *n_modes = self->priv->supported_modes->len;
-    *modes = (MMModemModeCombination *)self->priv->supported_modes->data;
+    *n_modes = array->len;
+    *modes = (MMModemModeCombination *)array->data;
     return TRUE;
 }
 
@@ -1464,73 +1478,6 @@ mm_modem_get_current_modes (MMModem *self,
 
 /*****************************************************************************/
 
-static void
-supported_bands_updated (MMModem *self,
-                         GParamSpec *pspec)
-{
-    g_mutex_lock (&self->priv->supported_bands_mutex);
-    {
-        GVariant *dictionary;
-
-        if (self->priv->supported_bands)
-            g_array_unref (self->priv->supported_bands);
-
-        dictionary = mm_gdbus_modem_get_supported_bands (MM_GDBUS_MODEM (self));
-        self->priv->supported_bands = (dictionary ?
-                                       mm_common_bands_variant_to_garray (dictionary) :
-                                       NULL);
-    }
-    g_mutex_unlock (&self->priv->supported_bands_mutex);
-}
-
-static gboolean
-ensure_internal_supported_bands (MMModem *self,
-                                 MMModemBand **dup_bands,
-                                 guint *dup_bands_n)
-{
-    gboolean ret;
-
-    g_mutex_lock (&self->priv->supported_bands_mutex);
-    {
-        /* If this is the first time ever asking for the array, setup the
-         * update listener and the initial array, if any. */
-        if (!self->priv->supported_bands_id) {
-            GVariant *dictionary;
-
-            dictionary = mm_gdbus_modem_dup_supported_bands (MM_GDBUS_MODEM (self));
-            if (dictionary) {
-                self->priv->supported_bands = mm_common_bands_variant_to_garray (dictionary);
-                g_variant_unref (dictionary);
-            }
-
-            /* No need to clear this signal connection when freeing self */
-            self->priv->supported_bands_id =
-                g_signal_connect (self,
-                                  "notify::supported-bands",
-                                  G_CALLBACK (supported_bands_updated),
-                                  NULL);
-        }
-
-        if (!self->priv->supported_bands)
-            ret = FALSE;
-        else {
-            ret = TRUE;
-
-            if (dup_bands && dup_bands_n) {
-                *dup_bands_n = self->priv->supported_bands->len;
-                if (self->priv->supported_bands->len > 0) {
-                    *dup_bands = g_malloc (sizeof (MMModemBand) * self->priv->supported_bands->len);
-                    memcpy (*dup_bands, self->priv->supported_bands->data, sizeof (MMModemBand) * self->priv->supported_bands->len);
-                } else
-                    *dup_bands = NULL;
-            }
-        }
-    }
-    g_mutex_unlock (&self->priv->supported_bands_mutex);
-
-    return ret;
-}
-
 /**
  * mm_modem_get_supported_bands:
  * @self: A #MMModem.
@@ -1552,7 +1499,7 @@ mm_modem_get_supported_bands (MMModem *self,
     g_return_val_if_fail (bands != NULL, FALSE);
     g_return_val_if_fail (n_bands != NULL, FALSE);
 
-    return ensure_internal_supported_bands (self, bands, n_bands);
+    return snapshot_dup_array (self, SNAPSHOT_SUPPORTED_BANDS, (gpointer *) bands, n_bands);
 }
 
 /**
@@ -1572,87 +1519,23 @@ mm_modem_peek_supported_bands (MMModem *self,
                                const MMModemBand **bands,
                                guint *n_bands)
 {
+    GArray *array;
+
     g_return_val_if_fail (MM_IS_MODEM (self), FALSE);
     g_return_val_if_fail (bands != NULL, FALSE);
     g_return_val_if_fail (n_bands != NULL, FALSE);
 
-    if (!ensure_internal_supported_bands (self, NULL, NULL))
+    array = snapshot_peek (self, SNAPSHOT_SUPPORTED_BANDS);
+    if (!array)
         return FALSE;
 
-    *n_bands = self->priv->supported_bands->len;
-    *bands = (MMModemBand *)self->priv->supported_bands->data;
+    *n_bands = array->len;
+    *bands = (MMModemBand *)array->data;
     return TRUE;
 }
 
 /*****************************************************************************/
 
-static void
-current_bands_updated (MMModem *self,
-                       GParamSpec *pspec)
-{
-    g_mutex_lock (&self->priv->current_bands_mutex);
-    {
-        GVariant *dictionary;
-
-        if (self->priv->current_bands)
-            g_array_unref (self->priv->current_bands);
-
-        dictionary = mm_gdbus_modem_get_current_bands (MM_GDBUS_MODEM (self));
-        self->priv->current_bands = (dictionary ?
-                                     mm_common_bands_variant_to_garray (dictionary) :
-                                     NULL);
-    }
-    g_mutex_unlock (&self->priv->current_bands_mutex);
-}
-
-static gboolean
-ensure_internal_current_bands (MMModem *self,
-                               MMModemBand **dup_bands,
-                               guint *dup_bands_n)
-{
-    gboolean ret;
-
-    g_mutex_lock (&self->priv->current_bands_mutex);
-    {
-        /* If this is the first time ever asking for the array, setup the
-         * update listener and the initial array, if any. */
-        if (!self->priv->current_bands_id) {
-            GVariant *dictionary;
-
-            dictionary = mm_gdbus_modem_dup_current_bands (MM_GDBUS_MODEM (self));
-            if (dictionary) {
-                self->priv->current_bands = mm_common_bands_variant_to_garray (dictionary);
-                g_variant_unref (dictionary);
-            }
-
-            /* No need to clear this signal connection when freeing self */
-            self->priv->current_bands_id =
-                g_signal_connect (self,
-                                  "notify::current-bands",
-                                  G_CALLBACK (current_bands_updated),
-                                  NULL);
-        }
-
-        if (!self->priv->current_bands)
-            ret = FALSE;
-        else {
-            ret = TRUE;
-
-            if (dup_bands && dup_bands_n) {
-                *dup_bands_n = self->priv->current_bands->len;
-                if (self->priv->current_bands->len > 0) {
-                    *dup_bands = g_malloc (sizeof (MMModemBand) * self->priv->current_bands->len);
-                    memcpy (*dup_bands, self->priv->current_bands->data, sizeof (MMModemBand) * self->priv->current_bands->len);
-                } else
-                    *dup_bands = NULL;
-            }
-        }
-    }
-    g_mutex_unlock (&self->priv->current_bands_mutex);
-
-    return ret;
-}
-
 /**
  * mm_modem_get_current_bands:
  * @self: A #MMModem.
@@ -1675,7 +1558,7 @@ mm_modem_get_current_bands (MMModem *self,
     g_return_val_if_fail (bands != NULL, FALSE);
     g_return_val_if_fail (n_bands != NULL, FALSE);
 
-    return ensure_internal_current_bands (self, bands, n_bands);
+    return snapshot_dup_array (self, SNAPSHOT_CURRENT_BANDS, (gpointer *) bands, n_bands);
 }
 
 /**
@@ -1696,15 +1579,18 @@ mm_modem_peek_current_bands (MMModem *self,
                              const MMModemBand **bands,
                              guint *n_bands)
 {
+    GArray *array;
+
     g_return_val_if_fail (MM_IS_MODEM (self), FALSE);
     g_return_val_if_fail (bands != NULL, FALSE);
     g_return_val_if_fail (n_bands != NULL, FALSE);
 
-    if (!ensure_internal_current_bands (self, NULL, NULL))
+    array = snapshot_peek (self, SNAPSHOT_CURRENT_BANDS);
+    if (!array)
         return FALSE;
 
-    *n_bands = self->priv->current_bands->len;
-    *bands = (MMModemBand *)self->priv->current_bands->data;
+    *n_bands = array->len;
+    *bands = (MMModemBand *)array->data;
     return TRUE;
 }
 
@@ -3051,54 +2937,35 @@ mm_modem_get_sim_sync (MMModem *self,
 static void
 mm_modem_init (MMModem *self)
 {
+    guint i;
+
     /* Setup private data */
     self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
                                               MM_TYPE_MODEM,
                                               MMModemPrivate);
-    g_mutex_init (&self->priv->unlock_retries_mutex);
-    g_mutex_init (&self->priv->supported_modes_mutex);
-    g_mutex_init (&self->priv->supported_capabilities_mutex);
-    g_mutex_init (&self->priv->supported_bands_mutex);
-    g_mutex_init (&self->priv->current_bands_mutex);
-    g_mutex_init (&self->priv->ports_mutex);
+
+    /* No need to clear these signal connections when freeing self */
+    for (i = 0; i < SNAPSHOT_LAST; i++)
+        g_signal_connect (self,
+                          snapshot_info[i].signal,
+                          G_CALLBACK (snapshot_invalidate),
+                          GUINT_TO_POINTER (i));
 }
 
 static void
 finalize (GObject *object)
 {
     MMModem *self = MM_MODEM (object);
+    guint    i;
 
-    g_mutex_clear (&self->priv->unlock_retries_mutex);
-    g_mutex_clear (&self->priv->supported_modes_mutex);
-    g_mutex_clear (&self->priv->supported_capabilities_mutex);
-    g_mutex_clear (&self->priv->supported_bands_mutex);
-    g_mutex_clear (&self->priv->current_bands_mutex);
-    g_mutex_clear (&self->priv->ports_mutex);
-
-    if (self->priv->supported_modes)
-        g_array_unref (self->priv->supported_modes);
-    if (self->priv->supported_capabilities)
-        g_array_unref (self->priv->supported_capabilities);
-    if (self->priv->supported_bands)
-        g_array_unref (self->priv->supported_bands);
-    if (self->priv->current_bands)
-        g_array_unref (self->priv->current_bands);
-    if (self->priv->ports)
-       g_array_unref (self->priv->ports);
+    for (i = 0; i < SNAPSHOT_LAST; i++) {
+        if (self->priv->snapshots[i].current)
+            snapshot_unref (self->priv->snapshots[i].current);
+    }
 
     G_OBJECT_CLASS (mm_modem_parent_class)->finalize (object);
 }
 
-static void
-dispose (GObject *object)
-{
-    MMModem *self = MM_MODEM (object);
-
-    g_clear_object (&self->priv->unlock_retries);
-
-    G_OBJECT_CLASS (mm_modem_parent_class)->dispose (object);
-}
-
 static void
 mm_modem_class_init (MMModemClass *modem_class)
 {
@@ -3107,6 +2974,5 @@ mm_modem_class_init (MMModemClass *modem_class)
     g_type_class_add_private (object_class, sizeof (MMModemPrivate));
 
     /* Virtual methods */
-    object_class->dispose = dispose;
     object_class->finalize = finalize;
 }
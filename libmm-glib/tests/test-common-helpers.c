@@ -13,6 +13,7 @@
  * Copyright (C) 2012 Google, Inc.
  */
 
+#include <string.h>
 #include <glib-object.h>
 
 #include <libmm-glib.h>
@@ -488,6 +489,178 @@ field_parser_double (void)
 
 /**************************************************************/
 
+/********************* HEX CONVERSION TESTS *********************/
+
+static gint
+hex_reference_num (gchar c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/* Byte-at-a-time reference decoder */
+static gboolean
+hex_reference_decode (const gchar *hex,
+                      gsize        len,
+                      guint8      *out)
+{
+    gsize i;
+
+    if (len % 2)
+        return FALSE;
+    for (i = 0; i < len; i += 2) {
+        gint a, b;
+
+        a = hex_reference_num (hex[i]);
+        b = hex_reference_num (hex[i + 1]);
+        if (a < 0 || b < 0)
+            return FALSE;
+        out[i / 2] = (a << 4) | b;
+    }
+    return TRUE;
+}
+
+static void
+hex_test_known (void)
+{
+    static const guint8 bin[] = { 0x00, 0x01, 0x7F, 0x80, 0xA5, 0x5A, 0xFE, 0xFF, 0x12 };
+    gchar  *hex;
+    gchar  *decoded;
+    gsize   decoded_len = 0;
+
+    hex = mm_utils_bin2hexstr (bin, sizeof (bin));
+    g_assert_cmpstr (hex, ==, "00017F80A55AFEFF12");
+
+    decoded = mm_utils_hexstr2bin ("00017f80a55AfEFF12", &decoded_len);
+    g_assert (decoded);
+    g_assert_cmpuint (decoded_len, ==, sizeof (bin));
+    g_assert (memcmp (decoded, bin, sizeof (bin)) == 0);
+    g_assert_cmpint (decoded[decoded_len], ==, '\0');
+    g_free (decoded);
+
+    g_assert (mm_utils_hexstr2bin_inplace (hex, &decoded_len));
+    g_assert_cmpuint (decoded_len, ==, sizeof (bin));
+    g_assert (memcmp (hex, bin, sizeof (bin)) == 0);
+    g_free (hex);
+
+    g_assert (mm_utils_ishexstr (""));
+    g_assert (mm_utils_ishexstr ("0123456789abcdefABCDEF"));
+    g_assert (!mm_utils_ishexstr ("0123456789abcdefABCDEFG0"));
+    g_assert (!mm_utils_ishexstr ("012"));
+    g_assert (!mm_utils_ishexstr ("0123456:"));
+    g_assert (!mm_utils_ishexstr ("@0123456"));
+    g_assert (!mm_utils_ishexstr ("0123456`"));
+    g_assert (!mm_utils_ishexstr ("0123456g"));
+    g_assert (!mm_utils_ishexstr ("01234/67"));
+    g_assert (!mm_utils_ishexstr ("012345\xc3\xa1"));
+}
+
+#define HEX_FUZZ_ITERATIONS 100000
+#define HEX_FUZZ_MAX_LEN    64
+
+static void
+hex_test_fuzz (void)
+{
+    /* Mostly hex digits, plus the chars right around the valid ranges */
+    static const gchar valid[] = "0123456789abcdefABCDEF";
+    static const gchar invalid[] = "/:@G`g \xff\x80\x00";
+    guint i;
+
+    for (i = 0; i < HEX_FUZZ_ITERATIONS; i++) {
+        gchar    hex[HEX_FUZZ_MAX_LEN + 1];
+        gchar    encoded[HEX_FUZZ_MAX_LEN + 1];
+        guint8   expected[HEX_FUZZ_MAX_LEN / 2];
+        guint8   out[HEX_FUZZ_MAX_LEN / 2];
+        gsize    len;
+        gsize    out_len = 0;
+        gboolean valid_input;
+        gsize    j;
+
+        len = g_test_rand_int_range (0, HEX_FUZZ_MAX_LEN + 1);
+        for (j = 0; j < len; j++) {
+            if (g_test_rand_int_range (0, 16) == 0)
+                hex[j] = invalid[g_test_rand_int_range (0, sizeof (invalid) - 1)];
+            else
+                hex[j] = valid[g_test_rand_int_range (0, sizeof (valid) - 1)];
+        }
+        hex[len] = '\0';
+        /* An embedded NUL shortens the string */
+        len = strlen (hex);
+
+        valid_input = hex_reference_decode (hex, len, expected);
+        g_assert_cmpint (mm_utils_ishexstr (hex), ==, valid_input);
+        g_assert_cmpint (mm_utils_hexstr2bin_buf (hex, len, out, sizeof (out), &out_len), ==, valid_input);
+        if (!valid_input)
+            continue;
+
+        g_assert_cmpuint (out_len, ==, len / 2);
+        g_assert (memcmp (out, expected, out_len) == 0);
+
+        /* Output buffer one byte too small */
+        if (out_len > 0)
+            g_assert (!mm_utils_hexstr2bin_buf (hex, len, out, out_len - 1, NULL));
+
+        /* Encoding gives back the uppercase input */
+        mm_utils_bin2hexstr_buf (out, out_len, encoded);
+        for (j = 0; j < len; j++)
+            g_assert_cmpint (encoded[j], ==, g_ascii_toupper (hex[j]));
+        g_assert_cmpint (encoded[len], ==, '\0');
+
+        g_assert (mm_utils_hexstr2bin_inplace (hex, &out_len));
+        g_assert_cmpuint (out_len, ==, len / 2);
+        g_assert (memcmp (hex, expected, out_len) == 0);
+    }
+}
+
+#define HEX_PERF_SIZE       4096
+#define HEX_PERF_ITERATIONS 10000
+
+static void
+hex_test_perf (void)
+{
+    guint8  *bin;
+    gchar   *hex;
+    gdouble  elapsed;
+    gsize    out_len;
+    guint    i;
+
+    bin = g_malloc (HEX_PERF_SIZE);
+    hex = g_malloc (2 * HEX_PERF_SIZE + 1);
+    for (i = 0; i < HEX_PERF_SIZE; i++)
+        bin[i] = g_test_rand_int_range (0, 256);
+
+    g_test_timer_start ();
+    for (i = 0; i < HEX_PERF_ITERATIONS; i++)
+        mm_utils_bin2hexstr_buf (bin, HEX_PERF_SIZE, hex);
+    elapsed = g_test_timer_elapsed ();
+    g_test_minimized_result (elapsed, "encode: %.1f MB/s",
+                             (HEX_PERF_SIZE * (gdouble) HEX_PERF_ITERATIONS) / (elapsed * 1e6));
+
+    g_test_timer_start ();
+    for (i = 0; i < HEX_PERF_ITERATIONS; i++)
+        g_assert (mm_utils_hexstr2bin_buf (hex, 2 * HEX_PERF_SIZE, bin, HEX_PERF_SIZE, &out_len));
+    elapsed = g_test_timer_elapsed ();
+    g_test_minimized_result (elapsed, "decode: %.1f MB/s",
+                             (HEX_PERF_SIZE * (gdouble) HEX_PERF_ITERATIONS) / (elapsed * 1e6));
+
+    g_test_timer_start ();
+    for (i = 0; i < HEX_PERF_ITERATIONS; i++)
+        g_assert (mm_utils_ishexstr (hex));
+    elapsed = g_test_timer_elapsed ();
+    g_test_minimized_result (elapsed, "validate: %.1f MB/s",
+                             (2 * HEX_PERF_SIZE * (gdouble) HEX_PERF_ITERATIONS) / (elapsed * 1e6));
+
+    g_free (hex);
+    g_free (bin);
+}
+
+/**************************************************************/
+
 int main (int argc, char **argv)
 {
     g_test_init (&argc, &argv, NULL);
@@ -524,5 +697,11 @@ int main (int argc, char **argv)
     g_test_add_func ("/MM/Common/FieldParsers/Uint", field_parser_uint);
     g_test_add_func ("/MM/Common/FieldParsers/Double", field_parser_double);
 
+    g_test_add_func ("/MM/Common/Hex/known", hex_test_known);
+    g_test_add_func ("/MM/Common/Hex/fuzz", hex_test_fuzz);
+    /* Benchmark, only run with -m perf */
+    if (g_test_perf ())
+        g_test_add_func ("/MM/Common/Hex/perf", hex_test_perf);
+
     return g_test_run ();
 }
@@ -0,0 +1,112 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+#include <glib.h>
+#include <libmm-glib.h>
+#include <string.h>
+
+typedef struct {
+    MMModem3gppNetworkAvailability availability;
+    const gchar *operator_long;
+    const gchar *operator_short;
+    const gchar *operator_code;
+    MMModemAccessTechnology access_technology;
+} TestNetwork;
+
+static const TestNetwork test_networks[] = {
+    { MM_MODEM_3GPP_NETWORK_AVAILABILITY_CURRENT,   "Orange SP", "Orange", "21403", MM_MODEM_ACCESS_TECHNOLOGY_LTE  },
+    { MM_MODEM_3GPP_NETWORK_AVAILABILITY_FORBIDDEN, NULL,        NULL,     "21401", MM_MODEM_ACCESS_TECHNOLOGY_UMTS },
+};
+
+/* Same format as the one built by the daemon in the Scan() reply and in the
+ * ScanUpdated signal */
+static GVariant *
+build_scan_results (const TestNetwork *networks,
+                    guint              n_networks)
+{
+    GVariantBuilder builder;
+    guint i;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sv}"));
+    for (i = 0; i < n_networks; i++) {
+        g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sv}"));
+        g_variant_builder_add (&builder, "{sv}",
+                               "status", g_variant_new_uint32 (networks[i].availability));
+        if (networks[i].operator_long)
+            g_variant_builder_add (&builder, "{sv}",
+                                   "operator-long", g_variant_new_string (networks[i].operator_long));
+        if (networks[i].operator_short)
+            g_variant_builder_add (&builder, "{sv}",
+                                   "operator-short", g_variant_new_string (networks[i].operator_short));
+        g_variant_builder_add (&builder, "{sv}",
+                               "operator-code", g_variant_new_string (networks[i].operator_code));
+        g_variant_builder_add (&builder, "{sv}",
+                               "access-technology", g_variant_new_uint32 (networks[i].access_technology));
+        g_variant_builder_close (&builder);
+    }
+    return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+static void
+test_network_list_from_variant (void)
+{
+    GVariant *results;
+    GList *list;
+    GList *l;
+    guint i;
+
+    results = build_scan_results (test_networks, G_N_ELEMENTS (test_networks));
+    list = mm_modem_3gpp_network_list_from_variant (results);
+    g_variant_unref (results);
+
+    g_assert_cmpuint (g_list_length (list), ==, G_N_ELEMENTS (test_networks));
+    for (i = 0; i < G_N_ELEMENTS (test_networks); i++) {
+        const MMModem3gppNetwork *network = NULL;
+
+        for (l = list; l; l = g_list_next (l)) {
+            if (g_str_equal (mm_modem_3gpp_network_get_operator_code (l->data), test_networks[i].operator_code)) {
+                network = l->data;
+                break;
+            }
+        }
+        g_assert (network != NULL);
+        g_assert_cmpuint (mm_modem_3gpp_network_get_availability (network), ==, test_networks[i].availability);
+        g_assert_cmpstr (mm_modem_3gpp_network_get_operator_long (network), ==, test_networks[i].operator_long);
+        g_assert_cmpstr (mm_modem_3gpp_network_get_operator_short (network), ==, test_networks[i].operator_short);
+        g_assert_cmpuint (mm_modem_3gpp_network_get_access_technology (network), ==, test_networks[i].access_technology);
+    }
+
+    g_list_free_full (list, (GDestroyNotify) mm_modem_3gpp_network_free);
+}
+
+static void
+test_network_list_from_variant_empty (void)
+{
+    GVariant *results;
+
+    results = build_scan_results (NULL, 0);
+    g_assert (mm_modem_3gpp_network_list_from_variant (results) == NULL);
+    g_variant_unref (results);
+}
+
+int main (int argc, char **argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/MM/modem-3gpp/network-list/from-variant",       test_network_list_from_variant);
+    g_test_add_func ("/MM/modem-3gpp/network-list/from-variant-empty", test_network_list_from_variant_empty);
+
+    return g_test_run ();
+}
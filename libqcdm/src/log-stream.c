@@ -0,0 +1,328 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * Copyright (C) 2019 The ModemManager authors
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <endian.h>
+
+#include "log-stream.h"
+#include "errors.h"
+#include "dm-commands.h"
+
+#define DIAG_ESC_CHAR     0x7D  /* Escape sequence 1st character value */
+#define DIAG_ESC_MASK     0x20  /* Escape sequence complement value */
+
+/* Log packets carry a 16-bit length, but in practice they are much smaller */
+#define FRAME_MAX_LEN     8192
+
+/* Power of two; log codes beyond this many are only counted in n_untracked */
+#define CODE_TABLE_SIZE   512
+
+typedef struct {
+    uint16_t log_code;
+    uint8_t used;
+    uint64_t count;
+} CodeCounter;
+
+struct QcdmLogStream {
+    /* Input given to qcdm_log_stream_feed() */
+    const char *in;
+    size_t in_len;
+
+    /* Current frame, unescaped */
+    size_t frame_len;
+    size_t frame_raw_len;
+    qcdmbool escaping;
+    qcdmbool oversized;
+
+    QcdmLogStreamStats stats;
+    CodeCounter codes[CODE_TABLE_SIZE];
+
+    char frame[FRAME_MAX_LEN];
+};
+
+/**********************************************************************/
+
+static void
+count_log_code (QcdmLogStream *stream, uint16_t log_code)
+{
+    uint32_t slot, i;
+
+    slot = ((uint32_t) log_code * 2654435761u) >> 23;
+    for (i = 0; i < CODE_TABLE_SIZE; i++) {
+        CodeCounter *c = &stream->codes[(slot + i) & (CODE_TABLE_SIZE - 1)];
+
+        if (!c->used) {
+            c->used = TRUE;
+            c->log_code = log_code;
+        }
+        if (c->log_code == log_code) {
+            c->count++;
+            return;
+        }
+    }
+    stream->stats.n_untracked++;
+}
+
+uint64_t
+qcdm_log_stream_get_code_count (QcdmLogStream *stream, uint16_t log_code)
+{
+    uint32_t slot, i;
+
+    qcdm_return_val_if_fail (stream != NULL, 0);
+
+    slot = ((uint32_t) log_code * 2654435761u) >> 23;
+    for (i = 0; i < CODE_TABLE_SIZE; i++) {
+        CodeCounter *c = &stream->codes[(slot + i) & (CODE_TABLE_SIZE - 1)];
+
+        if (!c->used)
+            break;
+        if (c->log_code == log_code)
+            return c->count;
+    }
+    return 0;
+}
+
+void
+qcdm_log_stream_get_stats (QcdmLogStream *stream, QcdmLogStreamStats *out_stats)
+{
+    qcdm_return_if_fail (stream != NULL);
+    qcdm_return_if_fail (out_stats != NULL);
+
+    memcpy (out_stats, &stream->stats, sizeof (*out_stats));
+}
+
+/**********************************************************************/
+
+static void
+frame_reset (QcdmLogStream *stream)
+{
+    stream->frame_len = 0;
+    stream->frame_raw_len = 0;
+    stream->escaping = FALSE;
+    stream->oversized = FALSE;
+}
+
+static void
+frame_drop (QcdmLogStream *stream, uint64_t *counter)
+{
+    (*counter)++;
+    stream->stats.n_dropped_bytes += stream->frame_raw_len;
+    frame_reset (stream);
+}
+
+/* Validates the frame ended by a control char; returns TRUE if it holds a
+ * log packet. */
+static qcdmbool
+frame_complete (QcdmLogStream *stream,
+                uint16_t *out_log_code,
+                const char **out_packet,
+                size_t *out_packet_len)
+{
+    const DMCmdLog *log_cmd = (const DMCmdLog *) stream->frame;
+    size_t packet_len;
+    uint16_t crc;
+
+    /* Back-to-back control chars are used as frame separators */
+    if (stream->frame_raw_len == 1) {
+        frame_reset (stream);
+        return FALSE;
+    }
+
+    if (stream->oversized) {
+        frame_drop (stream, &stream->stats.n_oversized);
+        return FALSE;
+    }
+
+    /* Need at least one byte of data plus the CRC, and no dangling escape */
+    if (stream->frame_len < 3 || stream->escaping) {
+        frame_drop (stream, &stream->stats.n_malformed);
+        return FALSE;
+    }
+
+    packet_len = stream->frame_len - 2;
+    crc = (stream->frame[packet_len] & 0xFF) | ((stream->frame[packet_len + 1] & 0xFF) << 8);
+    if (dm_crc16 (stream->frame, packet_len) != crc) {
+        frame_drop (stream, &stream->stats.n_crc_errors);
+        return FALSE;
+    }
+
+    if (stream->frame[0] != DIAG_CMD_LOG) {
+        stream->stats.n_other++;
+        frame_reset (stream);
+        return FALSE;
+    }
+
+    if (packet_len < sizeof (DMCmdLog)) {
+        frame_drop (stream, &stream->stats.n_malformed);
+        return FALSE;
+    }
+
+    stream->stats.n_packets++;
+    count_log_code (stream, le16toh (log_cmd->log_code));
+
+    *out_log_code = le16toh (log_cmd->log_code);
+    *out_packet = stream->frame;
+    *out_packet_len = packet_len;
+
+    /* The packet stays in the frame buffer until the next call */
+    frame_reset (stream);
+    return TRUE;
+}
+
+static void
+frame_append (QcdmLogStream *stream, const char *buf, size_t len)
+{
+    if (stream->oversized)
+        return;
+
+    if (len > sizeof (stream->frame) - stream->frame_len) {
+        stream->oversized = TRUE;
+        return;
+    }
+
+    memcpy (&stream->frame[stream->frame_len], buf, len);
+    stream->frame_len += len;
+}
+
+void
+qcdm_log_stream_feed (QcdmLogStream *stream, const char *buf, size_t len)
+{
+    qcdm_return_if_fail (stream != NULL);
+    qcdm_return_if_fail (buf != NULL || len == 0);
+    qcdm_return_if_fail (stream->in_len == 0);
+
+    stream->in = buf;
+    stream->in_len = len;
+    stream->stats.n_bytes += len;
+}
+
+qcdmbool
+qcdm_log_stream_next (QcdmLogStream *stream,
+                      uint16_t *out_log_code,
+                      const char **out_packet,
+                      size_t *out_packet_len)
+{
+    qcdm_return_val_if_fail (stream != NULL, FALSE);
+    qcdm_return_val_if_fail (out_log_code != NULL, FALSE);
+    qcdm_return_val_if_fail (out_packet != NULL, FALSE);
+    qcdm_return_val_if_fail (out_packet_len != NULL, FALSE);
+
+    while (stream->in_len > 0) {
+        const char *p = stream->in;
+        size_t n = stream->in_len;
+        size_t run;
+        char c;
+
+        /* Pending escape from the previous byte, possibly in an earlier chunk */
+        if (stream->escaping && *p != DIAG_CONTROL_CHAR) {
+            c = *p ^ DIAG_ESC_MASK;
+            frame_append (stream, &c, 1);
+            stream->escaping = FALSE;
+            stream->frame_raw_len++;
+            stream->in++;
+            stream->in_len--;
+            continue;
+        }
+
+        /* Copy the longest run of plain bytes in one go */
+        for (run = 0; run < n; run++) {
+            if (p[run] == DIAG_CONTROL_CHAR || p[run] == DIAG_ESC_CHAR)
+                break;
+        }
+        if (run > 0) {
+            frame_append (stream, p, run);
+            stream->frame_raw_len += run;
+            stream->in += run;
+            stream->in_len -= run;
+            continue;
+        }
+
+        stream->frame_raw_len++;
+        stream->in++;
+        stream->in_len--;
+
+        if (*p == DIAG_ESC_CHAR) {
+            stream->escaping = TRUE;
+            continue;
+        }
+
+        /* Control char */
+        if (frame_complete (stream, out_log_code, out_packet, out_packet_len))
+            return TRUE;
+    }
+
+    stream->in = NULL;
+    return FALSE;
+}
+
+size_t
+qcdm_log_stream_process (QcdmLogStream *stream,
+                         const char *buf,
+                         size_t len,
+                         QcdmLogStreamFunc func,
+                         void *user_data)
+{
+    uint16_t log_code = 0;
+    const char *packet = NULL;
+    size_t packet_len = 0;
+    size_t n = 0;
+
+    qcdm_return_val_if_fail (stream != NULL, 0);
+    qcdm_return_val_if_fail (func != NULL, 0);
+
+    qcdm_log_stream_feed (stream, buf, len);
+    while (qcdm_log_stream_next (stream, &log_code, &packet, &packet_len)) {
+        func (log_code, packet, packet_len, user_data);
+        n++;
+    }
+    return n;
+}
+
+/**********************************************************************/
+
+void
+qcdm_log_stream_reset (QcdmLogStream *stream)
+{
+    qcdm_return_if_fail (stream != NULL);
+
+    stream->in = NULL;
+    stream->in_len = 0;
+    frame_reset (stream);
+}
+
+QcdmLogStream *
+qcdm_log_stream_new (void)
+{
+    QcdmLogStream *stream;
+
+    stream = malloc (sizeof (QcdmLogStream));
+    if (stream) {
+        /* The frame buffer doesn't need clearing */
+        memset (stream, 0, offsetof (QcdmLogStream, frame));
+    }
+    return stream;
+}
+
+void
+qcdm_log_stream_free (QcdmLogStream *stream)
+{
+    qcdm_return_if_fail (stream != NULL);
+
+    memset (stream, 0, offsetof (QcdmLogStream, frame));
+    free (stream);
+}
@@ -0,0 +1,82 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * Copyright (C) 2019 The ModemManager authors
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBQCDM_LOG_STREAM_H
+#define LIBQCDM_LOG_STREAM_H
+
+#include <stddef.h>
+
+#include "utils.h"
+
+/* Incremental decoder for a stream of raw DM port data. Arbitrary chunks of
+ * data may be given; complete frames are unescaped into a buffer owned by the
+ * stream, CRC-checked, and the ones holding log packets are returned. Packets
+ * include the DM log header, so they can be given as-is to the
+ * qcdm_log_item_*_new() parsers, and are only valid until the next call to
+ * the stream. */
+
+typedef struct QcdmLogStream QcdmLogStream;
+
+typedef struct {
+    uint64_t n_bytes;         /* raw bytes received */
+    uint64_t n_packets;       /* log packets returned */
+    uint64_t n_other;         /* valid frames that were not log packets */
+    uint64_t n_crc_errors;    /* frames dropped because of a CRC mismatch */
+    uint64_t n_malformed;     /* frames dropped because they were too short */
+    uint64_t n_oversized;     /* frames dropped because they didn't fit */
+    uint64_t n_dropped_bytes; /* raw bytes in dropped frames */
+    uint64_t n_untracked;     /* packets not counted per log code */
+} QcdmLogStreamStats;
+
+typedef void (*QcdmLogStreamFunc) (uint16_t log_code,
+                                   const char *packet,
+                                   size_t packet_len,
+                                   void *user_data);
+
+QcdmLogStream *qcdm_log_stream_new  (void);
+
+void           qcdm_log_stream_free (QcdmLogStream *stream);
+
+/* Drops any partial frame, e.g. after the port has been reopened */
+void           qcdm_log_stream_reset (QcdmLogStream *stream);
+
+/* Iterator API: @buf is not copied and must be valid until
+ * qcdm_log_stream_next() returns FALSE. */
+void           qcdm_log_stream_feed (QcdmLogStream *stream,
+                                     const char *buf,
+                                     size_t len);
+
+qcdmbool       qcdm_log_stream_next (QcdmLogStream *stream,
+                                     uint16_t *out_log_code,
+                                     const char **out_packet,
+                                     size_t *out_packet_len);
+
+/* Callback API: runs @func for every log packet found in @buf, and returns
+ * the number of packets found. */
+size_t         qcdm_log_stream_process (QcdmLogStream *stream,
+                                        const char *buf,
+                                        size_t len,
+                                        QcdmLogStreamFunc func,
+                                        void *user_data);
+
+void           qcdm_log_stream_get_stats (QcdmLogStream *stream,
+                                          QcdmLogStreamStats *out_stats);
+
+uint64_t       qcdm_log_stream_get_code_count (QcdmLogStream *stream,
+                                               uint16_t log_code);
+
+#endif  /* LIBQCDM_LOG_STREAM_H */
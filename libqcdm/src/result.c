@@ -17,6 +17,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
 
 #include "result.h"
 #include "result-private.h"
@@ -24,7 +25,16 @@
 
 /*********************************************************/
 
-typedef struct Val Val;
+/* A result is a single allocation holding a fixed table of typed fields, a
+ * small open-addressing index to look them up by key, and an arena where
+ * keys, strings and arrays are stored. Values too big for the inline arena go
+ * to overflow chunks, which are never moved, so pointers given to the caller
+ * stay valid until the result is freed. */
+
+#define RESULT_MAX_FIELDS 32
+#define RESULT_INDEX_SIZE 64 /* power of two, at least 2 * RESULT_MAX_FIELDS */
+#define RESULT_ARENA_SIZE 256
+#define RESULT_CHUNK_SIZE 512
 
 typedef enum {
     VAL_TYPE_NONE = 0,
@@ -35,161 +45,174 @@ typedef enum {
     VAL_TYPE_U16_ARRAY = 5,
 } ValType;
 
-struct Val {
-    char *key;
+typedef struct {
+    const char *key;
+    uint32_t hash;
     uint8_t type;
     union {
-        char *s;
+        const char *s;
         uint8_t u8;
         uint32_t u32;
-        uint8_t *u8_array;
-        uint16_t *u16_array;
+        const uint8_t *u8_array;
+        const uint16_t *u16_array;
     } u;
     uint32_t array_len;
-    Val *next;
+} Field;
+
+typedef struct Chunk Chunk;
+struct Chunk {
+    Chunk *next;
+    size_t size;
+    size_t used;
+    uint64_t data[];
 };
 
-static void
-val_free (Val *v)
-{
-    if (v->type == VAL_TYPE_STRING) {
-        free (v->u.s);
-    } else if (v->type == VAL_TYPE_U8_ARRAY) {
-        free (v->u.u8_array);
-    } else if (v->type == VAL_TYPE_U16_ARRAY) {
-        free (v->u.u16_array);
-    }
-    free (v->key);
-    memset (v, 0, sizeof (*v));
-    free (v);
-}
+struct QcdmResult {
+    uint32_t refcount;
+    uint32_t n_fields;
+    Field fields[RESULT_MAX_FIELDS];
+    /* field index + 1 for each slot, 0 if empty */
+    uint8_t index[RESULT_INDEX_SIZE];
+    size_t arena_used;
+    uint64_t arena[RESULT_ARENA_SIZE / sizeof (uint64_t)];
+    Chunk *chunks;
+};
+
+#define ALIGN_SIZE(s) (((s) + sizeof (uint64_t) - 1) & ~(sizeof (uint64_t) - 1))
 
-static Val *
-val_new_string (const char *key, const char *value)
+static void *
+arena_alloc (QcdmResult *r, size_t size)
 {
-    Val *v;
+    Chunk *chunk;
+    void *p;
 
-    qcdm_return_val_if_fail (key != NULL, NULL);
-    qcdm_return_val_if_fail (key[0] != '\0', NULL);
-    qcdm_return_val_if_fail (value != NULL, NULL);
+    size = ALIGN_SIZE (size);
 
-    v = calloc (sizeof (Val), 1);
-    if (v == NULL)
-        return NULL;
+    if (size <= sizeof (r->arena) - r->arena_used) {
+        p = (char *) r->arena + r->arena_used;
+        r->arena_used += size;
+        return p;
+    }
 
-    v->key = strdup (key);
-    v->type = VAL_TYPE_STRING;
-    v->u.s = strdup (value);
-    return v;
+    chunk = r->chunks;
+    if (chunk == NULL || size > chunk->size - chunk->used) {
+        size_t chunk_size;
+
+        chunk_size = size > RESULT_CHUNK_SIZE ? size : RESULT_CHUNK_SIZE;
+        chunk = malloc (sizeof (Chunk) + chunk_size);
+        if (chunk == NULL)
+            return NULL;
+        chunk->size = chunk_size;
+        chunk->used = 0;
+        chunk->next = r->chunks;
+        r->chunks = chunk;
+    }
+
+    p = (char *) chunk->data + chunk->used;
+    chunk->used += size;
+    return p;
 }
 
-static Val *
-val_new_u8 (const char *key, uint8_t u)
+static void *
+arena_dup (QcdmResult *r, const void *data, size_t size)
 {
-    Val *v;
+    void *p;
 
-    qcdm_return_val_if_fail (key != NULL, NULL);
-    qcdm_return_val_if_fail (key[0] != '\0', NULL);
+    p = arena_alloc (r, size);
+    if (p)
+        memcpy (p, data, size);
+    return p;
+}
 
-    v = calloc (sizeof (Val), 1);
-    if (v == NULL)
-        return NULL;
+/* FNV-1a */
+static uint32_t
+key_hash (const char *key)
+{
+    uint32_t h = 2166136261u;
 
-    v->key = strdup (key);
-    v->type = VAL_TYPE_U8;
-    v->u.u8 = u;
-    return v;
+    for (; *key; key++) {
+        h ^= (uint8_t) *key;
+        h *= 16777619u;
+    }
+    return h;
 }
 
-static Val *
-val_new_u8_array (const char *key, const uint8_t *array, size_t array_len)
+static Field *
+lookup_field (QcdmResult *r, const char *key, uint32_t hash, uint32_t *out_slot)
 {
-    Val *v;
+    uint32_t slot;
 
-    qcdm_return_val_if_fail (key != NULL, NULL);
-    qcdm_return_val_if_fail (key[0] != '\0', NULL);
-    qcdm_return_val_if_fail (array != NULL, NULL);
-    qcdm_return_val_if_fail (array_len > 0, NULL);
-
-    v = calloc (sizeof (Val), 1);
-    if (v == NULL)
-        return NULL;
+    for (slot = hash & (RESULT_INDEX_SIZE - 1);
+         r->index[slot] != 0;
+         slot = (slot + 1) & (RESULT_INDEX_SIZE - 1)) {
+        Field *f = &r->fields[r->index[slot] - 1];
 
-    v->key = strdup (key);
-    v->type = VAL_TYPE_U8_ARRAY;
-    v->u.u8_array = malloc (array_len);
-    if (v->u.u8_array == NULL) {
-        val_free (v);
-        return NULL;
+        if (f->hash == hash && (f->key == key || strcmp (f->key, key) == 0)) {
+            if (out_slot)
+                *out_slot = slot;
+            return f;
+        }
     }
-    memcpy (v->u.u8_array, array, array_len);
-    v->array_len = array_len;
 
-    return v;
+    if (out_slot)
+        *out_slot = slot;
+    return NULL;
 }
 
-static Val *
-val_new_u32 (const char *key, uint32_t u)
+/* Returns the field for @key, creating it if needed; values previously
+ * stored with the same key are replaced, so the newest one wins. */
+static Field *
+add_field (QcdmResult *r, const char *key)
 {
-    Val *v;
+    Field *f;
+    uint32_t hash, slot;
 
     qcdm_return_val_if_fail (key != NULL, NULL);
     qcdm_return_val_if_fail (key[0] != '\0', NULL);
 
-    v = calloc (sizeof (Val), 1);
-    if (v == NULL)
-        return NULL;
+    hash = key_hash (key);
+    f = lookup_field (r, key, hash, &slot);
+    if (f)
+        return f;
 
-    v->key = strdup (key);
-    v->type = VAL_TYPE_U32;
-    v->u.u32 = u;
-    return v;
+    qcdm_return_val_if_fail (r->n_fields < RESULT_MAX_FIELDS, NULL);
+
+    f = &r->fields[r->n_fields];
+    f->key = arena_dup (r, key, strlen (key) + 1);
+    if (f->key == NULL)
+        return NULL;
+    f->hash = hash;
+    r->index[slot] = ++r->n_fields;
+    return f;
 }
 
-static Val *
-val_new_u16_array (const char *key, const uint16_t *array, size_t array_len)
+static Field *
+find_val (QcdmResult *r, const char *key, ValType expected_type)
 {
-    Val *v;
-    size_t sz;
+    Field *f;
 
-    qcdm_return_val_if_fail (key != NULL, NULL);
-    qcdm_return_val_if_fail (key[0] != '\0', NULL);
-    qcdm_return_val_if_fail (array != NULL, NULL);
-    qcdm_return_val_if_fail (array_len > 0, NULL);
-
-    v = calloc (sizeof (Val), 1);
-    if (v == NULL)
-        return NULL;
-
-    v->key = strdup (key);
-    v->type = VAL_TYPE_U16_ARRAY;
-    sz = sizeof (uint16_t) * array_len;
-    v->u.u16_array = malloc (sz);
-    if (v->u.u16_array == NULL) {
-        val_free (v);
-        return NULL;
+    f = lookup_field (r, key, key_hash (key), NULL);
+    if (f) {
+        /* Check type */
+        qcdm_return_val_if_fail (f->type == expected_type, NULL);
     }
-    memcpy (v->u.u16_array, array, sz);
-    v->array_len = array_len;
-
-    return v;
+    return f;
 }
 
 /*********************************************************/
 
-struct QcdmResult {
-    uint32_t refcount;
-    Val *first;
-};
-
 QcdmResult *
 qcdm_result_new (void)
 {
     QcdmResult *r;
 
-    r = calloc (sizeof (QcdmResult), 1);
-    if (r)
+    /* Only the header needs clearing, the arena is handed out as-is */
+    r = malloc (sizeof (QcdmResult));
+    if (r) {
+        memset (r, 0, offsetof (QcdmResult, arena));
+        r->chunks = NULL;
         r->refcount = 1;
+    }
     return r;
 }
 
@@ -206,15 +229,15 @@ qcdm_result_ref (QcdmResult *r)
 static void
 qcdm_result_free (QcdmResult *r)
 {
-    Val *v, *n;
+    Chunk *c, *n;
 
-    v = r->first;
-    while (v) {
-        n = v->next;
-        val_free (v);
-        v = n;
+    c = r->chunks;
+    while (c) {
+        n = c->next;
+        free (c);
+        c = n;
     }
-    memset (r, 0, sizeof (*r));
+    memset (r, 0, offsetof (QcdmResult, arena));
     free (r);
 }
 
@@ -229,40 +252,25 @@ qcdm_result_unref (QcdmResult *r)
         qcdm_result_free (r);
 }
 
-static Val *
-find_val (QcdmResult *r, const char *key, ValType expected_type)
-{
-    Val *v, *n;
-
-    v = r->first;
-    while (v) {
-        n = v->next;
-        if (strcmp (v->key, key) == 0) {
-            /* Check type */
-            qcdm_return_val_if_fail (v->type == expected_type, NULL);
-            return v;
-        }
-        v = n;
-    }
-    return NULL;
-}
-
 void
 qcdm_result_add_string (QcdmResult *r,
                        const char *key,
                        const char *str)
 {
-    Val *v;
+    Field *f;
+    const char *s;
 
     qcdm_return_if_fail (r != NULL);
     qcdm_return_if_fail (r->refcount > 0);
     qcdm_return_if_fail (key != NULL);
     qcdm_return_if_fail (str != NULL);
 
-    v = val_new_string (key, str);
-    qcdm_return_if_fail (v != NULL);
-    v->next = r->first;
-    r->first = v;
+    s = arena_dup (r, str, strlen (str) + 1);
+    qcdm_return_if_fail (s != NULL);
+    f = add_field (r, key);
+    qcdm_return_if_fail (f != NULL);
+    f->type = VAL_TYPE_STRING;
+    f->u.s = s;
 }
 
 int
@@ -270,7 +278,7 @@ qcdm_result_get_string (QcdmResult *r,
                        const char *key,
                        const char **out_val)
 {
-    Val *v;
+    Field *f;
 
     qcdm_return_val_if_fail (r != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (r->refcount > 0, -QCDM_ERROR_INVALID_ARGUMENTS);
@@ -278,11 +286,11 @@ qcdm_result_get_string (QcdmResult *r,
     qcdm_return_val_if_fail (out_val != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (*out_val == NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
 
-    v = find_val (r, key, VAL_TYPE_STRING);
-    if (v == NULL)
+    f = find_val (r, key, VAL_TYPE_STRING);
+    if (f == NULL)
         return -QCDM_ERROR_VALUE_NOT_FOUND;
 
-    *out_val = v->u.s;
+    *out_val = f->u.s;
     return 0;
 }
 
@@ -291,16 +299,16 @@ qcdm_result_add_u8 (QcdmResult *r,
                    const char *key,
                    uint8_t num)
 {
-    Val *v;
+    Field *f;
 
     qcdm_return_if_fail (r != NULL);
     qcdm_return_if_fail (r->refcount > 0);
     qcdm_return_if_fail (key != NULL);
 
-    v = val_new_u8 (key, num);
-    qcdm_return_if_fail (v != NULL);
-    v->next = r->first;
-    r->first = v;
+    f = add_field (r, key);
+    qcdm_return_if_fail (f != NULL);
+    f->type = VAL_TYPE_U8;
+    f->u.u8 = num;
 }
 
 int
@@ -308,18 +316,18 @@ qcdm_result_get_u8  (QcdmResult *r,
                     const char *key,
                     uint8_t *out_val)
 {
-    Val *v;
+    Field *f;
 
     qcdm_return_val_if_fail (r != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (r->refcount > 0, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (key != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (out_val != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
 
-    v = find_val (r, key, VAL_TYPE_U8);
-    if (v == NULL)
+    f = find_val (r, key, VAL_TYPE_U8);
+    if (f == NULL)
         return -QCDM_ERROR_VALUE_NOT_FOUND;
 
-    *out_val = v->u.u8;
+    *out_val = f->u.u8;
     return 0;
 }
 
@@ -329,17 +337,22 @@ qcdm_result_add_u8_array (QcdmResult *r,
                           const uint8_t *array,
                           size_t array_len)
 {
-    Val *v;
+    Field *f;
+    const uint8_t *a;
 
     qcdm_return_if_fail (r != NULL);
     qcdm_return_if_fail (r->refcount > 0);
     qcdm_return_if_fail (key != NULL);
     qcdm_return_if_fail (array != NULL);
-
-    v = val_new_u8_array (key, array, array_len);
-    qcdm_return_if_fail (v != NULL);
-    v->next = r->first;
-    r->first = v;
+    qcdm_return_if_fail (array_len > 0);
+
+    a = arena_dup (r, array, array_len);
+    qcdm_return_if_fail (a != NULL);
+    f = add_field (r, key);
+    qcdm_return_if_fail (f != NULL);
+    f->type = VAL_TYPE_U8_ARRAY;
+    f->u.u8_array = a;
+    f->array_len = array_len;
 }
 
 int
@@ -348,7 +361,7 @@ qcdm_result_get_u8_array (QcdmResult *r,
                           const uint8_t **out_val,
                           size_t *out_len)
 {
-    Val *v;
+    Field *f;
 
     qcdm_return_val_if_fail (r != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (r->refcount > 0, -QCDM_ERROR_INVALID_ARGUMENTS);
@@ -356,12 +369,12 @@ qcdm_result_get_u8_array (QcdmResult *r,
     qcdm_return_val_if_fail (out_val != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (out_len != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
 
-    v = find_val (r, key, VAL_TYPE_U8_ARRAY);
-    if (v == NULL)
+    f = find_val (r, key, VAL_TYPE_U8_ARRAY);
+    if (f == NULL)
         return -QCDM_ERROR_VALUE_NOT_FOUND;
 
-    *out_val = v->u.u8_array;
-    *out_len = v->array_len;
+    *out_val = f->u.u8_array;
+    *out_len = f->array_len;
     return 0;
 }
 
@@ -370,16 +383,16 @@ qcdm_result_add_u32 (QcdmResult *r,
                     const char *key,
                     uint32_t num)
 {
-    Val *v;
+    Field *f;
 
     qcdm_return_if_fail (r != NULL);
     qcdm_return_if_fail (r->refcount > 0);
     qcdm_return_if_fail (key != NULL);
 
-    v = val_new_u32 (key, num);
-    qcdm_return_if_fail (v != NULL);
-    v->next = r->first;
-    r->first = v;
+    f = add_field (r, key);
+    qcdm_return_if_fail (f != NULL);
+    f->type = VAL_TYPE_U32;
+    f->u.u32 = num;
 }
 
 int
@@ -387,18 +400,18 @@ qcdm_result_get_u32 (QcdmResult *r,
                     const char *key,
                     uint32_t *out_val)
 {
-    Val *v;
+    Field *f;
 
     qcdm_return_val_if_fail (r != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (r->refcount > 0, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (key != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (out_val != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
 
-    v = find_val (r, key, VAL_TYPE_U32);
-    if (v == NULL)
+    f = find_val (r, key, VAL_TYPE_U32);
+    if (f == NULL)
         return -QCDM_ERROR_VALUE_NOT_FOUND;
 
-    *out_val = v->u.u32;
+    *out_val = f->u.u32;
     return 0;
 }
 
@@ -408,17 +421,22 @@ qcdm_result_add_u16_array (QcdmResult *r,
                            const uint16_t *array,
                            size_t array_len)
 {
-    Val *v;
+    Field *f;
+    const uint16_t *a;
 
     qcdm_return_if_fail (r != NULL);
     qcdm_return_if_fail (r->refcount > 0);
     qcdm_return_if_fail (key != NULL);
     qcdm_return_if_fail (array != NULL);
-
-    v = val_new_u16_array (key, array, array_len);
-    qcdm_return_if_fail (v != NULL);
-    v->next = r->first;
-    r->first = v;
+    qcdm_return_if_fail (array_len > 0);
+
+    a = arena_dup (r, array, sizeof (uint16_t) * array_len);
+    qcdm_return_if_fail (a != NULL);
+    f = add_field (r, key);
+    qcdm_return_if_fail (f != NULL);
+    f->type = VAL_TYPE_U16_ARRAY;
+    f->u.u16_array = a;
+    f->array_len = array_len;
 }
 
 int
@@ -427,7 +445,7 @@ qcdm_result_get_u16_array (QcdmResult *r,
                            const uint16_t **out_val,
                            size_t *out_len)
 {
-    Val *v;
+    Field *f;
 
     qcdm_return_val_if_fail (r != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (r->refcount > 0, -QCDM_ERROR_INVALID_ARGUMENTS);
@@ -435,11 +453,11 @@ qcdm_result_get_u16_array (QcdmResult *r,
     qcdm_return_val_if_fail (out_val != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
     qcdm_return_val_if_fail (out_len != NULL, -QCDM_ERROR_INVALID_ARGUMENTS);
 
-    v = find_val (r, key, VAL_TYPE_U16_ARRAY);
-    if (v == NULL)
+    f = find_val (r, key, VAL_TYPE_U16_ARRAY);
+    if (f == NULL)
         return -QCDM_ERROR_VALUE_NOT_FOUND;
 
-    *out_val = v->u.u16_array;
-    *out_len = v->array_len;
+    *out_val = f->u.u16_array;
+    *out_len = f->array_len;
     return 0;
 }
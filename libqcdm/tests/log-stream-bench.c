@@ -0,0 +1,161 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * Copyright (C) 2019 The ModemManager authors
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Feeds a multi-megabyte stream of raw DM port data through a log stream in
+ * serial-read-sized chunks, and reports the sustained throughput. The stream
+ * is either read from a capture file given in the command line, or
+ * synthesized from log packets of assorted sizes. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "utils.h"
+#include "log-stream.h"
+
+#define SYNTHETIC_STREAM_LEN (32 * 1024 * 1024)
+#define CHUNK_LEN            4096
+
+static char *
+synthesize_stream (size_t *out_len)
+{
+    char *stream;
+    size_t len = 0;
+    uint32_t seed = 1;
+
+    stream = malloc (SYNTHETIC_STREAM_LEN);
+    if (!stream)
+        return NULL;
+
+    while (1) {
+        char packet[1024 + 2];
+        size_t packet_len, frame_len, i;
+        uint16_t log_code;
+
+        seed = seed * 1103515245 + 12345;
+        packet_len = 16 + ((seed >> 16) % 1000);
+        log_code = 0x1000 + ((seed >> 8) % 64);
+
+        memset (packet, 0, 16);
+        packet[0] = 0x10; /* DIAG_CMD_LOG */
+        packet[2] = (packet_len - 4) & 0xFF;
+        packet[3] = ((packet_len - 4) >> 8) & 0xFF;
+        packet[4] = packet[2];
+        packet[5] = packet[3];
+        packet[6] = log_code & 0xFF;
+        packet[7] = (log_code >> 8) & 0xFF;
+        /* Mostly small values, with the odd byte needing escaping */
+        for (i = 16; i < packet_len; i++)
+            packet[i] = (char) ((i * 7 + seed) % 0x90);
+
+        if (len + 2 * sizeof (packet) + 1 > SYNTHETIC_STREAM_LEN)
+            break;
+        frame_len = dm_encapsulate_buffer (packet, packet_len, sizeof (packet),
+                                           &stream[len], SYNTHETIC_STREAM_LEN - len);
+        if (!frame_len)
+            break;
+        len += frame_len;
+    }
+
+    *out_len = len;
+    return stream;
+}
+
+static char *
+read_capture (const char *path, size_t *out_len)
+{
+    FILE *f;
+    char *stream;
+    long len;
+
+    f = fopen (path, "rb");
+    if (!f)
+        return NULL;
+    if (fseek (f, 0, SEEK_END) < 0 || (len = ftell (f)) <= 0 || fseek (f, 0, SEEK_SET) < 0) {
+        fclose (f);
+        return NULL;
+    }
+    stream = malloc (len);
+    if (stream && fread (stream, 1, len, f) != (size_t) len) {
+        free (stream);
+        stream = NULL;
+    }
+    fclose (f);
+    *out_len = len;
+    return stream;
+}
+
+static void
+packet_cb (uint16_t log_code, const char *packet, size_t packet_len, void *user_data)
+{
+    *((size_t *) user_data) += packet_len;
+}
+
+static double
+now_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+int main (int argc, char *argv[])
+{
+    QcdmLogStream *log_stream;
+    QcdmLogStreamStats stats;
+    char *stream;
+    size_t stream_len = 0, offset, payload = 0;
+    double start, elapsed;
+
+    if (argc > 1)
+        stream = read_capture (argv[1], &stream_len);
+    else
+        stream = synthesize_stream (&stream_len);
+    if (!stream) {
+        fprintf (stderr, "E: failed to load the DM stream\n");
+        return 1;
+    }
+
+    log_stream = qcdm_log_stream_new ();
+
+    start = now_ns ();
+    for (offset = 0; offset < stream_len; offset += CHUNK_LEN) {
+        size_t len = stream_len - offset < CHUNK_LEN ? stream_len - offset : CHUNK_LEN;
+
+        qcdm_log_stream_process (log_stream, &stream[offset], len, packet_cb, &payload);
+    }
+    elapsed = now_ns () - start;
+
+    qcdm_log_stream_get_stats (log_stream, &stats);
+    fprintf (stdout, "bytes:        %llu\n", (unsigned long long) stats.n_bytes);
+    fprintf (stdout, "packets:      %llu (%zu bytes)\n", (unsigned long long) stats.n_packets, payload);
+    fprintf (stdout, "other:        %llu\n", (unsigned long long) stats.n_other);
+    fprintf (stdout, "dropped:      %llu bytes (crc %llu, malformed %llu, oversized %llu)\n",
+             (unsigned long long) stats.n_dropped_bytes,
+             (unsigned long long) stats.n_crc_errors,
+             (unsigned long long) stats.n_malformed,
+             (unsigned long long) stats.n_oversized);
+    fprintf (stdout, "throughput:   %.1f MB/s, %.0f packets/s\n",
+             ((double) stats.n_bytes / (1024.0 * 1024.0)) / (elapsed / 1e9),
+             (double) stats.n_packets / (elapsed / 1e9));
+
+    qcdm_log_stream_free (log_stream);
+    free (stream);
+    return 0;
+}
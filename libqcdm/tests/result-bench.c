@@ -0,0 +1,211 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * Copyright (C) 2019 The ModemManager authors
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Decodes a corpus of captured DM responses in a loop, and reports how long
+ * building and querying each result takes. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "utils.h"
+#include "errors.h"
+#include "commands.h"
+#include "result.h"
+
+#define DEFAULT_ITERATIONS 200000
+
+/* Pilot sets response, as read from the serial port */
+static const char pilot_sets_frame[] = {
+    0x40, 0x03, 0x00, 0x01, 0x00, 0x19, 0xf0, 0x00, 0x16, 0x00, 0x21, 0x00,
+    0x1c, 0x00, 0xd8, 0x00, 0x3f, 0x00, 0x56, 0x01, 0x3f, 0x00, 0x15, 0x00,
+    0x1a, 0x00, 0x11, 0x01, 0x3f, 0x00, 0x92, 0x01, 0x3f, 0x00, 0x39, 0x00,
+    0x3f, 0x00, 0x95, 0x01, 0x3f, 0x00, 0x12, 0x00, 0x3f, 0x00, 0x23, 0x01,
+    0x3f, 0x00, 0x66, 0x00, 0x3f, 0x00, 0x0b, 0x01, 0x3f, 0x00, 0xae, 0x00,
+    0x3f, 0x00, 0x02, 0x01, 0x3f, 0x00, 0xa8, 0x00, 0x3f, 0x00, 0x50, 0x01,
+    0x3f, 0x00, 0xf8, 0x01, 0x3f, 0x00, 0x57, 0x00, 0x3f, 0x00, 0x7d, 0x5e,
+    0x00, 0x3f, 0x00, 0x93, 0x00, 0x3f, 0x00, 0xbd, 0x00, 0x3f, 0x00, 0x77,
+    0x01, 0x3f, 0x00, 0xb7, 0x00, 0x3f, 0x00, 0xab, 0x00, 0x3f, 0x00, 0x33,
+    0x00, 0x3f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0xad, 0xde, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x13,
+    0x13, 0x50, 0x1f, 0x00, 0x00, 0xff, 0xff, 0x00, 0xaa, 0x19, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xb1, 0xc4, 0x7d, 0x5e,
+    0x7d, 0x5e, 0x7d, 0x5d, 0x5d, 0x04, 0x58, 0x1b, 0x5b, 0x1b, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x65, 0x69, 0x7e
+};
+
+/* CM subsystem state info response (decapsulated) */
+static const char cm_state_info_rsp[] = {
+    0x4b, 0x0f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00,
+    0x08, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0x3f,
+    0xff, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+/* HDR subsystem state info response (decapsulated) */
+static const char hdr_state_info_rsp[] = {
+    0x4b, 0x05, 0x08, 0x00, 0x01, 0x03, 0x03, 0x00, 0x02, 0x00, 0x00, 0x03,
+    0x01
+};
+
+typedef QcdmResult *(*ParseFunc) (const char *buf, size_t len, int *out_error);
+typedef int (*QueryFunc) (QcdmResult *result);
+
+static int
+query_pilot_sets (QcdmResult *result)
+{
+    uint32_t num = 0, pn = 0, ecio = 0;
+    float db = 0;
+
+    if (!qcdm_cmd_pilot_sets_result_get_num (result, QCDM_CMD_PILOT_SETS_TYPE_ACTIVE, &num))
+        return -1;
+    if (num && !qcdm_cmd_pilot_sets_result_get_pilot (result, QCDM_CMD_PILOT_SETS_TYPE_ACTIVE, 0, &pn, &ecio, &db))
+        return -1;
+    if (!qcdm_cmd_pilot_sets_result_get_num (result, QCDM_CMD_PILOT_SETS_TYPE_NEIGHBOR, &num))
+        return -1;
+    return 0;
+}
+
+static int
+query_cm_state_info (QcdmResult *result)
+{
+    static const char *keys[] = {
+        QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_CALL_STATE,
+        QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_OPERATING_MODE,
+        QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_SYSTEM_MODE,
+        QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_MODE_PREF,
+        QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_BAND_PREF,
+        QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_ROAM_PREF,
+        QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_SERVICE_DOMAIN_PREF,
+        QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_ACQ_ORDER_PREF,
+        QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_HYBRID_PREF,
+        QCDM_CMD_CM_SUBSYS_STATE_INFO_ITEM_NETWORK_SELECTION_PREF,
+    };
+    uint32_t num;
+    size_t i;
+
+    for (i = 0; i < sizeof (keys) / sizeof (keys[0]); i++) {
+        if (qcdm_result_get_u32 (result, keys[i], &num))
+            return -1;
+    }
+    return 0;
+}
+
+static int
+query_hdr_state_info (QcdmResult *result)
+{
+    static const char *keys[] = {
+        QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_AT_STATE,
+        QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_SESSION_STATE,
+        QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_ALMP_STATE,
+        QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_INIT_STATE,
+        QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_IDLE_STATE,
+        QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_CONNECTED_STATE,
+        QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_ROUTE_UPDATE_STATE,
+        QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_OVERHEAD_MSG_STATE,
+        QCDM_CMD_HDR_SUBSYS_STATE_INFO_ITEM_HDR_HYBRID_MODE,
+    };
+    uint8_t num;
+    size_t i;
+
+    for (i = 0; i < sizeof (keys) / sizeof (keys[0]); i++) {
+        if (qcdm_result_get_u8 (result, keys[i], &num))
+            return -1;
+    }
+    return 0;
+}
+
+typedef struct {
+    const char *name;
+    const char *buf;
+    size_t len;
+    qcdmbool encapsulated;
+    ParseFunc parse;
+    QueryFunc query;
+} CorpusEntry;
+
+static const CorpusEntry corpus[] = {
+    { "pilot-sets",     pilot_sets_frame,   sizeof (pilot_sets_frame),   TRUE,  qcdm_cmd_pilot_sets_result,            query_pilot_sets     },
+    { "cm-state-info",  cm_state_info_rsp,  sizeof (cm_state_info_rsp),  FALSE, qcdm_cmd_cm_subsys_state_info_result,  query_cm_state_info  },
+    { "hdr-state-info", hdr_state_info_rsp, sizeof (hdr_state_info_rsp), FALSE, qcdm_cmd_hdr_subsys_state_info_result, query_hdr_state_info },
+};
+
+static double
+now_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+int main (int argc, char *argv[])
+{
+    unsigned long iterations = DEFAULT_ITERATIONS;
+    size_t i;
+
+    if (argc > 1) {
+        iterations = strtoul (argv[1], NULL, 10);
+        if (!iterations) {
+            fprintf (stderr, "usage: %s [iterations]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    for (i = 0; i < sizeof (corpus) / sizeof (corpus[0]); i++) {
+        const CorpusEntry *entry = &corpus[i];
+        char buf[512];
+        size_t len = 0, used = 0;
+        qcdmbool more = FALSE;
+        unsigned long n;
+        double start, elapsed;
+        int err = QCDM_SUCCESS;
+
+        if (entry->encapsulated) {
+            if (!dm_decapsulate_buffer (entry->buf, entry->len, buf, sizeof (buf), &len, &used, &more)) {
+                fprintf (stderr, "E: failed to decapsulate %s response\n", entry->name);
+                return 1;
+            }
+        } else {
+            memcpy (buf, entry->buf, entry->len);
+            len = entry->len;
+        }
+
+        start = now_ns ();
+        for (n = 0; n < iterations; n++) {
+            QcdmResult *result;
+
+            result = entry->parse (buf, len, &err);
+            if (!result || entry->query (result) < 0) {
+                fprintf (stderr, "E: failed to decode %s response (%d)\n", entry->name, err);
+                return 1;
+            }
+            qcdm_result_unref (result);
+        }
+        elapsed = now_ns () - start;
+
+        fprintf (stdout, "%-16s %10lu iterations %10.1f ns/response\n",
+                 entry->name, iterations, elapsed / (double) iterations);
+    }
+
+    return 0;
+}
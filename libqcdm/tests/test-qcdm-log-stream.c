@@ -0,0 +1,181 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * Copyright (C) 2019 The ModemManager authors
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#include "test-qcdm-log-stream.h"
+#include "log-stream.h"
+#include "utils.h"
+
+#define LOG_CODE_1 0x1069
+#define LOG_CODE_2 0x108A
+
+/* Builds an encapsulated log packet with the given payload into @out */
+static size_t
+build_log_frame (guint16 log_code,
+                 const char *payload,
+                 size_t payload_len,
+                 char *out,
+                 size_t out_len)
+{
+    char buf[256];
+    size_t len;
+
+    g_assert (payload_len + 16 + 2 <= sizeof (buf));
+
+    memset (buf, 0, 16);
+    buf[0] = 0x10;                              /* DIAG_CMD_LOG */
+    len = 12 + payload_len;                     /* size after the len member */
+    buf[2] = len & 0xFF;
+    buf[3] = (len >> 8) & 0xFF;
+    buf[4] = buf[2];
+    buf[5] = buf[3];
+    buf[6] = log_code & 0xFF;
+    buf[7] = (log_code >> 8) & 0xFF;
+    memcpy (&buf[16], payload, payload_len);
+
+    len = dm_encapsulate_buffer (buf, 16 + payload_len, sizeof (buf), out, out_len);
+    g_assert_cmpint (len, >, 0);
+    return len;
+}
+
+typedef struct {
+    guint n_packets;
+    guint16 last_code;
+    char last_payload[32];
+} Received;
+
+static void
+packet_cb (uint16_t log_code,
+           const char *packet,
+           size_t packet_len,
+           void *user_data)
+{
+    Received *received = user_data;
+
+    g_assert_cmpint (packet_len, >=, 16);
+    g_assert_cmpint (packet_len - 16, <=, sizeof (received->last_payload));
+    received->n_packets++;
+    received->last_code = log_code;
+    memset (received->last_payload, 0, sizeof (received->last_payload));
+    memcpy (received->last_payload, &packet[16], packet_len - 16);
+}
+
+void
+test_log_stream_chunks (void *f, void *data)
+{
+    /* Includes the control and escape chars so that escaping is exercised */
+    static const char payload1[] = { 0x01, 0x7E, 0x02, 0x7D, 0x03 };
+    static const char payload2[] = { 0x7D, 0x7D, 0x7E, 0x7E };
+    char stream_buf[512];
+    size_t stream_len = 0;
+    QcdmLogStream *stream;
+    QcdmLogStreamStats stats;
+    Received received = { 0 };
+    size_t i;
+
+    /* Leading control char, as sent by most devices before the first frame */
+    stream_buf[stream_len++] = 0x7E;
+    stream_len += build_log_frame (LOG_CODE_1, payload1, sizeof (payload1),
+                                   &stream_buf[stream_len], sizeof (stream_buf) - stream_len);
+    stream_len += build_log_frame (LOG_CODE_2, payload2, sizeof (payload2),
+                                   &stream_buf[stream_len], sizeof (stream_buf) - stream_len);
+    stream_len += build_log_frame (LOG_CODE_1, payload2, sizeof (payload2),
+                                   &stream_buf[stream_len], sizeof (stream_buf) - stream_len);
+
+    stream = qcdm_log_stream_new ();
+    g_assert (stream);
+
+    /* One byte at a time */
+    for (i = 0; i < stream_len; i++)
+        qcdm_log_stream_process (stream, &stream_buf[i], 1, packet_cb, &received);
+    g_assert_cmpint (received.n_packets, ==, 3);
+    g_assert_cmpint (received.last_code, ==, LOG_CODE_1);
+    g_assert (memcmp (received.last_payload, payload2, sizeof (payload2)) == 0);
+
+    /* Everything at once, with the iterator API */
+    qcdm_log_stream_feed (stream, stream_buf, stream_len);
+    for (i = 0; ; i++) {
+        uint16_t log_code = 0;
+        const char *packet = NULL;
+        size_t packet_len = 0;
+
+        if (!qcdm_log_stream_next (stream, &log_code, &packet, &packet_len))
+            break;
+        g_assert_cmpint (log_code, ==, i == 1 ? LOG_CODE_2 : LOG_CODE_1);
+        if (i == 0) {
+            g_assert_cmpint (packet_len, ==, 16 + sizeof (payload1));
+            g_assert (memcmp (&packet[16], payload1, sizeof (payload1)) == 0);
+        }
+    }
+    g_assert_cmpint (i, ==, 3);
+
+    qcdm_log_stream_get_stats (stream, &stats);
+    g_assert_cmpint (stats.n_bytes, ==, 2 * stream_len);
+    g_assert_cmpint (stats.n_packets, ==, 6);
+    g_assert_cmpint (stats.n_dropped_bytes, ==, 0);
+    g_assert_cmpint (qcdm_log_stream_get_code_count (stream, LOG_CODE_1), ==, 4);
+    g_assert_cmpint (qcdm_log_stream_get_code_count (stream, LOG_CODE_2), ==, 2);
+    g_assert_cmpint (qcdm_log_stream_get_code_count (stream, 0x1234), ==, 0);
+
+    qcdm_log_stream_free (stream);
+}
+
+void
+test_log_stream_errors (void *f, void *data)
+{
+    static const char payload[] = { 0x11, 0x22, 0x33 };
+    /* Version info request, not a log packet */
+    static const char other[] = { 0x00, 0x78, 0xf0, 0x7e };
+    static const char short_frame[] = { 0x10, 0x7e };
+    char stream_buf[512];
+    size_t stream_len = 0;
+    size_t frame_len;
+    QcdmLogStream *stream;
+    QcdmLogStreamStats stats;
+    Received received = { 0 };
+
+    /* Corrupted CRC */
+    frame_len = build_log_frame (LOG_CODE_1, payload, sizeof (payload),
+                                 &stream_buf[stream_len], sizeof (stream_buf) - stream_len);
+    stream_buf[stream_len + frame_len - 2] ^= 0x01;
+    stream_len += frame_len;
+
+    memcpy (&stream_buf[stream_len], other, sizeof (other));
+    stream_len += sizeof (other);
+    memcpy (&stream_buf[stream_len], short_frame, sizeof (short_frame));
+    stream_len += sizeof (short_frame);
+
+    stream_len += build_log_frame (LOG_CODE_2, payload, sizeof (payload),
+                                   &stream_buf[stream_len], sizeof (stream_buf) - stream_len);
+
+    stream = qcdm_log_stream_new ();
+    g_assert (stream);
+
+    g_assert_cmpint (qcdm_log_stream_process (stream, stream_buf, stream_len, packet_cb, &received), ==, 1);
+    g_assert_cmpint (received.last_code, ==, LOG_CODE_2);
+
+    qcdm_log_stream_get_stats (stream, &stats);
+    g_assert_cmpint (stats.n_packets, ==, 1);
+    g_assert_cmpint (stats.n_crc_errors, ==, 1);
+    g_assert_cmpint (stats.n_other, ==, 1);
+    g_assert_cmpint (stats.n_malformed, ==, 1);
+    g_assert_cmpint (stats.n_dropped_bytes, ==, frame_len + sizeof (short_frame));
+
+    qcdm_log_stream_free (stream);
+}
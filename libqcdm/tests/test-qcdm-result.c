@@ -21,6 +21,7 @@
 #include "test-qcdm-result.h"
 #include "result.h"
 #include "result-private.h"
+#include "errors.h"
 
 #define TEST_TAG "test"
 
@@ -90,3 +91,64 @@ test_result_uint8_array (void *f, void *data)
 
     qcdm_result_unref (result);
 }
+
+void
+test_result_overwrite (void *f, void *data)
+{
+    const char *tmp = NULL;
+    guint32 num = 0;
+    QcdmResult *result;
+
+    result = qcdm_result_new ();
+    qcdm_result_add_u32 (result, TEST_TAG, 1);
+    qcdm_result_add_u32 (result, TEST_TAG, 2);
+    qcdm_result_get_u32 (result, TEST_TAG, &num);
+    g_assert_cmpint (num, ==, 2);
+
+    /* Newest value wins, even with a different type */
+    qcdm_result_add_string (result, TEST_TAG, "foobar");
+    g_assert_cmpint (qcdm_result_get_string (result, TEST_TAG, &tmp), ==, 0);
+    g_assert_cmpstr (tmp, ==, "foobar");
+
+    qcdm_result_unref (result);
+}
+
+void
+test_result_many (void *f, void *data)
+{
+    uint16_t array[300];
+    const uint16_t *tmp = NULL;
+    size_t tmp_len = 0;
+    guint32 num;
+    QcdmResult *result;
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (array); i++)
+        array[i] = i;
+
+    result = qcdm_result_new ();
+    for (i = 0; i < 20; i++) {
+        gchar key[16];
+
+        g_snprintf (key, sizeof (key), "key%u", i);
+        qcdm_result_add_u32 (result, key, i);
+    }
+    /* Bigger than the inline arena */
+    qcdm_result_add_u16_array (result, TEST_TAG, array, G_N_ELEMENTS (array));
+
+    for (i = 0; i < 20; i++) {
+        gchar key[16];
+
+        g_snprintf (key, sizeof (key), "key%u", i);
+        num = G_MAXUINT32;
+        g_assert_cmpint (qcdm_result_get_u32 (result, key, &num), ==, 0);
+        g_assert_cmpint (num, ==, i);
+    }
+    g_assert_cmpint (qcdm_result_get_u32 (result, "key20", &num), ==, -QCDM_ERROR_VALUE_NOT_FOUND);
+
+    g_assert_cmpint (qcdm_result_get_u16_array (result, TEST_TAG, &tmp, &tmp_len), ==, 0);
+    g_assert_cmpint (tmp_len, ==, G_N_ELEMENTS (array));
+    g_assert_cmpint (memcmp (tmp, array, sizeof (array)), ==, 0);
+
+    qcdm_result_unref (result);
+}
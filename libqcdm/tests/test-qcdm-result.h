@@ -22,6 +22,8 @@ void test_result_string (void *f, void *data);
 void test_result_uint32 (void *f, void *data);
 void test_result_uint8 (void *f, void *data);
 void test_result_uint8_array (void *f, void *data);
+void test_result_overwrite (void *f, void *data);
+void test_result_many (void *f, void *data);
 
 #endif  /* TEST_QCDM_RESULT_H */
 
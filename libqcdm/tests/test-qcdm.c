@@ -21,6 +21,7 @@
 #include "test-qcdm-crc.h"
 #include "test-qcdm-escaping.h"
 #include "test-qcdm-com.h"
+#include "test-qcdm-log-stream.h"
 #include "test-qcdm-result.h"
 #include "test-qcdm-utils.h"
 
@@ -90,6 +91,10 @@ int main (int argc, char **argv)
     g_test_suite_add (suite, TESTCASE (test_result_uint32, NULL));
     g_test_suite_add (suite, TESTCASE (test_result_uint8, NULL));
     g_test_suite_add (suite, TESTCASE (test_result_uint8_array, NULL));
+    g_test_suite_add (suite, TESTCASE (test_result_overwrite, NULL));
+    g_test_suite_add (suite, TESTCASE (test_result_many, NULL));
+    g_test_suite_add (suite, TESTCASE (test_log_stream_chunks, NULL));
+    g_test_suite_add (suite, TESTCASE (test_log_stream_errors, NULL));
 
     /* Live tests */
     if (port) {
@@ -391,6 +391,7 @@ mm_broadband_modem_dell_dw5821e_new (const gchar  *device,
                          MM_IFACE_MODEM_PERIODIC_SIGNAL_CHECK_DISABLED,      TRUE,
                          MM_IFACE_MODEM_LOCATION_ALLOW_GPS_UNMANAGED_ALWAYS, TRUE,
                          MM_IFACE_MODEM_CARRIER_CONFIG_MAPPING,              PKGDATADIR "/mm-dell-dw5821e-carrier-mapping.conf",
+                         MM_IFACE_MODEM_IDENTITY_CACHE_SUPPORTED,            TRUE,
                          NULL);
 }
 
@@ -26,6 +26,7 @@
 #include <arpa/inet.h>
 #include <ModemManager.h>
 #include "mm-base-modem-at.h"
+#include "mm-bearer-connect-wait.h"
 #include "mm-broadband-bearer-huawei.h"
 #include "mm-log.h"
 #include "mm-modem-helpers.h"
@@ -76,7 +77,7 @@ typedef struct {
     MMPortSerialAt *primary;
     MMPort *data;
     Connect3gppContextStep step;
-    guint check_count;
+    MMBearerConnectWait *wait;
     guint failed_ndisstatqry_count;
     MMBearerIpConfig *ipv4_config;
 } Connect3gppContext;
@@ -86,6 +87,7 @@ connect_3gpp_context_free (Connect3gppContext *ctx)
 {
     g_object_unref (ctx->modem);
 
+    g_clear_pointer (&ctx->wait, mm_bearer_connect_wait_free);
     g_clear_object (&ctx->ipv4_config);
     g_clear_object (&ctx->data);
     g_clear_object (&ctx->primary);
@@ -184,24 +186,6 @@ connect_dhcp_check_ready (MMBaseModem *modem,
     connect_3gpp_context_step (task);
 }
 
-static gboolean
-connect_retry_ndisstatqry_check_cb (MMBroadbandBearerHuawei *self)
-{
-    GTask *task;
-
-    /* Recover context */
-    task = self->priv->connect_pending;
-    g_assert (task != NULL);
-
-    /* Balance refcount */
-    g_object_unref (self);
-
-    /* Retry same step */
-    connect_3gpp_context_step (task);
-
-    return G_SOURCE_REMOVE;
-}
-
 static void
 connect_ndisstatqry_check_ready (MMBaseModem *modem,
                                  GAsyncResult *res,
@@ -216,15 +200,22 @@ connect_ndisstatqry_check_ready (MMBaseModem *modem,
     gboolean ipv6_available = FALSE;
     gboolean ipv6_connected = FALSE;
 
+    response = mm_base_modem_at_command_full_finish (modem, res, &error);
+
+    /* If the wait was already completed (e.g. by an unsolicited ^NDISSTAT),
+     * or timed out, nothing else to do */
     task = self->priv->connect_pending;
-    g_assert (task != NULL);
+    if (!task || !((Connect3gppContext *) g_task_get_task_data (task))->wait) {
+        g_clear_error (&error);
+        g_object_unref (self);
+        return;
+    }
 
     ctx = g_task_get_task_data (task);
 
     /* Balance refcount */
     g_object_unref (self);
 
-    response = mm_base_modem_at_command_full_finish (modem, res, &error);
     if (!response ||
         !mm_huawei_parse_ndisstatqry_response (response,
                                                &ipv4_available,
@@ -236,20 +227,85 @@ connect_ndisstatqry_check_ready (MMBaseModem *modem,
         mm_dbg ("Unexpected response to ^NDISSTATQRY command: %s (Attempts so far: %u)",
                 error->message, ctx->failed_ndisstatqry_count);
         g_error_free (error);
+
+        /* Give up if too many unexpected responses to NIDSSTATQRY are encountered. */
+        if (ctx->failed_ndisstatqry_count > 10) {
+            mm_bearer_connect_wait_complete (ctx->wait, FALSE, FALSE);
+            g_clear_pointer (&ctx->wait, mm_bearer_connect_wait_free);
+            /* Clear context */
+            self->priv->connect_pending = NULL;
+            g_task_return_new_error (task,
+                                     MM_MOBILE_EQUIPMENT_ERROR,
+                                     MM_MOBILE_EQUIPMENT_ERROR_NOT_SUPPORTED,
+                                     "Connection attempt not supported.");
+            g_object_unref (task);
+            return;
+        }
     }
 
     /* Connected in IPv4? */
     if (ipv4_available && ipv4_connected) {
         /* Success! */
+        mm_bearer_connect_wait_complete (ctx->wait, FALSE, TRUE);
+        g_clear_pointer (&ctx->wait, mm_bearer_connect_wait_free);
         ctx->step++;
         connect_3gpp_context_step (task);
         return;
     }
 
-    /* Setup timeout to retry the same step */
-    g_timeout_add_seconds (1,
-                           (GSourceFunc)connect_retry_ndisstatqry_check_cb,
-                           g_object_ref (self));
+    /* Poll again */
+    mm_bearer_connect_wait_schedule_poll (ctx->wait);
+}
+
+static void
+connect_ndisstatqry_poll (MMBearerConnectWait *wait,
+                          MMBroadbandBearerHuawei *self)
+{
+    GTask *task;
+    Connect3gppContext *ctx;
+
+    task = self->priv->connect_pending;
+    g_assert (task != NULL);
+    ctx = g_task_get_task_data (task);
+
+    /* Check for cancellation, handled in the step */
+    if (g_cancellable_is_cancelled (g_task_get_cancellable (task))) {
+        connect_3gpp_context_step (task);
+        return;
+    }
+
+    /* Check if connected */
+    mm_base_modem_at_command_full (ctx->modem,
+                                   ctx->primary,
+                                   "^NDISSTATQRY?",
+                                   3,
+                                   FALSE,
+                                   FALSE,
+                                   NULL,
+                                   (GAsyncReadyCallback)connect_ndisstatqry_check_ready,
+                                   g_object_ref (self));
+}
+
+static void
+connect_ndisstatqry_timed_out (MMBearerConnectWait *wait,
+                               MMBroadbandBearerHuawei *self)
+{
+    GTask *task;
+    Connect3gppContext *ctx;
+
+    task = self->priv->connect_pending;
+    g_assert (task != NULL);
+    ctx = g_task_get_task_data (task);
+
+    g_clear_pointer (&ctx->wait, mm_bearer_connect_wait_free);
+
+    /* Clear context */
+    self->priv->connect_pending = NULL;
+    g_task_return_new_error (task,
+                             MM_MOBILE_EQUIPMENT_ERROR,
+                             MM_MOBILE_EQUIPMENT_ERROR_NETWORK_TIMEOUT,
+                             "Connection attempt timed out");
+    g_object_unref (task);
 }
 
 static void
@@ -425,44 +481,16 @@ connect_3gpp_context_step (GTask *task)
     }
 
     case CONNECT_3GPP_CONTEXT_STEP_NDISSTATQRY:
-        /* Wait for dial up timeout, retries for 60 times
-         * (1s between the retries, so it means 1 minute).
-         * If too many retries, failed
-         */
-        if (ctx->check_count > 60) {
-            /* Clear context */
-            self->priv->connect_pending = NULL;
-            g_task_return_new_error (task,
-                                     MM_MOBILE_EQUIPMENT_ERROR,
-                                     MM_MOBILE_EQUIPMENT_ERROR_NETWORK_TIMEOUT,
-                                     "Connection attempt timed out");
-            g_object_unref (task);
-            return;
-        }
-
-        /* Give up if too many unexpected responses to NIDSSTATQRY are encountered. */
-        if (ctx->failed_ndisstatqry_count > 10) {
-            /* Clear context */
-            self->priv->connect_pending = NULL;
-            g_task_return_new_error (task,
-                                     MM_MOBILE_EQUIPMENT_ERROR,
-                                     MM_MOBILE_EQUIPMENT_ERROR_NOT_SUPPORTED,
-                                     "Connection attempt not supported.");
-            g_object_unref (task);
-            return;
-        }
-
-        /* Check if connected */
-        ctx->check_count++;
-        mm_base_modem_at_command_full (ctx->modem,
-                                       ctx->primary,
-                                       "^NDISSTATQRY?",
-                                       3,
-                                       FALSE,
-                                       FALSE,
-                                       NULL,
-                                       (GAsyncReadyCallback)connect_ndisstatqry_check_ready,
-                                       g_object_ref (self));
+        /* Wait up to 1 minute for the connection to be reported, either with
+         * an unsolicited ^NDISSTAT or polling ^NDISSTATQRY? */
+        g_assert (ctx->wait == NULL);
+        ctx->wait = mm_bearer_connect_wait_new ("huawei",
+                                                MM_BEARER_CONNECT_WAIT_TYPE_CONNECT,
+                                                60,
+                                                (MMBearerConnectWaitPollFunc)connect_ndisstatqry_poll,
+                                                (MMBearerConnectWaitTimeoutFunc)connect_ndisstatqry_timed_out,
+                                                self);
+        mm_bearer_connect_wait_schedule_poll (ctx->wait);
         return;
 
     case CONNECT_3GPP_CONTEXT_STEP_IP_CONFIG:
@@ -560,13 +588,14 @@ typedef struct {
     MMBaseModem *modem;
     MMPortSerialAt *primary;
     Disconnect3gppContextStep step;
-    guint check_count;
+    MMBearerConnectWait *wait;
     guint failed_ndisstatqry_count;
 } Disconnect3gppContext;
 
 static void
 disconnect_3gpp_context_free (Disconnect3gppContext *ctx)
 {
+    g_clear_pointer (&ctx->wait, mm_bearer_connect_wait_free);
     g_object_unref (ctx->primary);
     g_object_unref (ctx->modem);
     g_slice_free (Disconnect3gppContext, ctx);
@@ -582,23 +611,6 @@ disconnect_3gpp_finish (MMBroadbandBearer *self,
 
 static void disconnect_3gpp_context_step (GTask *task);
 
-static gboolean
-disconnect_retry_ndisstatqry_check_cb (MMBroadbandBearerHuawei *self)
-{
-    GTask *task;
-
-    /* Recover context */
-    task = self->priv->disconnect_pending;
-    g_assert (task != NULL);
-
-    /* Balance refcount */
-    g_object_unref (self);
-
-    /* Retry same step */
-    disconnect_3gpp_context_step (task);
-    return G_SOURCE_REMOVE;
-}
-
 static void
 disconnect_ndisstatqry_check_ready (MMBaseModem *modem,
                                     GAsyncResult *res,
@@ -613,15 +625,22 @@ disconnect_ndisstatqry_check_ready (MMBaseModem *modem,
     gboolean ipv6_available = FALSE;
     gboolean ipv6_connected = FALSE;
 
+    response = mm_base_modem_at_command_full_finish (modem, res, &error);
+
+    /* If the wait was already completed (e.g. by an unsolicited ^NDISSTAT),
+     * or timed out, nothing else to do */
     task = self->priv->disconnect_pending;
-    g_assert (task != NULL);
+    if (!task || !((Disconnect3gppContext *) g_task_get_task_data (task))->wait) {
+        g_clear_error (&error);
+        g_object_unref (self);
+        return;
+    }
 
     ctx = g_task_get_task_data (task);
 
     /* Balance refcount */
     g_object_unref (self);
 
-    response = mm_base_modem_at_command_full_finish (modem, res, &error);
     if (!response ||
         !mm_huawei_parse_ndisstatqry_response (response,
                                                &ipv4_available,
@@ -633,20 +652,77 @@ disconnect_ndisstatqry_check_ready (MMBaseModem *modem,
         mm_dbg ("Unexpected response to ^NDISSTATQRY command: %s (Attempts so far: %u)",
                 error->message, ctx->failed_ndisstatqry_count);
         g_error_free (error);
+
+        /* Give up if too many unexpected responses to NIDSSTATQRY are encountered. */
+        if (ctx->failed_ndisstatqry_count > 10) {
+            mm_bearer_connect_wait_complete (ctx->wait, FALSE, FALSE);
+            g_clear_pointer (&ctx->wait, mm_bearer_connect_wait_free);
+            /* Clear task */
+            self->priv->disconnect_pending = NULL;
+            g_task_return_new_error (task,
+                                     MM_MOBILE_EQUIPMENT_ERROR,
+                                     MM_MOBILE_EQUIPMENT_ERROR_NOT_SUPPORTED,
+                                     "Disconnection attempt not supported.");
+            g_object_unref (task);
+            return;
+        }
     }
 
     /* Disconnected IPv4? */
     if (ipv4_available && !ipv4_connected) {
         /* Success! */
+        mm_bearer_connect_wait_complete (ctx->wait, FALSE, TRUE);
+        g_clear_pointer (&ctx->wait, mm_bearer_connect_wait_free);
         ctx->step++;
         disconnect_3gpp_context_step (task);
         return;
     }
 
-    /* Setup timeout to retry the same step */
-    g_timeout_add_seconds (1,
-                           (GSourceFunc)disconnect_retry_ndisstatqry_check_cb,
-                           g_object_ref (self));
+    /* Poll again */
+    mm_bearer_connect_wait_schedule_poll (ctx->wait);
+}
+
+static void
+disconnect_ndisstatqry_poll (MMBearerConnectWait *wait,
+                             MMBroadbandBearerHuawei *self)
+{
+    Disconnect3gppContext *ctx;
+
+    g_assert (self->priv->disconnect_pending != NULL);
+    ctx = g_task_get_task_data (self->priv->disconnect_pending);
+
+    /* Check if disconnected */
+    mm_base_modem_at_command_full (ctx->modem,
+                                   ctx->primary,
+                                   "^NDISSTATQRY?",
+                                   3,
+                                   FALSE,
+                                   FALSE,
+                                   NULL,
+                                   (GAsyncReadyCallback)disconnect_ndisstatqry_check_ready,
+                                   g_object_ref (self));
+}
+
+static void
+disconnect_ndisstatqry_timed_out (MMBearerConnectWait *wait,
+                                  MMBroadbandBearerHuawei *self)
+{
+    GTask *task;
+    Disconnect3gppContext *ctx;
+
+    task = self->priv->disconnect_pending;
+    g_assert (task != NULL);
+    ctx = g_task_get_task_data (task);
+
+    g_clear_pointer (&ctx->wait, mm_bearer_connect_wait_free);
+
+    /* Clear task */
+    self->priv->disconnect_pending = NULL;
+    g_task_return_new_error (task,
+                             MM_MOBILE_EQUIPMENT_ERROR,
+                             MM_MOBILE_EQUIPMENT_ERROR_NETWORK_TIMEOUT,
+                             "Disconnection attempt timed out");
+    g_object_unref (task);
 }
 
 static void
@@ -717,41 +793,16 @@ disconnect_3gpp_context_step (GTask *task)
         return;
 
     case DISCONNECT_3GPP_CONTEXT_STEP_NDISSTATQRY:
-        /* If too many retries (1s of wait between the retries), failed */
-        if (ctx->check_count > 60) {
-            /* Clear task */
-            self->priv->disconnect_pending = NULL;
-            g_task_return_new_error (task,
-                                     MM_MOBILE_EQUIPMENT_ERROR,
-                                     MM_MOBILE_EQUIPMENT_ERROR_NETWORK_TIMEOUT,
-                                     "Disconnection attempt timed out");
-            g_object_unref (task);
-            return;
-        }
-
-        /* Give up if too many unexpected responses to NIDSSTATQRY are encountered. */
-        if (ctx->failed_ndisstatqry_count > 10) {
-            /* Clear task */
-            self->priv->disconnect_pending = NULL;
-            g_task_return_new_error (task,
-                                     MM_MOBILE_EQUIPMENT_ERROR,
-                                     MM_MOBILE_EQUIPMENT_ERROR_NOT_SUPPORTED,
-                                     "Disconnection attempt not supported.");
-            g_object_unref (task);
-            return;
-        }
-
-        /* Check if disconnected */
-        ctx->check_count++;
-        mm_base_modem_at_command_full (ctx->modem,
-                                       ctx->primary,
-                                       "^NDISSTATQRY?",
-                                       3,
-                                       FALSE,
-                                       FALSE,
-                                       NULL,
-                                       (GAsyncReadyCallback)disconnect_ndisstatqry_check_ready,
-                                       g_object_ref (self));
+        /* Wait up to 1 minute for the disconnection to be reported, either
+         * with an unsolicited ^NDISSTAT or polling ^NDISSTATQRY? */
+        g_assert (ctx->wait == NULL);
+        ctx->wait = mm_bearer_connect_wait_new ("huawei",
+                                                MM_BEARER_CONNECT_WAIT_TYPE_DISCONNECT,
+                                                60,
+                                                (MMBearerConnectWaitPollFunc)disconnect_ndisstatqry_poll,
+                                                (MMBearerConnectWaitTimeoutFunc)disconnect_ndisstatqry_timed_out,
+                                                self);
+        mm_bearer_connect_wait_schedule_poll (ctx->wait);
         return;
 
     case DISCONNECT_3GPP_CONTEXT_STEP_LAST:
@@ -821,11 +872,36 @@ report_connection_status (MMBaseBearer *bearer,
               status == MM_BEARER_CONNECTION_STATUS_DISCONNECTING ||
               status == MM_BEARER_CONNECTION_STATUS_DISCONNECTED);
 
-    /* When a pending connection / disconnection attempt is in progress, we use
-     * ^NDISSTATQRY? to check the connection status and thus temporarily ignore
-     * ^NDISSTAT unsolicited messages */
-    if (self->priv->connect_pending || self->priv->disconnect_pending)
+    /* When a pending connection attempt is waiting for the connection status,
+     * an unsolicited ^NDISSTAT reporting it connected completes the wait right
+     * away. Otherwise, ^NDISSTATQRY? is polled meanwhile, so ignore it. */
+    if (self->priv->connect_pending) {
+        GTask *task = self->priv->connect_pending;
+        Connect3gppContext *ctx = g_task_get_task_data (task);
+
+        if (ctx->wait && status == MM_BEARER_CONNECTION_STATUS_CONNECTED) {
+            mm_bearer_connect_wait_complete (ctx->wait, TRUE, TRUE);
+            g_clear_pointer (&ctx->wait, mm_bearer_connect_wait_free);
+            ctx->step++;
+            connect_3gpp_context_step (task);
+        }
+        return;
+    }
+
+    /* Same for a pending disconnection attempt; DISCONNECTING is what we get
+     * when ^NDISSTAT reports the IPv4 connection down */
+    if (self->priv->disconnect_pending) {
+        GTask *task = self->priv->disconnect_pending;
+        Disconnect3gppContext *ctx = g_task_get_task_data (task);
+
+        if (ctx->wait && status != MM_BEARER_CONNECTION_STATUS_CONNECTED) {
+            mm_bearer_connect_wait_complete (ctx->wait, TRUE, TRUE);
+            g_clear_pointer (&ctx->wait, mm_bearer_connect_wait_free);
+            ctx->step++;
+            disconnect_3gpp_context_step (task);
+        }
         return;
+    }
 
     mm_dbg ("Received spontaneous ^NDISSTAT (%s)",
             mm_bearer_connection_status_get_string (status));
@@ -34,6 +34,7 @@
 #include "mm-error-helpers.h"
 #include "mm-daemon-enums-types.h"
 #include "mm-modem-helpers-icera.h"
+#include "mm-bearer-connect-wait.h"
 
 G_DEFINE_TYPE (MMBroadbandBearerIcera, mm_broadband_bearer_icera, MM_TYPE_BROADBAND_BEARER);
 
@@ -50,13 +51,13 @@ struct _MMBroadbandBearerIceraPrivate {
 
     /* Connection related */
     gpointer connect_pending;
-    guint connect_pending_id;
+    MMBearerConnectWait *connect_wait;
     gulong connect_cancellable_id;
     gulong connect_port_closed_id;
 
     /* Disconnection related */
     gpointer disconnect_pending;
-    guint disconnect_pending_id;
+    MMBearerConnectWait *disconnect_wait;
 };
 
 /*****************************************************************************/
@@ -227,6 +228,20 @@ get_ip_config_3gpp (MMBroadbandBearer *_self,
 /*****************************************************************************/
 /* 3GPP disconnection */
 
+typedef struct {
+    MMBaseModem    *modem;
+    MMPortSerialAt *primary;
+    guint           cid;
+} DisconnectContext;
+
+static void
+disconnect_context_free (DisconnectContext *ctx)
+{
+    g_object_unref (ctx->primary);
+    g_object_unref (ctx->modem);
+    g_slice_free (DisconnectContext, ctx);
+}
+
 static gboolean
 disconnect_3gpp_finish (MMBroadbandBearer *self,
                         GAsyncResult *res,
@@ -235,29 +250,28 @@ disconnect_3gpp_finish (MMBroadbandBearer *self,
     return g_task_propagate_boolean (G_TASK (res), error);
 }
 
-static gboolean
-disconnect_3gpp_timed_out_cb (MMBroadbandBearerIcera *self)
+static void
+disconnect_3gpp_timed_out (MMBearerConnectWait    *wait,
+                           MMBroadbandBearerIcera *self)
 {
     GTask *task;
 
     /* Recover disconnection task */
     task = self->priv->disconnect_pending;
-
     self->priv->disconnect_pending = NULL;
-    self->priv->disconnect_pending_id = 0;
+    g_clear_pointer (&self->priv->disconnect_wait, mm_bearer_connect_wait_free);
 
     g_task_return_new_error (task,
                              MM_SERIAL_ERROR,
                              MM_SERIAL_ERROR_RESPONSE_TIMEOUT,
                              "Disconnection attempt timed out");
     g_object_unref (task);
-
-    return G_SOURCE_REMOVE;
 }
 
 static void
 process_pending_disconnect_attempt (MMBroadbandBearerIcera   *self,
-                                    MMBearerConnectionStatus  status)
+                                    MMBearerConnectionStatus  status,
+                                    gboolean                  unsolicited)
 {
     GTask *task;
 
@@ -266,10 +280,12 @@ process_pending_disconnect_attempt (MMBroadbandBearerIcera   *self,
     self->priv->disconnect_pending = NULL;
     g_assert (task != NULL);
 
-    /* Cleanup timeout, if any */
-    if (self->priv->disconnect_pending_id) {
-        g_source_remove (self->priv->disconnect_pending_id);
-        self->priv->disconnect_pending_id = 0;
+    /* Stop waiting */
+    if (self->priv->disconnect_wait) {
+        mm_bearer_connect_wait_complete (self->priv->disconnect_wait,
+                                         unsolicited,
+                                         status != MM_BEARER_CONNECTION_STATUS_CONNECTED);
+        g_clear_pointer (&self->priv->disconnect_wait, mm_bearer_connect_wait_free);
     }
 
     /* Received 'CONNECTED' during a disconnection attempt? */
@@ -294,6 +310,45 @@ process_pending_disconnect_attempt (MMBroadbandBearerIcera   *self,
     g_assert_not_reached ();
 }
 
+static void
+disconnect_poll_ready (MMBaseModem            *modem,
+                       GAsyncResult           *res,
+                       MMBroadbandBearerIcera *self)
+{
+    MMBearerConnectionStatus status;
+
+    status = mm_bearer_connect_wait_query_cgact_finish (modem, res, NULL);
+
+    /* Already completed by an unsolicited message or timed out? */
+    if (!self->priv->disconnect_pending || !self->priv->disconnect_wait)
+        goto out;
+
+    if (status == MM_BEARER_CONNECTION_STATUS_DISCONNECTED)
+        process_pending_disconnect_attempt (self, status, FALSE);
+    else
+        mm_bearer_connect_wait_schedule_poll (self->priv->disconnect_wait);
+
+ out:
+    /* Balance refcount with the extra ref we passed to the query */
+    g_object_unref (self);
+}
+
+static void
+disconnect_poll (MMBearerConnectWait    *wait,
+                 MMBroadbandBearerIcera *self)
+{
+    DisconnectContext *ctx;
+
+    /* The %IPDPACT unsolicited message may never arrive if it gets lost, so
+     * fallback to checking the context status ourselves */
+    ctx = g_task_get_task_data (self->priv->disconnect_pending);
+    mm_bearer_connect_wait_query_cgact (ctx->modem,
+                                        ctx->primary,
+                                        ctx->cid,
+                                        (GAsyncReadyCallback) disconnect_poll_ready,
+                                        g_object_ref (self));
+}
+
 static void
 disconnect_ipdpact_ready (MMBaseModem *modem,
                           GAsyncResult *res,
@@ -321,15 +376,15 @@ disconnect_ipdpact_ready (MMBaseModem *modem,
     mm_base_modem_at_command_full_finish (modem, res, &error);
     if (error) {
         self->priv->disconnect_pending = NULL;
+        mm_bearer_connect_wait_complete (self->priv->disconnect_wait, FALSE, FALSE);
+        g_clear_pointer (&self->priv->disconnect_wait, mm_bearer_connect_wait_free);
         g_task_return_error (task, error);
         g_object_unref (task);
         return;
     }
 
-    /* Set a 60-second disconnection-failure timeout */
-    self->priv->disconnect_pending_id = g_timeout_add_seconds (60,
-                                                               (GSourceFunc)disconnect_3gpp_timed_out_cb,
-                                                               self);
+    /* Wait for the unsolicited message, polling meanwhile */
+    mm_bearer_connect_wait_schedule_poll (self->priv->disconnect_wait);
 }
 
 static void
@@ -343,11 +398,18 @@ disconnect_3gpp (MMBroadbandBearer *bearer,
                  gpointer user_data)
 {
     MMBroadbandBearerIcera *self = MM_BROADBAND_BEARER_ICERA (bearer);
+    DisconnectContext *ctx;
     gchar *command;
     GTask *task;
 
     task = g_task_new (self, NULL, callback, user_data);
 
+    ctx = g_slice_new0 (DisconnectContext);
+    ctx->modem = MM_BASE_MODEM (g_object_ref (modem));
+    ctx->primary = g_object_ref (primary);
+    ctx->cid = cid;
+    g_task_set_task_data (task, ctx, (GDestroyNotify) disconnect_context_free);
+
     /* The unsolicited response to %IPDPACT may come before the OK does.
      * We will keep the disconnection task in the bearer private data so
      * that it is accessible from the unsolicited message handler. Note
@@ -357,6 +419,15 @@ disconnect_3gpp (MMBroadbandBearer *bearer,
     g_assert (self->priv->disconnect_pending == NULL);
     self->priv->disconnect_pending = task;
 
+    /* Disconnection-failure timeout */
+    g_assert (self->priv->disconnect_wait == NULL);
+    self->priv->disconnect_wait = mm_bearer_connect_wait_new ("icera",
+                                                              MM_BEARER_CONNECT_WAIT_TYPE_DISCONNECT,
+                                                              60,
+                                                              (MMBearerConnectWaitPollFunc) disconnect_poll,
+                                                              (MMBearerConnectWaitTimeoutFunc) disconnect_3gpp_timed_out,
+                                                              self);
+
     command = g_strdup_printf ("%%IPDPACT=%d,0", cid);
     mm_base_modem_at_command_full (
         MM_BASE_MODEM (modem),
@@ -444,14 +515,15 @@ connect_reset (GTask *task)
     g_free (command);
 }
 
-static gboolean
-connect_timed_out_cb (MMBroadbandBearerIcera *self)
+static void
+connect_timed_out (MMBearerConnectWait    *wait,
+                   MMBroadbandBearerIcera *self)
 {
     GTask           *task;
     Dial3gppContext *ctx;
 
-    /* Cleanup timeout ID */
-    self->priv->connect_pending_id = 0;
+    /* Cleanup wait */
+    g_clear_pointer (&self->priv->connect_wait, mm_bearer_connect_wait_free);
 
     /* Recover task and own it */
     task = self->priv->connect_pending;
@@ -474,8 +546,6 @@ connect_timed_out_cb (MMBroadbandBearerIcera *self)
 
     /* It's probably pointless to try to reset this here, but anyway... */
     connect_reset (task);
-
-    return G_SOURCE_REMOVE;
 }
 
 static void
@@ -514,7 +584,8 @@ ier_query_ready (MMBaseModem  *modem,
 
 static void
 process_pending_connect_attempt (MMBroadbandBearerIcera   *self,
-                                 MMBearerConnectionStatus status)
+                                 MMBearerConnectionStatus status,
+                                 gboolean                 unsolicited)
 {
     GTask           *task;
     Dial3gppContext *ctx;
@@ -526,9 +597,11 @@ process_pending_connect_attempt (MMBroadbandBearerIcera   *self,
 
     ctx = g_task_get_task_data (task);
 
-    if (self->priv->connect_pending_id) {
-        g_source_remove (self->priv->connect_pending_id);
-        self->priv->connect_pending_id = 0;
+    if (self->priv->connect_wait) {
+        mm_bearer_connect_wait_complete (self->priv->connect_wait,
+                                         unsolicited,
+                                         status == MM_BEARER_CONNECTION_STATUS_CONNECTED);
+        g_clear_pointer (&self->priv->connect_wait, mm_bearer_connect_wait_free);
     }
 
     if (self->priv->connect_port_closed_id) {
@@ -585,6 +658,45 @@ forced_close_cb (MMBroadbandBearerIcera *self)
                                              MM_BEARER_CONNECTION_STATUS_CONNECTION_FAILED);
 }
 
+static void
+connect_poll_ready (MMBaseModem            *modem,
+                    GAsyncResult           *res,
+                    MMBroadbandBearerIcera *self)
+{
+    MMBearerConnectionStatus status;
+
+    status = mm_bearer_connect_wait_query_cgact_finish (modem, res, NULL);
+
+    /* Already completed by an unsolicited message or timed out? */
+    if (!self->priv->connect_pending || !self->priv->connect_wait)
+        goto out;
+
+    /* Only a connected context is conclusive; failures are only reported
+     * by the unsolicited message */
+    if (status == MM_BEARER_CONNECTION_STATUS_CONNECTED)
+        process_pending_connect_attempt (self, status, FALSE);
+    else
+        mm_bearer_connect_wait_schedule_poll (self->priv->connect_wait);
+
+ out:
+    /* Balance refcount with the extra ref we passed to the query */
+    g_object_unref (self);
+}
+
+static void
+connect_poll (MMBearerConnectWait    *wait,
+              MMBroadbandBearerIcera *self)
+{
+    Dial3gppContext *ctx;
+
+    ctx = g_task_get_task_data (self->priv->connect_pending);
+    mm_bearer_connect_wait_query_cgact (ctx->modem,
+                                        ctx->primary,
+                                        ctx->cid,
+                                        (GAsyncReadyCallback) connect_poll_ready,
+                                        g_object_ref (self));
+}
+
 static void
 activate_ready (MMBaseModem            *modem,
                 GAsyncResult           *res,
@@ -609,6 +721,8 @@ activate_ready (MMBaseModem            *modem,
 
     /* Errors on the dial command are fatal */
     if (!mm_base_modem_at_command_full_finish (modem, res, &error)) {
+        mm_bearer_connect_wait_complete (self->priv->connect_wait, FALSE, FALSE);
+        g_clear_pointer (&self->priv->connect_wait, mm_bearer_connect_wait_free);
         g_task_return_error (task, error);
         g_object_unref (task);
         goto out;
@@ -617,13 +731,10 @@ activate_ready (MMBaseModem            *modem,
     /* Track again */
     self->priv->connect_pending = task;
 
-    /* We will now setup a timeout and keep the context in the bearer's private.
-     * Reports of modem being connected will arrive via unsolicited messages.
-     * This timeout should be long enough. Actually... ideally should never get
-     * reached. */
-    self->priv->connect_pending_id = g_timeout_add_seconds (60,
-                                                            (GSourceFunc)connect_timed_out_cb,
-                                                            self);
+    /* Keep the context in the bearer's private. Reports of modem being
+     * connected will arrive via unsolicited messages; poll meanwhile in case
+     * they get lost. */
+    mm_bearer_connect_wait_schedule_poll (self->priv->connect_wait);
 
     /* If we get the port closed, we treat as a connect error */
     ctx = g_task_get_task_data (task);
@@ -691,6 +802,16 @@ authenticate_ready (MMBaseModem  *modem,
     g_assert (self->priv->connect_pending == NULL);
     self->priv->connect_pending = task;
 
+    /* This timeout should be long enough. Actually... ideally should never
+     * get reached. */
+    g_assert (self->priv->connect_wait == NULL);
+    self->priv->connect_wait = mm_bearer_connect_wait_new ("icera",
+                                                           MM_BEARER_CONNECT_WAIT_TYPE_CONNECT,
+                                                           60,
+                                                           (MMBearerConnectWaitPollFunc) connect_poll,
+                                                           (MMBearerConnectWaitTimeoutFunc) connect_timed_out,
+                                                           self);
+
     command = g_strdup_printf ("%%IPDPACT=%d,1", ctx->cid);
     mm_base_modem_at_command_full (ctx->modem,
                                    ctx->primary,
@@ -869,13 +990,13 @@ report_connection_status (MMBaseBearer             *_self,
 
     /* Process pending connection attempt */
     if (self->priv->connect_pending) {
-        process_pending_connect_attempt (self, status);
+        process_pending_connect_attempt (self, status, TRUE);
         return;
     }
 
     /* Process pending disconnection attempt */
     if (self->priv->disconnect_pending) {
-        process_pending_disconnect_attempt (self, status);
+        process_pending_disconnect_attempt (self, status, TRUE);
         return;
     }
 
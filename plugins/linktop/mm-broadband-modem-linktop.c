@@ -240,6 +240,7 @@ mm_broadband_modem_linktop_new (const gchar *device,
                          MM_BASE_MODEM_PLUGIN, plugin,
                          MM_BASE_MODEM_VENDOR_ID, vendor_id,
                          MM_BASE_MODEM_PRODUCT_ID, product_id,
+                         MM_IFACE_MODEM_IDENTITY_CACHE_SUPPORTED, TRUE,
                          NULL);
 }
 
@@ -384,6 +384,7 @@ mm_broadband_modem_longcheer_new (const gchar *device,
                          MM_BASE_MODEM_PLUGIN, plugin,
                          MM_BASE_MODEM_VENDOR_ID, vendor_id,
                          MM_BASE_MODEM_PRODUCT_ID, product_id,
+                         MM_IFACE_MODEM_IDENTITY_CACHE_SUPPORTED, TRUE,
                          NULL);
 }
 
@@ -37,6 +37,7 @@
 #include <libmm-glib.h>
 
 #include "mm-base-modem-at.h"
+#include "mm-bearer-connect-wait.h"
 #include "mm-broadband-bearer-mbm.h"
 #include "mm-log.h"
 #include "mm-modem-helpers.h"
@@ -58,16 +59,15 @@ typedef struct {
     MMPortSerialAt *primary;
     guint           cid;
     MMPort         *data;
-    guint           poll_count;
-    guint           poll_id;
+    MMBearerConnectWait *wait;
     GError         *saved_error;
 } Dial3gppContext;
 
 static void
 dial_3gpp_context_free (Dial3gppContext *ctx)
 {
-    g_assert (!ctx->poll_id);
     g_assert (!ctx->saved_error);
+    g_clear_pointer (&ctx->wait, mm_bearer_connect_wait_free);
     g_clear_object (&ctx->data);
     g_clear_object (&ctx->primary);
     g_clear_object (&ctx->modem);
@@ -137,10 +137,7 @@ process_pending_connect_attempt (MMBroadbandBearerMbm     *self,
 
     ctx = g_task_get_task_data (task);
 
-    if (ctx->poll_id) {
-        g_source_remove (ctx->poll_id);
-        ctx->poll_id = 0;
-    }
+    mm_bearer_connect_wait_complete (ctx->wait, TRUE, status == MM_BEARER_CONNECTION_STATUS_CONNECTED);
 
     /* Received 'CONNECTED' during a connection attempt? */
     if (status == MM_BEARER_CONNECTION_STATUS_CONNECTED) {
@@ -167,8 +164,6 @@ process_pending_connect_attempt (MMBroadbandBearerMbm     *self,
     g_object_unref (task);
 }
 
-static gboolean connect_poll_cb (MMBroadbandBearerMbm *self);
-
 static void
 connect_poll_ready (MMBaseModem          *modem,
                     GAsyncResult         *res,
@@ -195,6 +190,7 @@ connect_poll_ready (MMBaseModem          *modem,
 
     response = mm_base_modem_at_command_full_finish (modem, res, &error);
     if (!response) {
+        mm_bearer_connect_wait_complete (ctx->wait, FALSE, FALSE);
         ctx->saved_error = error;
         connect_reset (task);
         return;
@@ -202,50 +198,36 @@ connect_poll_ready (MMBaseModem          *modem,
 
     if (sscanf (response, "*ENAP: %d", &state) == 1 && state == 1) {
         /* Success!  Connected... */
+        mm_bearer_connect_wait_complete (ctx->wait, FALSE, TRUE);
         g_task_return_pointer (task, g_object_ref (ctx->data), g_object_unref);
         g_object_unref (task);
         return;
     }
 
-    /* Restore pending task and check again in one second */
+    /* Restore pending task and check again */
     self->priv->connect_pending = task;
-    g_assert (ctx->poll_id == 0);
-    ctx->poll_id = g_timeout_add_seconds (1, (GSourceFunc) connect_poll_cb, self);
+    mm_bearer_connect_wait_schedule_poll (ctx->wait);
 }
 
-static gboolean
-connect_poll_cb (MMBroadbandBearerMbm *self)
+static void
+connect_poll (MMBearerConnectWait  *wait,
+              MMBroadbandBearerMbm *self)
 {
     GTask           *task;
     Dial3gppContext *ctx;
 
     task = self->priv->connect_pending;
-    self->priv->connect_pending = NULL;
-
     g_assert (task);
     ctx = g_task_get_task_data (task);
 
-    ctx->poll_id = 0;
-
     /* Complete if we were cancelled */
     if (g_cancellable_is_cancelled (g_task_get_cancellable (task))) {
+        self->priv->connect_pending = NULL;
+        mm_bearer_connect_wait_complete (ctx->wait, FALSE, FALSE);
         connect_reset (task);
-        return G_SOURCE_REMOVE;
-    }
-
-    /* Too many retries... */
-    if (ctx->poll_count > 50) {
-        g_assert (!ctx->saved_error);
-        ctx->saved_error = g_error_new (MM_MOBILE_EQUIPMENT_ERROR,
-                                        MM_MOBILE_EQUIPMENT_ERROR_NETWORK_TIMEOUT,
-                                        "Connection attempt timed out");
-        connect_reset (task);
-        return G_SOURCE_REMOVE;
+        return;
     }
 
-    /* Restore pending task and poll */
-    self->priv->connect_pending = task;
-    ctx->poll_count++;
     mm_base_modem_at_command_full (ctx->modem,
                                    ctx->primary,
                                    "AT*ENAP?",
@@ -255,7 +237,26 @@ connect_poll_cb (MMBroadbandBearerMbm *self)
                                    g_task_get_cancellable (task),
                                    (GAsyncReadyCallback)connect_poll_ready,
                                    self);
-    return G_SOURCE_REMOVE;
+}
+
+static void
+connect_timed_out (MMBearerConnectWait  *wait,
+                   MMBroadbandBearerMbm *self)
+{
+    GTask           *task;
+    Dial3gppContext *ctx;
+
+    /* Recover task and own it */
+    task = self->priv->connect_pending;
+    self->priv->connect_pending = NULL;
+    g_assert (task);
+    ctx = g_task_get_task_data (task);
+
+    g_assert (!ctx->saved_error);
+    ctx->saved_error = g_error_new (MM_MOBILE_EQUIPMENT_ERROR,
+                                    MM_MOBILE_EQUIPMENT_ERROR_NETWORK_TIMEOUT,
+                                    "Connection attempt timed out");
+    connect_reset (task);
 }
 
 static void
@@ -280,20 +281,21 @@ activate_ready (MMBaseModem          *modem,
         goto out;
     }
 
+    ctx = g_task_get_task_data (task);
+
     /* From now on, if we get cancelled, we'll need to run the connection
      * reset ourselves just in case */
     if (!mm_base_modem_at_command_full_finish (modem, res, &error)) {
+        mm_bearer_connect_wait_complete (ctx->wait, FALSE, FALSE);
         g_task_return_error (task, error);
         g_object_unref (task);
         goto out;
     }
 
-    ctx = g_task_get_task_data (task);
-
     /* No unsolicited E2NAP status yet; wait for it and periodically poll
      * to handle very old F3507g/MD300 firmware that may not send E2NAP. */
     self->priv->connect_pending = task;
-    ctx->poll_id = g_timeout_add_seconds (1, (GSourceFunc)connect_poll_cb, self);
+    mm_bearer_connect_wait_schedule_poll (ctx->wait);
 
  out:
     /* Balance refcount with the extra ref we passed to command_full() */
@@ -316,6 +318,15 @@ activate (GTask *task)
     g_assert (self->priv->connect_pending == NULL);
     self->priv->connect_pending = task;
 
+    /* Give up if not connected after 50s */
+    g_assert (ctx->wait == NULL);
+    ctx->wait = mm_bearer_connect_wait_new ("mbm",
+                                            MM_BEARER_CONNECT_WAIT_TYPE_CONNECT,
+                                            50,
+                                            (MMBearerConnectWaitPollFunc) connect_poll,
+                                            (MMBearerConnectWaitTimeoutFunc) connect_timed_out,
+                                            self);
+
     /* Activate the PDP context and start the data session */
     command = g_strdup_printf ("AT*ENAP=1,%d", ctx->cid);
     mm_base_modem_at_command_full (ctx->modem,
@@ -573,14 +584,13 @@ get_ip_config_3gpp (MMBroadbandBearer *self,
 typedef struct {
     MMBaseModem    *modem;
     MMPortSerialAt *primary;
-    guint           poll_count;
-    guint           poll_id;
+    MMBearerConnectWait *wait;
 } DisconnectContext;
 
 static void
 disconnect_context_free (DisconnectContext *ctx)
 {
-    g_assert (!ctx->poll_id);
+    g_clear_pointer (&ctx->wait, mm_bearer_connect_wait_free);
     g_clear_object (&ctx->primary);
     g_clear_object (&ctx->modem);
     g_free (ctx);
@@ -608,10 +618,7 @@ process_pending_disconnect_attempt (MMBroadbandBearerMbm     *self,
 
     ctx = g_task_get_task_data (task);
 
-    if (ctx->poll_id) {
-        g_source_remove (ctx->poll_id);
-        ctx->poll_id = 0;
-    }
+    mm_bearer_connect_wait_complete (ctx->wait, TRUE, status == MM_BEARER_CONNECTION_STATUS_DISCONNECTED);
 
     /* Received 'DISCONNECTED' during a disconnection attempt? */
     if (status == MM_BEARER_CONNECTION_STATUS_DISCONNECTED) {
@@ -624,8 +631,6 @@ process_pending_disconnect_attempt (MMBroadbandBearerMbm     *self,
     g_object_unref (task);
 }
 
-static gboolean disconnect_poll_cb (MMBroadbandBearerMbm *self);
-
 static void
 disconnect_poll_ready (MMBaseModem          *modem,
                        GAsyncResult         *res,
@@ -649,8 +654,11 @@ disconnect_poll_ready (MMBaseModem          *modem,
         goto out;
     }
 
+    ctx = g_task_get_task_data (task);
+
     response = mm_base_modem_at_command_full_finish (modem, res, &error);
     if (!response) {
+        mm_bearer_connect_wait_complete (ctx->wait, FALSE, FALSE);
         g_task_return_error (task, error);
         g_object_unref (task);
         goto out;
@@ -658,49 +666,30 @@ disconnect_poll_ready (MMBaseModem          *modem,
 
     if (sscanf (response, "*ENAP: %d", &state) == 1 && state == 0) {
         /* Disconnected */
+        mm_bearer_connect_wait_complete (ctx->wait, FALSE, TRUE);
         g_task_return_boolean (task, TRUE);
         g_object_unref (task);
         goto out;
     }
 
-    /* Restore pending task and check in 1s */
+    /* Restore pending task and check again */
     self->priv->disconnect_pending = task;
-    ctx = g_task_get_task_data (task);
-    g_assert (ctx->poll_id == 0);
-    ctx->poll_id = g_timeout_add_seconds (1, (GSourceFunc) disconnect_poll_cb, self);
+    mm_bearer_connect_wait_schedule_poll (ctx->wait);
 
  out:
     /* Balance refcount with the extra ref we passed to command_full() */
     g_object_unref (self);
 }
 
-static gboolean
-disconnect_poll_cb (MMBroadbandBearerMbm *self)
+static void
+disconnect_poll (MMBearerConnectWait  *wait,
+                 MMBroadbandBearerMbm *self)
 {
-    GTask             *task;
     DisconnectContext *ctx;
 
-    task = self->priv->disconnect_pending;
-    self->priv->disconnect_pending = NULL;
-
-    g_assert (task);
-    ctx = g_task_get_task_data (task);
-
-    ctx->poll_id = 0;
-
-    /* Too many retries... */
-    if (ctx->poll_count > 20) {
-        g_task_return_new_error (task,
-                                 MM_MOBILE_EQUIPMENT_ERROR,
-                                 MM_MOBILE_EQUIPMENT_ERROR_NETWORK_TIMEOUT,
-                                 "Disconnection attempt timed out");
-        g_object_unref (task);
-        return G_SOURCE_REMOVE;
-    }
+    g_assert (self->priv->disconnect_pending);
+    ctx = g_task_get_task_data (self->priv->disconnect_pending);
 
-    /* Restore pending task and poll */
-    self->priv->disconnect_pending = task;
-    ctx->poll_count++;
     mm_base_modem_at_command_full (ctx->modem,
                                    ctx->primary,
                                    "AT*ENAP?",
@@ -710,7 +699,23 @@ disconnect_poll_cb (MMBroadbandBearerMbm *self)
                                    NULL, /* cancellable */
                                    (GAsyncReadyCallback) disconnect_poll_ready,
                                    g_object_ref (self)); /* we pass the bearer object! */
-    return G_SOURCE_REMOVE;
+}
+
+static void
+disconnect_timed_out (MMBearerConnectWait  *wait,
+                      MMBroadbandBearerMbm *self)
+{
+    GTask *task;
+
+    task = self->priv->disconnect_pending;
+    self->priv->disconnect_pending = NULL;
+    g_assert (task);
+
+    g_task_return_new_error (task,
+                             MM_MOBILE_EQUIPMENT_ERROR,
+                             MM_MOBILE_EQUIPMENT_ERROR_NETWORK_TIMEOUT,
+                             "Disconnection attempt timed out");
+    g_object_unref (task);
 }
 
 static void
@@ -744,7 +749,7 @@ disconnect_enap_ready (MMBaseModem          *modem,
     /* No unsolicited E2NAP status yet; wait for it and periodically poll
      * to handle very old F3507g/MD300 firmware that may not send E2NAP. */
     self->priv->disconnect_pending = task;
-    ctx->poll_id = g_timeout_add_seconds (1, (GSourceFunc)disconnect_poll_cb, self);
+    mm_bearer_connect_wait_schedule_poll (ctx->wait);
 
  out:
     /* Balance refcount with the extra ref we passed to command_full() */
@@ -774,6 +779,14 @@ disconnect_3gpp (MMBroadbandBearer   *_self,
     ctx->primary = g_object_ref (primary);
     g_task_set_task_data (task, ctx, (GDestroyNotify) disconnect_context_free);
 
+    /* Give up if not disconnected after 20s */
+    ctx->wait = mm_bearer_connect_wait_new ("mbm",
+                                            MM_BEARER_CONNECT_WAIT_TYPE_DISCONNECT,
+                                            20,
+                                            (MMBearerConnectWaitPollFunc) disconnect_poll,
+                                            (MMBearerConnectWaitTimeoutFunc) disconnect_timed_out,
+                                            self);
+
     /* The unsolicited response to ENAP may come before the OK does.
      * We will keep the disconnection context in the bearer private data so
      * that it is accessible from the unsolicited message handler. */
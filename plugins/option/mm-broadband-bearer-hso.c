@@ -33,15 +33,16 @@
 #include "mm-log.h"
 #include "mm-modem-helpers.h"
 #include "mm-daemon-enums-types.h"
+#include "mm-bearer-connect-wait.h"
 
 G_DEFINE_TYPE (MMBroadbandBearerHso, mm_broadband_bearer_hso, MM_TYPE_BROADBAND_BEARER);
 
 struct _MMBroadbandBearerHsoPrivate {
     guint  auth_idx;
 
-    GTask *connect_pending;
-    guint  connect_pending_id;
-    gulong connect_port_closed_id;
+    GTask               *connect_pending;
+    MMBearerConnectWait *connect_wait;
+    gulong               connect_port_closed_id;
 };
 
 /*****************************************************************************/
@@ -287,7 +288,8 @@ connect_reset (GTask *task)
 
 static void
 process_pending_connect_attempt (MMBroadbandBearerHso     *self,
-                                 MMBearerConnectionStatus  status)
+                                 MMBearerConnectionStatus  status,
+                                 gboolean                  unsolicited)
 {
     GTask           *task;
     Dial3gppContext *ctx;
@@ -299,9 +301,11 @@ process_pending_connect_attempt (MMBroadbandBearerHso     *self,
 
     ctx = g_task_get_task_data (task);
 
-    if (self->priv->connect_pending_id) {
-        g_source_remove (self->priv->connect_pending_id);
-        self->priv->connect_pending_id = 0;
+    if (self->priv->connect_wait) {
+        mm_bearer_connect_wait_complete (self->priv->connect_wait,
+                                         unsolicited,
+                                         status == MM_BEARER_CONNECTION_STATUS_CONNECTED);
+        g_clear_pointer (&self->priv->connect_wait, mm_bearer_connect_wait_free);
     }
 
     if (self->priv->connect_port_closed_id) {
@@ -329,14 +333,15 @@ process_pending_connect_attempt (MMBroadbandBearerHso     *self,
     g_object_unref (task);
 }
 
-static gboolean
-connect_timed_out_cb (MMBroadbandBearerHso *self)
+static void
+connect_timed_out (MMBearerConnectWait  *wait,
+                   MMBroadbandBearerHso *self)
 {
     GTask           *task;
     Dial3gppContext *ctx;
 
-    /* Cleanup timeout ID */
-    self->priv->connect_pending_id = 0;
+    /* Cleanup wait */
+    g_clear_pointer (&self->priv->connect_wait, mm_bearer_connect_wait_free);
 
     /* Recover task and own it */
     task = self->priv->connect_pending;
@@ -359,8 +364,45 @@ connect_timed_out_cb (MMBroadbandBearerHso *self)
 
     /* It's probably pointless to try to reset this here, but anyway... */
     connect_reset (task);
+}
+
+static void
+connect_poll_ready (MMBaseModem          *modem,
+                    GAsyncResult         *res,
+                    MMBroadbandBearerHso *self)
+{
+    MMBearerConnectionStatus status;
+
+    status = mm_bearer_connect_wait_query_cgact_finish (modem, res, NULL);
+
+    /* Already completed by an unsolicited message or timed out? */
+    if (!self->priv->connect_pending || !self->priv->connect_wait)
+        goto out;
+
+    /* Only a connected context is conclusive; failures are only reported
+     * by the _OWANCALL unsolicited message */
+    if (status == MM_BEARER_CONNECTION_STATUS_CONNECTED)
+        process_pending_connect_attempt (self, status, FALSE);
+    else
+        mm_bearer_connect_wait_schedule_poll (self->priv->connect_wait);
 
-    return G_SOURCE_REMOVE;
+ out:
+    /* Balance refcount with the extra ref we passed to the query */
+    g_object_unref (self);
+}
+
+static void
+connect_poll (MMBearerConnectWait  *wait,
+              MMBroadbandBearerHso *self)
+{
+    Dial3gppContext *ctx;
+
+    ctx = g_task_get_task_data (self->priv->connect_pending);
+    mm_bearer_connect_wait_query_cgact (ctx->modem,
+                                        ctx->primary,
+                                        ctx->cid,
+                                        (GAsyncReadyCallback) connect_poll_ready,
+                                        g_object_ref (self));
 }
 
 static void
@@ -399,6 +441,8 @@ activate_ready (MMBaseModem          *modem,
 
     /* Errors on the dial command are fatal */
     if (!mm_base_modem_at_command_full_finish (modem, res, &error)) {
+        mm_bearer_connect_wait_complete (self->priv->connect_wait, FALSE, FALSE);
+        g_clear_pointer (&self->priv->connect_wait, mm_bearer_connect_wait_free);
         g_task_return_error (task, error);
         g_object_unref (task);
         goto out;
@@ -407,13 +451,10 @@ activate_ready (MMBaseModem          *modem,
     /* Track the task again */
     self->priv->connect_pending = task;
 
-    /* We will now setup a timeout and keep the context in the bearer's private.
-     * Reports of modem being connected will arrive via unsolicited messages.
-     * This timeout should be long enough. Actually... ideally should never get
-     * reached. */
-    self->priv->connect_pending_id = g_timeout_add_seconds (60,
-                                                            (GSourceFunc)connect_timed_out_cb,
-                                                            self);
+    /* Keep the context in the bearer's private. Reports of modem being
+     * connected will arrive via unsolicited messages; poll meanwhile in case
+     * they get lost. */
+    mm_bearer_connect_wait_schedule_poll (self->priv->connect_wait);
 
     /* If we get the port closed, we treat as a connect error */
     ctx = g_task_get_task_data (task);
@@ -466,6 +507,16 @@ authenticate_ready (MMBaseModem  *modem,
     g_assert (self->priv->connect_pending == NULL);
     self->priv->connect_pending = task;
 
+    /* This timeout should be long enough. Actually... ideally should never
+     * get reached. */
+    g_assert (self->priv->connect_wait == NULL);
+    self->priv->connect_wait = mm_bearer_connect_wait_new ("hso",
+                                                           MM_BEARER_CONNECT_WAIT_TYPE_CONNECT,
+                                                           60,
+                                                           (MMBearerConnectWaitPollFunc) connect_poll,
+                                                           (MMBearerConnectWaitTimeoutFunc) connect_timed_out,
+                                                           self);
+
     /* Success, activate the PDP context and start the data session */
     command = g_strdup_printf ("AT_OWANCALL=%d,1,1", ctx->cid);
     mm_base_modem_at_command_full (ctx->modem,
@@ -707,7 +758,7 @@ report_connection_status (MMBaseBearer             *_self,
 
     /* Process pending connection attempt */
     if (self->priv->connect_pending) {
-        process_pending_connect_attempt (self, status);
+        process_pending_connect_attempt (self, status, TRUE);
         return;
     }
 
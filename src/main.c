@@ -28,6 +28,9 @@
 
 #include "mm-base-manager.h"
 #include "mm-log.h"
+#include "mm-trace.h"
+#include "mm-identity-cache.h"
+#include "mm-io-worker.h"
 #include "mm-context.h"
 
 #if defined WITH_SYSTEMD_SUSPEND_RESUME
@@ -60,6 +63,11 @@ quit_cb (gpointer user_data)
 static void
 sleeping_cb (MMSleepMonitor *sleep_monitor)
 {
+    if (mm_context_get_quick_suspend_resume ()) {
+        mm_dbg ("Keeping devices... (sleeping)");
+        return;
+    }
+
     mm_dbg ("Removing devices... (sleeping)");
     mm_base_manager_shutdown (manager, FALSE);
 }
@@ -67,7 +75,14 @@ sleeping_cb (MMSleepMonitor *sleep_monitor)
 static void
 resuming_cb (MMSleepMonitor *sleep_monitor)
 {
+    if (mm_context_get_quick_suspend_resume ()) {
+        mm_dbg ("Syncing devices (resuming)");
+        mm_base_manager_sync (manager);
+        return;
+    }
+
     mm_dbg ("Re-scanning (resuming)");
+    mm_base_manager_set_resumed (manager);
     mm_base_manager_start (manager, FALSE);
 }
 
@@ -151,6 +166,20 @@ main (int argc, char *argv[])
         exit (1);
     }
 
+    if (!mm_trace_setup (mm_context_get_log_trace_file (), &err)) {
+        g_warning ("Failed to set up tracing: %s", err->message);
+        g_error_free (err);
+        exit (1);
+    }
+
+    if (mm_context_get_identity_cache () &&
+        !mm_identity_cache_setup (MM_CACHE_DIR "/identity-cache", &err)) {
+        mm_warn ("Failed to set up identity cache: %s", err->message);
+        g_clear_error (&err);
+    }
+
+    mm_io_worker_setup (mm_context_get_io_workers ());
+
     g_unix_signal_add (SIGTERM, quit_cb, NULL);
     g_unix_signal_add (SIGINT, quit_cb, NULL);
 
@@ -217,6 +246,9 @@ main (int argc, char *argv[])
 
     mm_info ("ModemManager is shut down");
 
+    mm_io_worker_shutdown ();
+    mm_identity_cache_shutdown ();
+    mm_trace_shutdown ();
     mm_log_shutdown ();
 
     return 0;
@@ -38,6 +38,7 @@
 #include "mm-log.h"
 #include "mm-modem-helpers.h"
 #include "mm-bearer-stats.h"
+#include "mm-netlink-monitor.h"
 
 /* We require up to 20s to get a proper IP when using PPP */
 #define BEARER_IP_TIMEOUT_DEFAULT 20
@@ -46,9 +47,16 @@
 
 #define BEARER_STATS_UPDATE_TIMEOUT 30
 
-/* Initial connectivity check after 30s, then each 5s */
+/* Initial connectivity check after 30s, then each 5s; or each 60s if the
+ * network interface is known to report carrier loss */
 #define BEARER_CONNECTION_MONITOR_INITIAL_TIMEOUT 30
 #define BEARER_CONNECTION_MONITOR_TIMEOUT          5
+#define BEARER_CONNECTION_MONITOR_NETLINK_TIMEOUT 60
+
+/* Set in net data ports once carrier loss is reported, i.e. once the driver
+ * is known to drop carrier when the data session goes away */
+#define NETLINK_REPORTS_CARRIER_TAG "netlink-reports-carrier-tag"
+static GQuark netlink_reports_carrier_quark;
 
 G_DEFINE_TYPE (MMBaseBearer, mm_base_bearer, MM_GDBUS_TYPE_BEARER_SKELETON)
 
@@ -97,6 +105,9 @@ struct _MMBaseBearerPrivate {
 
     /* Connection status monitoring */
     guint connection_monitor_id;
+    /* Kernel network interface monitoring, if using a net data port */
+    MMNetlinkMonitorWatch *netlink_watch;
+    MMPort *netlink_port;
     /* Flag to specify whether connection monitoring is supported or not */
     gboolean load_connection_status_unsupported;
 
@@ -158,11 +169,14 @@ connection_monitor_stop (MMBaseBearer *self)
         g_source_remove (self->priv->connection_monitor_id);
         self->priv->connection_monitor_id = 0;
     }
+    g_clear_pointer (&self->priv->netlink_watch, mm_netlink_monitor_watch_free);
+    g_clear_object (&self->priv->netlink_port);
 }
 
 static void
 load_connection_status_ready (MMBaseBearer *self,
-                              GAsyncResult *res)
+                              GAsyncResult *res,
+                              gpointer      netlink_check)
 {
     GError                   *error = NULL;
     MMBearerConnectionStatus  status;
@@ -180,7 +194,10 @@ load_connection_status_ready (MMBaseBearer *self,
          * ignore the error and remove the timeout. */
         mm_dbg ("Connection monitoring is unsupported by the device");
         self->priv->load_connection_status_unsupported = TRUE;
-        connection_monitor_stop (self);
+        if (self->priv->connection_monitor_id) {
+            g_source_remove (self->priv->connection_monitor_id);
+            self->priv->connection_monitor_id = 0;
+        }
         g_error_free (error);
         return;
     }
@@ -188,30 +205,58 @@ load_connection_status_ready (MMBaseBearer *self,
     /* Report connection or disconnection */
     g_assert (status == MM_BEARER_CONNECTION_STATUS_CONNECTED || status == MM_BEARER_CONNECTION_STATUS_DISCONNECTED);
     mm_dbg ("connection status loaded: %s", mm_bearer_connection_status_get_string (status));
+    if (status == MM_BEARER_CONNECTION_STATUS_DISCONNECTED &&
+        self->priv->status == MM_BEARER_STATUS_CONNECTED &&
+        !self->priv->ignore_disconnection_reports)
+        mm_base_modem_record_bearer_monitor_event (self->priv->modem,
+                                                   netlink_check ?
+                                                   MM_BASE_MODEM_BEARER_MONITOR_NETLINK_DISCONNECT :
+                                                   MM_BASE_MODEM_BEARER_MONITOR_POLL_DISCONNECT);
     mm_base_bearer_report_connection_status (self, status);
 }
 
 static gboolean
-connection_monitor_cb (MMBaseBearer *self)
+connection_monitor_supported (MMBaseBearer *self)
+{
+    return (MM_BASE_BEARER_GET_CLASS (self)->load_connection_status &&
+            MM_BASE_BEARER_GET_CLASS (self)->load_connection_status_finish &&
+            !self->priv->load_connection_status_unsupported);
+}
+
+static void
+connection_monitor_load (MMBaseBearer *self,
+                         gboolean      netlink_check)
 {
-    /* If the implementation knows how to load connection status, run it */
     MM_BASE_BEARER_GET_CLASS (self)->load_connection_status (
         self,
         (GAsyncReadyCallback)load_connection_status_ready,
-        NULL);
+        GUINT_TO_POINTER (netlink_check));
+}
+
+static gboolean
+connection_monitor_cb (MMBaseBearer *self)
+{
+    /* If the implementation knows how to load connection status, run it */
+    connection_monitor_load (self, FALSE);
     return G_SOURCE_CONTINUE;
 }
 
 static gboolean
 initial_connection_monitor_cb (MMBaseBearer *self)
 {
-    MM_BASE_BEARER_GET_CLASS (self)->load_connection_status (
-        self,
-        (GAsyncReadyCallback)load_connection_status_ready,
-        NULL);
+    guint timeout;
+
+    connection_monitor_load (self, FALSE);
+
+    /* Polling is just a fallback if the kernel reports carrier loss */
+    if (self->priv->netlink_watch &&
+        GPOINTER_TO_UINT (g_object_get_qdata (G_OBJECT (self->priv->netlink_port), netlink_reports_carrier_quark)))
+        timeout = BEARER_CONNECTION_MONITOR_NETLINK_TIMEOUT;
+    else
+        timeout = BEARER_CONNECTION_MONITOR_TIMEOUT;
 
     /* Add new monitor timeout at a higher rate */
-    self->priv->connection_monitor_id = g_timeout_add_seconds (BEARER_CONNECTION_MONITOR_TIMEOUT,
+    self->priv->connection_monitor_id = g_timeout_add_seconds (timeout,
                                                                (GSourceFunc) connection_monitor_cb,
                                                                self);
 
@@ -220,14 +265,57 @@ initial_connection_monitor_cb (MMBaseBearer *self)
 }
 
 static void
-connection_monitor_start (MMBaseBearer *self)
+netlink_event_cb (MMNetlinkMonitorEvent  event,
+                  MMBaseBearer          *self)
 {
-    /* If not implemented, don't schedule anything */
-    if (!MM_BASE_BEARER_GET_CLASS (self)->load_connection_status ||
-        !MM_BASE_BEARER_GET_CLASS (self)->load_connection_status_finish)
+    switch (event) {
+    case MM_NETLINK_MONITOR_EVENT_CARRIER_LOST:
+        /* Remembered as long as the port exists */
+        g_object_set_qdata (G_OBJECT (self->priv->netlink_port),
+                            netlink_reports_carrier_quark,
+                            GUINT_TO_POINTER (TRUE));
+        /* Fall through */
+    case MM_NETLINK_MONITOR_EVENT_LINK_REMOVED:
+        mm_dbg ("Bearer '%s' data interface %s, reporting disconnection",
+                self->priv->path,
+                event == MM_NETLINK_MONITOR_EVENT_CARRIER_LOST ? "lost carrier" : "removed");
+        if (!self->priv->ignore_disconnection_reports)
+            mm_base_modem_record_bearer_monitor_event (self->priv->modem,
+                                                       MM_BASE_MODEM_BEARER_MONITOR_NETLINK_DISCONNECT);
+        /* May free the watch */
+        mm_base_bearer_report_connection_status (self, MM_BEARER_CONNECTION_STATUS_DISCONNECTED);
         return;
+    case MM_NETLINK_MONITOR_EVENT_ADDRESS_REMOVED:
+    case MM_NETLINK_MONITOR_EVENT_OVERRUN:
+        /* Addresses may be removed by the connection manager for other
+         * reasons, so let the modem confirm */
+        if (!connection_monitor_supported (self))
+            return;
+        mm_base_modem_record_bearer_monitor_event (self->priv->modem,
+                                                   MM_BASE_MODEM_BEARER_MONITOR_NETLINK_CHECK);
+        connection_monitor_load (self, TRUE);
+        return;
+    default:
+        g_assert_not_reached ();
+    }
+}
 
-    if (self->priv->load_connection_status_unsupported)
+static void
+connection_monitor_start (MMBaseBearer *self,
+                          MMPort       *data)
+{
+    /* Watch the kernel network interface, if any */
+    if (mm_port_get_port_type (data) == MM_PORT_TYPE_NET) {
+        g_assert (!self->priv->netlink_watch);
+        self->priv->netlink_watch = mm_netlink_monitor_watch_new (mm_port_get_device (data),
+                                                                  (MMNetlinkMonitorFunc) netlink_event_cb,
+                                                                  self);
+        if (self->priv->netlink_watch)
+            self->priv->netlink_port = g_object_ref (data);
+    }
+
+    /* If not implemented, don't schedule anything */
+    if (!connection_monitor_supported (self))
         return;
 
     /* Schedule initial check */
@@ -387,13 +475,13 @@ bearer_update_status (MMBaseBearer *self,
 
 static void
 bearer_update_status_connected (MMBaseBearer *self,
-                                const gchar *interface,
+                                MMPort *data,
                                 MMBearerIpConfig *ipv4_config,
                                 MMBearerIpConfig *ipv6_config)
 {
     mm_gdbus_bearer_set_connected (MM_GDBUS_BEARER (self), TRUE);
     mm_gdbus_bearer_set_suspended (MM_GDBUS_BEARER (self), FALSE);
-    mm_gdbus_bearer_set_interface (MM_GDBUS_BEARER (self), interface);
+    mm_gdbus_bearer_set_interface (MM_GDBUS_BEARER (self), mm_port_get_device (data));
     mm_gdbus_bearer_set_ip4_config (
         MM_GDBUS_BEARER (self),
         mm_bearer_ip_config_get_dictionary (ipv4_config));
@@ -415,7 +503,7 @@ bearer_update_status_connected (MMBaseBearer *self,
     bearer_stats_start (self);
 
     /* Start connection monitor, if supported */
-    connection_monitor_start (self);
+    connection_monitor_start (self, data);
 
     /* Update the property value */
     self->priv->status = MM_BEARER_STATUS_CONNECTED;
@@ -747,7 +835,7 @@ connect_ready (MMBaseBearer *self,
         /* Update bearer and interface status */
         bearer_update_status_connected (
             self,
-            mm_port_get_device (mm_bearer_connect_result_peek_data (result)),
+            mm_bearer_connect_result_peek_data (result),
             mm_bearer_connect_result_peek_ipv4_config (result),
             mm_bearer_connect_result_peek_ipv6_config (result));
         mm_bearer_connect_result_unref (result);
@@ -1482,6 +1570,8 @@ mm_base_bearer_class_init (MMBaseBearerClass *klass)
 
     g_type_class_add_private (object_class, sizeof (MMBaseBearerPrivate));
 
+    netlink_reports_carrier_quark = g_quark_from_static_string (NETLINK_REPORTS_CARRIER_TAG);
+
     /* Virtual methods */
     object_class->get_property = get_property;
     object_class->set_property = set_property;
@@ -40,6 +40,7 @@
 #include "mm-base-manager.h"
 #include "mm-daemon-enums-types.h"
 #include "mm-device.h"
+#include "mm-iface-modem.h"
 #include "mm-plugin-manager.h"
 #include "mm-auth.h"
 #include "mm-plugin.h"
@@ -93,12 +94,21 @@ struct _MMBaseManagerPrivate {
     /* The Test interface support */
     MmGdbusTest *test_skeleton;
 
+    /* Resume handling */
+    gint64 resume_time;
+    guint n_syncs_pending;
+    gboolean sync_reprobe;
+
 #if defined WITH_UDEV
     /* The UDev client */
     GUdevClient *udev;
 #endif
 };
 
+/* Resume-to-registered latency is only reported if the modem registers
+ * within this time */
+#define RESUME_LATENCY_TIMEOUT_SECS 120
+
 /*****************************************************************************/
 
 static MMDevice *
@@ -164,6 +174,78 @@ find_device_support_context_free (FindDeviceSupportContext *ctx)
     g_slice_free (FindDeviceSupportContext, ctx);
 }
 
+/*****************************************************************************/
+/* Resume latency */
+
+static void modem_state_updated_after_resume (MMBaseModem   *modem,
+                                              GParamSpec    *pspec,
+                                              MMBaseManager *self);
+
+static gboolean
+check_resume_latency (MMBaseManager *self,
+                      MMBaseModem   *modem)
+{
+    MMModemState state = MM_MODEM_STATE_UNKNOWN;
+    gint64       elapsed_ms;
+
+    elapsed_ms = (g_get_monotonic_time () - self->priv->resume_time) / 1000;
+    if (elapsed_ms > RESUME_LATENCY_TIMEOUT_SECS * 1000) {
+        mm_dbg ("Modem %s not registered %d s after resume",
+                mm_base_modem_get_device (modem), RESUME_LATENCY_TIMEOUT_SECS);
+        return TRUE;
+    }
+
+    g_object_get (modem,
+                  MM_IFACE_MODEM_STATE, &state,
+                  NULL);
+    if (state < MM_MODEM_STATE_REGISTERED)
+        return FALSE;
+
+    mm_info ("Modem %s registered %" G_GINT64_FORMAT " ms after resume",
+             mm_base_modem_get_device (modem), elapsed_ms);
+    return TRUE;
+}
+
+static void
+modem_state_updated_after_resume (MMBaseModem   *modem,
+                                  GParamSpec    *pspec,
+                                  MMBaseManager *self)
+{
+    if (check_resume_latency (self, modem))
+        g_signal_handlers_disconnect_by_func (modem, modem_state_updated_after_resume, self);
+}
+
+static void
+track_resume_latency (MMBaseManager *self,
+                      MMBaseModem   *modem)
+{
+    if (!modem || !self->priv->resume_time)
+        return;
+
+    /* Not right after a resume */
+    if ((g_get_monotonic_time () - self->priv->resume_time) > (RESUME_LATENCY_TIMEOUT_SECS * G_USEC_PER_SEC))
+        return;
+
+    g_signal_handlers_disconnect_by_func (modem, modem_state_updated_after_resume, self);
+    if (check_resume_latency (self, modem))
+        return;
+
+    g_signal_connect (modem,
+                      "notify::" MM_IFACE_MODEM_STATE,
+                      G_CALLBACK (modem_state_updated_after_resume),
+                      self);
+}
+
+void
+mm_base_manager_set_resumed (MMBaseManager *self)
+{
+    g_return_if_fail (MM_IS_BASE_MANAGER (self));
+
+    self->priv->resume_time = g_get_monotonic_time ();
+}
+
+/*****************************************************************************/
+
 static void
 device_support_check_ready (MMPluginManager          *plugin_manager,
                             GAsyncResult             *res,
@@ -204,6 +286,7 @@ device_support_check_ready (MMPluginManager          *plugin_manager,
     /* Modem now created */
     mm_info ("Modem for device '%s' successfully created",
              mm_device_get_uid (ctx->device));
+    track_resume_latency (ctx->self, mm_device_peek_modem (ctx->device));
     find_device_support_context_free (ctx);
 }
 
@@ -707,6 +790,129 @@ mm_base_manager_shutdown (MMBaseManager *self,
     g_hash_table_foreach_remove (self->priv->devices, (GHRFunc)foreach_remove, self);
 }
 
+/*****************************************************************************/
+/* Sync after resume */
+
+typedef struct {
+    MMBaseManager *self;
+    MMDevice      *device;
+} SyncContext;
+
+static void
+sync_context_free (SyncContext *ctx)
+{
+    g_object_unref (ctx->self);
+    g_object_unref (ctx->device);
+    g_slice_free (SyncContext, ctx);
+}
+
+static void
+sync_completed (MMBaseManager *self)
+{
+    g_assert (self->priv->n_syncs_pending > 0);
+    if (--self->priv->n_syncs_pending > 0)
+        return;
+
+    /* Once all modems are synced, re-scan to probe again the removed ones */
+    if (self->priv->sync_reprobe) {
+        self->priv->sync_reprobe = FALSE;
+        mm_dbg ("Re-scanning (resuming)");
+        mm_base_manager_start (self, FALSE);
+    }
+}
+
+static void
+remove_device (MMBaseManager *self,
+               MMDevice      *device)
+{
+    MMBaseModem *modem;
+
+    modem = mm_device_peek_modem (device);
+    if (modem)
+        g_cancellable_cancel (mm_base_modem_peek_cancellable (modem));
+    if (mm_plugin_manager_device_support_check_cancel (self->priv->plugin_manager, device))
+        mm_dbg ("Device support check has been cancelled");
+    mm_device_remove_modem (device);
+    g_hash_table_remove (self->priv->devices, mm_device_get_uid (device));
+}
+
+static void
+base_modem_sync_ready (MMBaseModem  *modem,
+                       GAsyncResult *res,
+                       SyncContext  *ctx)
+{
+    GError *error = NULL;
+
+    if (!mm_base_modem_sync_finish (modem, res, &error)) {
+        mm_info ("Couldn't sync modem for device '%s' after resume: %s",
+                 mm_device_get_uid (ctx->device), error->message);
+        g_error_free (error);
+
+        /* Fall back to a full re-probe, unless the device was already
+         * removed or the modem replaced while syncing */
+        if (mm_device_peek_modem (ctx->device) == modem &&
+            g_hash_table_lookup (ctx->self->priv->devices, mm_device_get_uid (ctx->device)) == ctx->device)
+            remove_device (ctx->self, ctx->device);
+        ctx->self->priv->sync_reprobe = TRUE;
+    } else {
+        mm_info ("Modem for device '%s' successfully synced after resume",
+                 mm_device_get_uid (ctx->device));
+        track_resume_latency (ctx->self, modem);
+    }
+
+    sync_completed (ctx->self);
+    sync_context_free (ctx);
+}
+
+void
+mm_base_manager_sync (MMBaseManager *self)
+{
+    GHashTableIter  iter;
+    gpointer        value;
+    GList          *devices = NULL;
+    GList          *l;
+
+    g_return_if_fail (MM_IS_BASE_MANAGER (self));
+
+    mm_base_manager_set_resumed (self);
+
+    /* The sync of a modem may remove the device from the table, so iterate
+     * over a copy of the list of devices */
+    g_hash_table_iter_init (&iter, self->priv->devices);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+        devices = g_list_prepend (devices, g_object_ref (value));
+
+    /* Hold a pending sync ourselves, so that the re-scan isn't run until all
+     * syncs have been launched */
+    self->priv->n_syncs_pending++;
+    for (l = devices; l; l = g_list_next (l)) {
+        MMDevice    *device = MM_DEVICE (l->data);
+        MMBaseModem *modem;
+        SyncContext *ctx;
+
+        /* Devices still being probed when the system went to sleep are
+         * probed again from scratch */
+        modem = mm_device_peek_modem (device);
+        if (!modem) {
+            mm_dbg ("Removing device '%s' without modem (resuming)", mm_device_get_uid (device));
+            remove_device (self, device);
+            self->priv->sync_reprobe = TRUE;
+            continue;
+        }
+
+        ctx = g_slice_new (SyncContext);
+        ctx->self = g_object_ref (self);
+        ctx->device = g_object_ref (device);
+        self->priv->n_syncs_pending++;
+        mm_base_modem_sync (modem, (GAsyncReadyCallback) base_modem_sync_ready, ctx);
+    }
+    g_list_free_full (devices, g_object_unref);
+
+    sync_completed (self);
+}
+
+/*****************************************************************************/
+
 guint32
 mm_base_manager_num_modems (MMBaseManager *self)
 {
@@ -67,4 +67,12 @@ void             mm_base_manager_shutdown    (MMBaseManager *manager,
 
 guint32          mm_base_manager_num_modems  (MMBaseManager *manager);
 
+/* Validate all known modems after a system resume, and fully re-probe the
+ * ones that fail the validation */
+void             mm_base_manager_sync        (MMBaseManager *manager);
+
+/* Report that the system was just resumed, so that the time until each
+ * modem gets registered is measured */
+void             mm_base_manager_set_resumed (MMBaseManager *manager);
+
 #endif /* MM_BASE_MANAGER_H */
@@ -33,6 +33,8 @@
 
 #include "mm-log.h"
 #include "mm-port-enums-types.h"
+#include "mm-port-stats.h"
+#include "mm-poll-scheduler.h"
 #include "mm-serial-parsers.h"
 #include "mm-modem-helpers.h"
 
@@ -84,6 +86,10 @@ struct _MMBaseModemPrivate {
     MMAuthProvider *authp;
     GCancellable *authp_cancellable;
 
+    /* Runtime statistics */
+    MmGdbusModemStats *stats_skeleton;
+    guint bearer_monitor_counters[MM_BASE_MODEM_BEARER_MONITOR_LAST];
+
     GHashTable *ports;
     MMPortSerialAt *primary;
     MMPortSerialAt *secondary;
@@ -338,6 +344,18 @@ mm_base_modem_grab_port (MMBaseModem         *self,
             mm_port_type_get_string (ptype),
             mm_base_modem_get_device (self));
 
+    /* Device-specific periodic query budget */
+    if (mm_kernel_device_has_global_property (kernel_device, ID_MM_POLL_BUDGET)) {
+        gint budget;
+
+        budget = mm_kernel_device_get_global_property_as_int (kernel_device, ID_MM_POLL_BUDGET);
+        if (budget > 0)
+            mm_poll_scheduler_set_budget (mm_poll_scheduler_get (), self, (guint) budget);
+        else
+            mm_warn ("(%s/%s) invalid poll budget in device: %s",
+                     subsys, name, mm_kernel_device_get_global_property (kernel_device, ID_MM_POLL_BUDGET));
+    }
+
     /* Add it to the tracking HT.
      * Note: 'key' and 'port' now owned by the HT. */
     g_hash_table_insert (self->priv->ports, key, port);
@@ -350,6 +368,52 @@ mm_base_modem_grab_port (MMBaseModem         *self,
     return TRUE;
 }
 
+gboolean
+mm_base_modem_sync_finish (MMBaseModem   *self,
+                           GAsyncResult  *res,
+                           GError       **error)
+{
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+static void
+sync_ready (MMBaseModem  *self,
+            GAsyncResult *res,
+            GTask        *task)
+{
+    GError *error = NULL;
+
+    if (!MM_BASE_MODEM_GET_CLASS (self)->sync_finish (self, res, &error))
+        g_task_return_error (task, error);
+    else
+        g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
+}
+
+void
+mm_base_modem_sync (MMBaseModem         *self,
+                    GAsyncReadyCallback  callback,
+                    gpointer             user_data)
+{
+    GTask *task;
+
+    task = g_task_new (self, self->priv->cancellable, callback, user_data);
+
+    if (!MM_BASE_MODEM_GET_CLASS (self)->sync ||
+        !MM_BASE_MODEM_GET_CLASS (self)->sync_finish) {
+        g_task_return_new_error (task, MM_CORE_ERROR, MM_CORE_ERROR_UNSUPPORTED,
+                                 "Modem sync not supported");
+        g_object_unref (task);
+        return;
+    }
+
+    MM_BASE_MODEM_GET_CLASS (self)->sync (
+        self,
+        self->priv->cancellable,
+        (GAsyncReadyCallback) sync_ready,
+        task);
+}
+
 gboolean
 mm_base_modem_disable_finish (MMBaseModem   *self,
                               GAsyncResult  *res,
@@ -901,6 +965,29 @@ mm_base_modem_has_at_port (MMBaseModem *self)
     return FALSE;
 }
 
+static MMModemPortType
+port_type_to_modem_port_type (MMPortType port_type)
+{
+    switch (port_type) {
+    case MM_PORT_TYPE_NET:
+        return MM_MODEM_PORT_TYPE_NET;
+    case MM_PORT_TYPE_AT:
+        return MM_MODEM_PORT_TYPE_AT;
+    case MM_PORT_TYPE_QCDM:
+        return MM_MODEM_PORT_TYPE_QCDM;
+    case MM_PORT_TYPE_GPS:
+        return MM_MODEM_PORT_TYPE_GPS;
+    case MM_PORT_TYPE_QMI:
+        return MM_MODEM_PORT_TYPE_QMI;
+    case MM_PORT_TYPE_MBIM:
+        return MM_MODEM_PORT_TYPE_MBIM;
+    case MM_PORT_TYPE_UNKNOWN:
+    case MM_PORT_TYPE_IGNORED:
+    default:
+        return MM_MODEM_PORT_TYPE_UNKNOWN;
+    }
+}
+
 MMModemPortInfo *
 mm_base_modem_get_port_infos (MMBaseModem *self,
                               guint *n_port_infos)
@@ -916,32 +1003,7 @@ mm_base_modem_get_port_infos (MMBaseModem *self,
     i = 0;
     while (g_hash_table_iter_next (&iter, NULL, (gpointer)&port)) {
         port_infos[i].name = g_strdup (mm_port_get_device (port));
-        switch (mm_port_get_port_type (port)) {
-        case MM_PORT_TYPE_NET:
-            port_infos[i].type = MM_MODEM_PORT_TYPE_NET;
-            break;
-        case MM_PORT_TYPE_AT:
-            port_infos[i].type = MM_MODEM_PORT_TYPE_AT;
-            break;
-        case MM_PORT_TYPE_QCDM:
-            port_infos[i].type = MM_MODEM_PORT_TYPE_QCDM;
-            break;
-        case MM_PORT_TYPE_GPS:
-            port_infos[i].type = MM_MODEM_PORT_TYPE_GPS;
-            break;
-        case MM_PORT_TYPE_QMI:
-            port_infos[i].type = MM_MODEM_PORT_TYPE_QMI;
-            break;
-        case MM_PORT_TYPE_MBIM:
-            port_infos[i].type = MM_MODEM_PORT_TYPE_MBIM;
-            break;
-        case MM_PORT_TYPE_UNKNOWN:
-        case MM_PORT_TYPE_IGNORED:
-        default:
-            port_infos[i].type = MM_MODEM_PORT_TYPE_UNKNOWN;
-            break;
-        }
-
+        port_infos[i].type = port_type_to_modem_port_type (mm_port_get_port_type (port));
         i++;
     }
 
@@ -1347,6 +1409,207 @@ mm_base_modem_authorize (MMBaseModem *self,
                                 task);
 }
 
+/*****************************************************************************/
+/* Runtime statistics */
+
+typedef struct {
+    MmGdbusModemStats     *skeleton;
+    GDBusMethodInvocation *invocation;
+} HandleGetPortStatsContext;
+
+static void
+handle_get_port_stats_context_free (HandleGetPortStatsContext *ctx)
+{
+    g_object_unref (ctx->skeleton);
+    g_object_unref (ctx->invocation);
+    g_slice_free (HandleGetPortStatsContext, ctx);
+}
+
+static void
+handle_get_port_stats_auth_ready (MMBaseModem               *self,
+                                  GAsyncResult              *res,
+                                  HandleGetPortStatsContext *ctx)
+{
+    GVariantBuilder  builder;
+    GHashTableIter   iter;
+    MMPort          *port;
+    GError          *error = NULL;
+
+    if (!mm_base_modem_authorize_finish (self, res, &error)) {
+        g_dbus_method_invocation_take_error (ctx->invocation, error);
+        handle_get_port_stats_context_free (ctx);
+        return;
+    }
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sv}"));
+
+    if (self->priv->ports) {
+        g_hash_table_iter_init (&iter, self->priv->ports);
+        while (g_hash_table_iter_next (&iter, NULL, (gpointer)&port)) {
+            GVariantBuilder  port_builder;
+            GVariant        *dictionary;
+            GVariantIter     dictionary_iter;
+            const gchar     *key;
+            GVariant        *value;
+
+            g_variant_builder_init (&port_builder, G_VARIANT_TYPE ("a{sv}"));
+            g_variant_builder_add (&port_builder, "{sv}", "port",
+                                   g_variant_new_string (mm_port_get_device (port)));
+            g_variant_builder_add (&port_builder, "{sv}", "port-type",
+                                   g_variant_new_uint32 (port_type_to_modem_port_type (mm_port_get_port_type (port))));
+
+            dictionary = g_variant_ref_sink (mm_port_stats_get_dictionary (mm_port_peek_stats (port)));
+            g_variant_iter_init (&dictionary_iter, dictionary);
+            while (g_variant_iter_next (&dictionary_iter, "{&sv}", &key, &value)) {
+                g_variant_builder_add (&port_builder, "{sv}", key, value);
+                g_variant_unref (value);
+            }
+            g_variant_unref (dictionary);
+
+            g_variant_builder_add_value (&builder, g_variant_builder_end (&port_builder));
+        }
+    }
+
+    mm_gdbus_modem_stats_complete_get_port_stats (ctx->skeleton, ctx->invocation, g_variant_builder_end (&builder));
+    handle_get_port_stats_context_free (ctx);
+}
+
+static gboolean
+handle_get_port_stats (MmGdbusModemStats     *skeleton,
+                       GDBusMethodInvocation *invocation,
+                       MMBaseModem           *self)
+{
+    HandleGetPortStatsContext *ctx;
+
+    ctx = g_slice_new0 (HandleGetPortStatsContext);
+    ctx->skeleton = g_object_ref (skeleton);
+    ctx->invocation = g_object_ref (invocation);
+
+    mm_base_modem_authorize (self,
+                             invocation,
+                             MM_AUTHORIZATION_DEVICE_CONTROL,
+                             (GAsyncReadyCallback)handle_get_port_stats_auth_ready,
+                             ctx);
+    return TRUE;
+}
+
+typedef struct {
+    MmGdbusModemStats     *skeleton;
+    GDBusMethodInvocation *invocation;
+} HandleGetPollStatsContext;
+
+static void
+handle_get_poll_stats_context_free (HandleGetPollStatsContext *ctx)
+{
+    g_object_unref (ctx->skeleton);
+    g_object_unref (ctx->invocation);
+    g_slice_free (HandleGetPollStatsContext, ctx);
+}
+
+static void
+handle_get_poll_stats_auth_ready (MMBaseModem               *self,
+                                  GAsyncResult              *res,
+                                  HandleGetPollStatsContext *ctx)
+{
+    GVariantBuilder      builder;
+    MMPollSchedulerStats stats;
+    GError              *error = NULL;
+
+    if (!mm_base_modem_authorize_finish (self, res, &error)) {
+        g_dbus_method_invocation_take_error (ctx->invocation, error);
+        handle_get_poll_stats_context_free (ctx);
+        return;
+    }
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+    if (mm_poll_scheduler_get_stats (mm_poll_scheduler_get (), self, &stats)) {
+        g_variant_builder_add (&builder, "{sv}", "budget",         g_variant_new_uint32 (stats.budget));
+        g_variant_builder_add (&builder, "{sv}", "polls",          g_variant_new_uint32 (stats.n_polls));
+        g_variant_builder_add (&builder, "{sv}", "deferred-busy",  g_variant_new_uint32 (stats.n_deferred_busy));
+        g_variant_builder_add (&builder, "{sv}", "deferred-load",  g_variant_new_uint32 (stats.n_deferred_load));
+        g_variant_builder_add (&builder, "{sv}", "skipped-fresh",  g_variant_new_uint32 (stats.n_skipped_fresh));
+    }
+
+    mm_gdbus_modem_stats_complete_get_poll_stats (ctx->skeleton, ctx->invocation, g_variant_builder_end (&builder));
+    handle_get_poll_stats_context_free (ctx);
+}
+
+static gboolean
+handle_get_poll_stats (MmGdbusModemStats     *skeleton,
+                       GDBusMethodInvocation *invocation,
+                       MMBaseModem           *self)
+{
+    HandleGetPollStatsContext *ctx;
+
+    ctx = g_slice_new0 (HandleGetPollStatsContext);
+    ctx->skeleton = g_object_ref (skeleton);
+    ctx->invocation = g_object_ref (invocation);
+
+    mm_base_modem_authorize (self,
+                             invocation,
+                             MM_AUTHORIZATION_DEVICE_CONTROL,
+                             (GAsyncReadyCallback)handle_get_poll_stats_auth_ready,
+                             ctx);
+    return TRUE;
+}
+
+static void
+update_bearer_monitor_stats (MMBaseModem *self)
+{
+    GVariantBuilder builder;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+    g_variant_builder_add (&builder, "{sv}", "poll-disconnects",
+                           g_variant_new_uint32 (self->priv->bearer_monitor_counters[MM_BASE_MODEM_BEARER_MONITOR_POLL_DISCONNECT]));
+    g_variant_builder_add (&builder, "{sv}", "netlink-disconnects",
+                           g_variant_new_uint32 (self->priv->bearer_monitor_counters[MM_BASE_MODEM_BEARER_MONITOR_NETLINK_DISCONNECT]));
+    g_variant_builder_add (&builder, "{sv}", "netlink-checks",
+                           g_variant_new_uint32 (self->priv->bearer_monitor_counters[MM_BASE_MODEM_BEARER_MONITOR_NETLINK_CHECK]));
+    mm_gdbus_modem_stats_set_bearer_monitor (self->priv->stats_skeleton,
+                                             g_variant_builder_end (&builder));
+}
+
+void
+mm_base_modem_record_bearer_monitor_event (MMBaseModem                   *self,
+                                           MMBaseModemBearerMonitorEvent  event)
+{
+    g_return_if_fail (event < MM_BASE_MODEM_BEARER_MONITOR_LAST);
+
+    self->priv->bearer_monitor_counters[event]++;
+    if (self->priv->stats_skeleton)
+        update_bearer_monitor_stats (self);
+}
+
+static void
+setup_stats_skeleton (MMBaseModem *self)
+{
+    GVariantBuilder  builder;
+    const guint     *limits;
+    guint            i;
+
+    self->priv->stats_skeleton = mm_gdbus_modem_stats_skeleton_new ();
+
+    limits = mm_port_stats_get_bucket_limits ();
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("au"));
+    for (i = 0; i < MM_PORT_STATS_N_BUCKETS; i++)
+        g_variant_builder_add (&builder, "u", limits[i]);
+    mm_gdbus_modem_stats_set_histogram_buckets (self->priv->stats_skeleton,
+                                                g_variant_builder_end (&builder));
+    update_bearer_monitor_stats (self);
+
+    g_signal_connect (self->priv->stats_skeleton,
+                      "handle-get-port-stats",
+                      G_CALLBACK (handle_get_port_stats),
+                      self);
+    g_signal_connect (self->priv->stats_skeleton,
+                      "handle-get-poll-stats",
+                      G_CALLBACK (handle_get_poll_stats),
+                      self);
+
+    mm_gdbus_object_skeleton_set_modem_stats (MM_GDBUS_OBJECT_SKELETON (self),
+                                              self->priv->stats_skeleton);
+}
+
 /*****************************************************************************/
 
 const gchar *
@@ -1438,6 +1701,9 @@ mm_base_modem_init (MMBaseModem *self)
                                                g_object_unref);
 
     self->priv->max_timeouts = DEFAULT_MAX_TIMEOUTS;
+
+    /* Setup runtime statistics interface */
+    setup_stats_skeleton (self);
 }
 
 static void
@@ -1597,6 +1863,17 @@ dispose (GObject *object)
         self->priv->ports = NULL;
     }
 
+    if (self->priv->stats_skeleton) {
+        g_signal_handlers_disconnect_by_func (self->priv->stats_skeleton,
+                                              handle_get_port_stats,
+                                              self);
+        g_signal_handlers_disconnect_by_func (self->priv->stats_skeleton,
+                                              handle_get_poll_stats,
+                                              self);
+        mm_gdbus_object_skeleton_set_modem_stats (MM_GDBUS_OBJECT_SKELETON (self), NULL);
+        g_clear_object (&self->priv->stats_skeleton);
+    }
+
     g_clear_object (&self->priv->connection);
 
     G_OBJECT_CLASS (mm_base_modem_parent_class)->dispose (object);
@@ -101,6 +101,17 @@ struct _MMBaseModemClass {
     gboolean (*disable_finish) (MMBaseModem *self,
                                 GAsyncResult *res,
                                 GError **error);
+
+    /* Modem sync.
+     * Validates that the modem is still the same one and still usable after
+     * the system has been suspended, and refreshes its state */
+    void (* sync) (MMBaseModem *self,
+                   GCancellable *cancellable,
+                   GAsyncReadyCallback callback,
+                   gpointer user_data);
+    gboolean (*sync_finish) (MMBaseModem *self,
+                             GAsyncResult *res,
+                             GError **error);
 };
 
 GType mm_base_modem_get_type (void);
@@ -180,6 +191,17 @@ guint mm_base_modem_get_product_id (MMBaseModem *self);
 GCancellable *mm_base_modem_peek_cancellable (MMBaseModem *self);
 GCancellable *mm_base_modem_get_cancellable  (MMBaseModem *self);
 
+/* Bearer connection monitor counters, exposed in the Stats interface */
+typedef enum {
+    MM_BASE_MODEM_BEARER_MONITOR_POLL_DISCONNECT,
+    MM_BASE_MODEM_BEARER_MONITOR_NETLINK_DISCONNECT,
+    MM_BASE_MODEM_BEARER_MONITOR_NETLINK_CHECK,
+    MM_BASE_MODEM_BEARER_MONITOR_LAST
+} MMBaseModemBearerMonitorEvent;
+
+void mm_base_modem_record_bearer_monitor_event (MMBaseModem                   *self,
+                                                MMBaseModemBearerMonitorEvent  event);
+
 void     mm_base_modem_authorize        (MMBaseModem *self,
                                          GDBusMethodInvocation *invocation,
                                          const gchar *authorization,
@@ -210,4 +232,11 @@ gboolean mm_base_modem_disable_finish (MMBaseModem *self,
                                        GAsyncResult *res,
                                        GError **error);
 
+void     mm_base_modem_sync        (MMBaseModem *self,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data);
+gboolean mm_base_modem_sync_finish (MMBaseModem *self,
+                                    GAsyncResult *res,
+                                    GError **error);
+
 #endif /* MM_BASE_MODEM_H */
@@ -31,6 +31,8 @@
 #include "mm-base-modem-at.h"
 #include "mm-base-modem.h"
 #include "mm-log.h"
+#include "mm-trace.h"
+#include "mm-identity-cache.h"
 #include "mm-modem-helpers.h"
 
 static void async_initable_iface_init (GAsyncInitableIface *iface);
@@ -1347,8 +1349,206 @@ typedef enum {
 struct _InitAsyncContext {
     InitializationStep step;
     guint sim_identifier_tries;
+    gboolean from_identity_cache;
 };
 
+/*****************************************************************************/
+/* Identity cache */
+
+static gchar *
+dup_modem_equipment_identifier (MMBaseSim *self)
+{
+    MmGdbusModem *skeleton = NULL;
+    gchar        *imei = NULL;
+
+    if (!self->priv->modem)
+        return NULL;
+
+    g_object_get (self->priv->modem,
+                  MM_IFACE_MODEM_DBUS_SKELETON, &skeleton,
+                  NULL);
+    if (skeleton) {
+        imei = mm_gdbus_modem_dup_equipment_identifier (skeleton);
+        g_object_unref (skeleton);
+    }
+    return imei;
+}
+
+static gboolean
+identity_cache_load (MMBaseSim *self)
+{
+    gchar    *imei;
+    gchar    *imsi = NULL;
+    gchar    *operator_identifier = NULL;
+    gchar    *operator_name = NULL;
+    gboolean  found;
+
+    if (!mm_identity_cache_enabled ())
+        return FALSE;
+
+    imei = dup_modem_equipment_identifier (self);
+    found = mm_identity_cache_lookup_sim (imei,
+                                          mm_gdbus_sim_get_sim_identifier (MM_GDBUS_SIM (self)),
+                                          &imsi,
+                                          &operator_identifier,
+                                          &operator_name);
+    if (found) {
+        mm_dbg ("SIM information loaded from identity cache");
+        mm_gdbus_sim_set_imsi (MM_GDBUS_SIM (self), imsi);
+        mm_gdbus_sim_set_operator_identifier (MM_GDBUS_SIM (self), operator_identifier);
+        mm_gdbus_sim_set_operator_name (MM_GDBUS_SIM (self), operator_name);
+    }
+
+    g_free (imei);
+    g_free (imsi);
+    g_free (operator_identifier);
+    g_free (operator_name);
+    return found;
+}
+
+static void
+identity_cache_store (MMBaseSim *self)
+{
+    gchar *imei;
+
+    if (!mm_identity_cache_enabled ())
+        return;
+
+    imei = dup_modem_equipment_identifier (self);
+    mm_identity_cache_store_sim (imei,
+                                 mm_gdbus_sim_get_sim_identifier (MM_GDBUS_SIM (self)),
+                                 mm_gdbus_sim_get_imsi (MM_GDBUS_SIM (self)),
+                                 mm_gdbus_sim_get_operator_identifier (MM_GDBUS_SIM (self)),
+                                 mm_gdbus_sim_get_operator_name (MM_GDBUS_SIM (self)));
+    g_free (imei);
+}
+
+/* When the SIM information was taken from the identity cache, it is loaded
+ * again in the background, to fix any difference */
+
+typedef enum {
+    REFRESH_STEP_FIRST,
+    REFRESH_STEP_IMSI,
+    REFRESH_STEP_OPERATOR_ID,
+    REFRESH_STEP_OPERATOR_NAME,
+    REFRESH_STEP_LAST
+} RefreshStep;
+
+typedef struct {
+    RefreshStep step;
+} RefreshContext;
+
+static void identity_cache_refresh_step (GTask *task);
+
+#undef STR_REFRESH_READY_FN
+#define STR_REFRESH_READY_FN(NAME,DISPLAY)                              \
+    static void                                                         \
+    refresh_##NAME##_ready (MMBaseSim *self,                            \
+                            GAsyncResult *res,                          \
+                            GTask *task)                                \
+    {                                                                   \
+        RefreshContext *ctx;                                            \
+        GError *error = NULL;                                           \
+        gchar *val;                                                     \
+                                                                        \
+        val = MM_BASE_SIM_GET_CLASS (self)->load_##NAME##_finish (self, res, &error); \
+        if (error) {                                                    \
+            /* Keep the cached value */                                 \
+            mm_dbg ("couldn't refresh %s: '%s'", DISPLAY, error->message); \
+            g_error_free (error);                                       \
+        } else if (g_strcmp0 (val, mm_gdbus_sim_get_##NAME (MM_GDBUS_SIM (self))) != 0) { \
+            mm_dbg ("%s changed since it was cached", DISPLAY);         \
+            mm_gdbus_sim_set_##NAME (MM_GDBUS_SIM (self), val);         \
+        }                                                               \
+        g_free (val);                                                   \
+                                                                        \
+        /* Go on to next step */                                        \
+        ctx = g_task_get_task_data (task);                              \
+        ctx->step++;                                                    \
+        identity_cache_refresh_step (task);                             \
+    }
+
+STR_REFRESH_READY_FN (imsi, "IMSI")
+STR_REFRESH_READY_FN (operator_identifier, "Operator identifier")
+STR_REFRESH_READY_FN (operator_name, "Operator name")
+
+static void
+identity_cache_refresh_step (GTask *task)
+{
+    MMBaseSim      *self;
+    RefreshContext *ctx;
+
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    switch (ctx->step) {
+    case REFRESH_STEP_FIRST:
+        ctx->step++;
+        /* fall through */
+
+    case REFRESH_STEP_IMSI:
+        if (MM_BASE_SIM_GET_CLASS (self)->load_imsi &&
+            MM_BASE_SIM_GET_CLASS (self)->load_imsi_finish) {
+            MM_BASE_SIM_GET_CLASS (self)->load_imsi (
+                self,
+                (GAsyncReadyCallback)refresh_imsi_ready,
+                task);
+            return;
+        }
+        ctx->step++;
+        /* fall through */
+
+    case REFRESH_STEP_OPERATOR_ID:
+        if (MM_BASE_SIM_GET_CLASS (self)->load_operator_identifier &&
+            MM_BASE_SIM_GET_CLASS (self)->load_operator_identifier_finish) {
+            MM_BASE_SIM_GET_CLASS (self)->load_operator_identifier (
+                self,
+                (GAsyncReadyCallback)refresh_operator_identifier_ready,
+                task);
+            return;
+        }
+        ctx->step++;
+        /* fall through */
+
+    case REFRESH_STEP_OPERATOR_NAME:
+        if (MM_BASE_SIM_GET_CLASS (self)->load_operator_name &&
+            MM_BASE_SIM_GET_CLASS (self)->load_operator_name_finish) {
+            MM_BASE_SIM_GET_CLASS (self)->load_operator_name (
+                self,
+                (GAsyncReadyCallback)refresh_operator_name_ready,
+                task);
+            return;
+        }
+        ctx->step++;
+        /* fall through */
+
+    case REFRESH_STEP_LAST:
+        identity_cache_store (self);
+        g_task_return_boolean (task, TRUE);
+        g_object_unref (task);
+        return;
+    }
+
+    g_assert_not_reached ();
+}
+
+static void
+identity_cache_refresh (MMBaseSim *self)
+{
+    RefreshContext *ctx;
+    GTask          *task;
+
+    ctx = g_new0 (RefreshContext, 1);
+    ctx->step = REFRESH_STEP_FIRST;
+
+    task = g_task_new (self, NULL, NULL, NULL);
+    g_task_set_task_data (task, ctx, g_free);
+
+    identity_cache_refresh_step (task);
+}
+
+/*****************************************************************************/
+
 MMBaseSim *
 mm_base_sim_new_finish (GAsyncResult  *res,
                         GError       **error)
@@ -1458,6 +1658,8 @@ interface_initialization_step (GTask *task)
     self = g_task_get_source_object (task);
     ctx = g_task_get_task_data (task);
 
+    mm_trace_step (task, "sim-initialization", ctx->step, mm_base_sim_get_path (self));
+
     switch (ctx->step) {
     case INITIALIZATION_STEP_FIRST:
         /* Fall down to next step */
@@ -1480,6 +1682,16 @@ interface_initialization_step (GTask *task)
         ctx->step++;
 
     case INITIALIZATION_STEP_IMSI:
+        /* If this SIM was already seen in this modem, the rest of the
+         * information may be taken from the identity cache */
+        if (mm_gdbus_sim_get_imsi (MM_GDBUS_SIM (self)) == NULL &&
+            identity_cache_load (self)) {
+            ctx->from_identity_cache = TRUE;
+            ctx->step = INITIALIZATION_STEP_LAST;
+            interface_initialization_step (task);
+            return;
+        }
+
         /* IMSI is meant to be loaded only once during the whole
          * lifetime of the modem. Therefore, if we already have them loaded,
          * don't try to load them again. */
@@ -1528,6 +1740,11 @@ interface_initialization_step (GTask *task)
         ctx->step++;
 
     case INITIALIZATION_STEP_LAST:
+        if (ctx->from_identity_cache)
+            identity_cache_refresh (self);
+        else
+            identity_cache_store (self);
+
         /* We are done without errors! */
         g_task_return_boolean (task, TRUE);
         g_object_unref (task);
@@ -1550,7 +1767,7 @@ common_init_async (GAsyncInitable *initable,
 
     self = MM_BASE_SIM (initable);
 
-    ctx = g_new (InitAsyncContext, 1);
+    ctx = g_new0 (InitAsyncContext, 1);
     ctx->step = INITIALIZATION_STEP_FIRST;
     ctx->sim_identifier_tries = 0;
 
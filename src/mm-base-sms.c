@@ -71,6 +71,10 @@ struct _MMBaseSmsPrivate {
     /* Set to true when all needed parts were received,
      * parsed and assembled */
     gboolean is_assembled;
+
+    /* Set to true when the text of the parts is only assembled once
+     * requested */
+    gboolean text_pending;
 };
 
 /*****************************************************************************/
@@ -706,6 +710,53 @@ sms_dbus_unexport (MMBaseSms *self)
         g_dbus_interface_skeleton_unexport (G_DBUS_INTERFACE_SKELETON (self));
 }
 
+/* The text of received messages is assembled when first read, either
+ * alone or along with all other properties */
+
+static void assemble_text (MMBaseSms *self);
+
+static GVariant *
+sms_dbus_get_property (GDBusConnection *connection,
+                       const gchar *sender,
+                       const gchar *object_path,
+                       const gchar *interface_name,
+                       const gchar *property_name,
+                       GError **error,
+                       gpointer user_data)
+{
+    MMBaseSms *self = MM_BASE_SMS (user_data);
+    GDBusInterfaceVTable *parent_vtable;
+
+    if (self->priv->text_pending && g_str_equal (property_name, "Text"))
+        assemble_text (self);
+
+    parent_vtable = G_DBUS_INTERFACE_SKELETON_CLASS (mm_base_sms_parent_class)->get_vtable (G_DBUS_INTERFACE_SKELETON (self));
+    return parent_vtable->get_property (connection, sender, object_path, interface_name, property_name, error, user_data);
+}
+
+static GDBusInterfaceVTable *
+sms_dbus_get_vtable (GDBusInterfaceSkeleton *skeleton)
+{
+    static GDBusInterfaceVTable vtable;
+
+    if (G_UNLIKELY (!vtable.get_property)) {
+        vtable = *G_DBUS_INTERFACE_SKELETON_CLASS (mm_base_sms_parent_class)->get_vtable (skeleton);
+        vtable.get_property = sms_dbus_get_property;
+    }
+    return &vtable;
+}
+
+static GVariant *
+sms_dbus_get_properties (GDBusInterfaceSkeleton *skeleton)
+{
+    MMBaseSms *self = MM_BASE_SMS (skeleton);
+
+    if (self->priv->text_pending)
+        assemble_text (self);
+
+    return G_DBUS_INTERFACE_SKELETON_CLASS (mm_base_sms_parent_class)->get_properties (skeleton);
+}
+
 /*****************************************************************************/
 
 const gchar *
@@ -1537,6 +1588,29 @@ initialize_sms (MMBaseSms *self)
                   NULL);
 }
 
+static void
+assemble_text (MMBaseSms *self)
+{
+    GString *fulltext;
+    GList *l;
+
+    /* Parts are sorted by sequence, and were already validated */
+    fulltext = g_string_new ("");
+    for (l = self->priv->parts; l; l = g_list_next (l)) {
+        const gchar *parttext;
+
+        parttext = mm_sms_part_get_text ((MMSmsPart *)l->data);
+        if (parttext)
+            g_string_append (fulltext, parttext);
+    }
+
+    self->priv->text_pending = FALSE;
+    g_object_set (self,
+                  "text", fulltext->str,
+                  NULL);
+    g_string_free (fulltext, TRUE);
+}
+
 static gboolean
 assemble_sms (MMBaseSms  *self,
               GError    **error)
@@ -1544,7 +1618,6 @@ assemble_sms (MMBaseSms  *self,
     GList      *l;
     guint       idx;
     MMSmsPart **sorted_parts;
-    GString    *fulltext;
     GByteArray *fulldata;
 
     sorted_parts = g_new0 (MMSmsPart *, self->priv->max_parts);
@@ -1584,14 +1657,14 @@ assemble_sms (MMBaseSms  *self,
         }
     }
 
-    fulltext = g_string_new ("");
     fulldata = g_byte_array_sized_new (160 * self->priv->max_parts);
 
-    /* Assemble text and data from all parts. Now 'idx' is the index of the
-     * array, so for multipart messages the real index of the part is 'idx + 1'
+    /* Assemble data from all parts, the text is assembled separately. Now
+     * 'idx' is the index of the array, so for multipart messages the real
+     * index of the part is 'idx + 1'
      */
     for (idx = 0; idx < self->priv->max_parts; idx++) {
-        const gchar *parttext;
+        gboolean hastext;
         const GByteArray *partdata;
 
         if (!sorted_parts[idx]) {
@@ -1600,32 +1673,29 @@ assemble_sms (MMBaseSms  *self,
                          MM_CORE_ERROR_FAILED,
                          "Cannot assemble SMS, missing part at index (%u)",
                          self->priv->max_parts == 1 ? idx : idx + 1);
-            g_string_free (fulltext, TRUE);
             g_byte_array_free (fulldata, TRUE);
             g_free (sorted_parts);
             return FALSE;
         }
 
         /* When the user creates the SMS, it will have either 'text' or 'data',
-         * not both. Also status report PDUs may not have neither text nor data. */
-        parttext = mm_sms_part_get_text (sorted_parts[idx]);
+         * not both. Also status report PDUs may not have neither text nor data.
+         * Text still to be decoded counts as text, as it never decodes to NULL. */
+        hastext = mm_sms_part_has_text (sorted_parts[idx]);
         partdata = mm_sms_part_get_data (sorted_parts[idx]);
 
-        if (!parttext && !partdata &&
+        if (!hastext && !partdata &&
             mm_sms_part_get_pdu_type (sorted_parts[idx]) != MM_SMS_PDU_TYPE_STATUS_REPORT) {
             g_set_error (error,
                          MM_CORE_ERROR,
                          MM_CORE_ERROR_FAILED,
                          "Cannot assemble SMS, part at index (%u) has neither text nor data",
                          self->priv->max_parts == 1 ? idx : idx + 1);
-            g_string_free (fulltext, TRUE);
             g_byte_array_free (fulldata, TRUE);
             g_free (sorted_parts);
             return FALSE;
         }
 
-        if (parttext)
-            g_string_append (fulltext, parttext);
         if (partdata)
             g_byte_array_append (fulldata, partdata->data, partdata->len);
     }
@@ -1633,9 +1703,8 @@ assemble_sms (MMBaseSms  *self,
     /* If we got all parts, we also have the first one always */
     g_assert (sorted_parts[0] != NULL);
 
-    /* If we got everything, assemble the text! */
+    /* If we got everything, assemble the data! */
     g_object_set (self,
-                  "text", fulltext->str,
                   "data", g_variant_new_from_data (G_VARIANT_TYPE ("ay"),
                                                    fulldata->data,
                                                    fulldata->len * sizeof (guint8),
@@ -1647,10 +1716,16 @@ assemble_sms (MMBaseSms  *self,
                   "delivery-report-request", mm_sms_part_get_delivery_report_request (sorted_parts[self->priv->max_parts - 1]),
                   NULL);
 
-    g_string_free (fulltext, TRUE);
     g_byte_array_unref (fulldata);
     g_free (sorted_parts);
 
+    /* Decoding and concatenating the text of the parts is delayed until
+     * it's requested, unless the SMS is already exported, as in that case
+     * clients are notified right away of the new value */
+    self->priv->text_pending = TRUE;
+    if (self->priv->path)
+        assemble_text (self);
+
     self->priv->is_assembled = TRUE;
 
     return TRUE;
@@ -2028,6 +2103,7 @@ static void
 mm_base_sms_class_init (MMBaseSmsClass *klass)
 {
     GObjectClass *object_class = G_OBJECT_CLASS (klass);
+    GDBusInterfaceSkeletonClass *skeleton_class = G_DBUS_INTERFACE_SKELETON_CLASS (klass);
 
     g_type_class_add_private (object_class, sizeof (MMBaseSmsPrivate));
 
@@ -2037,6 +2113,9 @@ mm_base_sms_class_init (MMBaseSmsClass *klass)
     object_class->finalize = finalize;
     object_class->dispose = dispose;
 
+    skeleton_class->get_vtable = sms_dbus_get_vtable;
+    skeleton_class->get_properties = sms_dbus_get_properties;
+
     klass->store = sms_store;
     klass->store_finish = sms_store_finish;
     klass->send = sms_send;
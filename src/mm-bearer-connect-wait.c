@@ -0,0 +1,306 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+#include <config.h>
+
+#include "mm-bearer-connect-wait.h"
+#include "mm-base-modem-at.h"
+#include "mm-modem-helpers.h"
+#include "mm-trace.h"
+#include "mm-log.h"
+
+/* Polls start after this time, and the interval is doubled after each one up
+ * to the max */
+#define POLL_INTERVAL_INITIAL_MS 100
+#define POLL_INTERVAL_MAX_MS     1000
+
+struct _MMBearerConnectWait {
+    gchar                          *plugin;
+    MMBearerConnectWaitType         type;
+    MMBearerConnectWaitPollFunc     poll_func;
+    MMBearerConnectWaitTimeoutFunc  timeout_func;
+    gpointer                        user_data;
+
+    gint64  start_time;
+    guint   poll_interval_ms;
+    guint   n_polls;
+    guint   poll_id;
+    guint   timeout_id;
+    gboolean done;
+};
+
+/*****************************************************************************/
+/* Per-plugin time to complete */
+
+typedef struct {
+    guint   n_success;
+    guint   n_unsolicited;
+    guint   n_failed;
+    guint   n_timed_out;
+    gint64  total_ms;
+    gint64  max_ms;
+} WaitStats;
+
+static GHashTable *wait_stats;
+
+static const gchar *
+wait_type_get_string (MMBearerConnectWaitType type)
+{
+    return (type == MM_BEARER_CONNECT_WAIT_TYPE_CONNECT ? "connect" : "disconnect");
+}
+
+static void
+wait_record (MMBearerConnectWait *wait,
+             gboolean             unsolicited,
+             gboolean             success,
+             gboolean             timed_out)
+{
+    WaitStats *stats;
+    gchar     *key;
+    gint64     elapsed_ms;
+
+    wait->done = TRUE;
+    elapsed_ms = (g_get_monotonic_time () - wait->start_time) / 1000;
+
+    if (G_UNLIKELY (!wait_stats))
+        wait_stats = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+    key = g_strdup_printf ("%s/%s", wait->plugin, wait_type_get_string (wait->type));
+    stats = g_hash_table_lookup (wait_stats, key);
+    if (!stats) {
+        stats = g_new0 (WaitStats, 1);
+        g_hash_table_insert (wait_stats, key, stats);
+    } else
+        g_free (key);
+
+    mm_trace_transaction_end (wait, "bearer", wait_type_get_string (wait->type),
+                              timed_out ? "timed out" : (success ? "ok" : "failed"));
+
+    if (timed_out) {
+        stats->n_timed_out++;
+        mm_dbg ("(%s) %s timed out after %" G_GINT64_FORMAT " ms (%u polls)",
+                wait->plugin, wait_type_get_string (wait->type), elapsed_ms, wait->n_polls);
+        return;
+    }
+
+    if (!success) {
+        stats->n_failed++;
+        mm_dbg ("(%s) %s failed after %" G_GINT64_FORMAT " ms (%u polls)",
+                wait->plugin, wait_type_get_string (wait->type), elapsed_ms, wait->n_polls);
+        return;
+    }
+
+    stats->n_success++;
+    if (unsolicited)
+        stats->n_unsolicited++;
+    stats->total_ms += elapsed_ms;
+    stats->max_ms = MAX (stats->max_ms, elapsed_ms);
+
+    mm_info ("(%s) %s completed in %" G_GINT64_FORMAT " ms (%s, %u polls); "
+             "average %" G_GINT64_FORMAT " ms, max %" G_GINT64_FORMAT " ms over %u attempts "
+             "(%u unsolicited, %u failed, %u timed out)",
+             wait->plugin, wait_type_get_string (wait->type), elapsed_ms,
+             unsolicited ? "unsolicited" : "polled", wait->n_polls,
+             stats->total_ms / stats->n_success, stats->max_ms, stats->n_success,
+             stats->n_unsolicited, stats->n_failed, stats->n_timed_out);
+}
+
+/*****************************************************************************/
+
+static void
+wait_stop (MMBearerConnectWait *wait)
+{
+    if (wait->poll_id) {
+        g_source_remove (wait->poll_id);
+        wait->poll_id = 0;
+    }
+    if (wait->timeout_id) {
+        g_source_remove (wait->timeout_id);
+        wait->timeout_id = 0;
+    }
+}
+
+static gboolean
+poll_cb (MMBearerConnectWait *wait)
+{
+    wait->poll_id = 0;
+    wait->n_polls++;
+
+    /* May complete and free the wait */
+    wait->poll_func (wait, wait->user_data);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+timeout_cb (MMBearerConnectWait *wait)
+{
+    wait->timeout_id = 0;
+    wait_stop (wait);
+    wait_record (wait, FALSE, FALSE, TRUE);
+
+    /* May free the wait */
+    wait->timeout_func (wait, wait->user_data);
+    return G_SOURCE_REMOVE;
+}
+
+void
+mm_bearer_connect_wait_schedule_poll (MMBearerConnectWait *wait)
+{
+    g_return_if_fail (wait->poll_func != NULL);
+    g_return_if_fail (wait->poll_id == 0);
+
+    if (wait->done)
+        return;
+
+    wait->poll_id = g_timeout_add (wait->poll_interval_ms, (GSourceFunc) poll_cb, wait);
+    wait->poll_interval_ms = MIN (wait->poll_interval_ms * 2, POLL_INTERVAL_MAX_MS);
+}
+
+void
+mm_bearer_connect_wait_complete (MMBearerConnectWait *wait,
+                                 gboolean             unsolicited,
+                                 gboolean             success)
+{
+    g_return_if_fail (!wait->done);
+
+    wait_stop (wait);
+    wait_record (wait, unsolicited, success, FALSE);
+}
+
+/*****************************************************************************/
+
+MMBearerConnectWait *
+mm_bearer_connect_wait_new (const gchar                    *plugin,
+                            MMBearerConnectWaitType         type,
+                            guint                           timeout_secs,
+                            MMBearerConnectWaitPollFunc     poll_func,
+                            MMBearerConnectWaitTimeoutFunc  timeout_func,
+                            gpointer                        user_data)
+{
+    MMBearerConnectWait *wait;
+
+    g_return_val_if_fail (plugin != NULL, NULL);
+    g_return_val_if_fail (timeout_func != NULL, NULL);
+
+    wait = g_slice_new0 (MMBearerConnectWait);
+    wait->plugin = g_strdup (plugin);
+    wait->type = type;
+    wait->poll_func = poll_func;
+    wait->timeout_func = timeout_func;
+    wait->user_data = user_data;
+    wait->start_time = g_get_monotonic_time ();
+    wait->poll_interval_ms = POLL_INTERVAL_INITIAL_MS;
+
+    mm_trace_transaction_begin (wait, "bearer", wait_type_get_string (type), plugin);
+
+    wait->timeout_id = g_timeout_add_seconds (timeout_secs, (GSourceFunc) timeout_cb, wait);
+
+    return wait;
+}
+
+void
+mm_bearer_connect_wait_free (MMBearerConnectWait *wait)
+{
+    g_return_if_fail (wait != NULL);
+
+    /* Freed without an outcome, e.g. when cancelled */
+    if (!wait->done) {
+        wait_stop (wait);
+        mm_trace_transaction_end (wait, "bearer", wait_type_get_string (wait->type), "aborted");
+    }
+
+    g_free (wait->plugin);
+    g_slice_free (MMBearerConnectWait, wait);
+}
+
+/*****************************************************************************/
+
+MMBearerConnectionStatus
+mm_bearer_connect_wait_query_cgact_finish (MMBaseModem   *modem,
+                                           GAsyncResult  *res,
+                                           GError       **error)
+{
+    GError *inner_error = NULL;
+    gssize  value;
+
+    value = g_task_propagate_int (G_TASK (res), &inner_error);
+    if (inner_error) {
+        g_propagate_error (error, inner_error);
+        return MM_BEARER_CONNECTION_STATUS_UNKNOWN;
+    }
+    return (MMBearerConnectionStatus) value;
+}
+
+static void
+cgact_query_ready (MMBaseModem  *modem,
+                   GAsyncResult *res,
+                   GTask        *task)
+{
+    const gchar              *response;
+    GError                   *error = NULL;
+    GList                    *pdp_active_list = NULL;
+    GList                    *l;
+    guint                     cid;
+    MMBearerConnectionStatus  status = MM_BEARER_CONNECTION_STATUS_UNKNOWN;
+
+    response = mm_base_modem_at_command_full_finish (modem, res, &error);
+    if (response)
+        pdp_active_list = mm_3gpp_parse_cgact_read_response (response, &error);
+
+    if (error) {
+        g_assert (!pdp_active_list);
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    cid = GPOINTER_TO_UINT (g_task_get_task_data (task));
+    for (l = pdp_active_list; l; l = g_list_next (l)) {
+        MM3gppPdpContextActive *pdp_active;
+
+        pdp_active = (MM3gppPdpContextActive *)(l->data);
+        if (pdp_active->cid == cid) {
+            status = (pdp_active->active ? MM_BEARER_CONNECTION_STATUS_CONNECTED : MM_BEARER_CONNECTION_STATUS_DISCONNECTED);
+            break;
+        }
+    }
+    mm_3gpp_pdp_context_active_list_free (pdp_active_list);
+
+    g_task_return_int (task, (gssize) status);
+    g_object_unref (task);
+}
+
+void
+mm_bearer_connect_wait_query_cgact (MMBaseModem         *modem,
+                                    MMPortSerialAt      *port,
+                                    guint                cid,
+                                    GAsyncReadyCallback  callback,
+                                    gpointer             user_data)
+{
+    GTask *task;
+
+    task = g_task_new (modem, NULL, callback, user_data);
+    g_task_set_task_data (task, GUINT_TO_POINTER (cid), NULL);
+
+    mm_base_modem_at_command_full (modem,
+                                   port,
+                                   "+CGACT?",
+                                   3,
+                                   FALSE, /* allow cached */
+                                   FALSE, /* raw */
+                                   NULL, /* cancellable */
+                                   (GAsyncReadyCallback) cgact_query_ready,
+                                   task);
+}
@@ -0,0 +1,82 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+#ifndef MM_BEARER_CONNECT_WAIT_H
+#define MM_BEARER_CONNECT_WAIT_H
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <ModemManager.h>
+
+#include "mm-base-modem.h"
+#include "mm-port-serial-at.h"
+
+/* Wait for the outcome of a connection or disconnection request.
+ *
+ * Plugins whose modems report the data session state with a vendor
+ * unsolicited message complete the wait as soon as that message arrives.
+ * Meanwhile, and only as a fallback, the status is polled with increasing
+ * sub-second intervals (up to 1s), and the wait times out if no outcome is
+ * known after the given time. The time to complete is logged, along with
+ * per-plugin averages. */
+
+typedef enum {
+    MM_BEARER_CONNECT_WAIT_TYPE_CONNECT,
+    MM_BEARER_CONNECT_WAIT_TYPE_DISCONNECT,
+} MMBearerConnectWaitType;
+
+typedef struct _MMBearerConnectWait MMBearerConnectWait;
+
+/* Run one status query. Once done, the plugin must either complete the wait
+ * or call mm_bearer_connect_wait_schedule_poll() again. */
+typedef void (* MMBearerConnectWaitPollFunc)    (MMBearerConnectWait *wait,
+                                                 gpointer             user_data);
+
+/* No outcome was known in time; polls are stopped already. */
+typedef void (* MMBearerConnectWaitTimeoutFunc) (MMBearerConnectWait *wait,
+                                                 gpointer             user_data);
+
+/* The timeout starts right away */
+MMBearerConnectWait *mm_bearer_connect_wait_new           (const gchar                    *plugin,
+                                                           MMBearerConnectWaitType         type,
+                                                           guint                           timeout_secs,
+                                                           MMBearerConnectWaitPollFunc     poll_func,
+                                                           MMBearerConnectWaitTimeoutFunc  timeout_func,
+                                                           gpointer                        user_data);
+void                 mm_bearer_connect_wait_free          (MMBearerConnectWait            *wait);
+
+/* Schedule the next poll; the first one should be scheduled once the
+ * connection or disconnection request is acknowledged by the modem. */
+void                 mm_bearer_connect_wait_schedule_poll (MMBearerConnectWait            *wait);
+
+/* Report the outcome, either from an unsolicited message or from a poll.
+ * Polls and timeout are stopped, but the wait must still be freed. */
+void                 mm_bearer_connect_wait_complete      (MMBearerConnectWait            *wait,
+                                                           gboolean                        unsolicited,
+                                                           gboolean                        success);
+
+/* Poll helper for modems supporting +CGACT?; gives the status of the PDP
+ * context @cid, or UNKNOWN if it isn't listed. */
+void                     mm_bearer_connect_wait_query_cgact        (MMBaseModem          *modem,
+                                                                    MMPortSerialAt       *port,
+                                                                    guint                 cid,
+                                                                    GAsyncReadyCallback   callback,
+                                                                    gpointer              user_data);
+MMBearerConnectionStatus mm_bearer_connect_wait_query_cgact_finish (MMBaseModem          *modem,
+                                                                    GAsyncResult         *res,
+                                                                    GError              **error);
+
+#endif /* MM_BEARER_CONNECT_WAIT_H */
@@ -31,6 +31,7 @@
 #include "mm-port-enums-types.h"
 #include "mm-bearer-mbim.h"
 #include "mm-log.h"
+#include "mm-trace.h"
 
 G_DEFINE_TYPE (MMBearerMbim, mm_bearer_mbim, MM_TYPE_BASE_BEARER)
 
@@ -837,6 +838,8 @@ connect_context_step (GTask *task)
     self = g_task_get_source_object (task);
     ctx = g_task_get_task_data (task);
 
+    mm_trace_step (task, "mbim-connect", ctx->step, mm_base_bearer_get_path (MM_BASE_BEARER (self)));
+
     switch (ctx->step) {
     case CONNECT_STEP_FIRST:
         /* Fall down */
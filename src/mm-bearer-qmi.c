@@ -30,8 +30,10 @@
 #include "mm-iface-modem.h"
 #include "mm-bearer-qmi.h"
 #include "mm-modem-helpers-qmi.h"
+#include "mm-qmi-indication-router.h"
 #include "mm-port-enums-types.h"
 #include "mm-log.h"
+#include "mm-trace.h"
 #include "mm-modem-helpers.h"
 
 G_DEFINE_TYPE (MMBearerQmi, mm_bearer_qmi, MM_TYPE_BASE_BEARER)
@@ -49,6 +51,8 @@ struct _MMBearerQmiPrivate {
     guint event_report_ipv6_indication_id;
 
     MMPort *data;
+    /* Port where the WDS clients are leased from */
+    MMPortQmi *qmi;
     guint32 packet_data_handle_ipv4;
     guint32 packet_data_handle_ipv6;
 };
@@ -394,21 +398,34 @@ typedef enum {
     CONNECT_STEP_FIRST,
     CONNECT_STEP_OPEN_QMI_PORT,
     CONNECT_STEP_IP_METHOD,
-    CONNECT_STEP_IPV4,
-    CONNECT_STEP_WDS_CLIENT_IPV4,
-    CONNECT_STEP_IP_FAMILY_IPV4,
-    CONNECT_STEP_ENABLE_INDICATIONS_IPV4,
-    CONNECT_STEP_START_NETWORK_IPV4,
-    CONNECT_STEP_GET_CURRENT_SETTINGS_IPV4,
-    CONNECT_STEP_IPV6,
-    CONNECT_STEP_WDS_CLIENT_IPV6,
-    CONNECT_STEP_IP_FAMILY_IPV6,
-    CONNECT_STEP_ENABLE_INDICATIONS_IPV6,
-    CONNECT_STEP_START_NETWORK_IPV6,
-    CONNECT_STEP_GET_CURRENT_SETTINGS_IPV6,
+    CONNECT_STEP_SETUP,
     CONNECT_STEP_LAST
 } ConnectStep;
 
+/* IPv4 and IPv6 are setup in parallel, each with its own WDS client */
+typedef enum {
+    CONNECT_FAMILY_STEP_FIRST,
+    CONNECT_FAMILY_STEP_WDS_CLIENT,
+    CONNECT_FAMILY_STEP_IP_FAMILY,
+    CONNECT_FAMILY_STEP_ENABLE_INDICATIONS,
+    CONNECT_FAMILY_STEP_START_NETWORK,
+    CONNECT_FAMILY_STEP_GET_CURRENT_SETTINGS,
+    CONNECT_FAMILY_STEP_LAST
+} ConnectFamilyStep;
+
+typedef struct {
+    /* Not owned, the family contexts are part of the task data */
+    GTask *task;
+    gboolean ipv6;
+    ConnectFamilyStep step;
+    QmiClientWds *client;
+    gboolean default_ip_family_set;
+    guint packet_service_status_indication_id;
+    guint event_report_indication_id;
+    guint32 packet_data_handle;
+    GError *error;
+} ConnectFamilyContext;
+
 typedef struct {
     MMBearerQmi *self;
     ConnectStep step;
@@ -419,63 +436,54 @@ typedef struct {
     gchar *apn;
     QmiWdsAuthentication auth;
     gboolean no_ip_family_preference;
-    gboolean default_ip_family_set;
+    gint64 start_time;
 
     MMBearerIpMethod ip_method;
 
     gboolean ipv4;
-    gboolean running_ipv4;
-    QmiClientWds *client_ipv4;
-    guint packet_service_status_ipv4_indication_id;
-    guint event_report_ipv4_indication_id;
-    guint32 packet_data_handle_ipv4;
+    ConnectFamilyContext family_ipv4;
     MMBearerIpConfig *ipv4_config;
-    GError *error_ipv4;
 
     gboolean ipv6;
-    gboolean running_ipv6;
-    QmiClientWds *client_ipv6;
-    guint packet_service_status_ipv6_indication_id;
-    guint event_report_ipv6_indication_id;
-    guint32 packet_data_handle_ipv6;
+    ConnectFamilyContext family_ipv6;
     MMBearerIpConfig *ipv6_config;
-    GError *error_ipv6;
+
+    /* Number of families still being setup */
+    guint n_running;
 } ConnectContext;
 
 static void
-connect_context_free (ConnectContext *ctx)
+connect_family_context_clear (ConnectContext *ctx,
+                              ConnectFamilyContext *fam)
 {
-    g_free (ctx->apn);
-    g_free (ctx->user);
-    g_free (ctx->password);
-
-    if (ctx->packet_service_status_ipv4_indication_id) {
+    if (fam->packet_service_status_indication_id) {
         common_setup_cleanup_packet_service_status_unsolicited_events (ctx->self,
-                                                                       ctx->client_ipv4,
+                                                                       fam->client,
                                                                        FALSE,
-                                                                       &ctx->packet_service_status_ipv4_indication_id);
+                                                                       &fam->packet_service_status_indication_id);
     }
-    if (ctx->event_report_ipv4_indication_id) {
+    if (fam->event_report_indication_id) {
         cleanup_event_report_unsolicited_events (ctx->self,
-                                                 ctx->client_ipv4,
-                                                 &ctx->event_report_ipv4_indication_id);
-    }
-    if (ctx->packet_service_status_ipv6_indication_id) {
-        common_setup_cleanup_packet_service_status_unsolicited_events (ctx->self,
-                                                                       ctx->client_ipv6,
-                                                                       FALSE,
-                                                                       &ctx->packet_service_status_ipv6_indication_id);
+                                                 fam->client,
+                                                 &fam->event_report_indication_id);
     }
-    if (ctx->event_report_ipv6_indication_id) {
-        cleanup_event_report_unsolicited_events (ctx->self,
-                                                 ctx->client_ipv6,
-                                                 &ctx->event_report_ipv6_indication_id);
+    g_clear_error (&fam->error);
+    if (fam->client) {
+        mm_port_qmi_release_client (ctx->qmi, QMI_CLIENT (fam->client));
+        g_clear_object (&fam->client);
     }
+}
+
+static void
+connect_context_free (ConnectContext *ctx)
+{
+    g_free (ctx->apn);
+    g_free (ctx->user);
+    g_free (ctx->password);
+
+    connect_family_context_clear (ctx, &ctx->family_ipv4);
+    connect_family_context_clear (ctx, &ctx->family_ipv6);
 
-    g_clear_error (&ctx->error_ipv4);
-    g_clear_error (&ctx->error_ipv6);
-    g_clear_object (&ctx->client_ipv4);
-    g_clear_object (&ctx->client_ipv6);
     g_clear_object (&ctx->ipv4_config);
     g_clear_object (&ctx->ipv6_config);
     g_object_unref (ctx->data);
@@ -493,20 +501,22 @@ connect_finish (MMBaseBearer *self,
 }
 
 static void connect_context_step (GTask *task);
+static void connect_family_context_step (ConnectFamilyContext *fam);
+
+static const gchar *
+connect_family_get_string (ConnectFamilyContext *fam)
+{
+    return fam->ipv6 ? "IPv6" : "IPv4";
+}
 
 static void
 start_network_ready (QmiClientWds *client,
                      GAsyncResult *res,
-                     GTask *task)
+                     ConnectFamilyContext *fam)
 {
-    ConnectContext *ctx;
     GError *error = NULL;
     QmiMessageWdsStartNetworkOutput *output;
 
-    ctx = g_task_get_task_data (task);
-    g_assert (ctx->running_ipv4 || ctx->running_ipv6);
-    g_assert (!(ctx->running_ipv4 && ctx->running_ipv6));
-
     output = qmi_client_wds_start_network_finish (client, res, &error);
     if (output &&
         !qmi_message_wds_start_network_output_get_result (output, &error)) {
@@ -520,10 +530,7 @@ start_network_ready (QmiClientWds *client,
                              QMI_PROTOCOL_ERROR_NO_EFFECT)) {
             g_error_free (error);
             error = NULL;
-            if (ctx->running_ipv4)
-                ctx->packet_data_handle_ipv4 = GLOBAL_PACKET_DATA_HANDLE;
-            else
-                ctx->packet_data_handle_ipv6 = GLOBAL_PACKET_DATA_HANDLE;
+            fam->packet_data_handle = GLOBAL_PACKET_DATA_HANDLE;
 
             /* Fall down to a successful connection */
         } else {
@@ -557,35 +564,26 @@ start_network_ready (QmiClientWds *client,
         }
     }
 
-    if (error) {
-        if (ctx->running_ipv4)
-            ctx->error_ipv4 = error;
-        else
-            ctx->error_ipv6 = error;
-    } else {
-        if (ctx->running_ipv4)
-            qmi_message_wds_start_network_output_get_packet_data_handle (output, &ctx->packet_data_handle_ipv4, NULL);
-        else
-            qmi_message_wds_start_network_output_get_packet_data_handle (output, &ctx->packet_data_handle_ipv6, NULL);
-    }
+    if (error)
+        fam->error = error;
+    else if (!fam->packet_data_handle)
+        qmi_message_wds_start_network_output_get_packet_data_handle (output, &fam->packet_data_handle, NULL);
 
     if (output)
         qmi_message_wds_start_network_output_unref (output);
 
     /* Keep on */
-    ctx->step++;
-    connect_context_step (task);
+    fam->step++;
+    connect_family_context_step (fam);
 }
 
 static QmiMessageWdsStartNetworkInput *
-build_start_network_input (ConnectContext *ctx)
+build_start_network_input (ConnectContext *ctx,
+                           ConnectFamilyContext *fam)
 {
     QmiMessageWdsStartNetworkInput *input;
     gboolean has_user, has_password;
 
-    g_assert (ctx->running_ipv4 || ctx->running_ipv6);
-    g_assert (!(ctx->running_ipv4 && ctx->running_ipv6));
-
     input = qmi_message_wds_start_network_input_new ();
 
     if (ctx->apn && ctx->apn[0])
@@ -615,10 +613,10 @@ build_start_network_input (ConnectContext *ctx)
      * TLV if we already set a default IP family preference with "WDS Set IP
      * Family" */
     if (!ctx->no_ip_family_preference &&
-        !ctx->default_ip_family_set) {
+        !fam->default_ip_family_set) {
         qmi_message_wds_start_network_input_set_ip_family_preference (
             input,
-            (ctx->running_ipv6 ? QMI_WDS_IP_FAMILY_IPV6 : QMI_WDS_IP_FAMILY_IPV4),
+            (fam->ipv6 ? QMI_WDS_IP_FAMILY_IPV6 : QMI_WDS_IP_FAMILY_IPV4),
             NULL);
     }
 
@@ -818,14 +816,13 @@ get_ipv6_config (MMBearerQmi *self,
 static void
 get_current_settings_ready (QmiClientWds *client,
                             GAsyncResult *res,
-                            GTask *task)
+                            ConnectFamilyContext *fam)
 {
     ConnectContext *ctx;
     GError *error = NULL;
     QmiMessageWdsGetCurrentSettingsOutput *output;
 
-    ctx = g_task_get_task_data (task);
-    g_assert (ctx->running_ipv4 || ctx->running_ipv6);
+    ctx = g_task_get_task_data (fam->task);
 
     output = qmi_client_wds_get_current_settings_finish (client, res, &error);
     if (!output ||
@@ -853,9 +850,9 @@ get_current_settings_ready (QmiClientWds *client,
             g_clear_error (&error);
         }
 
-        if (ip_family == QMI_WDS_IP_FAMILY_IPV4)
+        if (ip_family == QMI_WDS_IP_FAMILY_IPV4 && !ctx->ipv4_config)
             ctx->ipv4_config = get_ipv4_config (ctx->self, ctx->ip_method, output, mtu);
-        else if (ip_family == QMI_WDS_IP_FAMILY_IPV6)
+        else if (ip_family == QMI_WDS_IP_FAMILY_IPV6 && !ctx->ipv6_config)
             ctx->ipv6_config = get_ipv6_config (ctx->self, ctx->ip_method, output, mtu);
 
         /* Domain names */
@@ -880,20 +877,16 @@ get_current_settings_ready (QmiClientWds *client,
         qmi_message_wds_get_current_settings_output_unref (output);
 
     /* Keep on */
-    ctx->step++;
-    connect_context_step (task);
+    fam->step++;
+    connect_family_context_step (fam);
 }
 
 static void
-get_current_settings (GTask *task, QmiClientWds *client)
+get_current_settings (ConnectFamilyContext *fam)
 {
-    ConnectContext *ctx;
     QmiMessageWdsGetCurrentSettingsInput *input;
     QmiWdsGetCurrentSettingsRequestedSettings requested;
 
-    ctx = g_task_get_task_data (task);
-    g_assert (ctx->running_ipv4 || ctx->running_ipv6);
-
     requested = QMI_WDS_GET_CURRENT_SETTINGS_REQUESTED_SETTINGS_DNS_ADDRESS |
                 QMI_WDS_GET_CURRENT_SETTINGS_REQUESTED_SETTINGS_GRANTED_QOS |
                 QMI_WDS_GET_CURRENT_SETTINGS_REQUESTED_SETTINGS_IP_ADDRESS |
@@ -904,28 +897,23 @@ get_current_settings (GTask *task, QmiClientWds *client)
 
     input = qmi_message_wds_get_current_settings_input_new ();
     qmi_message_wds_get_current_settings_input_set_requested_settings (input, requested, NULL);
-    qmi_client_wds_get_current_settings (client,
+    qmi_client_wds_get_current_settings (fam->client,
                                          input,
                                          10,
-                                         g_task_get_cancellable (task),
+                                         g_task_get_cancellable (fam->task),
                                          (GAsyncReadyCallback)get_current_settings_ready,
-                                         task);
+                                         fam);
     qmi_message_wds_get_current_settings_input_unref (input);
 }
 
 static void
 set_ip_family_ready (QmiClientWds *client,
                      GAsyncResult *res,
-                     GTask *task)
+                     ConnectFamilyContext *fam)
 {
-    ConnectContext *ctx;
     GError *error = NULL;
     QmiMessageWdsSetIpFamilyOutput *output;
 
-    ctx = g_task_get_task_data (task);
-    g_assert (ctx->running_ipv4 || ctx->running_ipv6);
-    g_assert (!(ctx->running_ipv4 && ctx->running_ipv6));
-
     output = qmi_client_wds_set_ip_family_finish (client, res, &error);
     if (output) {
         qmi_message_wds_set_ip_family_output_get_result (output, &error);
@@ -936,59 +924,45 @@ set_ip_family_ready (QmiClientWds *client,
         /* Ensure we add the IP family preference TLV */
         mm_dbg ("Couldn't set IP family preference: '%s'", error->message);
         g_error_free (error);
-        ctx->default_ip_family_set = FALSE;
+        fam->default_ip_family_set = FALSE;
     } else {
         /* No need to add IP family preference */
-        ctx->default_ip_family_set = TRUE;
+        fam->default_ip_family_set = TRUE;
     }
 
     /* Keep on */
-    ctx->step++;
-    connect_context_step (task);
+    fam->step++;
+    connect_family_context_step (fam);
 }
 
 static void
-packet_service_status_indication_cb (QmiClientWds *client,
-                                     QmiIndicationWdsPacketServiceStatusOutput *output,
+packet_service_status_indication_cb (QmiClient *client,
+                                     const MMQmiWdsPacketServiceStatus *status,
                                      MMBearerQmi *self)
 {
-    QmiWdsConnectionStatus connection_status;
-
-    if (qmi_indication_wds_packet_service_status_output_get_connection_status (
-            output,
-            &connection_status,
-            NULL,
-            NULL)) {
-        MMBearerStatus bearer_status = mm_base_bearer_get_status (MM_BASE_BEARER (self));
-
-        if (connection_status == QMI_WDS_CONNECTION_STATUS_DISCONNECTED &&
-            bearer_status != MM_BEARER_STATUS_DISCONNECTED &&
-            bearer_status != MM_BEARER_STATUS_DISCONNECTING) {
-            QmiWdsCallEndReason cer;
-            QmiWdsVerboseCallEndReasonType verbose_cer_type;
-            gint16 verbose_cer_reason;
-
-            if (qmi_indication_wds_packet_service_status_output_get_call_end_reason (
-                    output,
-                    &cer,
-                    NULL))
-                mm_info ("bearer call end reason (%u): '%s'",
-                         cer,
-                         qmi_wds_call_end_reason_get_string (cer));
-
-            if (qmi_indication_wds_packet_service_status_output_get_verbose_call_end_reason (
-                    output,
-                    &verbose_cer_type,
-                    &verbose_cer_reason,
-                    NULL))
-                mm_info ("bearer verbose call end reason (%u,%d): [%s] %s",
-                         verbose_cer_type,
-                         verbose_cer_reason,
-                         qmi_wds_verbose_call_end_reason_type_get_string (verbose_cer_type),
-                         qmi_wds_verbose_call_end_reason_get_string (verbose_cer_type, verbose_cer_reason));
-
-            mm_base_bearer_report_connection_status (MM_BASE_BEARER (self), MM_BEARER_CONNECTION_STATUS_DISCONNECTED);
-        }
+    MMBearerStatus bearer_status;
+
+    /* Already parsed once by the indication router for all the bearers
+     * sharing the client */
+    bearer_status = mm_base_bearer_get_status (MM_BASE_BEARER (self));
+
+    if (status->connection_status == QMI_WDS_CONNECTION_STATUS_DISCONNECTED &&
+        bearer_status != MM_BEARER_STATUS_DISCONNECTED &&
+        bearer_status != MM_BEARER_STATUS_DISCONNECTING) {
+        if (status->has_call_end_reason)
+            mm_info ("bearer call end reason (%u): '%s'",
+                     status->call_end_reason,
+                     qmi_wds_call_end_reason_get_string (status->call_end_reason));
+
+        if (status->has_verbose_call_end_reason)
+            mm_info ("bearer verbose call end reason (%u,%d): [%s] %s",
+                     status->verbose_call_end_reason_type,
+                     status->verbose_call_end_reason,
+                     qmi_wds_verbose_call_end_reason_type_get_string (status->verbose_call_end_reason_type),
+                     qmi_wds_verbose_call_end_reason_get_string (status->verbose_call_end_reason_type,
+                                                                 status->verbose_call_end_reason));
+
+        mm_base_bearer_report_connection_status (MM_BASE_BEARER (self), MM_BEARER_CONNECTION_STATUS_DISCONNECTED);
     }
 }
 
@@ -1005,12 +979,12 @@ common_setup_cleanup_packet_service_status_unsolicited_events (MMBearerQmi *self
     if (enable) {
         g_assert (*indication_id == 0);
         *indication_id =
-            g_signal_connect (client,
-                              "packet-service-status",
-                              G_CALLBACK (packet_service_status_indication_cb),
-                              self);
+            mm_qmi_indication_router_subscribe (QMI_CLIENT (client),
+                                                MM_QMI_INDICATION_WDS_PACKET_SERVICE_STATUS,
+                                                (MMQmiIndicationCallback)packet_service_status_indication_cb,
+                                                self);
     } else if (*indication_id != 0) {
-        g_signal_handler_disconnect (client, *indication_id);
+        mm_qmi_indication_router_unsubscribe (QMI_CLIENT (client), *indication_id);
         *indication_id = 0;
     }
 }
@@ -1047,45 +1021,24 @@ connect_enable_indications_ready (QmiClientWds *client,
 }
 
 static void
-connect_enable_indications_ipv4_ready (QmiClientWds *client,
-                                       GAsyncResult *res,
-                                       GTask *task)
-{
-    ConnectContext *ctx;
-
-    ctx = g_task_get_task_data (task);
-    g_assert (ctx->event_report_ipv4_indication_id == 0);
-
-    ctx->event_report_ipv4_indication_id =
-        connect_enable_indications_ready (client, res, ctx->self, &ctx->error_ipv4);
-
-    if (!ctx->event_report_ipv4_indication_id)
-        ctx->step = CONNECT_STEP_LAST;
-    else
-        ctx->step++;
-
-    connect_context_step (task);
-}
-
-static void
-connect_enable_indications_ipv6_ready (QmiClientWds *client,
-                                       GAsyncResult *res,
-                                       GTask *task)
+connect_enable_indications_family_ready (QmiClientWds *client,
+                                         GAsyncResult *res,
+                                         ConnectFamilyContext *fam)
 {
     ConnectContext *ctx;
 
-    ctx = g_task_get_task_data (task);
-    g_assert (ctx->event_report_ipv6_indication_id == 0);
+    ctx = g_task_get_task_data (fam->task);
+    g_assert (fam->event_report_indication_id == 0);
 
-    ctx->event_report_ipv6_indication_id =
-        connect_enable_indications_ready (client, res, ctx->self, &ctx->error_ipv6);
+    fam->event_report_indication_id =
+        connect_enable_indications_ready (client, res, ctx->self, &fam->error);
 
-    if (!ctx->event_report_ipv6_indication_id)
-        ctx->step = CONNECT_STEP_LAST;
+    if (!fam->event_report_indication_id)
+        fam->step = CONNECT_FAMILY_STEP_LAST;
     else
-        ctx->step++;
+        fam->step++;
 
-    connect_context_step (task);
+    connect_family_context_step (fam);
 }
 
 static QmiMessageWdsSetEventReportInput *
@@ -1150,35 +1103,24 @@ cleanup_event_report_unsolicited_events (MMBearerQmi *self,
 }
 
 static void
-qmi_port_allocate_client_ready (MMPortQmi *qmi,
-                                GAsyncResult *res,
-                                GTask *task)
+qmi_port_acquire_client_ready (MMPortQmi *qmi,
+                               GAsyncResult *res,
+                               ConnectFamilyContext *fam)
 {
-    ConnectContext *ctx;
-    GError *error = NULL;
+    QmiClient *client;
 
-    ctx = g_task_get_task_data (task);
-    g_assert (ctx->running_ipv4 || ctx->running_ipv6);
-    g_assert (!(ctx->running_ipv4 && ctx->running_ipv6));
-
-    if (!mm_port_qmi_allocate_client_finish (qmi, res, &error)) {
-        g_task_return_error (task, error);
-        g_object_unref (task);
+    client = mm_port_qmi_acquire_client_finish (qmi, res, &fam->error);
+    if (!client) {
+        fam->step = CONNECT_FAMILY_STEP_LAST;
+        connect_family_context_step (fam);
         return;
     }
 
-    if (ctx->running_ipv4)
-        ctx->client_ipv4 = QMI_CLIENT_WDS (mm_port_qmi_get_client (qmi,
-                                                                   QMI_SERVICE_WDS,
-                                                                   MM_PORT_QMI_FLAG_WDS_IPV4));
-    else
-        ctx->client_ipv6 = QMI_CLIENT_WDS (mm_port_qmi_get_client (qmi,
-                                                                   QMI_SERVICE_WDS,
-                                                                   MM_PORT_QMI_FLAG_WDS_IPV6));
+    fam->client = QMI_CLIENT_WDS (client);
 
     /* Keep on */
-    ctx->step++;
-    connect_context_step (task);
+    fam->step++;
+    connect_family_context_step (fam);
 }
 
 static void
@@ -1202,286 +1144,227 @@ qmi_port_open_ready (MMPortQmi *qmi,
 }
 
 static void
-connect_context_step (GTask *task)
+connect_family_context_step (ConnectFamilyContext *fam)
 {
     ConnectContext *ctx;
     GCancellable *cancellable;
 
-    /* If cancelled, complete */
-    if (g_task_return_error_if_cancelled (task)) {
-        g_object_unref (task);
-        return;
-    }
-
-    ctx = g_task_get_task_data (task);
-    cancellable = g_task_get_cancellable (task);
-
-    switch (ctx->step) {
-    case CONNECT_STEP_FIRST:
-
-        g_assert (ctx->ipv4 || ctx->ipv6);
-
-        /* Fall down */
-        ctx->step++;
-
-    case CONNECT_STEP_OPEN_QMI_PORT:
-        if (!mm_port_qmi_is_open (ctx->qmi)) {
-            mm_port_qmi_open (ctx->qmi,
-                              TRUE,
-                              cancellable,
-                              (GAsyncReadyCallback)qmi_port_open_ready,
-                              task);
-            return;
-        }
-
-        /* If already open, just fall down */
-        ctx->step++;
-
-    case CONNECT_STEP_IP_METHOD:
-        /* Once the QMI port is open, we decide the IP method we're going
-         * to request. If the LLP is raw-ip, we force Static IP, because not
-         * all DHCP clients support the raw-ip interfaces; otherwise default
-         * to DHCP as always. */
-        if (mm_port_qmi_llp_is_raw_ip (ctx->qmi))
-            ctx->ip_method = MM_BEARER_IP_METHOD_STATIC;
-        else
-            ctx->ip_method = MM_BEARER_IP_METHOD_DHCP;
-
-        mm_dbg ("Defaulting to use %s IP method", mm_bearer_ip_method_get_string (ctx->ip_method));
-
-        /* Just fall down */
-        ctx->step++;
+    ctx = g_task_get_task_data (fam->task);
+    cancellable = g_task_get_cancellable (fam->task);
 
-    case CONNECT_STEP_IPV4:
-        /* If no IPv4 setup needed, jump to IPv6 */
-        if (!ctx->ipv4) {
-            ctx->step = CONNECT_STEP_IPV6;
-            connect_context_step (task);
-            return;
-        }
+    /* If cancelled, stop; the task is completed once all families are done */
+    if (fam->step < CONNECT_FAMILY_STEP_LAST && g_cancellable_is_cancelled (cancellable))
+        fam->step = CONNECT_FAMILY_STEP_LAST;
 
-        /* Start IPv4 setup */
-        mm_dbg ("Running IPv4 connection setup");
-        ctx->running_ipv4 = TRUE;
-        ctx->running_ipv6 = FALSE;
+    switch (fam->step) {
+    case CONNECT_FAMILY_STEP_FIRST:
+        mm_dbg ("Running %s connection setup", connect_family_get_string (fam));
+        mm_trace_transaction_begin (fam, "qmi",
+                                    fam->ipv6 ? "connect-ipv6" : "connect-ipv4",
+                                    mm_base_bearer_get_path (MM_BASE_BEARER (ctx->self)));
         /* Just fall down */
-        ctx->step++;
-
-    case CONNECT_STEP_WDS_CLIENT_IPV4: {
-        QmiClient *client;
-
-        client = mm_port_qmi_get_client (ctx->qmi,
-                                         QMI_SERVICE_WDS,
-                                         MM_PORT_QMI_FLAG_WDS_IPV4);
-        if (!client) {
-            mm_dbg ("Allocating IPv4-specific WDS client");
-            mm_port_qmi_allocate_client (ctx->qmi,
-                                         QMI_SERVICE_WDS,
-                                         MM_PORT_QMI_FLAG_WDS_IPV4,
-                                         cancellable,
-                                         (GAsyncReadyCallback)qmi_port_allocate_client_ready,
-                                         task);
-            return;
-        }
+        fam->step++;
+
+    case CONNECT_FAMILY_STEP_WDS_CLIENT:
+        /* Leased from the port pool, so that it is reused on reconnections */
+        mm_dbg ("Acquiring %s-specific WDS client", connect_family_get_string (fam));
+        mm_port_qmi_acquire_client (ctx->qmi,
+                                    QMI_SERVICE_WDS,
+                                    fam->ipv6 ? MM_PORT_QMI_FLAG_WDS_IPV6 : MM_PORT_QMI_FLAG_WDS_IPV4,
+                                    cancellable,
+                                    (GAsyncReadyCallback)qmi_port_acquire_client_ready,
+                                    fam);
+        return;
 
-        ctx->client_ipv4 = QMI_CLIENT_WDS (client);
-        /* Just fall down */
-        ctx->step++;
-    }
+    case CONNECT_FAMILY_STEP_IP_FAMILY:
+        if (fam->ipv6)
+            g_assert (ctx->no_ip_family_preference == FALSE);
 
-    case CONNECT_STEP_IP_FAMILY_IPV4:
         /* If client is new enough, select IP family */
         if (!ctx->no_ip_family_preference &&
-            qmi_client_check_version (QMI_CLIENT (ctx->client_ipv4), 1, 9)) {
+            qmi_client_check_version (QMI_CLIENT (fam->client), 1, 9)) {
             QmiMessageWdsSetIpFamilyInput *input;
 
-            mm_dbg ("Setting default IP family to: IPv4");
+            mm_dbg ("Setting default IP family to: %s", connect_family_get_string (fam));
             input = qmi_message_wds_set_ip_family_input_new ();
-            qmi_message_wds_set_ip_family_input_set_preference (input, QMI_WDS_IP_FAMILY_IPV4, NULL);
-            qmi_client_wds_set_ip_family (ctx->client_ipv4,
+            qmi_message_wds_set_ip_family_input_set_preference (input,
+                                                                fam->ipv6 ? QMI_WDS_IP_FAMILY_IPV6 : QMI_WDS_IP_FAMILY_IPV4,
+                                                                NULL);
+            qmi_client_wds_set_ip_family (fam->client,
                                           input,
                                           10,
                                           cancellable,
                                           (GAsyncReadyCallback)set_ip_family_ready,
-                                          task);
+                                          fam);
             qmi_message_wds_set_ip_family_input_unref (input);
             return;
         }
 
-        ctx->default_ip_family_set = FALSE;
+        fam->default_ip_family_set = FALSE;
 
         /* Just fall down */
-        ctx->step++;
+        fam->step++;
 
-    case CONNECT_STEP_ENABLE_INDICATIONS_IPV4:
+    case CONNECT_FAMILY_STEP_ENABLE_INDICATIONS:
         common_setup_cleanup_packet_service_status_unsolicited_events (ctx->self,
-                                                                       ctx->client_ipv4,
+                                                                       fam->client,
                                                                        TRUE,
-                                                                       &ctx->packet_service_status_ipv4_indication_id);
+                                                                       &fam->packet_service_status_indication_id);
         setup_event_report_unsolicited_events (ctx->self,
-                                               ctx->client_ipv4,
+                                               fam->client,
                                                cancellable,
-                                               (GAsyncReadyCallback) connect_enable_indications_ipv4_ready,
-                                               task);
+                                               (GAsyncReadyCallback) connect_enable_indications_family_ready,
+                                               fam);
         return;
 
-    case CONNECT_STEP_START_NETWORK_IPV4: {
+    case CONNECT_FAMILY_STEP_START_NETWORK: {
         QmiMessageWdsStartNetworkInput *input;
 
-        mm_dbg ("Starting IPv4 connection...");
-        input = build_start_network_input (ctx);
-        qmi_client_wds_start_network (ctx->client_ipv4,
+        mm_dbg ("Starting %s connection...", connect_family_get_string (fam));
+        input = build_start_network_input (ctx, fam);
+        qmi_client_wds_start_network (fam->client,
                                       input,
                                       45,
                                       cancellable,
                                       (GAsyncReadyCallback)start_network_ready,
-                                      task);
+                                      fam);
         qmi_message_wds_start_network_input_unref (input);
         return;
     }
 
-    case CONNECT_STEP_GET_CURRENT_SETTINGS_IPV4: {
+    case CONNECT_FAMILY_STEP_GET_CURRENT_SETTINGS:
         /* Retrieve and print IP configuration */
-        if (ctx->packet_data_handle_ipv4) {
-            mm_dbg ("Getting IPv4 configuration...");
-            get_current_settings (task, ctx->client_ipv4);
+        if (fam->packet_data_handle) {
+            mm_dbg ("Getting %s configuration...", connect_family_get_string (fam));
+            get_current_settings (fam);
             return;
         }
         /* Fall through */
-        ctx->step++;
-    }
+        fam->step++;
 
-    case CONNECT_STEP_IPV6:
-        /* If no IPv6 setup needed, jump to last */
-        if (!ctx->ipv6) {
-            ctx->step = CONNECT_STEP_LAST;
-            connect_context_step (task);
-            return;
-        }
-
-        /* Start IPv6 setup */
-        mm_dbg ("Running IPv6 connection setup");
-        ctx->running_ipv4 = FALSE;
-        ctx->running_ipv6 = TRUE;
-        /* Just fall down */
-        ctx->step++;
+    case CONNECT_FAMILY_STEP_LAST:
+        mm_trace_transaction_end (fam, "qmi",
+                                  fam->ipv6 ? "connect-ipv6" : "connect-ipv4",
+                                  fam->packet_data_handle ? "ok" : (fam->error ? fam->error->message : "cancelled"));
 
-    case CONNECT_STEP_WDS_CLIENT_IPV6: {
-        QmiClient *client;
-
-        client = mm_port_qmi_get_client (ctx->qmi,
-                                         QMI_SERVICE_WDS,
-                                         MM_PORT_QMI_FLAG_WDS_IPV6);
-        if (!client) {
-            mm_dbg ("Allocating IPv6-specific WDS client");
-            mm_port_qmi_allocate_client (ctx->qmi,
-                                         QMI_SERVICE_WDS,
-                                         MM_PORT_QMI_FLAG_WDS_IPV6,
-                                         cancellable,
-                                         (GAsyncReadyCallback)qmi_port_allocate_client_ready,
-                                         task);
-            return;
+        /* Once the last family is done, keep on with the connection */
+        g_assert (ctx->n_running > 0);
+        if (--ctx->n_running == 0) {
+            ctx->step++;
+            connect_context_step (fam->task);
         }
+        return;
+    }
+}
 
-        ctx->client_ipv6 = QMI_CLIENT_WDS (client);
-        /* Just fall down */
-        ctx->step++;
+static void
+connect_context_step (GTask *task)
+{
+    ConnectContext *ctx;
+    GCancellable *cancellable;
+
+    /* If cancelled, complete */
+    if (g_task_return_error_if_cancelled (task)) {
+        g_object_unref (task);
+        return;
     }
 
-    case CONNECT_STEP_IP_FAMILY_IPV6:
+    ctx = g_task_get_task_data (task);
+    cancellable = g_task_get_cancellable (task);
 
-        g_assert (ctx->no_ip_family_preference == FALSE);
+    mm_trace_step (task, "qmi-connect", ctx->step, mm_base_bearer_get_path (MM_BASE_BEARER (g_task_get_source_object (task))));
 
-        /* If client is new enough, select IP family */
-        if (qmi_client_check_version (QMI_CLIENT (ctx->client_ipv6), 1, 9)) {
-            QmiMessageWdsSetIpFamilyInput *input;
+    switch (ctx->step) {
+    case CONNECT_STEP_FIRST:
 
-            mm_dbg ("Setting default IP family to: IPv6");
-            input = qmi_message_wds_set_ip_family_input_new ();
-            qmi_message_wds_set_ip_family_input_set_preference (input, QMI_WDS_IP_FAMILY_IPV6, NULL);
-            qmi_client_wds_set_ip_family (ctx->client_ipv6,
-                                          input,
-                                          10,
-                                          cancellable,
-                                          (GAsyncReadyCallback)set_ip_family_ready,
-                                          task);
-            qmi_message_wds_set_ip_family_input_unref (input);
+        g_assert (ctx->ipv4 || ctx->ipv6);
+
+        /* Fall down */
+        ctx->step++;
+
+    case CONNECT_STEP_OPEN_QMI_PORT:
+        if (!mm_port_qmi_is_open (ctx->qmi)) {
+            mm_port_qmi_open (ctx->qmi,
+                              TRUE,
+                              cancellable,
+                              (GAsyncReadyCallback)qmi_port_open_ready,
+                              task);
             return;
         }
 
-        ctx->default_ip_family_set = FALSE;
-
-        /* Just fall down */
+        /* If already open, just fall down */
         ctx->step++;
 
-    case CONNECT_STEP_ENABLE_INDICATIONS_IPV6:
-        common_setup_cleanup_packet_service_status_unsolicited_events (ctx->self,
-                                                                       ctx->client_ipv6,
-                                                                       TRUE,
-                                                                       &ctx->packet_service_status_ipv6_indication_id);
-        setup_event_report_unsolicited_events (ctx->self,
-                                               ctx->client_ipv6,
-                                               cancellable,
-                                               (GAsyncReadyCallback) connect_enable_indications_ipv6_ready,
-                                               task);
-        return;
-
-    case CONNECT_STEP_START_NETWORK_IPV6: {
-        QmiMessageWdsStartNetworkInput *input;
+    case CONNECT_STEP_IP_METHOD:
+        /* Once the QMI port is open, we decide the IP method we're going
+         * to request. If the LLP is raw-ip, we force Static IP, because not
+         * all DHCP clients support the raw-ip interfaces; otherwise default
+         * to DHCP as always. */
+        if (mm_port_qmi_llp_is_raw_ip (ctx->qmi))
+            ctx->ip_method = MM_BEARER_IP_METHOD_STATIC;
+        else
+            ctx->ip_method = MM_BEARER_IP_METHOD_DHCP;
 
-        mm_dbg ("Starting IPv6 connection...");
-        input = build_start_network_input (ctx);
-        qmi_client_wds_start_network (ctx->client_ipv6,
-                                      input,
-                                      45,
-                                      cancellable,
-                                      (GAsyncReadyCallback)start_network_ready,
-                                      task);
-        qmi_message_wds_start_network_input_unref (input);
-        return;
-    }
+        mm_dbg ("Defaulting to use %s IP method", mm_bearer_ip_method_get_string (ctx->ip_method));
 
-    case CONNECT_STEP_GET_CURRENT_SETTINGS_IPV6: {
-        /* Retrieve and print IP configuration */
-        if (ctx->packet_data_handle_ipv6) {
-            mm_dbg ("Getting IPv6 configuration...");
-            get_current_settings (task, ctx->client_ipv6);
-            return;
-        }
-        /* Fall through */
+        /* Just fall down */
         ctx->step++;
+
+    case CONNECT_STEP_SETUP: {
+        ConnectFamilyContext *family_ipv4 = &ctx->family_ipv4;
+        ConnectFamilyContext *family_ipv6 = &ctx->family_ipv6;
+        gboolean ipv4 = ctx->ipv4;
+        gboolean ipv6 = ctx->ipv6;
+
+        /* IPv4 and IPv6 setups are independent, so run them in parallel.
+         * The context may be gone as soon as the last one is done. */
+        g_assert (ctx->n_running == 0);
+        ctx->n_running = (ipv4 ? 1 : 0) + (ipv6 ? 1 : 0);
+        if (ipv4)
+            connect_family_context_step (family_ipv4);
+        if (ipv6)
+            connect_family_context_step (family_ipv6);
+        return;
     }
 
     case CONNECT_STEP_LAST:
+        mm_dbg ("QMI connection setup finished in %" G_GINT64_FORMAT " ms",
+                (g_get_monotonic_time () - ctx->start_time) / 1000);
+
         /* If one of IPv4 or IPv6 succeeds, we're connected */
-        if (ctx->packet_data_handle_ipv4 || ctx->packet_data_handle_ipv6) {
+        if (ctx->family_ipv4.packet_data_handle || ctx->family_ipv6.packet_data_handle) {
             /* Port is connected; update the state */
             mm_port_set_connected (MM_PORT (ctx->data), TRUE);
 
             /* Keep connection related data */
             g_assert (ctx->self->priv->data == NULL);
             ctx->self->priv->data = g_object_ref (ctx->data);
+            g_assert (ctx->self->priv->qmi == NULL);
+            ctx->self->priv->qmi = g_object_ref (ctx->qmi);
 
             g_assert (ctx->self->priv->packet_data_handle_ipv4 == 0);
             g_assert (ctx->self->priv->client_ipv4 == NULL);
-            if (ctx->packet_data_handle_ipv4) {
-                ctx->self->priv->packet_data_handle_ipv4 = ctx->packet_data_handle_ipv4;
-                ctx->self->priv->packet_service_status_ipv4_indication_id = ctx->packet_service_status_ipv4_indication_id;
-                ctx->packet_service_status_ipv4_indication_id = 0;
-                ctx->self->priv->event_report_ipv4_indication_id = ctx->event_report_ipv4_indication_id;
-                ctx->event_report_ipv4_indication_id = 0;
-                ctx->self->priv->client_ipv4 = g_object_ref (ctx->client_ipv4);
+            if (ctx->family_ipv4.packet_data_handle) {
+                ctx->self->priv->packet_data_handle_ipv4 = ctx->family_ipv4.packet_data_handle;
+                ctx->self->priv->packet_service_status_ipv4_indication_id = ctx->family_ipv4.packet_service_status_indication_id;
+                ctx->family_ipv4.packet_service_status_indication_id = 0;
+                ctx->self->priv->event_report_ipv4_indication_id = ctx->family_ipv4.event_report_indication_id;
+                ctx->family_ipv4.event_report_indication_id = 0;
+                /* The client lease is kept while connected */
+                ctx->self->priv->client_ipv4 = ctx->family_ipv4.client;
+                ctx->family_ipv4.client = NULL;
             }
 
             g_assert (ctx->self->priv->packet_data_handle_ipv6 == 0);
             g_assert (ctx->self->priv->client_ipv6 == NULL);
-            if (ctx->packet_data_handle_ipv6) {
-                ctx->self->priv->packet_data_handle_ipv6 = ctx->packet_data_handle_ipv6;
-                ctx->self->priv->packet_service_status_ipv6_indication_id = ctx->packet_service_status_ipv6_indication_id;
-                ctx->packet_service_status_ipv6_indication_id = 0;
-                ctx->self->priv->event_report_ipv6_indication_id = ctx->event_report_ipv6_indication_id;
-                ctx->event_report_ipv6_indication_id = 0;
-                ctx->self->priv->client_ipv6 = g_object_ref (ctx->client_ipv6);
+            if (ctx->family_ipv6.packet_data_handle) {
+                ctx->self->priv->packet_data_handle_ipv6 = ctx->family_ipv6.packet_data_handle;
+                ctx->self->priv->packet_service_status_ipv6_indication_id = ctx->family_ipv6.packet_service_status_indication_id;
+                ctx->family_ipv6.packet_service_status_indication_id = 0;
+                ctx->self->priv->event_report_ipv6_indication_id = ctx->family_ipv6.event_report_indication_id;
+                ctx->family_ipv6.event_report_indication_id = 0;
+                ctx->self->priv->client_ipv6 = ctx->family_ipv6.client;
+                ctx->family_ipv6.client = NULL;
             }
 
             /* Set operation result */
@@ -1493,12 +1376,12 @@ connect_context_step (GTask *task)
             GError *error;
 
             /* No connection, set error. If both set, IPv4 error preferred */
-            if (ctx->error_ipv4) {
-                error = ctx->error_ipv4;
-                ctx->error_ipv4 = NULL;
+            if (ctx->family_ipv4.error) {
+                error = ctx->family_ipv4.error;
+                ctx->family_ipv4.error = NULL;
             } else {
-                error = ctx->error_ipv6;
-                ctx->error_ipv6 = NULL;
+                error = ctx->family_ipv6.error;
+                ctx->family_ipv6.error = NULL;
             }
 
             g_task_return_error (task, error);
@@ -1603,6 +1486,7 @@ _connect (MMBaseBearer *self,
     ctx->data = data;
     ctx->step = CONNECT_STEP_FIRST;
     ctx->ip_method = MM_BEARER_IP_METHOD_UNKNOWN;
+    ctx->start_time = g_get_monotonic_time ();
 
     g_object_get (self,
                   MM_BASE_BEARER_CONFIG, &properties,
@@ -1610,6 +1494,9 @@ _connect (MMBaseBearer *self,
 
     task = g_task_new (self, cancellable, callback, user_data);
     g_task_set_task_data (task, ctx, (GDestroyNotify)connect_context_free);
+    ctx->family_ipv4.task = task;
+    ctx->family_ipv6.task = task;
+    ctx->family_ipv6.ipv6 = TRUE;
 
     if (properties) {
         MMBearerAllowedAuth auth;
@@ -1733,6 +1620,17 @@ disconnect_finish (MMBaseBearer *self,
     return g_task_propagate_boolean (G_TASK (res), error);
 }
 
+static void
+release_client (MMBearerQmi *self,
+                QmiClientWds **client)
+{
+    if (!*client)
+        return;
+
+    mm_port_qmi_release_client (self->priv->qmi, QMI_CLIENT (*client));
+    g_clear_object (client);
+}
+
 static void
 reset_bearer_connection (MMBearerQmi *self,
                          gboolean reset_ipv4,
@@ -1751,7 +1649,7 @@ reset_bearer_connection (MMBearerQmi *self,
                                                          &self->priv->event_report_ipv4_indication_id);
         }
         self->priv->packet_data_handle_ipv4 = 0;
-        g_clear_object (&self->priv->client_ipv4);
+        release_client (self, &self->priv->client_ipv4);
     }
 
     if (reset_ipv6) {
@@ -1767,7 +1665,7 @@ reset_bearer_connection (MMBearerQmi *self,
                                                          &self->priv->event_report_ipv6_indication_id);
         }
         self->priv->packet_data_handle_ipv6 = 0;
-        g_clear_object (&self->priv->client_ipv6);
+        release_client (self, &self->priv->client_ipv6);
     }
 
     if (!self->priv->packet_data_handle_ipv4 &&
@@ -1777,6 +1675,7 @@ reset_bearer_connection (MMBearerQmi *self,
             mm_port_set_connected (self->priv->data, FALSE);
             g_clear_object (&self->priv->data);
         }
+        g_clear_object (&self->priv->qmi);
     }
 }
 
@@ -2035,8 +1934,9 @@ dispose (GObject *object)
     }
 
     g_clear_object (&self->priv->data);
-    g_clear_object (&self->priv->client_ipv4);
-    g_clear_object (&self->priv->client_ipv6);
+    release_client (self, &self->priv->client_ipv4);
+    release_client (self, &self->priv->client_ipv6);
+    g_clear_object (&self->priv->qmi);
 
     G_OBJECT_CLASS (mm_bearer_qmi_parent_class)->dispose (object);
 }
@@ -33,6 +33,7 @@
 #include "mm-iface-modem-cdma.h"
 #include "mm-base-modem-at.h"
 #include "mm-log.h"
+#include "mm-trace.h"
 #include "mm-modem-helpers.h"
 #include "mm-port-enums-types.h"
 #include "mm-helper-enums-types.h"
@@ -2121,6 +2122,8 @@ interface_initialization_step (GTask *task)
     self = g_task_get_source_object (task);
     ctx = g_task_get_task_data (task);
 
+    mm_trace_step (task, "bearer-initialization", ctx->step, mm_base_modem_get_device (ctx->modem));
+
     switch (ctx->step) {
     case INITIALIZATION_STEP_FIRST:
         /* Fall down to next step */
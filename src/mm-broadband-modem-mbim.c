@@ -86,6 +86,32 @@ typedef enum {
     PROCESS_NOTIFICATION_FLAG_LTE_ATTACH_STATUS    = 1 << 8,
 } ProcessNotificationFlag;
 
+/* Notifications reporting the same state as the last one are skipped, unless
+ * the last one was accepted long ago, so that e.g. the signal quality doesn't
+ * expire */
+#define NOTIFICATION_REFRESH_TIMEOUT_SECS 30
+/* Bursts of the most frequent notifications are coalesced, and only the last
+ * one received within this window is processed */
+#define NOTIFICATION_COALESCE_TIMEOUT_MS 100
+
+typedef enum {
+    NOTIFICATION_CACHE_REGISTER_STATE,
+    NOTIFICATION_CACHE_PACKET_SERVICE,
+    NOTIFICATION_CACHE_SIGNAL_STATE,
+    NOTIFICATION_CACHE_SUBSCRIBER_READY_STATUS,
+    NOTIFICATION_CACHE_PCO,
+    NOTIFICATION_CACHE_LTE_ATTACH_STATUS,
+    NOTIFICATION_CACHE_LAST
+} NotificationCache;
+
+typedef struct {
+    /* Information buffer of the last accepted notification */
+    GByteArray  *last;
+    gint64       last_time;
+    /* Coalesced notification waiting to be processed */
+    MbimMessage *pending;
+} NotificationCacheEntry;
+
 struct _MMBroadbandModemMbimPrivate {
     /* Queried and cached capabilities */
     MbimCellularClass caps_cellular_class;
@@ -108,6 +134,13 @@ struct _MMBroadbandModemMbimPrivate {
     ProcessNotificationFlag setup_flags;
     ProcessNotificationFlag enable_flags;
 
+    /* Skip unchanged and coalesce burst notifications */
+    NotificationCacheEntry notification_cache[NOTIFICATION_CACHE_LAST];
+    guint notification_coalesce_id;
+    guint n_notifications_received;
+    guint n_notifications_unchanged;
+    guint n_notifications_coalesced;
+
     GList *pco_list;
 
     /* 3GPP registration helpers */
@@ -3261,19 +3294,10 @@ ussd_notification (MMBroadbandModemMbim *self,
 }
 
 static void
-device_notification_cb (MbimDevice *device,
-                        MbimMessage *notification,
-                        MMBroadbandModemMbim *self)
+process_notification (MMBroadbandModemMbim *self,
+                      MbimMessage          *notification)
 {
-    MbimService service;
-
-    service = mbim_message_indicate_status_get_service (notification);
-    mm_dbg ("Received notification (service '%s', command '%s')",
-            mbim_service_get_string (service),
-            mbim_cid_get_printable (service,
-                                    mbim_message_indicate_status_get_cid (notification)));
-
-    switch (service) {
+    switch (mbim_message_indicate_status_get_service (notification)) {
     case MBIM_SERVICE_BASIC_CONNECT:
         basic_connect_notification (self, notification);
         break;
@@ -3292,6 +3316,161 @@ device_notification_cb (MbimDevice *device,
     }
 }
 
+static NotificationCache
+notification_get_cache (MbimMessage *notification)
+{
+    guint32 cid;
+
+    cid = mbim_message_indicate_status_get_cid (notification);
+
+    switch (mbim_message_indicate_status_get_service (notification)) {
+    case MBIM_SERVICE_BASIC_CONNECT:
+        switch (cid) {
+        case MBIM_CID_BASIC_CONNECT_REGISTER_STATE:
+            return NOTIFICATION_CACHE_REGISTER_STATE;
+        case MBIM_CID_BASIC_CONNECT_PACKET_SERVICE:
+            return NOTIFICATION_CACHE_PACKET_SERVICE;
+        case MBIM_CID_BASIC_CONNECT_SIGNAL_STATE:
+            return NOTIFICATION_CACHE_SIGNAL_STATE;
+        case MBIM_CID_BASIC_CONNECT_SUBSCRIBER_READY_STATUS:
+            return NOTIFICATION_CACHE_SUBSCRIBER_READY_STATUS;
+        default:
+            break;
+        }
+        break;
+    case MBIM_SERVICE_MS_BASIC_CONNECT_EXTENSIONS:
+        switch (cid) {
+        case MBIM_CID_MS_BASIC_CONNECT_EXTENSIONS_PCO:
+            return NOTIFICATION_CACHE_PCO;
+        case MBIM_CID_MS_BASIC_CONNECT_EXTENSIONS_LTE_ATTACH_STATUS:
+            return NOTIFICATION_CACHE_LTE_ATTACH_STATUS;
+        default:
+            break;
+        }
+        break;
+    default:
+        break;
+    }
+
+    /* Connection, SMS and USSD notifications are always processed */
+    return NOTIFICATION_CACHE_LAST;
+}
+
+static gboolean
+notification_coalesce_timeout (MMBroadbandModemMbim *self)
+{
+    guint i;
+
+    self->priv->notification_coalesce_id = 0;
+
+    for (i = 0; i < NOTIFICATION_CACHE_LAST; i++) {
+        MbimMessage *notification;
+
+        notification = self->priv->notification_cache[i].pending;
+        if (!notification)
+            continue;
+        self->priv->notification_cache[i].pending = NULL;
+        process_notification (self, notification);
+        mbim_message_unref (notification);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Process any coalesced notification right away and forget the last
+ * accepted ones, so that the next notifications are always processed */
+static void
+notification_cache_reset (MMBroadbandModemMbim *self,
+                          gboolean              flush)
+{
+    guint i;
+
+    if (self->priv->notification_coalesce_id) {
+        g_source_remove (self->priv->notification_coalesce_id);
+        self->priv->notification_coalesce_id = 0;
+        if (flush)
+            notification_coalesce_timeout (self);
+    }
+
+    for (i = 0; i < NOTIFICATION_CACHE_LAST; i++) {
+        NotificationCacheEntry *entry = &self->priv->notification_cache[i];
+
+        g_clear_pointer (&entry->pending, mbim_message_unref);
+        g_clear_pointer (&entry->last, g_byte_array_unref);
+        entry->last_time = 0;
+    }
+}
+
+static void
+device_notification_cb (MbimDevice *device,
+                        MbimMessage *notification,
+                        MMBroadbandModemMbim *self)
+{
+    MbimService             service;
+    NotificationCache       cache;
+    NotificationCacheEntry *entry;
+    const guint8           *buffer;
+    guint32                 buffer_len = 0;
+    gint64                  now;
+
+    service = mbim_message_indicate_status_get_service (notification);
+    mm_dbg ("Received notification (service '%s', command '%s')",
+            mbim_service_get_string (service),
+            mbim_cid_get_printable (service,
+                                    mbim_message_indicate_status_get_cid (notification)));
+
+    self->priv->n_notifications_received++;
+
+    cache = notification_get_cache (notification);
+    if (cache == NOTIFICATION_CACHE_LAST) {
+        process_notification (self, notification);
+        return;
+    }
+
+    /* Compare the payload with the last accepted one (either processed or
+     * waiting to be processed) */
+    entry = &self->priv->notification_cache[cache];
+    buffer = mbim_message_indicate_status_get_raw_information_buffer (notification, &buffer_len);
+    now = g_get_monotonic_time ();
+    if (entry->last &&
+        entry->last->len == buffer_len &&
+        (!buffer_len || memcmp (entry->last->data, buffer, buffer_len) == 0) &&
+        (now - entry->last_time) < (NOTIFICATION_REFRESH_TIMEOUT_SECS * G_USEC_PER_SEC)) {
+        self->priv->n_notifications_unchanged++;
+        mm_dbg ("Skipping unchanged notification (%u unchanged, %u coalesced out of %u received)",
+                self->priv->n_notifications_unchanged,
+                self->priv->n_notifications_coalesced,
+                self->priv->n_notifications_received);
+        return;
+    }
+
+    if (!entry->last)
+        entry->last = g_byte_array_sized_new (buffer_len);
+    g_byte_array_set_size (entry->last, 0);
+    if (buffer_len)
+        g_byte_array_append (entry->last, buffer, buffer_len);
+    entry->last_time = now;
+
+    /* Only the most frequent state updates are coalesced */
+    if (cache != NOTIFICATION_CACHE_REGISTER_STATE &&
+        cache != NOTIFICATION_CACHE_PACKET_SERVICE &&
+        cache != NOTIFICATION_CACHE_SIGNAL_STATE) {
+        process_notification (self, notification);
+        return;
+    }
+
+    if (entry->pending) {
+        self->priv->n_notifications_coalesced++;
+        mbim_message_unref (entry->pending);
+    }
+    entry->pending = mbim_message_ref (notification);
+
+    if (!self->priv->notification_coalesce_id)
+        self->priv->notification_coalesce_id = g_timeout_add (NOTIFICATION_COALESCE_TIMEOUT_MS,
+                                                              (GSourceFunc) notification_coalesce_timeout,
+                                                              self);
+}
+
 static void
 common_setup_cleanup_unsolicited_events_sync (MMBroadbandModemMbim *self,
                                               MbimDevice           *device,
@@ -3300,6 +3479,10 @@ common_setup_cleanup_unsolicited_events_sync (MMBroadbandModemMbim *self,
     if (!device)
         return;
 
+    /* The set of processed notifications changes, so make sure the next
+     * ones are not skipped */
+    notification_cache_reset (self, TRUE);
+
     mm_dbg ("Supported notifications: signal (%s), registration (%s), sms (%s), connect (%s), subscriber (%s), packet (%s), pco (%s), ussd (%s), lte attach status (%s)",
             self->priv->setup_flags & PROCESS_NOTIFICATION_FLAG_SIGNAL_QUALITY ? "yes" : "no",
             self->priv->setup_flags & PROCESS_NOTIFICATION_FLAG_REGISTRATION_UPDATES ? "yes" : "no",
@@ -5166,6 +5349,7 @@ mm_broadband_modem_mbim_new (const gchar *device,
                          MM_IFACE_MODEM_SIM_HOT_SWAP_SUPPORTED, TRUE,
                          MM_IFACE_MODEM_SIM_HOT_SWAP_CONFIGURED, FALSE,
                          MM_IFACE_MODEM_PERIODIC_SIGNAL_CHECK_DISABLED, TRUE,
+                         MM_IFACE_MODEM_IDENTITY_CACHE_SUPPORTED, TRUE,
                          NULL);
 }
 
@@ -5196,6 +5380,13 @@ finalize (GObject *object)
             mm_port_mbim_close (mbim, NULL, NULL);
     }
 
+    if (self->priv->n_notifications_received)
+        mm_dbg ("MBIM notifications: %u received, %u skipped as unchanged, %u coalesced",
+                self->priv->n_notifications_received,
+                self->priv->n_notifications_unchanged,
+                self->priv->n_notifications_coalesced);
+    notification_cache_reset (self, FALSE);
+
     g_free (self->priv->caps_device_id);
     g_free (self->priv->caps_firmware_info);
     g_free (self->priv->caps_hardware_info);
@@ -30,6 +30,7 @@
 #include "mm-errors-types.h"
 #include "mm-modem-helpers.h"
 #include "mm-modem-helpers-qmi.h"
+#include "mm-qmi-indication-router.h"
 #include "mm-iface-modem.h"
 #include "mm-iface-modem-3gpp.h"
 #include "mm-iface-modem-3gpp-ussd.h"
@@ -4453,7 +4454,7 @@ common_setup_cleanup_unsolicited_registration_events_finish (MMBroadbandModemQmi
 
 #if defined WITH_NEWEST_QMI_COMMANDS
 static void
-system_info_indication_cb (QmiClientNas *client,
+system_info_indication_cb (QmiClient *client,
                            QmiIndicationNasSystemInfoOutput *output,
                            MMBroadbandModemQmi *self)
 {
@@ -4463,7 +4464,7 @@ system_info_indication_cb (QmiClientNas *client,
 #endif
 
 static void
-serving_system_indication_cb (QmiClientNas *client,
+serving_system_indication_cb (QmiClient *client,
                               QmiIndicationNasServingSystemOutput *output,
                               MMBroadbandModemQmi *self)
 {
@@ -4507,13 +4508,13 @@ common_setup_cleanup_unsolicited_registration_events (MMBroadbandModemQmi *self,
         if (enable) {
             g_assert (self->priv->system_info_indication_id == 0);
             self->priv->system_info_indication_id =
-                g_signal_connect (client,
-                                  "system-info",
-                                  G_CALLBACK (system_info_indication_cb),
-                                  self);
+                mm_qmi_indication_router_subscribe (client,
+                                                    MM_QMI_INDICATION_NAS_SYSTEM_INFO,
+                                                    (MMQmiIndicationCallback)system_info_indication_cb,
+                                                    self);
         } else {
             g_assert (self->priv->system_info_indication_id != 0);
-            g_signal_handler_disconnect (client, self->priv->system_info_indication_id);
+            mm_qmi_indication_router_unsubscribe (client, self->priv->system_info_indication_id);
             self->priv->system_info_indication_id = 0;
         }
     } else
@@ -4523,13 +4524,13 @@ common_setup_cleanup_unsolicited_registration_events (MMBroadbandModemQmi *self,
         if (enable) {
             g_assert (self->priv->serving_system_indication_id == 0);
             self->priv->serving_system_indication_id =
-                g_signal_connect (client,
-                                  "serving-system",
-                                  G_CALLBACK (serving_system_indication_cb),
-                                  self);
+                mm_qmi_indication_router_subscribe (client,
+                                                    MM_QMI_INDICATION_NAS_SERVING_SYSTEM,
+                                                    (MMQmiIndicationCallback)serving_system_indication_cb,
+                                                    self);
         } else {
             g_assert (self->priv->serving_system_indication_id != 0);
-            g_signal_handler_disconnect (client, self->priv->serving_system_indication_id);
+            mm_qmi_indication_router_unsubscribe (client, self->priv->serving_system_indication_id);
             self->priv->serving_system_indication_id = 0;
         }
     }
@@ -4968,68 +4969,50 @@ common_setup_cleanup_unsolicited_events_finish (MMBroadbandModemQmi *self,
 }
 
 static void
-event_report_indication_cb (QmiClientNas *client,
-                            QmiIndicationNasEventReportOutput *output,
+event_report_indication_cb (QmiClient *client,
+                            const MMQmiNasSignalStrength *state,
                             MMBroadbandModemQmi *self)
 {
-    gint8 signal_strength;
-    QmiNasRadioInterface signal_strength_radio_interface;
+    /* Already parsed by the indication router, and only reported if changed */
+    if (qmi_dbm_valid (state->strength, state->radio_interface)) {
+        guint8 quality;
 
-    if (qmi_indication_nas_event_report_output_get_signal_strength (
-            output,
-            &signal_strength,
-            &signal_strength_radio_interface,
-            NULL)) {
-        if (qmi_dbm_valid (signal_strength, signal_strength_radio_interface)) {
-            guint8 quality;
-
-            /* This signal strength comes as negative dBms */
-            quality = STRENGTH_TO_QUALITY (signal_strength);
-
-            mm_dbg ("Signal strength indication (%s): %d dBm --> %u%%",
-                    qmi_nas_radio_interface_get_string (signal_strength_radio_interface),
-                    signal_strength,
-                    quality);
-
-            mm_iface_modem_update_signal_quality (MM_IFACE_MODEM (self), quality);
-            mm_iface_modem_update_access_technologies (
-                MM_IFACE_MODEM (self),
-                mm_modem_access_technology_from_qmi_radio_interface (signal_strength_radio_interface),
-                (MM_IFACE_MODEM_3GPP_ALL_ACCESS_TECHNOLOGIES_MASK | MM_IFACE_MODEM_CDMA_ALL_ACCESS_TECHNOLOGIES_MASK));
-        } else {
-            mm_dbg ("Ignoring invalid signal strength (%s): %d dBm",
-                    qmi_nas_radio_interface_get_string (signal_strength_radio_interface),
-                    signal_strength);
-        }
+        /* This signal strength comes as negative dBms */
+        quality = STRENGTH_TO_QUALITY (state->strength);
+
+        mm_dbg ("Signal strength indication (%s): %d dBm --> %u%%",
+                qmi_nas_radio_interface_get_string (state->radio_interface),
+                state->strength,
+                quality);
+
+        mm_iface_modem_update_signal_quality (MM_IFACE_MODEM (self), quality);
+        mm_iface_modem_update_access_technologies (
+            MM_IFACE_MODEM (self),
+            mm_modem_access_technology_from_qmi_radio_interface (state->radio_interface),
+            (MM_IFACE_MODEM_3GPP_ALL_ACCESS_TECHNOLOGIES_MASK | MM_IFACE_MODEM_CDMA_ALL_ACCESS_TECHNOLOGIES_MASK));
+    } else {
+        mm_dbg ("Ignoring invalid signal strength (%s): %d dBm",
+                qmi_nas_radio_interface_get_string (state->radio_interface),
+                state->strength);
     }
 }
 
 #if defined WITH_NEWEST_QMI_COMMANDS
 
 static void
-signal_info_indication_cb (QmiClientNas *client,
-                           QmiIndicationNasSignalInfoOutput *output,
+signal_info_indication_cb (QmiClient *client,
+                           const MMQmiNasSignalInfo *state,
                            MMBroadbandModemQmi *self)
 {
-    gint8 cdma1x_rssi = 0;
-    gint8 evdo_rssi = 0;
-    gint8 gsm_rssi = 0;
-    gint8 wcdma_rssi = 0;
-    gint8 lte_rssi = 0;
     guint8 quality;
     MMModemAccessTechnology act = MM_MODEM_ACCESS_TECHNOLOGY_UNKNOWN;
 
-    qmi_indication_nas_signal_info_output_get_cdma_signal_strength (output, &cdma1x_rssi, NULL, NULL);
-    qmi_indication_nas_signal_info_output_get_hdr_signal_strength (output, &evdo_rssi, NULL, NULL, NULL, NULL);
-    qmi_indication_nas_signal_info_output_get_gsm_signal_strength (output, &gsm_rssi, NULL);
-    qmi_indication_nas_signal_info_output_get_wcdma_signal_strength (output, &wcdma_rssi, NULL, NULL);
-    qmi_indication_nas_signal_info_output_get_lte_signal_strength (output, &lte_rssi, NULL, NULL, NULL, NULL);
-
-    if (common_signal_info_get_quality (cdma1x_rssi,
-                                        evdo_rssi,
-                                        gsm_rssi,
-                                        wcdma_rssi,
-                                        lte_rssi,
+    /* Already parsed by the indication router, and only reported if changed */
+    if (common_signal_info_get_quality (state->cdma1x_rssi,
+                                        state->evdo_rssi,
+                                        state->gsm_rssi,
+                                        state->wcdma_rssi,
+                                        state->lte_rssi,
                                         &quality,
                                         &act)) {
         mm_iface_modem_update_signal_quality (MM_IFACE_MODEM (self), quality);
@@ -5073,13 +5056,13 @@ common_setup_cleanup_unsolicited_events (MMBroadbandModemQmi *self,
     if (enable) {
         g_assert (self->priv->event_report_indication_id == 0);
         self->priv->event_report_indication_id =
-            g_signal_connect (client,
-                              "event-report",
-                              G_CALLBACK (event_report_indication_cb),
-                              self);
+            mm_qmi_indication_router_subscribe (client,
+                                                MM_QMI_INDICATION_NAS_SIGNAL_STRENGTH,
+                                                (MMQmiIndicationCallback)event_report_indication_cb,
+                                                self);
     } else {
         g_assert (self->priv->event_report_indication_id != 0);
-        g_signal_handler_disconnect (client, self->priv->event_report_indication_id);
+        mm_qmi_indication_router_unsubscribe (client, self->priv->event_report_indication_id);
         self->priv->event_report_indication_id = 0;
     }
 
@@ -5090,13 +5073,13 @@ common_setup_cleanup_unsolicited_events (MMBroadbandModemQmi *self,
         if (enable) {
             g_assert (self->priv->signal_info_indication_id == 0);
             self->priv->signal_info_indication_id =
-                g_signal_connect (client,
-                                  "signal-info",
-                                  G_CALLBACK (signal_info_indication_cb),
-                                  self);
+                mm_qmi_indication_router_subscribe (client,
+                                                    MM_QMI_INDICATION_NAS_SIGNAL_INFO,
+                                                    (MMQmiIndicationCallback)signal_info_indication_cb,
+                                                    self);
         } else {
             g_assert (self->priv->signal_info_indication_id != 0);
-            g_signal_handler_disconnect (client, self->priv->signal_info_indication_id);
+            mm_qmi_indication_router_unsubscribe (client, self->priv->signal_info_indication_id);
             self->priv->signal_info_indication_id = 0;
         }
     }
@@ -8250,20 +8233,27 @@ enabling_started (MMBroadbandModem *self,
 /*****************************************************************************/
 /* First initialization step */
 
-static const QmiService qmi_services[] = {
-    QMI_SERVICE_DMS,
-    QMI_SERVICE_NAS,
-    QMI_SERVICE_WMS,
-    QMI_SERVICE_PDS,
-    QMI_SERVICE_OMA,
-    QMI_SERVICE_UIM,
-    QMI_SERVICE_LOC,
-    QMI_SERVICE_PDC,
+/* Clients allocated right away and kept in the port until closed. The WDS
+ * client is the one used by IPv4 bearers, so that the first connection
+ * doesn't need to wait for it. */
+static const struct {
+    QmiService service;
+    MMPortQmiFlag flag;
+} qmi_services[] = {
+    { QMI_SERVICE_DMS, MM_PORT_QMI_FLAG_DEFAULT  },
+    { QMI_SERVICE_NAS, MM_PORT_QMI_FLAG_DEFAULT  },
+    { QMI_SERVICE_WMS, MM_PORT_QMI_FLAG_DEFAULT  },
+    { QMI_SERVICE_PDS, MM_PORT_QMI_FLAG_DEFAULT  },
+    { QMI_SERVICE_OMA, MM_PORT_QMI_FLAG_DEFAULT  },
+    { QMI_SERVICE_UIM, MM_PORT_QMI_FLAG_DEFAULT  },
+    { QMI_SERVICE_LOC, MM_PORT_QMI_FLAG_DEFAULT  },
+    { QMI_SERVICE_PDC, MM_PORT_QMI_FLAG_DEFAULT  },
+    { QMI_SERVICE_WDS, MM_PORT_QMI_FLAG_WDS_IPV4 },
 };
 
 typedef struct {
     MMPortQmi *qmi;
-    guint service_index;
+    guint n_pending;
 } InitializationStartedContext;
 
 static void
@@ -8366,8 +8356,6 @@ untrack_qmi_device_removed (MMBroadbandModemQmi *self,
     self->priv->qmi_device_removed_id = 0;
 }
 
-static void allocate_next_client (GTask *task);
-
 static void
 qmi_port_allocate_client_ready (MMPortQmi *qmi,
                                 GAsyncResult *res,
@@ -8378,40 +8366,39 @@ qmi_port_allocate_client_ready (MMPortQmi *qmi,
 
     ctx = g_task_get_task_data (task);
 
+    /* The error message already tells the service */
     if (!mm_port_qmi_allocate_client_finish (qmi, res, &error)) {
-        mm_dbg ("Couldn't allocate client for service '%s': %s",
-                qmi_service_get_string (qmi_services[ctx->service_index]),
-                error->message);
+        mm_dbg ("%s", error->message);
         g_error_free (error);
     }
 
-    ctx->service_index++;
-    allocate_next_client (task);
+    g_assert (ctx->n_pending > 0);
+    if (--ctx->n_pending > 0)
+        return;
+
+    /* Done we are, track device removal and launch parent's callback */
+    track_qmi_device_removed (MM_BROADBAND_MODEM_QMI (g_task_get_source_object (task)), ctx->qmi);
+    parent_initialization_started (task);
 }
 
 static void
-allocate_next_client (GTask *task)
+allocate_clients (GTask *task)
 {
     InitializationStartedContext *ctx;
-    MMBroadbandModemQmi *self;
+    guint i;
 
-    self = g_task_get_source_object (task);
     ctx = g_task_get_task_data (task);
 
-    if (ctx->service_index == G_N_ELEMENTS (qmi_services)) {
-        /* Done we are, track device removal and launch parent's callback */
-        track_qmi_device_removed (self, ctx->qmi);
-        parent_initialization_started (task);
-        return;
-    }
-
-    /* Otherwise, allocate next client */
-    mm_port_qmi_allocate_client (ctx->qmi,
-                                 qmi_services[ctx->service_index],
-                                 MM_PORT_QMI_FLAG_DEFAULT,
-                                 NULL,
-                                 (GAsyncReadyCallback)qmi_port_allocate_client_ready,
-                                 task);
+    /* All CTL requests are sent right away; the device serves them in order
+     * but without waiting for us in between */
+    ctx->n_pending = G_N_ELEMENTS (qmi_services);
+    for (i = 0; i < G_N_ELEMENTS (qmi_services); i++)
+        mm_port_qmi_allocate_client (ctx->qmi,
+                                     qmi_services[i].service,
+                                     qmi_services[i].flag,
+                                     NULL,
+                                     (GAsyncReadyCallback)qmi_port_allocate_client_ready,
+                                     task);
 }
 
 
@@ -8428,7 +8415,7 @@ qmi_port_open_ready_no_data_format (MMPortQmi *qmi,
         return;
     }
 
-    allocate_next_client (task);
+    allocate_clients (task);
 }
 
 static void
@@ -8457,7 +8444,7 @@ qmi_port_open_ready (MMPortQmi *qmi,
         return;
     }
 
-    allocate_next_client (task);
+    allocate_clients (task);
 }
 
 static void
@@ -8515,6 +8502,7 @@ mm_broadband_modem_qmi_new (const gchar *device,
                          MM_BASE_MODEM_PLUGIN, plugin,
                          MM_BASE_MODEM_VENDOR_ID, vendor_id,
                          MM_BASE_MODEM_PRODUCT_ID, product_id,
+                         MM_IFACE_MODEM_IDENTITY_CACHE_SUPPORTED, TRUE,
                          NULL);
 }
 
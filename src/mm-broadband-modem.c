@@ -49,6 +49,7 @@
 #include "mm-call-list.h"
 #include "mm-base-sim.h"
 #include "mm-log.h"
+#include "mm-trace.h"
 #include "mm-modem-helpers.h"
 #include "mm-error-helpers.h"
 #include "mm-port-serial-qcdm.h"
@@ -123,6 +124,7 @@ enum {
     PROP_MODEM_PERIODIC_SIGNAL_CHECK_DISABLED,
     PROP_MODEM_PERIODIC_CALL_LIST_CHECK_DISABLED,
     PROP_MODEM_CARRIER_CONFIG_MAPPING,
+    PROP_MODEM_IDENTITY_CACHE_SUPPORTED,
     PROP_FLOW_CONTROL,
     PROP_LAST
 };
@@ -143,6 +145,7 @@ struct _MMBroadbandModemPrivate {
     gboolean sim_hot_swap_supported;
     gboolean sim_hot_swap_configured;
     gboolean periodic_signal_check_disabled;
+    gboolean identity_cache_supported;
 
     /*<--- Modem interface --->*/
     /* Properties */
@@ -10392,6 +10395,8 @@ disabling_step (GTask *task)
     }
     ctx = g_task_get_task_data (task);
 
+    mm_trace_step (task, "disable", ctx->step, mm_base_modem_get_device (MM_BASE_MODEM (ctx->self)));
+
     switch (ctx->step) {
     case DISABLING_STEP_FIRST:
         /* Fall down to next step */
@@ -10738,6 +10743,8 @@ enabling_step (GTask *task)
 
     ctx = g_task_get_task_data (task);
 
+    mm_trace_step (task, "enable", ctx->step, mm_base_modem_get_device (MM_BASE_MODEM (ctx->self)));
+
     switch (ctx->step) {
     case ENABLING_STEP_FIRST:
         /* Fall down to next step */
@@ -10978,6 +10985,305 @@ enable (MMBaseModem *self,
     g_object_unref (task);
 }
 
+/*****************************************************************************/
+/* Sync (after resume) */
+
+typedef enum {
+    SYNC_STEP_FIRST,
+    SYNC_STEP_PORTS,
+    SYNC_STEP_EQUIPMENT_IDENTIFIER,
+    SYNC_STEP_SIM_IDENTIFIER,
+    SYNC_STEP_REGISTRATION_CHECKS,
+    SYNC_STEP_LAST,
+} SyncStep;
+
+typedef struct {
+    MMBroadbandModem *self;
+    SyncStep step;
+} SyncContext;
+
+static void sync_step (GTask *task);
+
+static void
+sync_context_free (SyncContext *ctx)
+{
+    g_object_unref (ctx->self);
+    g_free (ctx);
+}
+
+static gboolean
+modem_sync_finish (MMBaseModem   *self,
+                   GAsyncResult  *res,
+                   GError       **error)
+{
+    return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+static void
+sync_registration_checks_ready (MMBroadbandModem *self,
+                                GAsyncResult     *res,
+                                GTask            *task)
+{
+    SyncContext *ctx;
+    GError      *error = NULL;
+
+    ctx = g_task_get_task_data (task);
+
+    /* Not being able to refresh the registration state is not fatal, the
+     * modem will keep on reporting it */
+    if ((mm_iface_modem_is_3gpp (MM_IFACE_MODEM (self)) &&
+         !mm_iface_modem_3gpp_run_registration_checks_finish (MM_IFACE_MODEM_3GPP (self), res, &error)) ||
+        (!mm_iface_modem_is_3gpp (MM_IFACE_MODEM (self)) &&
+         !mm_iface_modem_cdma_run_registration_checks_finish (MM_IFACE_MODEM_CDMA (self), res, &error))) {
+        mm_dbg ("Couldn't refresh registration state after resume: %s", error->message);
+        g_error_free (error);
+    }
+
+    ctx->step++;
+    sync_step (task);
+}
+
+static void
+sync_sim_identifier_ready (MMBaseSim    *sim,
+                           GAsyncResult *res,
+                           GTask        *task)
+{
+    SyncContext *ctx;
+    GError      *error = NULL;
+    gchar       *simid;
+    const gchar *current;
+
+    ctx = g_task_get_task_data (task);
+
+    simid = mm_base_sim_load_sim_identifier_finish (sim, res, &error);
+    if (!simid) {
+        g_prefix_error (&error, "Couldn't load SIM identifier: ");
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    current = mm_gdbus_sim_get_sim_identifier (MM_GDBUS_SIM (sim));
+    if (g_strcmp0 (current, simid) != 0) {
+        g_task_return_new_error (task, MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
+                                 "SIM identifier changed: '%s' -> '%s'",
+                                 current ? current : "unknown", simid);
+        g_object_unref (task);
+        g_free (simid);
+        return;
+    }
+    g_free (simid);
+
+    ctx->step++;
+    sync_step (task);
+}
+
+static void
+sync_equipment_identifier_ready (MMIfaceModem *self,
+                                 GAsyncResult *res,
+                                 GTask        *task)
+{
+    SyncContext *ctx;
+    GError      *error = NULL;
+    gchar       *equipment_identifier;
+    const gchar *current;
+
+    ctx = g_task_get_task_data (task);
+
+    equipment_identifier = MM_IFACE_MODEM_GET_INTERFACE (self)->load_equipment_identifier_finish (self, res, &error);
+    if (!equipment_identifier) {
+        g_prefix_error (&error, "Couldn't load equipment identifier: ");
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    current = mm_gdbus_modem_get_equipment_identifier (MM_GDBUS_MODEM (ctx->self->priv->modem_dbus_skeleton));
+    if (g_strcmp0 (current, equipment_identifier) != 0) {
+        g_task_return_new_error (task, MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
+                                 "Equipment identifier changed: '%s' -> '%s'",
+                                 current ? current : "unknown", equipment_identifier);
+        g_object_unref (task);
+        g_free (equipment_identifier);
+        return;
+    }
+    g_free (equipment_identifier);
+
+    ctx->step++;
+    sync_step (task);
+}
+
+static void
+sync_at_ping_ready (MMBaseModem  *self,
+                    GAsyncResult *res,
+                    GTask        *task)
+{
+    SyncContext *ctx;
+    GError      *error = NULL;
+
+    ctx = g_task_get_task_data (task);
+
+    if (!mm_base_modem_at_command_finish (self, res, &error)) {
+        g_prefix_error (&error, "Modem didn't reply: ");
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    ctx->step++;
+    sync_step (task);
+}
+
+static gboolean
+sync_check_ports (MMBroadbandModem  *self,
+                  GError           **error)
+{
+    GList    *ports;
+    GList    *l;
+    gboolean  found = TRUE;
+
+    ports = mm_base_modem_find_ports (MM_BASE_MODEM (self), MM_PORT_SUBSYS_UNKNOWN, MM_PORT_TYPE_UNKNOWN, NULL);
+    for (l = ports; l && found; l = g_list_next (l)) {
+        MMKernelDevice *kernel_device;
+        const gchar    *sysfs_path;
+
+        kernel_device = mm_port_peek_kernel_device (MM_PORT (l->data));
+        if (!kernel_device)
+            continue;
+        sysfs_path = mm_kernel_device_get_sysfs_path (kernel_device);
+        if (sysfs_path && !g_file_test (sysfs_path, G_FILE_TEST_EXISTS)) {
+            g_set_error (error, MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
+                         "Port '%s' is gone", mm_port_get_device (MM_PORT (l->data)));
+            found = FALSE;
+        }
+    }
+    g_list_free_full (ports, g_object_unref);
+
+    return found;
+}
+
+static void
+sync_step (GTask *task)
+{
+    SyncContext *ctx;
+
+    ctx = g_task_get_task_data (task);
+
+    mm_trace_step (task, "sync", ctx->step, mm_base_modem_get_device (MM_BASE_MODEM (ctx->self)));
+
+    switch (ctx->step) {
+    case SYNC_STEP_FIRST:
+        ctx->step++;
+        /* fall through */
+
+    case SYNC_STEP_PORTS: {
+        GError *error = NULL;
+
+        if (!sync_check_ports (ctx->self, &error)) {
+            g_task_return_error (task, error);
+            g_object_unref (task);
+            return;
+        }
+        ctx->step++;
+    }   /* fall through */
+
+    case SYNC_STEP_EQUIPMENT_IDENTIFIER:
+        /* Reloading the equipment identifier validates both that the modem
+         * is still the same one and that it is still responsive, using
+         * whatever control protocol the modem uses */
+        if (MM_IFACE_MODEM_GET_INTERFACE (ctx->self)->load_equipment_identifier &&
+            MM_IFACE_MODEM_GET_INTERFACE (ctx->self)->load_equipment_identifier_finish) {
+            MM_IFACE_MODEM_GET_INTERFACE (ctx->self)->load_equipment_identifier (
+                MM_IFACE_MODEM (ctx->self),
+                (GAsyncReadyCallback)sync_equipment_identifier_ready,
+                task);
+            return;
+        }
+        /* Otherwise, just a quick ping */
+        if (mm_base_modem_peek_port_primary (MM_BASE_MODEM (ctx->self))) {
+            mm_base_modem_at_command (MM_BASE_MODEM (ctx->self),
+                                      "",
+                                      3,
+                                      FALSE,
+                                      (GAsyncReadyCallback)sync_at_ping_ready,
+                                      task);
+            return;
+        }
+        ctx->step++;
+        /* fall through */
+
+    case SYNC_STEP_SIM_IDENTIFIER: {
+        MMBaseSim *sim = NULL;
+
+        g_object_get (ctx->self,
+                      MM_IFACE_MODEM_SIM, &sim,
+                      NULL);
+        if (sim) {
+            mm_base_sim_load_sim_identifier (sim,
+                                             (GAsyncReadyCallback)sync_sim_identifier_ready,
+                                             task);
+            g_object_unref (sim);
+            return;
+        }
+        ctx->step++;
+    }   /* fall through */
+
+    case SYNC_STEP_REGISTRATION_CHECKS:
+        /* Registration may have changed while sleeping */
+        if (ctx->self->priv->modem_state >= MM_MODEM_STATE_ENABLED) {
+            if (mm_iface_modem_is_3gpp (MM_IFACE_MODEM (ctx->self))) {
+                mm_iface_modem_3gpp_run_registration_checks (MM_IFACE_MODEM_3GPP (ctx->self),
+                                                             (GAsyncReadyCallback)sync_registration_checks_ready,
+                                                             task);
+                return;
+            }
+            if (mm_iface_modem_is_cdma (MM_IFACE_MODEM (ctx->self))) {
+                mm_iface_modem_cdma_run_registration_checks (MM_IFACE_MODEM_CDMA (ctx->self),
+                                                             (GAsyncReadyCallback)sync_registration_checks_ready,
+                                                             task);
+                return;
+            }
+        }
+        ctx->step++;
+        /* fall through */
+
+    case SYNC_STEP_LAST:
+        g_task_return_boolean (task, TRUE);
+        g_object_unref (task);
+        return;
+    }
+
+    g_assert_not_reached ();
+}
+
+static void
+modem_sync (MMBaseModem         *self,
+            GCancellable        *cancellable,
+            GAsyncReadyCallback  callback,
+            gpointer             user_data)
+{
+    SyncContext *ctx;
+    GTask       *task;
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    /* Modems that didn't complete initialization are not validated, they
+     * will be fully re-probed instead */
+    if (MM_BROADBAND_MODEM (self)->priv->modem_state <= MM_MODEM_STATE_INITIALIZING) {
+        g_task_return_new_error (task, MM_CORE_ERROR, MM_CORE_ERROR_WRONG_STATE,
+                                 "Cannot sync modem: not initialized");
+        g_object_unref (task);
+        return;
+    }
+
+    ctx = g_new0 (SyncContext, 1);
+    ctx->self = g_object_ref (self);
+    ctx->step = SYNC_STEP_FIRST;
+    g_task_set_task_data (task, ctx, (GDestroyNotify)sync_context_free);
+
+    sync_step (task);
+}
+
 /*****************************************************************************/
 
 typedef enum {
@@ -11195,6 +11501,8 @@ initialize_step (GTask *task)
 
     ctx = g_task_get_task_data (task);
 
+    mm_trace_step (task, "initialize", ctx->step, mm_base_modem_get_device (MM_BASE_MODEM (ctx->self)));
+
     switch (ctx->step) {
     case INITIALIZE_STEP_FIRST:
         /* Fall down to next step */
@@ -11628,6 +11936,9 @@ mm_broadband_modem_new (const gchar *device,
                          MM_BASE_MODEM_PLUGIN, plugin,
                          MM_BASE_MODEM_VENDOR_ID, vendor_id,
                          MM_BASE_MODEM_PRODUCT_ID, product_id,
+                         /* The generic implementation keeps no internal state
+                          * when loading supported modes and bands */
+                         MM_IFACE_MODEM_IDENTITY_CACHE_SUPPORTED, TRUE,
                          NULL);
 }
 
@@ -11760,6 +12071,9 @@ set_property (GObject *object,
     case PROP_MODEM_PERIODIC_SIGNAL_CHECK_DISABLED:
         self->priv->periodic_signal_check_disabled = g_value_get_boolean (value);
         break;
+    case PROP_MODEM_IDENTITY_CACHE_SUPPORTED:
+        self->priv->identity_cache_supported = g_value_get_boolean (value);
+        break;
     case PROP_MODEM_PERIODIC_CALL_LIST_CHECK_DISABLED:
         self->priv->periodic_call_list_check_disabled = g_value_get_boolean (value);
         break;
@@ -11886,6 +12200,9 @@ get_property (GObject *object,
     case PROP_MODEM_PERIODIC_SIGNAL_CHECK_DISABLED:
         g_value_set_boolean (value, self->priv->periodic_signal_check_disabled);
         break;
+    case PROP_MODEM_IDENTITY_CACHE_SUPPORTED:
+        g_value_set_boolean (value, self->priv->identity_cache_supported);
+        break;
     case PROP_MODEM_PERIODIC_CALL_LIST_CHECK_DISABLED:
         g_value_set_boolean (value, self->priv->periodic_call_list_check_disabled);
         break;
@@ -12306,6 +12623,8 @@ mm_broadband_modem_class_init (MMBroadbandModemClass *klass)
     base_modem_class->enable_finish = enable_finish;
     base_modem_class->disable = disable;
     base_modem_class->disable_finish = disable_finish;
+    base_modem_class->sync = modem_sync;
+    base_modem_class->sync_finish = modem_sync_finish;
 
     klass->setup_ports = setup_ports;
     klass->initialization_started = initialization_started;
@@ -12453,6 +12772,10 @@ mm_broadband_modem_class_init (MMBroadbandModemClass *klass)
                                       PROP_MODEM_PERIODIC_SIGNAL_CHECK_DISABLED,
                                       MM_IFACE_MODEM_PERIODIC_SIGNAL_CHECK_DISABLED);
 
+    g_object_class_override_property (object_class,
+                                      PROP_MODEM_IDENTITY_CACHE_SUPPORTED,
+                                      MM_IFACE_MODEM_IDENTITY_CACHE_SUPPORTED);
+
     g_object_class_override_property (object_class,
                                       PROP_MODEM_PERIODIC_CALL_LIST_CHECK_DISABLED,
                                       MM_IFACE_MODEM_VOICE_PERIODIC_CALL_LIST_CHECK_DISABLED);
@@ -176,8 +176,12 @@ mm_modem_charset_byte_array_to_utf8 (GByteArray     *array,
 char *
 mm_modem_charset_hex_to_utf8 (const char *src, MMModemCharset charset)
 {
-    char *unconverted, *converted;
+    guint8 unconverted_buffer[256];
+    guint8 *unconverted = unconverted_buffer;
+    gsize unconverted_size = sizeof (unconverted_buffer);
+    char *converted;
     const char *iconv_from;
+    gsize src_len;
     gsize unconverted_len = 0;
     GError *error = NULL;
 
@@ -187,22 +191,30 @@ mm_modem_charset_hex_to_utf8 (const char *src, MMModemCharset charset)
     iconv_from = charset_iconv_from (charset);
     g_return_val_if_fail (iconv_from != NULL, FALSE);
 
-    unconverted = mm_utils_hexstr2bin (src, &unconverted_len);
-    if (!unconverted)
-        return NULL;
-
     if (charset == MM_MODEM_CHARSET_UTF8 || charset == MM_MODEM_CHARSET_IRA)
-        return unconverted;
+        return mm_utils_hexstr2bin (src, &unconverted_len);
+
+    /* Most strings fit in the stack buffer, as the converted string is the
+     * only thing that needs to be allocated */
+    src_len = strlen (src);
+    if (src_len / 2 > unconverted_size) {
+        unconverted_size = src_len / 2;
+        unconverted = g_malloc (unconverted_size);
+    }
 
-    converted = g_convert (unconverted, unconverted_len,
-                           "UTF-8//TRANSLIT", iconv_from,
-                           NULL, NULL, &error);
-    if (!converted || error) {
-        g_clear_error (&error);
+    if (mm_utils_hexstr2bin_buf (src, src_len, unconverted, unconverted_size, &unconverted_len)) {
+        converted = g_convert ((const gchar *) unconverted, unconverted_len,
+                               "UTF-8//TRANSLIT", iconv_from,
+                               NULL, NULL, &error);
+        if (!converted || error) {
+            g_clear_error (&error);
+            converted = NULL;
+        }
+    } else
         converted = NULL;
-    }
 
-    g_free (unconverted);
+    if (unconverted != unconverted_buffer)
+        g_free (unconverted);
 
     return converted;
 }
@@ -649,34 +661,56 @@ mm_charset_gsm_unpack (const guint8 *gsm,
                        guint8 start_offset,  /* in _bits_ */
                        guint32 *out_unpacked_len)
 {
-    GByteArray *unpacked;
-    int i;
-
-    unpacked = g_byte_array_sized_new (num_septets + 1);
-
-    for (i = 0; i < num_septets; i++) {
-        guint8 bits_here, bits_in_next, octet, offset, c;
-        guint32 start_bit;
-
-        start_bit = start_offset + (i * 7); /* Overall bit offset of char in buffer */
-        offset = start_bit % 8;  /* Offset to start of char in this byte */
-        bits_here = offset ? (8 - offset) : 7;
-        bits_in_next = 7 - bits_here;
-
-        /* Grab bits in the current byte */
-        octet = gsm[start_bit / 8];
-        c = (octet >> offset) & (0xFF >> (8 - bits_here));
+    guint8 *unpacked;
+    guint32 acc = 0;
+    guint acc_bits = 0;
+    guint32 i = 0;
+
+    unpacked = g_malloc (num_septets + 1);
+
+    gsm += start_offset / 8;
+    start_offset %= 8;
+
+    /* Septets are packed LSB first, and 8 septets fill exactly 7 bytes; so
+     * when byte aligned, unpack blocks of 8 septets out of a single word */
+    if (!start_offset) {
+        for (; i + 8 <= num_septets; i += 8, gsm += 7) {
+            guint64 word;
+
+            word = ((guint64) gsm[0]        |
+                    (guint64) gsm[1] <<  8  |
+                    (guint64) gsm[2] << 16  |
+                    (guint64) gsm[3] << 24  |
+                    (guint64) gsm[4] << 32  |
+                    (guint64) gsm[5] << 40  |
+                    (guint64) gsm[6] << 48);
+            unpacked[i]     =  word        & 0x7F;
+            unpacked[i + 1] = (word >>  7) & 0x7F;
+            unpacked[i + 2] = (word >> 14) & 0x7F;
+            unpacked[i + 3] = (word >> 21) & 0x7F;
+            unpacked[i + 4] = (word >> 28) & 0x7F;
+            unpacked[i + 5] = (word >> 35) & 0x7F;
+            unpacked[i + 6] = (word >> 42) & 0x7F;
+            unpacked[i + 7] = (word >> 49) & 0x7F;
+        }
+    } else if (num_septets) {
+        acc = *gsm++ >> start_offset;
+        acc_bits = 8 - start_offset;
+    }
 
-        /* Grab any bits that spilled over to next byte */
-        if (bits_in_next) {
-            octet = gsm[(start_bit / 8) + 1];
-            c |= (octet & (0xFF >> (8 - bits_in_next))) << bits_here;
+    /* Remaining septets, loading each byte only once it's needed */
+    for (; i < num_septets; i++) {
+        if (acc_bits < 7) {
+            acc |= (guint32) *gsm++ << acc_bits;
+            acc_bits += 8;
         }
-        g_byte_array_append (unpacked, &c, 1);
+        unpacked[i] = acc & 0x7F;
+        acc >>= 7;
+        acc_bits -= 7;
     }
 
-    *out_unpacked_len = unpacked->len;
-    return g_byte_array_free (unpacked, FALSE);
+    *out_unpacked_len = num_septets;
+    return unpacked;
 }
 
 guint8 *
@@ -41,6 +41,11 @@ static gboolean      debug;
 static MMFilterRule  filter_policy = MM_FILTER_POLICY_DEFAULT;
 static gboolean      no_auto_scan = NO_AUTO_SCAN_DEFAULT;
 static const gchar  *initial_kernel_events;
+static gboolean      quick_suspend_resume;
+static gboolean      identity_cache;
+static gint          io_workers;
+static gint          network_scan_interval;
+static gint          poll_budget;
 
 static gboolean
 filter_policy_option_arg (const gchar  *option_name,
@@ -90,6 +95,33 @@ static const GOptionEntry entries[] = {
         "Path to initial kernel events file",
         "[PATH]"
     },
+    {
+        "identity-cache", 0, 0, G_OPTION_ARG_NONE, &identity_cache,
+        "Cache modem, SIM and carrier configuration information that rarely changes on disk",
+        NULL
+    },
+    {
+        "io-workers", 0, 0, G_OPTION_ARG_INT, &io_workers,
+        "Number of threads reading from serial ports (default: 0, read in the main loop)",
+        "[N]"
+    },
+    {
+        "network-scan-interval", 0, 0, G_OPTION_ARG_INT, &network_scan_interval,
+        "Scan 3GPP networks in the background every SECS seconds while idle, and reuse the results (default: 0, disabled)",
+        "[SECS]"
+    },
+    {
+        "poll-budget", 0, 0, G_OPTION_ARG_INT, &poll_budget,
+        "Maximum number of periodic queries run per second on each modem (default: 1)",
+        "[N]"
+    },
+#if defined WITH_SYSTEMD_SUSPEND_RESUME
+    {
+        "quick-suspend-resume", 0, 0, G_OPTION_ARG_NONE, &quick_suspend_resume,
+        "Keep modems across suspend and just validate them on resume",
+        NULL
+    },
+#endif
     {
         "debug", 0, 0, G_OPTION_ARG_NONE, &debug,
         "Run with extended debugging capabilities",
@@ -126,6 +158,36 @@ mm_context_get_no_auto_scan (void)
     return no_auto_scan;
 }
 
+gboolean
+mm_context_get_identity_cache (void)
+{
+    return identity_cache;
+}
+
+guint
+mm_context_get_io_workers (void)
+{
+    return (guint) MAX (io_workers, 0);
+}
+
+guint
+mm_context_get_network_scan_interval (void)
+{
+    return (guint) MAX (network_scan_interval, 0);
+}
+
+guint
+mm_context_get_poll_budget (void)
+{
+    return (guint) MAX (poll_budget, 0);
+}
+
+gboolean
+mm_context_get_quick_suspend_resume (void)
+{
+    return quick_suspend_resume;
+}
+
 MMFilterRule
 mm_context_get_filter_policy (void)
 {
@@ -140,6 +202,7 @@ static const gchar *log_file;
 static gboolean     log_journal;
 static gboolean     log_show_ts;
 static gboolean     log_rel_ts;
+static const gchar *log_trace_file;
 
 static const GOptionEntry log_entries[] = {
     {
@@ -169,6 +232,11 @@ static const GOptionEntry log_entries[] = {
         "Use relative timestamps (from MM start)",
         NULL
     },
+    {
+        "log-trace-file", 0, 0, G_OPTION_ARG_FILENAME, &log_trace_file,
+        "Path to profiling trace file (Chrome trace-event JSON)",
+        "[PATH]"
+    },
     { NULL }
 };
 
@@ -216,6 +284,12 @@ mm_context_get_log_relative_timestamps (void)
     return log_rel_ts;
 }
 
+const gchar *
+mm_context_get_log_trace_file (void)
+{
+    return log_trace_file;
+}
+
 /*****************************************************************************/
 /* Test context */
 
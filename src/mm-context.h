@@ -31,6 +31,11 @@ void mm_context_init (gint    argc,
 gboolean     mm_context_get_debug                 (void);
 const gchar *mm_context_get_initial_kernel_events (void);
 gboolean     mm_context_get_no_auto_scan          (void);
+gboolean     mm_context_get_quick_suspend_resume  (void);
+gboolean     mm_context_get_identity_cache        (void);
+guint        mm_context_get_io_workers            (void);
+guint        mm_context_get_network_scan_interval (void);
+guint        mm_context_get_poll_budget           (void);
 
 /* Filter support */
 MMFilterRule mm_context_get_filter_policy (void);
@@ -41,6 +46,7 @@ const gchar *mm_context_get_log_file                (void);
 gboolean     mm_context_get_log_journal             (void);
 gboolean     mm_context_get_log_timestamps          (void);
 gboolean     mm_context_get_log_relative_timestamps (void);
+const gchar *mm_context_get_log_trace_file          (void);
 
 /* Testing support */
 gboolean     mm_context_get_test_session    (void);
@@ -0,0 +1,550 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <ModemManager.h>
+#include <mm-errors-types.h>
+
+#include "mm-identity-cache.h"
+#include "mm-log.h"
+
+/* Bump whenever the format of the stored data changes; caches with a
+ * different version are discarded */
+#define CACHE_VERSION 1
+
+#define CACHE_GROUP       "cache"
+#define CACHE_KEY_VERSION "version"
+
+#define MODEM_GROUP_PREFIX          "modem "
+#define SIM_GROUP_PREFIX            "sim "
+#define CARRIER_CONFIG_GROUP_PREFIX "carrier-config "
+
+#define KEY_LAST_USED           "last-used"
+#define KEY_SUPPORTED_MODES     "supported-modes"
+#define KEY_SUPPORTED_BANDS     "supported-bands"
+#define KEY_IMSI                "imsi"
+#define KEY_OPERATOR_IDENTIFIER "operator-identifier"
+#define KEY_OPERATOR_NAME       "operator-name"
+#define KEY_CONFIGS             "configs"
+
+/* Max number of entries of each kind kept in the cache; the least recently
+ * used ones are removed first */
+#define MAX_ENTRIES 16
+
+/* Don't rewrite the cache just to update the last used time of an entry
+ * more often than this */
+#define LAST_USED_UPDATE_SECS (24 * 60 * 60)
+
+/* Changes are written together after this time, so that the stores done
+ * along the initialization of a modem end up in a single write */
+#define WRITE_DELAY_SECS 5
+
+static gchar    *cache_path;
+static GKeyFile *cache;
+
+/* Pending delayed write, ongoing write, and changes done while writing */
+static guint    write_id;
+static gboolean writing;
+static gboolean write_again;
+
+/*****************************************************************************/
+
+gboolean
+mm_identity_cache_enabled (void)
+{
+    return !!cache;
+}
+
+static gchar *
+build_group (const gchar *prefix,
+             const gchar *id1,
+             const gchar *id2)
+{
+    gchar *key;
+    gchar *checksum;
+    gchar *group;
+
+    /* The identifiers used as keys (IMEI, ICCID...) don't appear in the group
+     * names, and any character is allowed in them. The cached values, which
+     * include the IMSI of the SIM cards, are stored as they are; the file is
+     * protected by its permissions instead, see cache_write(). */
+    key = g_strdup_printf ("%s\n%s", id1, id2);
+    checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA256, key, -1);
+    group = g_strconcat (prefix, checksum, NULL);
+    g_free (checksum);
+    g_free (key);
+    return group;
+}
+
+/* The cache is only readable by the daemon user: the file is created with
+ * restricted permissions right away (instead of being changed after writing
+ * it), and the new contents are written to a temporary file which is then
+ * renamed over the previous one, so that it is never readable by others, not
+ * even partially written. GIO does the writing in a worker thread, the main
+ * loop never waits for the disk. */
+
+static void cache_write_start (void);
+
+static void
+cache_write_ready (GFile        *file,
+                   GAsyncResult *res,
+                   gchar        *data)
+{
+    GError *error = NULL;
+
+    writing = FALSE;
+    if (!g_file_replace_contents_finish (file, res, NULL, &error)) {
+        mm_warn ("Couldn't write identity cache: %s", error->message);
+        g_error_free (error);
+    }
+    g_free (data);
+
+    if (write_again) {
+        write_again = FALSE;
+        cache_write_start ();
+    }
+}
+
+static void
+cache_write_start (void)
+{
+    GFile *file;
+    gchar *data;
+    gsize  len;
+
+    g_assert (!writing);
+
+    data = g_key_file_to_data (cache, &len, NULL);
+    file = g_file_new_for_path (cache_path);
+    writing = TRUE;
+    g_file_replace_contents_async (file,
+                                   data,
+                                   len,
+                                   NULL,
+                                   FALSE,
+                                   G_FILE_CREATE_PRIVATE,
+                                   NULL,
+                                   (GAsyncReadyCallback) cache_write_ready,
+                                   data);
+    g_object_unref (file);
+}
+
+static gboolean
+cache_write_cb (void)
+{
+    write_id = 0;
+
+    /* Only one write at a time, so that an older one never ends up renamed
+     * over a newer one */
+    if (writing)
+        write_again = TRUE;
+    else
+        cache_write_start ();
+    return G_SOURCE_REMOVE;
+}
+
+static void
+cache_write (void)
+{
+    if (!write_id)
+        write_id = g_timeout_add_seconds (WRITE_DELAY_SECS, (GSourceFunc) cache_write_cb, NULL);
+}
+
+/* Synchronous flush of any pending change, when the main loop is no longer
+ * running */
+static void
+cache_flush (void)
+{
+    gboolean  pending;
+    GError   *error = NULL;
+
+    pending = (write_id || write_again);
+    if (write_id) {
+        g_source_remove (write_id);
+        write_id = 0;
+    }
+    write_again = FALSE;
+
+    /* Let the ongoing write finish before writing over it */
+    while (writing)
+        g_main_context_iteration (NULL, TRUE);
+
+    if (pending) {
+        GFile *file;
+        gchar *data;
+        gsize  len;
+
+        data = g_key_file_to_data (cache, &len, NULL);
+        file = g_file_new_for_path (cache_path);
+        if (!g_file_replace_contents (file, data, len, NULL, FALSE, G_FILE_CREATE_PRIVATE, NULL, NULL, &error)) {
+            mm_warn ("Couldn't write identity cache: %s", error->message);
+            g_error_free (error);
+        }
+        g_object_unref (file);
+        g_free (data);
+    }
+}
+static void
+cache_prune (const gchar *prefix)
+{
+    gchar **groups;
+    guint   n_groups = 0;
+    guint   i;
+
+    groups = g_key_file_get_groups (cache, NULL);
+    for (i = 0; groups[i]; i++) {
+        if (g_str_has_prefix (groups[i], prefix))
+            n_groups++;
+    }
+
+    while (n_groups > MAX_ENTRIES) {
+        const gchar *oldest = NULL;
+        gint64       oldest_time = G_MAXINT64;
+
+        for (i = 0; groups[i]; i++) {
+            gint64 last_used;
+
+            if (!g_str_has_prefix (groups[i], prefix) || !g_key_file_has_group (cache, groups[i]))
+                continue;
+            last_used = g_key_file_get_int64 (cache, groups[i], KEY_LAST_USED, NULL);
+            if (last_used < oldest_time) {
+                oldest_time = last_used;
+                oldest = groups[i];
+            }
+        }
+        g_assert (oldest);
+        g_key_file_remove_group (cache, oldest, NULL);
+        n_groups--;
+    }
+
+    g_strfreev (groups);
+}
+
+/* Mark the entry as used, and tell whether the cache needs to be written */
+static gboolean
+cache_touch (const gchar *group)
+{
+    gint64 now;
+
+    now = g_get_real_time () / G_USEC_PER_SEC;
+    if (ABS (now - g_key_file_get_int64 (cache, group, KEY_LAST_USED, NULL)) < LAST_USED_UPDATE_SECS)
+        return FALSE;
+    g_key_file_set_int64 (cache, group, KEY_LAST_USED, now);
+    return TRUE;
+}
+
+/* Update a string value, and tell whether it changed */
+static gboolean
+cache_set_string (const gchar *group,
+                  const gchar *key,
+                  const gchar *value)
+{
+    gchar    *current;
+    gboolean  changed;
+
+    current = g_key_file_get_string (cache, group, key, NULL);
+    changed = (g_strcmp0 (current, value) != 0);
+    g_free (current);
+
+    if (changed) {
+        if (value)
+            g_key_file_set_string (cache, group, key, value);
+        else
+            g_key_file_remove_key (cache, group, key, NULL);
+    }
+    return changed;
+}
+
+static gboolean
+cache_set_variant (const gchar *group,
+                   const gchar *key,
+                   GVariant    *value)
+{
+    gchar    *str;
+    gboolean  changed;
+
+    str = value ? g_variant_print (value, TRUE) : NULL;
+    changed = cache_set_string (group, key, str);
+    g_free (str);
+    return changed;
+}
+
+static GVariant *
+cache_get_variant (const gchar        *group,
+                   const gchar        *key,
+                   const GVariantType *type)
+{
+    GVariant *value;
+    gchar    *str;
+    GError   *error = NULL;
+
+    str = g_key_file_get_string (cache, group, key, NULL);
+    if (!str)
+        return NULL;
+
+    value = g_variant_parse (type, str, NULL, NULL, &error);
+    if (!value) {
+        mm_dbg ("Invalid '%s' value in identity cache: %s", key, error->message);
+        g_error_free (error);
+    }
+    g_free (str);
+    return value;
+}
+
+/*****************************************************************************/
+
+gboolean
+mm_identity_cache_lookup_modem (const gchar  *imei,
+                                const gchar  *revision,
+                                GVariant    **supported_modes,
+                                GVariant    **supported_bands)
+{
+    gchar    *group;
+    GVariant *modes = NULL;
+    GVariant *bands = NULL;
+
+    if (!cache || !imei || !revision)
+        return FALSE;
+
+    group = build_group (MODEM_GROUP_PREFIX, imei, revision);
+    if (g_key_file_has_group (cache, group)) {
+        if (supported_modes)
+            modes = cache_get_variant (group, KEY_SUPPORTED_MODES, G_VARIANT_TYPE ("a(uu)"));
+        if (supported_bands)
+            bands = cache_get_variant (group, KEY_SUPPORTED_BANDS, G_VARIANT_TYPE ("au"));
+    }
+    g_free (group);
+
+    if (supported_modes)
+        *supported_modes = (modes ? g_variant_ref_sink (modes) : NULL);
+    if (supported_bands)
+        *supported_bands = (bands ? g_variant_ref_sink (bands) : NULL);
+    return (modes || bands);
+}
+
+void
+mm_identity_cache_store_modem (const gchar *imei,
+                               const gchar *revision,
+                               GVariant    *supported_modes,
+                               GVariant    *supported_bands)
+{
+    gchar    *group;
+    gboolean  changed = FALSE;
+
+    if (!cache || !imei || !revision || (!supported_modes && !supported_bands))
+        return;
+
+    g_return_if_fail (!supported_modes || g_variant_is_of_type (supported_modes, G_VARIANT_TYPE ("a(uu)")));
+    g_return_if_fail (!supported_bands || g_variant_is_of_type (supported_bands, G_VARIANT_TYPE ("au")));
+
+    group = build_group (MODEM_GROUP_PREFIX, imei, revision);
+    if (supported_modes)
+        changed |= cache_set_variant (group, KEY_SUPPORTED_MODES, supported_modes);
+    if (supported_bands)
+        changed |= cache_set_variant (group, KEY_SUPPORTED_BANDS, supported_bands);
+    changed |= cache_touch (group);
+    g_free (group);
+
+    if (changed) {
+        cache_prune (MODEM_GROUP_PREFIX);
+        cache_write ();
+    }
+}
+
+/*****************************************************************************/
+
+gboolean
+mm_identity_cache_lookup_sim (const gchar  *imei,
+                              const gchar  *sim_identifier,
+                              gchar       **imsi,
+                              gchar       **operator_identifier,
+                              gchar       **operator_name)
+{
+    gchar *group;
+
+    if (!cache || !imei || !sim_identifier)
+        return FALSE;
+
+    group = build_group (SIM_GROUP_PREFIX, imei, sim_identifier);
+    if (!g_key_file_has_group (cache, group)) {
+        g_free (group);
+        return FALSE;
+    }
+
+    *imsi = g_key_file_get_string (cache, group, KEY_IMSI, NULL);
+    if (!*imsi) {
+        g_free (group);
+        return FALSE;
+    }
+    *operator_identifier = g_key_file_get_string (cache, group, KEY_OPERATOR_IDENTIFIER, NULL);
+    *operator_name = g_key_file_get_string (cache, group, KEY_OPERATOR_NAME, NULL);
+    g_free (group);
+    return TRUE;
+}
+
+void
+mm_identity_cache_store_sim (const gchar *imei,
+                             const gchar *sim_identifier,
+                             const gchar *imsi,
+                             const gchar *operator_identifier,
+                             const gchar *operator_name)
+{
+    gchar    *group;
+    gboolean  changed = FALSE;
+
+    /* The IMSI cannot be read e.g. while the SIM is locked, don't store
+     * incomplete information */
+    if (!cache || !imei || !sim_identifier || !imsi)
+        return;
+
+    group = build_group (SIM_GROUP_PREFIX, imei, sim_identifier);
+    changed |= cache_set_string (group, KEY_IMSI, imsi);
+    changed |= cache_set_string (group, KEY_OPERATOR_IDENTIFIER, operator_identifier);
+    changed |= cache_set_string (group, KEY_OPERATOR_NAME, operator_name);
+    changed |= cache_touch (group);
+    g_free (group);
+
+    if (changed) {
+        cache_prune (SIM_GROUP_PREFIX);
+        cache_write ();
+    }
+}
+
+/*****************************************************************************/
+
+#define CARRIER_CONFIGS_TYPE G_VARIANT_TYPE ("a(ayuuus)")
+
+static gchar *
+build_carrier_config_group (const gchar *imei,
+                            const gchar *revision,
+                            const gchar *list_hash)
+{
+    gchar *id2;
+    gchar *group;
+
+    id2 = g_strdup_printf ("%s\n%s", revision, list_hash);
+    group = build_group (CARRIER_CONFIG_GROUP_PREFIX, imei, id2);
+    g_free (id2);
+    return group;
+}
+
+gboolean
+mm_identity_cache_lookup_carrier_configs (const gchar  *imei,
+                                          const gchar  *revision,
+                                          const gchar  *list_hash,
+                                          GVariant    **configs)
+{
+    gchar    *group;
+    GVariant *value = NULL;
+
+    if (!cache || !imei || !revision || !list_hash)
+        return FALSE;
+
+    group = build_carrier_config_group (imei, revision, list_hash);
+    if (g_key_file_has_group (cache, group))
+        value = cache_get_variant (group, KEY_CONFIGS, CARRIER_CONFIGS_TYPE);
+    g_free (group);
+
+    if (!value)
+        return FALSE;
+
+    *configs = g_variant_ref_sink (value);
+    return TRUE;
+}
+
+void
+mm_identity_cache_store_carrier_configs (const gchar *imei,
+                                         const gchar *revision,
+                                         const gchar *list_hash,
+                                         GVariant    *configs)
+{
+    gchar    *group;
+    gboolean  changed = FALSE;
+
+    if (!cache || !imei || !revision || !list_hash)
+        return;
+
+    g_return_if_fail (configs && g_variant_is_of_type (configs, CARRIER_CONFIGS_TYPE));
+
+    group = build_carrier_config_group (imei, revision, list_hash);
+    changed |= cache_set_variant (group, KEY_CONFIGS, configs);
+    changed |= cache_touch (group);
+    g_free (group);
+
+    if (changed) {
+        cache_prune (CARRIER_CONFIG_GROUP_PREFIX);
+        cache_write ();
+    }
+}
+
+/*****************************************************************************/
+
+gboolean
+mm_identity_cache_setup (const gchar  *path,
+                         GError      **error)
+{
+    GError *inner_error = NULL;
+    gchar  *dir;
+
+    g_return_val_if_fail (path != NULL, FALSE);
+
+    mm_identity_cache_shutdown ();
+
+    cache = g_key_file_new ();
+    cache_path = g_strdup (path);
+
+    dir = g_path_get_dirname (cache_path);
+    if (g_mkdir_with_parents (dir, 0700) < 0)
+        mm_warn ("Couldn't create identity cache directory '%s': %s", dir, g_strerror (errno));
+    else
+        g_chmod (dir, 0700);
+    g_free (dir);
+
+    if (!g_key_file_load_from_file (cache, cache_path, G_KEY_FILE_NONE, &inner_error)) {
+        /* A missing or corrupted cache is just started from scratch */
+        if (inner_error->domain != G_KEY_FILE_ERROR &&
+            !g_error_matches (inner_error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+            g_propagate_prefixed_error (error, inner_error, "Couldn't load identity cache: ");
+            mm_identity_cache_shutdown ();
+            return FALSE;
+        }
+        mm_dbg ("Starting new identity cache: %s", inner_error->message);
+        g_error_free (inner_error);
+        g_key_file_free (cache);
+        cache = g_key_file_new ();
+    } else if (g_key_file_get_integer (cache, CACHE_GROUP, CACHE_KEY_VERSION, NULL) != CACHE_VERSION) {
+        mm_dbg ("Discarding identity cache with unsupported version");
+        g_key_file_free (cache);
+        cache = g_key_file_new ();
+    }
+
+    g_key_file_set_integer (cache, CACHE_GROUP, CACHE_KEY_VERSION, CACHE_VERSION);
+    return TRUE;
+}
+
+void
+mm_identity_cache_shutdown (void)
+{
+    if (cache)
+        cache_flush ();
+    g_clear_pointer (&cache, g_key_file_free);
+    g_clear_pointer (&cache_path, g_free);
+}
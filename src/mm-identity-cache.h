@@ -0,0 +1,68 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+#ifndef MM_IDENTITY_CACHE_H
+#define MM_IDENTITY_CACHE_H
+
+#include <glib.h>
+
+/* Versioned on-disk cache of the data that never changes for a given modem
+ * (keyed by IMEI and firmware revision) or for a given SIM card in a given
+ * modem (keyed by IMEI and ICCID). A hit lets the initialization sequences
+ * skip the slow loads, which are then run again in the background to correct
+ * any drift. */
+
+gboolean mm_identity_cache_setup    (const gchar  *path,
+                                     GError      **error);
+void     mm_identity_cache_shutdown (void);
+gboolean mm_identity_cache_enabled  (void);
+
+/* Supported modes (a(uu)) and bands (au) of a modem, cached independently:
+ * the lookup succeeds if any of them is found (the other one is returned as
+ * NULL), and a NULL value given to store leaves the cached one untouched */
+gboolean mm_identity_cache_lookup_modem (const gchar  *imei,
+                                         const gchar  *revision,
+                                         GVariant    **supported_modes,
+                                         GVariant    **supported_bands);
+void     mm_identity_cache_store_modem  (const gchar  *imei,
+                                         const gchar  *revision,
+                                         GVariant     *supported_modes,
+                                         GVariant     *supported_bands);
+
+/* SIM card information; only the IMSI is mandatory */
+gboolean mm_identity_cache_lookup_sim (const gchar  *imei,
+                                       const gchar  *sim_identifier,
+                                       gchar       **imsi,
+                                       gchar       **operator_identifier,
+                                       gchar       **operator_name);
+void     mm_identity_cache_store_sim  (const gchar  *imei,
+                                       const gchar  *sim_identifier,
+                                       const gchar  *imsi,
+                                       const gchar  *operator_identifier,
+                                       const gchar  *operator_name);
+
+/* Carrier configurations installed in a modem (a(ayuuus): id, type,
+ * version, total size and description), also keyed by a hash of the list of
+ * configs reported by the modem, so that any change is detected */
+gboolean mm_identity_cache_lookup_carrier_configs (const gchar  *imei,
+                                                   const gchar  *revision,
+                                                   const gchar  *list_hash,
+                                                   GVariant    **configs);
+void     mm_identity_cache_store_carrier_configs  (const gchar  *imei,
+                                                   const gchar  *revision,
+                                                   const gchar  *list_hash,
+                                                   GVariant     *configs);
+
+#endif /* MM_IDENTITY_CACHE_H */
@@ -27,6 +27,7 @@
 #include "mm-base-modem.h"
 #include "mm-modem-helpers.h"
 #include "mm-log.h"
+#include "mm-trace.h"
 
 #define SUPPORT_CHECKED_TAG "3gpp-ussd-support-checked-tag"
 #define SUPPORTED_TAG       "3gpp-ussd-supported-tag"
@@ -828,6 +829,8 @@ interface_initialization_step (GTask *task)
     self = g_task_get_source_object (task);
     ctx = g_task_get_task_data (task);
 
+    mm_trace_step (task, "modem-3gpp-ussd-initialization", ctx->step, mm_base_modem_get_device (MM_BASE_MODEM (self)));
+
     switch (ctx->step) {
     case INITIALIZATION_STEP_FIRST:
         /* Setup quarks if we didn't do it before */
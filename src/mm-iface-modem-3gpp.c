@@ -27,6 +27,9 @@
 #include "mm-modem-helpers.h"
 #include "mm-error-helpers.h"
 #include "mm-log.h"
+#include "mm-trace.h"
+#include "mm-poll-scheduler.h"
+#include "mm-context.h"
 
 #define REGISTRATION_CHECK_TIMEOUT_SEC 30
 
@@ -34,9 +37,11 @@
 
 #define REGISTRATION_STATE_CONTEXT_TAG    "3gpp-registration-state-context-tag"
 #define REGISTRATION_CHECK_CONTEXT_TAG    "3gpp-registration-check-context-tag"
+#define NETWORK_SCAN_CONTEXT_TAG          "3gpp-network-scan-context-tag"
 
 static GQuark registration_state_context_quark;
 static GQuark registration_check_context_quark;
+static GQuark network_scan_context_quark;
 
 /*****************************************************************************/
 
@@ -677,7 +682,253 @@ scan_networks_build_result (GList *info_list)
         g_variant_builder_close (&builder);
     }
 
-    return g_variant_ref (g_variant_builder_end (&builder));
+    return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+/*****************************************************************************/
+/* Network scans
+ *
+ * Only if enabled in the daemon, scans are also run in the background while
+ * the modem is enabled but not connected, and the last results are kept for
+ * one scan interval. Requests received meanwhile get the cached results right
+ * away, or wait for the scan in progress, so that the modem doesn't run
+ * several of these long operations one after the other. */
+
+typedef struct {
+    guint     poll_id;
+    /* Id of the scan in progress, 0 if none */
+    guint     running_id;
+    /* HandleScanContexts waiting for the scan in progress */
+    GList    *waiters;
+    GVariant *results;
+    gint64    results_time;
+} NetworkScanContext;
+
+static void handle_scan_complete (HandleScanContext *ctx,
+                                  GVariant          *results,
+                                  const GError      *error);
+
+static void
+network_scan_context_complete_waiters (NetworkScanContext *ctx,
+                                       GVariant           *results,
+                                       const GError       *error)
+{
+    GList *waiters;
+    GList *l;
+
+    waiters = ctx->waiters;
+    ctx->waiters = NULL;
+    for (l = waiters; l; l = g_list_next (l))
+        handle_scan_complete ((HandleScanContext *) l->data, results, error);
+    g_list_free (waiters);
+}
+
+static void
+network_scan_context_free (NetworkScanContext *ctx)
+{
+    GError *error;
+
+    if (ctx->poll_id)
+        mm_poll_scheduler_remove (mm_poll_scheduler_get (), ctx->poll_id);
+
+    error = g_error_new (MM_CORE_ERROR, MM_CORE_ERROR_ABORTED,
+                         "Cannot scan networks: modem disabled");
+    network_scan_context_complete_waiters (ctx, NULL, error);
+    g_error_free (error);
+
+    if (ctx->results)
+        g_variant_unref (ctx->results);
+    g_slice_free (NetworkScanContext, ctx);
+}
+
+static NetworkScanContext *
+peek_network_scan_context (MMIfaceModem3gpp *self)
+{
+    if (G_UNLIKELY (!network_scan_context_quark))
+        network_scan_context_quark = (g_quark_from_static_string (
+                                          NETWORK_SCAN_CONTEXT_TAG));
+
+    return g_object_get_qdata (G_OBJECT (self), network_scan_context_quark);
+}
+
+static gboolean
+network_scan_results_fresh (NetworkScanContext *ctx)
+{
+    return (ctx->results &&
+            (g_get_monotonic_time () - ctx->results_time) < ((gint64) mm_context_get_network_scan_interval () * G_USEC_PER_SEC));
+}
+
+static void
+network_scan_emit_updated (MMIfaceModem3gpp *self,
+                           GVariant         *results)
+{
+    MmGdbusModem3gpp *skeleton = NULL;
+
+    mm_dbg ("Network scan results updated (%" G_GSIZE_FORMAT " networks)", g_variant_n_children (results));
+    g_object_get (self,
+                  MM_IFACE_MODEM_3GPP_DBUS_SKELETON, &skeleton,
+                  NULL);
+    if (skeleton) {
+        mm_gdbus_modem3gpp_emit_scan_updated (skeleton, results);
+        g_object_unref (skeleton);
+    }
+}
+
+static void
+network_scan_ready (MMIfaceModem3gpp *self,
+                    GAsyncResult     *res,
+                    gpointer          scan_id)
+{
+    NetworkScanContext *ctx;
+    GError             *error = NULL;
+    GList              *info_list;
+    GVariant           *results = NULL;
+
+    info_list = MM_IFACE_MODEM_3GPP_GET_INTERFACE (self)->scan_networks_finish (self, res, &error);
+    if (!error)
+        results = scan_networks_build_result (info_list);
+    mm_3gpp_network_info_list_free (info_list);
+
+    /* Ignore results of scans launched before the modem was disabled */
+    ctx = peek_network_scan_context (self);
+    if (!ctx || ctx->running_id != GPOINTER_TO_UINT (scan_id)) {
+        g_clear_error (&error);
+        if (results)
+            g_variant_unref (results);
+        return;
+    }
+    ctx->running_id = 0;
+
+    if (error) {
+        mm_dbg ("Couldn't scan networks: '%s'", error->message);
+        network_scan_context_complete_waiters (ctx, NULL, error);
+        g_error_free (error);
+        return;
+    }
+
+    /* Only notify differences */
+    if (!ctx->results || !g_variant_equal (ctx->results, results))
+        network_scan_emit_updated (self, results);
+
+    if (ctx->results)
+        g_variant_unref (ctx->results);
+    ctx->results = g_variant_ref (results);
+    ctx->results_time = g_get_monotonic_time ();
+
+    network_scan_context_complete_waiters (ctx, results, NULL);
+    g_variant_unref (results);
+}
+
+static void
+network_scan_run (MMIfaceModem3gpp   *self,
+                  NetworkScanContext *ctx)
+{
+    static guint next_id;
+
+    g_assert (!ctx->running_id);
+    ctx->running_id = ++next_id ? next_id : ++next_id;
+    MM_IFACE_MODEM_3GPP_GET_INTERFACE (self)->scan_networks (
+        self,
+        (GAsyncReadyCallback)network_scan_ready,
+        GUINT_TO_POINTER (ctx->running_id));
+}
+
+static gboolean
+network_scan_port_busy (MMIfaceModem3gpp *self)
+{
+    MMPortSerialAt *port;
+
+    port = mm_base_modem_peek_best_at_port (MM_BASE_MODEM (self), NULL);
+    return (port && mm_port_serial_is_busy (MM_PORT_SERIAL (port)));
+}
+
+static gboolean
+network_scan_poll (MMIfaceModem3gpp *self)
+{
+    NetworkScanContext *ctx;
+    MMModemState        modem_state = MM_MODEM_STATE_UNKNOWN;
+
+    ctx = peek_network_scan_context (self);
+
+    /* Only while idle */
+    g_object_get (self,
+                  MM_IFACE_MODEM_STATE, &modem_state,
+                  NULL);
+    if (modem_state != MM_MODEM_STATE_ENABLED &&
+        modem_state != MM_MODEM_STATE_SEARCHING &&
+        modem_state != MM_MODEM_STATE_REGISTERED)
+        return G_SOURCE_CONTINUE;
+
+    /* Not if a scan is running, or if one was just requested */
+    if (ctx->running_id || network_scan_results_fresh (ctx))
+        return G_SOURCE_CONTINUE;
+
+    /* A scan keeps the port busy for a long time, so never run it in the
+     * background while there is other work waiting for the port; the poll
+     * scheduler would only defer it a few times */
+    if (network_scan_port_busy (self)) {
+        mm_dbg ("Skipping background network scan: commands queued in the port");
+        return G_SOURCE_CONTINUE;
+    }
+
+    mm_dbg ("Running background network scan...");
+    network_scan_run (self, ctx);
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+network_scan_disable (MMIfaceModem3gpp *self)
+{
+    if (!peek_network_scan_context (self))
+        return;
+
+    /* Overwriting the data will free the previous context */
+    g_object_set_qdata (G_OBJECT (self), network_scan_context_quark, NULL);
+    mm_dbg ("Background 3GPP network scans disabled");
+}
+
+static void
+network_scan_enable (MMIfaceModem3gpp *self)
+{
+    NetworkScanContext *ctx;
+    guint               interval;
+
+    interval = mm_context_get_network_scan_interval ();
+    if (!interval ||
+        !MM_IFACE_MODEM_3GPP_GET_INTERFACE (self)->scan_networks ||
+        !MM_IFACE_MODEM_3GPP_GET_INTERFACE (self)->scan_networks_finish)
+        return;
+
+    /* If context is already there, we're already enabled */
+    if (peek_network_scan_context (self))
+        return;
+
+    mm_dbg ("Background 3GPP network scans enabled (every %u seconds)", interval);
+    ctx = g_slice_new0 (NetworkScanContext);
+    ctx->poll_id = mm_poll_scheduler_add (mm_poll_scheduler_get (),
+                                          MM_BASE_MODEM (self),
+                                          "3gpp-network-scan",
+                                          interval,
+                                          (GSourceFunc)network_scan_poll,
+                                          self);
+    g_object_set_qdata_full (G_OBJECT (self),
+                             network_scan_context_quark,
+                             ctx,
+                             (GDestroyNotify)network_scan_context_free);
+}
+
+static void
+handle_scan_complete (HandleScanContext *ctx,
+                      GVariant          *results,
+                      const GError      *error)
+{
+    if (error)
+        g_dbus_method_invocation_return_gerror (ctx->invocation, error);
+    else
+        mm_gdbus_modem3gpp_complete_scan (ctx->skeleton,
+                                          ctx->invocation,
+                                          results);
+    handle_scan_context_free (ctx);
 }
 
 static void
@@ -698,6 +949,9 @@ handle_scan_ready (MMIfaceModem3gpp *self,
         mm_gdbus_modem3gpp_complete_scan (ctx->skeleton,
                                           ctx->invocation,
                                           dict_array);
+        /* Without background scans no previous results are kept, so every
+         * requested scan is an update */
+        network_scan_emit_updated (self, dict_array);
         g_variant_unref (dict_array);
     }
 
@@ -705,6 +959,35 @@ handle_scan_ready (MMIfaceModem3gpp *self,
     handle_scan_context_free (ctx);
 }
 
+static void
+handle_scan_run (HandleScanContext *ctx)
+{
+    NetworkScanContext *scan_ctx;
+
+    /* Without background scans, just run one */
+    scan_ctx = peek_network_scan_context (ctx->self);
+    if (!scan_ctx) {
+        MM_IFACE_MODEM_3GPP_GET_INTERFACE (ctx->self)->scan_networks (
+            ctx->self,
+            (GAsyncReadyCallback)handle_scan_ready,
+            ctx);
+        return;
+    }
+
+    if (network_scan_results_fresh (scan_ctx)) {
+        mm_dbg ("Reusing network scan results from %" G_GINT64_FORMAT " seconds ago",
+                (g_get_monotonic_time () - scan_ctx->results_time) / G_USEC_PER_SEC);
+        handle_scan_complete (ctx, scan_ctx->results, NULL);
+        return;
+    }
+
+    scan_ctx->waiters = g_list_append (scan_ctx->waiters, ctx);
+    if (!scan_ctx->running_id)
+        network_scan_run (ctx->self, scan_ctx);
+    else
+        mm_dbg ("Network scan already in progress, waiting for its results...");
+}
+
 static void
 handle_scan_auth_ready (MMBaseModem *self,
                         GAsyncResult *res,
@@ -766,10 +1049,7 @@ handle_scan_auth_ready (MMBaseModem *self,
     case MM_MODEM_STATE_DISCONNECTING:
     case MM_MODEM_STATE_CONNECTING:
     case MM_MODEM_STATE_CONNECTED:
-        MM_IFACE_MODEM_3GPP_GET_INTERFACE (self)->scan_networks (
-            MM_IFACE_MODEM_3GPP (self),
-            (GAsyncReadyCallback)handle_scan_ready,
-            ctx);
+        handle_scan_run (ctx);
         return;
     }
 
@@ -1485,6 +1765,8 @@ update_registration_state (MMIfaceModem3gpp *self,
     update_non_registered_state (self, old_state, new_state);
 }
 
+static void registration_state_reported (MMIfaceModem3gpp *self);
+
 void
 mm_iface_modem_3gpp_update_cs_registration_state (MMIfaceModem3gpp *self,
                                                   MMModem3gppRegistrationState state)
@@ -1502,6 +1784,7 @@ mm_iface_modem_3gpp_update_cs_registration_state (MMIfaceModem3gpp *self,
     ctx = get_registration_state_context (self);
     ctx->cs = state;
     update_registration_state (self, get_consolidated_reg_state (ctx), TRUE);
+    registration_state_reported (self);
 }
 
 void
@@ -1521,6 +1804,7 @@ mm_iface_modem_3gpp_update_ps_registration_state (MMIfaceModem3gpp *self,
     ctx = get_registration_state_context (self);
     ctx->ps = state;
     update_registration_state (self, get_consolidated_reg_state (ctx), TRUE);
+    registration_state_reported (self);
 }
 
 void
@@ -1540,6 +1824,7 @@ mm_iface_modem_3gpp_update_eps_registration_state (MMIfaceModem3gpp *self,
     ctx = get_registration_state_context (self);
     ctx->eps = state;
     update_registration_state (self, get_consolidated_reg_state (ctx), TRUE);
+    registration_state_reported (self);
 }
 
 /*****************************************************************************/
@@ -1553,10 +1838,26 @@ static void
 registration_check_context_free (RegistrationCheckContext *ctx)
 {
     if (ctx->timeout_source)
-        g_source_remove (ctx->timeout_source);
+        mm_poll_scheduler_remove (mm_poll_scheduler_get (), ctx->timeout_source);
     g_free (ctx);
 }
 
+static void
+registration_state_reported (MMIfaceModem3gpp *self)
+{
+    RegistrationCheckContext *ctx;
+
+    if (G_UNLIKELY (!registration_check_context_quark))
+        return;
+
+    /* If the registration state was reported by other means (e.g. unsolicited
+     * messages) and not by our own periodic check, there's no point in
+     * polling it again soon */
+    ctx = g_object_get_qdata (G_OBJECT (self), registration_check_context_quark);
+    if (ctx && ctx->timeout_source && !ctx->running)
+        mm_poll_scheduler_notify_fresh (mm_poll_scheduler_get (), ctx->timeout_source);
+}
+
 static void
 periodic_registration_checks_ready (MMIfaceModem3gpp *self,
                                     GAsyncResult *res)
@@ -1626,7 +1927,10 @@ periodic_registration_check_enable (MMIfaceModem3gpp *self)
     /* Create context and keep it as object data */
     mm_dbg ("Periodic 3GPP registration checks enabled");
     ctx = g_new0 (RegistrationCheckContext, 1);
-    ctx->timeout_source = g_timeout_add_seconds (REGISTRATION_CHECK_TIMEOUT_SEC,
+    ctx->timeout_source = mm_poll_scheduler_add (mm_poll_scheduler_get (),
+                                                 MM_BASE_MODEM (self),
+                                                 "3gpp-registration",
+                                                 REGISTRATION_CHECK_TIMEOUT_SEC,
                                                  (GSourceFunc)periodic_registration_check,
                                                  self);
     g_object_set_qdata_full (G_OBJECT (self),
@@ -1716,6 +2020,7 @@ typedef enum {
     DISABLING_STEP_FIRST,
     DISABLING_STEP_INITIAL_EPS_BEARER,
     DISABLING_STEP_PERIODIC_REGISTRATION_CHECKS,
+    DISABLING_STEP_NETWORK_SCANS,
     DISABLING_STEP_DISABLE_UNSOLICITED_REGISTRATION_EVENTS,
     DISABLING_STEP_CLEANUP_UNSOLICITED_REGISTRATION_EVENTS,
     DISABLING_STEP_CLEANUP_UNSOLICITED_EVENTS,
@@ -1801,6 +2106,12 @@ interface_disabling_step (GTask *task)
         /* Fall down to next step */
         ctx->step++;
 
+    case DISABLING_STEP_NETWORK_SCANS:
+        /* Disable background network scans, if they were set */
+        network_scan_disable (self);
+        /* Fall down to next step */
+        ctx->step++;
+
     case DISABLING_STEP_DISABLE_UNSOLICITED_REGISTRATION_EVENTS: {
         gboolean cs_supported = FALSE;
         gboolean ps_supported = FALSE;
@@ -1921,6 +2232,7 @@ typedef enum {
     ENABLING_STEP_SETUP_UNSOLICITED_REGISTRATION_EVENTS,
     ENABLING_STEP_ENABLE_UNSOLICITED_REGISTRATION_EVENTS,
     ENABLING_STEP_INITIAL_EPS_BEARER,
+    ENABLING_STEP_NETWORK_SCANS,
     ENABLING_STEP_LAST
 } EnablingStep;
 
@@ -2176,6 +2488,12 @@ interface_enabling_step (GTask *task)
         ctx->step++;
     }
 
+    case ENABLING_STEP_NETWORK_SCANS:
+        /* Setup background network scans, if enabled in the daemon */
+        network_scan_enable (self);
+        /* Fall down to next step */
+        ctx->step++;
+
     case ENABLING_STEP_LAST:
         /* We are done without errors! */
         g_task_return_boolean (task, TRUE);
@@ -2391,6 +2709,8 @@ interface_initialization_step (GTask *task)
     self = g_task_get_source_object (task);
     ctx = g_task_get_task_data (task);
 
+    mm_trace_step (task, "modem-3gpp-initialization", ctx->step, mm_base_modem_get_device (MM_BASE_MODEM (self)));
+
     switch (ctx->step) {
     case INITIALIZATION_STEP_FIRST:
         /* Fall down to next step */
@@ -2556,6 +2876,10 @@ mm_iface_modem_3gpp_shutdown (MMIfaceModem3gpp *self)
         g_object_set_qdata (G_OBJECT (self),
                             registration_check_context_quark,
                             NULL);
+    if (G_LIKELY (network_scan_context_quark))
+        g_object_set_qdata (G_OBJECT (self),
+                            network_scan_context_quark,
+                            NULL);
 
     /* Unexport DBus interface and remove the skeleton */
     mm_gdbus_object_skeleton_set_modem3gpp (MM_GDBUS_OBJECT_SKELETON (self), NULL);
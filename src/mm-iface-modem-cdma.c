@@ -24,6 +24,8 @@
 #include "mm-base-modem.h"
 #include "mm-modem-helpers.h"
 #include "mm-log.h"
+#include "mm-trace.h"
+#include "mm-poll-scheduler.h"
 
 #define REGISTRATION_CHECK_TIMEOUT_SEC 30
 
@@ -1033,6 +1035,8 @@ mm_iface_modem_cdma_update_access_technologies (MMIfaceModemCdma *self,
                                                    MM_IFACE_MODEM_CDMA_ALL_ACCESS_TECHNOLOGIES_MASK);
 }
 
+static void registration_state_reported (MMIfaceModemCdma *self);
+
 void
 mm_iface_modem_cdma_update_evdo_registration_state (MMIfaceModemCdma *self,
                                                     MMModemCdmaRegistrationState state)
@@ -1070,6 +1074,8 @@ mm_iface_modem_cdma_update_evdo_registration_state (MMIfaceModemCdma *self,
                                                    MM_MODEM_STATE_CHANGE_REASON_UNKNOWN);
             break;
         }
+
+        registration_state_reported (self);
     }
 
     g_object_unref (skeleton);
@@ -1121,6 +1127,8 @@ mm_iface_modem_cdma_update_cdma1x_registration_state (MMIfaceModemCdma *self,
                                                    MM_MODEM_STATE_CHANGE_REASON_UNKNOWN);
             break;
         }
+
+        registration_state_reported (self);
     }
 
     g_object_unref (skeleton);
@@ -1137,10 +1145,26 @@ static void
 registration_check_context_free (RegistrationCheckContext *ctx)
 {
     if (ctx->timeout_source)
-        g_source_remove (ctx->timeout_source);
+        mm_poll_scheduler_remove (mm_poll_scheduler_get (), ctx->timeout_source);
     g_free (ctx);
 }
 
+static void
+registration_state_reported (MMIfaceModemCdma *self)
+{
+    RegistrationCheckContext *ctx;
+
+    if (G_UNLIKELY (!registration_check_context_quark))
+        return;
+
+    /* If the registration state was reported by other means (e.g. unsolicited
+     * messages) and not by our own periodic check, there's no point in
+     * polling it again soon */
+    ctx = g_object_get_qdata (G_OBJECT (self), registration_check_context_quark);
+    if (ctx && ctx->timeout_source && !ctx->running)
+        mm_poll_scheduler_notify_fresh (mm_poll_scheduler_get (), ctx->timeout_source);
+}
+
 static void
 periodic_registration_checks_ready (MMIfaceModemCdma *self,
                                     GAsyncResult *res)
@@ -1210,7 +1234,10 @@ periodic_registration_check_enable (MMIfaceModemCdma *self)
     /* Create context and keep it as object data */
     mm_dbg ("Periodic CDMA registration checks enabled");
     ctx = g_new0 (RegistrationCheckContext, 1);
-    ctx->timeout_source = g_timeout_add_seconds (REGISTRATION_CHECK_TIMEOUT_SEC,
+    ctx->timeout_source = mm_poll_scheduler_add (mm_poll_scheduler_get (),
+                                                 MM_BASE_MODEM (self),
+                                                 "cdma-registration",
+                                                 REGISTRATION_CHECK_TIMEOUT_SEC,
                                                  (GSourceFunc)periodic_registration_check,
                                                  self);
     g_object_set_qdata_full (G_OBJECT (self),
@@ -1684,6 +1711,8 @@ interface_initialization_step (GTask *task)
     self = g_task_get_source_object (task);
     ctx = g_task_get_task_data (task);
 
+    mm_trace_step (task, "modem-cdma-initialization", ctx->step, mm_base_modem_get_device (MM_BASE_MODEM (self)));
+
     switch (ctx->step) {
     case INITIALIZATION_STEP_FIRST:
         /* Fall down to next step */
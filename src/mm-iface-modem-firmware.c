@@ -20,6 +20,7 @@
 #include "mm-iface-modem.h"
 #include "mm-iface-modem-firmware.h"
 #include "mm-log.h"
+#include "mm-trace.h"
 
 /*****************************************************************************/
 
@@ -432,6 +433,8 @@ interface_initialization_step (GTask *task)
     self = g_task_get_source_object (task);
     ctx = g_task_get_task_data (task);
 
+    mm_trace_step (task, "modem-firmware-initialization", ctx->step, mm_base_modem_get_device (MM_BASE_MODEM (self)));
+
     switch (ctx->step) {
     case INITIALIZATION_STEP_FIRST:
         /* Fall down to next step */
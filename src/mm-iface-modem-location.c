@@ -22,6 +22,7 @@
 #include "mm-iface-modem.h"
 #include "mm-iface-modem-location.h"
 #include "mm-log.h"
+#include "mm-trace.h"
 #include "mm-modem-helpers.h"
 
 #define MM_LOCATION_GPS_REFRESH_TIME_SECS 30
@@ -626,6 +627,8 @@ setup_gathering_step (GTask *task)
         return;
     }
 
+    mm_trace_step (task, "modem-location-setup-gathering", ctx->current, mm_base_modem_get_device (MM_BASE_MODEM (self)));
+
     while (ctx->current <= MM_MODEM_LOCATION_SOURCE_LAST) {
         gchar *source_str;
 
@@ -1706,6 +1709,8 @@ interface_initialization_step (GTask *task)
     self = g_task_get_source_object (task);
     ctx = g_task_get_task_data (task);
 
+    mm_trace_step (task, "modem-location-initialization", ctx->step, mm_base_modem_get_device (MM_BASE_MODEM (self)));
+
     switch (ctx->step) {
     case INITIALIZATION_STEP_FIRST:
         /* Fall down to next step */
@@ -20,6 +20,7 @@
 #include "mm-iface-modem.h"
 #include "mm-iface-modem-oma.h"
 #include "mm-log.h"
+#include "mm-trace.h"
 
 #define SUPPORT_CHECKED_TAG "oma-support-checked-tag"
 #define SUPPORTED_TAG       "oma-supported-tag"
@@ -1061,6 +1062,8 @@ interface_initialization_step (GTask *task)
     self = g_task_get_source_object (task);
     ctx = g_task_get_task_data (task);
 
+    mm_trace_step (task, "modem-oma-initialization", ctx->step, mm_base_modem_get_device (MM_BASE_MODEM (self)));
+
     switch (ctx->step) {
     case INITIALIZATION_STEP_FIRST:
         /* Setup quarks if we didn't do it before */
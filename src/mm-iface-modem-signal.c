@@ -20,6 +20,8 @@
 #include "mm-iface-modem.h"
 #include "mm-iface-modem-signal.h"
 #include "mm-log.h"
+#include "mm-trace.h"
+#include "mm-poll-scheduler.h"
 
 #define SUPPORT_CHECKED_TAG "signal-support-checked-tag"
 #define SUPPORTED_TAG       "signal-supported-tag"
@@ -48,7 +50,7 @@ static void
 refresh_context_free (RefreshContext *ctx)
 {
     if (ctx->timeout_source)
-        g_source_remove (ctx->timeout_source);
+        mm_poll_scheduler_remove (mm_poll_scheduler_get (), ctx->timeout_source);
     g_slice_free (RefreshContext, ctx);
 }
 
@@ -72,33 +74,16 @@ clear_values (MMIfaceModemSignal *self)
 }
 
 static void
-load_values_ready (MMIfaceModemSignal *self,
-                   GAsyncResult *res)
+update_values (MMIfaceModemSignal *self,
+               MMSignal           *cdma,
+               MMSignal           *evdo,
+               MMSignal           *gsm,
+               MMSignal           *umts,
+               MMSignal           *lte)
 {
     GVariant *dictionary;
-    GError *error = NULL;
-    MMSignal *cdma = NULL;
-    MMSignal *evdo = NULL;
-    MMSignal *gsm = NULL;
-    MMSignal *umts = NULL;
-    MMSignal *lte = NULL;
     MmGdbusModemSignal *skeleton;
 
-    if (!MM_IFACE_MODEM_SIGNAL_GET_INTERFACE (self)->load_values_finish (
-            self,
-            res,
-            &cdma,
-            &evdo,
-            &gsm,
-            &umts,
-            &lte,
-            &error)) {
-        mm_warn ("Couldn't load extended signal information: %s", error->message);
-        g_error_free (error);
-        clear_values (self);
-        return;
-    }
-
     g_object_get (self,
                   MM_IFACE_MODEM_SIGNAL_DBUS_SKELETON, &skeleton,
                   NULL);
@@ -112,7 +97,6 @@ load_values_ready (MMIfaceModemSignal *self,
         dictionary = mm_signal_get_dictionary (cdma);
         mm_gdbus_modem_signal_set_cdma (skeleton, dictionary);
         g_variant_unref (dictionary);
-        g_object_unref (cdma);
     } else
         mm_gdbus_modem_signal_set_cdma (skeleton, NULL);
 
@@ -120,7 +104,6 @@ load_values_ready (MMIfaceModemSignal *self,
         dictionary = mm_signal_get_dictionary (evdo);
         mm_gdbus_modem_signal_set_evdo (skeleton, dictionary);
         g_variant_unref (dictionary);
-        g_object_unref (evdo);
     } else
         mm_gdbus_modem_signal_set_evdo (skeleton, NULL);
 
@@ -128,7 +111,6 @@ load_values_ready (MMIfaceModemSignal *self,
         dictionary = mm_signal_get_dictionary (gsm);
         mm_gdbus_modem_signal_set_gsm (skeleton, dictionary);
         g_variant_unref (dictionary);
-        g_object_unref (gsm);
     } else
         mm_gdbus_modem_signal_set_gsm (skeleton, NULL);
 
@@ -136,7 +118,6 @@ load_values_ready (MMIfaceModemSignal *self,
         dictionary = mm_signal_get_dictionary (umts);
         mm_gdbus_modem_signal_set_umts (skeleton, dictionary);
         g_variant_unref (dictionary);
-        g_object_unref (umts);
     } else
         mm_gdbus_modem_signal_set_umts (skeleton, NULL);
 
@@ -144,7 +125,6 @@ load_values_ready (MMIfaceModemSignal *self,
         dictionary = mm_signal_get_dictionary (lte);
         mm_gdbus_modem_signal_set_lte (skeleton, dictionary);
         g_variant_unref (dictionary);
-        g_object_unref (lte);
     } else
         mm_gdbus_modem_signal_set_lte (skeleton, NULL);
 
@@ -154,6 +134,66 @@ load_values_ready (MMIfaceModemSignal *self,
     g_object_unref (skeleton);
 }
 
+void
+mm_iface_modem_signal_update (MMIfaceModemSignal *self,
+                              MMSignal           *cdma,
+                              MMSignal           *evdo,
+                              MMSignal           *gsm,
+                              MMSignal           *umts,
+                              MMSignal           *lte)
+{
+    RefreshContext *ctx;
+
+    if (G_UNLIKELY (!refresh_context_quark))
+        return;
+
+    /* Only while extended signal information reporting is enabled */
+    ctx = g_object_get_qdata (G_OBJECT (self), refresh_context_quark);
+    if (!ctx)
+        return;
+
+    update_values (self, cdma, evdo, gsm, umts, lte);
+
+    /* Reported by other means, so there's no point in polling again soon */
+    if (ctx->timeout_source)
+        mm_poll_scheduler_notify_fresh (mm_poll_scheduler_get (), ctx->timeout_source);
+}
+
+static void
+load_values_ready (MMIfaceModemSignal *self,
+                   GAsyncResult *res)
+{
+    GError *error = NULL;
+    MMSignal *cdma = NULL;
+    MMSignal *evdo = NULL;
+    MMSignal *gsm = NULL;
+    MMSignal *umts = NULL;
+    MMSignal *lte = NULL;
+
+    if (!MM_IFACE_MODEM_SIGNAL_GET_INTERFACE (self)->load_values_finish (
+            self,
+            res,
+            &cdma,
+            &evdo,
+            &gsm,
+            &umts,
+            &lte,
+            &error)) {
+        mm_warn ("Couldn't load extended signal information: %s", error->message);
+        g_error_free (error);
+        clear_values (self);
+        return;
+    }
+
+    update_values (self, cdma, evdo, gsm, umts, lte);
+
+    g_clear_object (&cdma);
+    g_clear_object (&evdo);
+    g_clear_object (&gsm);
+    g_clear_object (&umts);
+    g_clear_object (&lte);
+}
+
 static gboolean
 refresh_context_cb (MMIfaceModemSignal *self)
 {
@@ -239,8 +279,13 @@ setup_refresh_context (MMIfaceModemSignal *self,
     mm_dbg ("Extended signal information reporting enabled (rate: %u seconds)", new_rate);
     ctx->rate = new_rate;
     if (ctx->timeout_source)
-        g_source_remove (ctx->timeout_source);
-    ctx->timeout_source = g_timeout_add_seconds (ctx->rate, (GSourceFunc) refresh_context_cb, self);
+        mm_poll_scheduler_remove (mm_poll_scheduler_get (), ctx->timeout_source);
+    ctx->timeout_source = mm_poll_scheduler_add (mm_poll_scheduler_get (),
+                                                 MM_BASE_MODEM (self),
+                                                 "extended-signal",
+                                                 ctx->rate,
+                                                 (GSourceFunc) refresh_context_cb,
+                                                 self);
 
     /* Also launch right away */
     refresh_context_cb (self);
@@ -431,6 +476,8 @@ interface_initialization_step (GTask *task)
     self = g_task_get_source_object (task);
     ctx = g_task_get_task_data (task);
 
+    mm_trace_step (task, "modem-signal-initialization", ctx->step, mm_base_modem_get_device (MM_BASE_MODEM (self)));
+
     switch (ctx->step) {
     case INITIALIZATION_STEP_FIRST:
         /* Setup quarks if we didn't do it before */
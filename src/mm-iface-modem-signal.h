@@ -88,6 +88,16 @@ gboolean mm_iface_modem_signal_disable_finish (MMIfaceModemSignal *self,
 /* Shutdown Signal interface */
 void mm_iface_modem_signal_shutdown (MMIfaceModemSignal *self);
 
+/* Report extended signal information received by other means than the
+ * periodic load (e.g. unsolicited messages); ignored unless reporting is
+ * enabled */
+void mm_iface_modem_signal_update (MMIfaceModemSignal *self,
+                                   MMSignal *cdma,
+                                   MMSignal *evdo,
+                                   MMSignal *gsm,
+                                   MMSignal *umts,
+                                   MMSignal *lte);
+
 /* Bind properties for simple GetStatus() */
 void mm_iface_modem_signal_bind_simple_status (MMIfaceModemSignal *self,
                                                MMSimpleStatus *status);
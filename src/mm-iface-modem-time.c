@@ -20,6 +20,8 @@
 #include "mm-iface-modem.h"
 #include "mm-iface-modem-time.h"
 #include "mm-log.h"
+#include "mm-trace.h"
+#include "mm-poll-scheduler.h"
 
 #define SUPPORT_CHECKED_TAG          "time-support-checked-tag"
 #define SUPPORTED_TAG                "time-supported-tag"
@@ -145,7 +147,7 @@ network_timezone_context_free (NetworkTimezoneContext *ctx)
      * in stop_network_timezone() when the logic is disabled (or will be done
      * automatically when the last modem object reference is dropped) */
     if (ctx->network_timezone_poll_id)
-        g_source_remove (ctx->network_timezone_poll_id);
+        mm_poll_scheduler_remove (mm_poll_scheduler_get (), ctx->network_timezone_poll_id);
     g_free (ctx);
 }
 
@@ -203,7 +205,10 @@ load_network_timezone_ready (MMIfaceModemTime *self,
         }
 
         /* Otherwise, relaunch timeout to query a bit later */
-        ctx->network_timezone_poll_id = g_timeout_add_seconds (NETWORK_TIMEZONE_POLL_INTERVAL_SEC,
+        ctx->network_timezone_poll_id = mm_poll_scheduler_add (mm_poll_scheduler_get (),
+                                                               MM_BASE_MODEM (self),
+                                                               "network-timezone",
+                                                               NETWORK_TIMEZONE_POLL_INTERVAL_SEC,
                                                                (GSourceFunc)network_timezone_poll_cb,
                                                                self);
         return;
@@ -239,7 +244,12 @@ start_network_timezone_poll (MMIfaceModemTime *self)
 
     mm_dbg ("Network timezone polling started");
     ctx->network_timezone_poll_retries = NETWORK_TIMEZONE_POLL_RETRIES;
-    ctx->network_timezone_poll_id = g_timeout_add_seconds (NETWORK_TIMEZONE_POLL_INTERVAL_SEC, (GSourceFunc)network_timezone_poll_cb, self);
+    ctx->network_timezone_poll_id = mm_poll_scheduler_add (mm_poll_scheduler_get (),
+                                                           MM_BASE_MODEM (self),
+                                                           "network-timezone",
+                                                           NETWORK_TIMEZONE_POLL_INTERVAL_SEC,
+                                                           (GSourceFunc)network_timezone_poll_cb,
+                                                           self);
 }
 
 static void
@@ -251,7 +261,7 @@ stop_network_timezone_poll (MMIfaceModemTime *self)
 
     if (ctx->network_timezone_poll_id) {
         mm_dbg ("Network timezone polling stopped");
-        g_source_remove (ctx->network_timezone_poll_id);
+        mm_poll_scheduler_remove (mm_poll_scheduler_get (), ctx->network_timezone_poll_id);
         ctx->network_timezone_poll_id = 0;
     }
 }
@@ -336,6 +346,21 @@ start_network_timezone (MMIfaceModemTime *self)
 
 /*****************************************************************************/
 
+static void
+network_timezone_reported (MMIfaceModemTime *self)
+{
+    NetworkTimezoneContext *ctx;
+
+    if (G_UNLIKELY (!network_timezone_context_quark))
+        return;
+
+    /* If the timezone was reported by other means (e.g. unsolicited
+     * messages), there's no point in polling it again soon */
+    ctx = (NetworkTimezoneContext *) g_object_get_qdata (G_OBJECT (self), network_timezone_context_quark);
+    if (ctx && ctx->network_timezone_poll_id)
+        mm_poll_scheduler_notify_fresh (mm_poll_scheduler_get (), ctx->network_timezone_poll_id);
+}
+
 void
 mm_iface_modem_time_update_network_time (MMIfaceModemTime *self,
                                          const gchar *network_time)
@@ -373,6 +398,8 @@ mm_iface_modem_time_update_network_timezone (MMIfaceModemTime  *self,
         g_variant_unref (dictionary);
 
     g_object_unref (skeleton);
+
+    network_timezone_reported (self);
 }
 
 /*****************************************************************************/
@@ -771,6 +798,8 @@ interface_initialization_step (GTask *task)
     self = g_task_get_source_object (task);
     ctx = g_task_get_task_data (task);
 
+    mm_trace_step (task, "modem-time-initialization", ctx->step, mm_base_modem_get_device (MM_BASE_MODEM (self)));
+
     switch (ctx->step) {
     case INITIALIZATION_STEP_FIRST:
         /* Setup quarks if we didn't do it before */
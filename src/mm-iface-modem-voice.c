@@ -22,6 +22,8 @@
 #include "mm-iface-modem-voice.h"
 #include "mm-call-list.h"
 #include "mm-log.h"
+#include "mm-trace.h"
+#include "mm-poll-scheduler.h"
 
 #define SUPPORT_CHECKED_TAG           "voice-support-checked-tag"
 #define SUPPORTED_TAG                 "voice-supported-tag"
@@ -196,6 +198,8 @@ report_call_foreach (MMBaseCall               *call,
         ctx->call_info = NULL;
 }
 
+static void call_list_reported (MMIfaceModemVoice *self);
+
 void
 mm_iface_modem_voice_report_call (MMIfaceModemVoice *self,
                                   const MMCallInfo  *call_info)
@@ -211,6 +215,8 @@ mm_iface_modem_voice_report_call (MMIfaceModemVoice *self,
      */
     g_assert (call_info->state != MM_CALL_STATE_UNKNOWN);
 
+    call_list_reported (self);
+
     /* Early debugging of the call state update */
     mm_dbg ("call at index %u: direction %s, state %s, number %s",
             call_info->index,
@@ -319,6 +325,8 @@ mm_iface_modem_voice_report_all_calls (MMIfaceModemVoice *self,
     MMCallList                   *list = NULL;
     GList                        *l;
 
+    call_list_reported (self);
+
     /* Early debugging of the full list of calls */
     mm_dbg ("Reported %u ongoing calls", g_list_length (call_info_list));
     for (l = call_info_list; l; l = g_list_next (l)) {
@@ -2320,7 +2328,7 @@ static void
 call_list_polling_context_free (CallListPollingContext *ctx)
 {
     if (ctx->polling_id)
-        g_source_remove (ctx->polling_id);
+        mm_poll_scheduler_remove (mm_poll_scheduler_get (), ctx->polling_id);
     g_slice_free (CallListPollingContext, ctx);
 }
 
@@ -2350,6 +2358,22 @@ get_call_list_polling_context (MMIfaceModemVoice *self)
 
 static gboolean call_list_poll (MMIfaceModemVoice *self);
 
+static void
+call_list_reported (MMIfaceModemVoice *self)
+{
+    CallListPollingContext *ctx;
+
+    if (G_UNLIKELY (!call_list_polling_context_quark))
+        return;
+
+    /* If call updates were reported by other means (e.g. unsolicited
+     * messages) and not by our own poll, there's no point in polling the
+     * call list again soon */
+    ctx = g_object_get_qdata (G_OBJECT (self), call_list_polling_context_quark);
+    if (ctx && ctx->polling_id && !ctx->polling_ongoing)
+        mm_poll_scheduler_notify_fresh (mm_poll_scheduler_get (), ctx->polling_id);
+}
+
 static void
 load_call_list_ready (MMIfaceModemVoice *self,
                       GAsyncResult      *res)
@@ -2373,7 +2397,10 @@ load_call_list_ready (MMIfaceModemVoice *self,
 
     /* setup the polling again */
     g_assert (!ctx->polling_id);
-    ctx->polling_id = g_timeout_add_seconds (CALL_LIST_POLLING_TIMEOUT_SECS,
+    ctx->polling_id = mm_poll_scheduler_add (mm_poll_scheduler_get (),
+                                             MM_BASE_MODEM (self),
+                                             "call-list",
+                                             CALL_LIST_POLLING_TIMEOUT_SECS,
                                              (GSourceFunc) call_list_poll,
                                              self);
 }
@@ -2444,7 +2471,10 @@ setup_call_list_polling (MMCallList        *call_list,
     ctx = get_call_list_polling_context (self);
 
     if (!ctx->polling_id && !ctx->polling_ongoing)
-        ctx->polling_id = g_timeout_add_seconds (CALL_LIST_POLLING_TIMEOUT_SECS,
+        ctx->polling_id = mm_poll_scheduler_add (mm_poll_scheduler_get (),
+                                                 MM_BASE_MODEM (self),
+                                                 "call-list",
+                                                 CALL_LIST_POLLING_TIMEOUT_SECS,
                                                  (GSourceFunc) call_list_poll,
                                                  self);
 }
@@ -2915,6 +2945,8 @@ interface_initialization_step (GTask *task)
     self = g_task_get_source_object (task);
     ctx = g_task_get_task_data (task);
 
+    mm_trace_step (task, "modem-voice-initialization", ctx->step, mm_base_modem_get_device (MM_BASE_MODEM (self)));
+
     switch (ctx->step) {
     case INITIALIZATION_STEP_FIRST:
         /* Setup quarks if we didn't do it before */
@@ -27,7 +27,10 @@
 #include "mm-base-sim.h"
 #include "mm-bearer-list.h"
 #include "mm-log.h"
+#include "mm-trace.h"
 #include "mm-context.h"
+#include "mm-poll-scheduler.h"
+#include "mm-identity-cache.h"
 
 #define SIGNAL_QUALITY_RECENT_TIMEOUT_SEC 60
 
@@ -1122,11 +1125,14 @@ update_signal_quality (MMIfaceModem *self,
     g_object_unref (skeleton);
 }
 
+static void signal_quality_reported (MMIfaceModem *self);
+
 void
 mm_iface_modem_update_signal_quality (MMIfaceModem *self,
                                       guint signal_quality)
 {
     update_signal_quality (self, signal_quality, TRUE);
+    signal_quality_reported (self);
 }
 
 /*****************************************************************************/
@@ -1163,7 +1169,7 @@ static void
 signal_check_context_free (SignalCheckContext *ctx)
 {
     if (ctx->timeout_source)
-        g_source_remove (ctx->timeout_source);
+        mm_poll_scheduler_remove (mm_poll_scheduler_get (), ctx->timeout_source);
     g_slice_free (SignalCheckContext, ctx);
 }
 
@@ -1202,6 +1208,21 @@ get_signal_check_context (MMIfaceModem *self)
     return ctx;
 }
 
+static void
+signal_quality_reported (MMIfaceModem *self)
+{
+    SignalCheckContext *ctx;
+
+    if (G_UNLIKELY (!signal_check_context_quark))
+        return;
+
+    /* If the signal quality was reported by other means while we're polling
+     * at the slow rate, there's no point in polling it again soon */
+    ctx = g_object_get_qdata (G_OBJECT (self), signal_check_context_quark);
+    if (ctx && ctx->timeout_source && ctx->interval == SIGNAL_CHECK_TIMEOUT_SEC)
+        mm_poll_scheduler_notify_fresh (mm_poll_scheduler_get (), ctx->timeout_source);
+}
+
 static void     periodic_signal_check_disable (MMIfaceModem *self,
                                                gboolean      clear);
 static gboolean periodic_signal_check_cb      (MMIfaceModem *self);
@@ -1355,7 +1376,12 @@ peridic_signal_check_step (MMIfaceModem *self)
 
         mm_dbg ("Periodic signal quality checks scheduled in %ds", ctx->interval);
         g_assert (!ctx->timeout_source);
-        ctx->timeout_source = g_timeout_add_seconds (ctx->interval, (GSourceFunc) periodic_signal_check_cb, self);
+        ctx->timeout_source = mm_poll_scheduler_add (mm_poll_scheduler_get (),
+                                                     MM_BASE_MODEM (self),
+                                                     "signal-quality",
+                                                     ctx->interval,
+                                                     (GSourceFunc) periodic_signal_check_cb,
+                                                     self);
         return;
     }
 }
@@ -1404,7 +1430,7 @@ mm_iface_modem_refresh_signal (MMIfaceModem *self)
     /* Remove the scheduled timeout as we're going to refresh
      * right away */
     if (ctx->timeout_source) {
-        g_source_remove (ctx->timeout_source);
+        mm_poll_scheduler_remove (mm_poll_scheduler_get (), ctx->timeout_source);
         ctx->timeout_source = 0;
     }
 
@@ -1437,7 +1463,7 @@ periodic_signal_check_disable (MMIfaceModem *self,
 
     /* Remove scheduled timeout */
     if (ctx->timeout_source) {
-        g_source_remove (ctx->timeout_source);
+        mm_poll_scheduler_remove (mm_poll_scheduler_get (), ctx->timeout_source);
         ctx->timeout_source = 0;
     }
 
@@ -4098,6 +4124,7 @@ typedef enum {
     INITIALIZATION_STEP_CARRIER_CONFIG,
     INITIALIZATION_STEP_HARDWARE_REVISION,
     INITIALIZATION_STEP_EQUIPMENT_ID,
+    INITIALIZATION_STEP_CARRIER_CONFIG_IDENTITY_CACHE,
     INITIALIZATION_STEP_DEVICE_ID,
     INITIALIZATION_STEP_SUPPORTED_MODES,
     INITIALIZATION_STEP_SUPPORTED_BANDS,
@@ -4117,6 +4144,8 @@ struct _InitializationContext {
     InitializationStep step;
     MmGdbusModem *skeleton;
     GError *fatal_error;
+    gboolean supported_modes_from_identity_cache;
+    gboolean supported_bands_from_identity_cache;
 };
 
 static void
@@ -4127,6 +4156,265 @@ initialization_context_free (InitializationContext *ctx)
     g_free (ctx);
 }
 
+/*****************************************************************************/
+/* Identity cache */
+
+static gboolean
+identity_cache_supported (MMIfaceModem *self)
+{
+    gboolean supported = FALSE;
+
+    if (!mm_identity_cache_enabled ())
+        return FALSE;
+
+    /* CDMA modems also setup the EV-DO and 1x network support flags while
+     * loading the supported modes */
+    if (mm_iface_modem_is_cdma (self))
+        return FALSE;
+
+    /* Only if loading the supported modes and bands doesn't setup any other
+     * internal state in the implementation */
+    g_object_get (self,
+                  MM_IFACE_MODEM_IDENTITY_CACHE_SUPPORTED, &supported,
+                  NULL);
+    return supported;
+}
+
+static gboolean
+identity_cache_load_supported_modes (MMIfaceModem *self,
+                                     MmGdbusModem *skeleton)
+{
+    GVariant *supported_modes = NULL;
+
+    if (!identity_cache_supported (self) ||
+        !mm_identity_cache_lookup_modem (mm_gdbus_modem_get_equipment_identifier (skeleton),
+                                         mm_gdbus_modem_get_revision (skeleton),
+                                         &supported_modes,
+                                         NULL))
+        return FALSE;
+
+    mm_dbg ("Supported modes loaded from identity cache");
+    mm_gdbus_modem_set_supported_modes (skeleton, supported_modes);
+    g_variant_unref (supported_modes);
+    return TRUE;
+}
+
+static gboolean
+identity_cache_load_supported_bands (MMIfaceModem *self,
+                                     MmGdbusModem *skeleton)
+{
+    GVariant *supported_bands = NULL;
+
+    if (!identity_cache_supported (self) ||
+        !mm_identity_cache_lookup_modem (mm_gdbus_modem_get_equipment_identifier (skeleton),
+                                         mm_gdbus_modem_get_revision (skeleton),
+                                         NULL,
+                                         &supported_bands))
+        return FALSE;
+
+    mm_dbg ("Supported bands loaded from identity cache");
+    mm_gdbus_modem_set_supported_bands (skeleton, supported_bands);
+    g_variant_unref (supported_bands);
+    return TRUE;
+}
+
+/* Supported modes and bands are stored independently, so that e.g. a modem
+ * without any way to load the supported bands still gets its supported modes
+ * cached. The defaults set when loading failed are never stored. */
+static void
+identity_cache_store (MMIfaceModem *self,
+                      MmGdbusModem *skeleton)
+{
+    GArray   *supported_modes;
+    GArray   *supported_bands;
+    gboolean  modes_valid;
+    gboolean  bands_valid;
+
+    if (!identity_cache_supported (self))
+        return;
+
+    supported_modes = mm_common_mode_combinations_variant_to_garray (mm_gdbus_modem_get_supported_modes (skeleton));
+    modes_valid = (supported_modes->len > 0 &&
+                   !(supported_modes->len == 1 &&
+                     g_array_index (supported_modes, MMModemModeCombination, 0).allowed == MM_MODEM_MODE_ANY &&
+                     g_array_index (supported_modes, MMModemModeCombination, 0).preferred == MM_MODEM_MODE_NONE));
+    g_array_unref (supported_modes);
+
+    supported_bands = mm_common_bands_variant_to_garray (mm_gdbus_modem_get_supported_bands (skeleton));
+    bands_valid = (supported_bands->len > 0 &&
+                   g_array_index (supported_bands, MMModemBand, 0) != MM_MODEM_BAND_UNKNOWN);
+    g_array_unref (supported_bands);
+
+    mm_identity_cache_store_modem (mm_gdbus_modem_get_equipment_identifier (skeleton),
+                                   mm_gdbus_modem_get_revision (skeleton),
+                                   modes_valid ? mm_gdbus_modem_get_supported_modes (skeleton) : NULL,
+                                   bands_valid ? mm_gdbus_modem_get_supported_bands (skeleton) : NULL);
+}
+
+/* When the supported modes or bands were taken from the identity cache, they
+ * are loaded again in the background, to fix any difference */
+
+typedef enum {
+    REFRESH_STEP_FIRST,
+    REFRESH_STEP_SUPPORTED_MODES,
+    REFRESH_STEP_SUPPORTED_BANDS,
+    REFRESH_STEP_LAST
+} RefreshStep;
+
+typedef struct {
+    RefreshStep   step;
+    MmGdbusModem *skeleton;
+    gboolean      supported_modes;
+    gboolean      supported_bands;
+} RefreshContext;
+
+static void identity_cache_refresh_step (GTask *task);
+
+static void
+refresh_context_free (RefreshContext *ctx)
+{
+    g_object_unref (ctx->skeleton);
+    g_free (ctx);
+}
+
+static void
+refresh_supported_modes_ready (MMIfaceModem *self,
+                               GAsyncResult *res,
+                               GTask        *task)
+{
+    RefreshContext *ctx;
+    GError         *error = NULL;
+    GArray         *modes_array;
+
+    ctx = g_task_get_task_data (task);
+
+    modes_array = MM_IFACE_MODEM_GET_INTERFACE (self)->load_supported_modes_finish (self, res, &error);
+    if (!modes_array) {
+        /* Keep the cached value */
+        mm_dbg ("couldn't refresh Supported Modes: '%s'", error->message);
+        g_error_free (error);
+    } else {
+        GVariant *modes;
+
+        modes = g_variant_ref_sink (mm_common_mode_combinations_garray_to_variant (modes_array));
+        if (!g_variant_equal (modes, mm_gdbus_modem_get_supported_modes (ctx->skeleton))) {
+            mm_dbg ("Supported Modes changed since they were cached");
+            mm_gdbus_modem_set_supported_modes (ctx->skeleton, modes);
+        }
+        g_variant_unref (modes);
+        g_array_unref (modes_array);
+    }
+
+    ctx->step++;
+    identity_cache_refresh_step (task);
+}
+
+static void
+refresh_supported_bands_ready (MMIfaceModem *self,
+                               GAsyncResult *res,
+                               GTask        *task)
+{
+    RefreshContext *ctx;
+    GError         *error = NULL;
+    GArray         *bands_array;
+
+    ctx = g_task_get_task_data (task);
+
+    bands_array = MM_IFACE_MODEM_GET_INTERFACE (self)->load_supported_bands_finish (self, res, &error);
+    if (!bands_array) {
+        /* Keep the cached value */
+        mm_dbg ("couldn't refresh Supported Bands: '%s'", error->message);
+        g_error_free (error);
+    } else {
+        GVariant *bands;
+
+        mm_common_bands_garray_sort (bands_array);
+        bands = g_variant_ref_sink (mm_common_bands_garray_to_variant (bands_array));
+        if (!g_variant_equal (bands, mm_gdbus_modem_get_supported_bands (ctx->skeleton))) {
+            mm_dbg ("Supported Bands changed since they were cached");
+            mm_gdbus_modem_set_supported_bands (ctx->skeleton, bands);
+        }
+        g_variant_unref (bands);
+        g_array_unref (bands_array);
+    }
+
+    ctx->step++;
+    identity_cache_refresh_step (task);
+}
+
+static void
+identity_cache_refresh_step (GTask *task)
+{
+    MMIfaceModem   *self;
+    RefreshContext *ctx;
+
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    switch (ctx->step) {
+    case REFRESH_STEP_FIRST:
+        ctx->step++;
+        /* fall through */
+
+    case REFRESH_STEP_SUPPORTED_MODES:
+        if (ctx->supported_modes &&
+            MM_IFACE_MODEM_GET_INTERFACE (self)->load_supported_modes &&
+            MM_IFACE_MODEM_GET_INTERFACE (self)->load_supported_modes_finish) {
+            MM_IFACE_MODEM_GET_INTERFACE (self)->load_supported_modes (
+                self,
+                (GAsyncReadyCallback)refresh_supported_modes_ready,
+                task);
+            return;
+        }
+        ctx->step++;
+        /* fall through */
+
+    case REFRESH_STEP_SUPPORTED_BANDS:
+        if (ctx->supported_bands &&
+            MM_IFACE_MODEM_GET_INTERFACE (self)->load_supported_bands &&
+            MM_IFACE_MODEM_GET_INTERFACE (self)->load_supported_bands_finish) {
+            MM_IFACE_MODEM_GET_INTERFACE (self)->load_supported_bands (
+                self,
+                (GAsyncReadyCallback)refresh_supported_bands_ready,
+                task);
+            return;
+        }
+        ctx->step++;
+        /* fall through */
+
+    case REFRESH_STEP_LAST:
+        identity_cache_store (self, ctx->skeleton);
+        g_task_return_boolean (task, TRUE);
+        g_object_unref (task);
+        return;
+    }
+
+    g_assert_not_reached ();
+}
+
+static void
+identity_cache_refresh (MMIfaceModem *self,
+                        MmGdbusModem *skeleton,
+                        gboolean      supported_modes,
+                        gboolean      supported_bands)
+{
+    RefreshContext *ctx;
+    GTask          *task;
+
+    ctx = g_new0 (RefreshContext, 1);
+    ctx->step = REFRESH_STEP_FIRST;
+    ctx->skeleton = g_object_ref (skeleton);
+    ctx->supported_modes = supported_modes;
+    ctx->supported_bands = supported_bands;
+
+    task = g_task_new (self, NULL, NULL, NULL);
+    g_task_set_task_data (task, ctx, (GDestroyNotify)refresh_context_free);
+
+    identity_cache_refresh_step (task);
+}
+
+/*****************************************************************************/
+
 #undef STR_REPLY_READY_FN
 #define STR_REPLY_READY_FN(NAME,DISPLAY)                                \
     static void                                                         \
@@ -4536,6 +4824,29 @@ load_carrier_config_ready (MMIfaceModem *self,
     interface_initialization_step (task);
 }
 
+static gboolean
+load_carrier_config (GTask *task)
+{
+    MMIfaceModem          *self;
+    InitializationContext *ctx;
+
+    self = g_task_get_source_object (task);
+    ctx = g_task_get_task_data (task);
+
+    /* Current carrier config is meant to be loaded only once during the whole
+     * lifetime of the modem. Therefore, if we already have them loaded,
+     * don't try to load them again. */
+    if (mm_gdbus_modem_get_carrier_configuration (ctx->skeleton) != NULL ||
+        !MM_IFACE_MODEM_GET_INTERFACE (self)->load_carrier_config ||
+        !MM_IFACE_MODEM_GET_INTERFACE (self)->load_carrier_config_finish)
+        return FALSE;
+
+    MM_IFACE_MODEM_GET_INTERFACE (self)->load_carrier_config (self,
+                                                              (GAsyncReadyCallback)load_carrier_config_ready,
+                                                              task);
+    return TRUE;
+}
+
 void
 mm_iface_modem_update_own_numbers (MMIfaceModem *self,
                                    const GStrv own_numbers)
@@ -4695,6 +5006,8 @@ interface_initialization_step (GTask *task)
         return;
     }
 
+    mm_trace_step (task, "modem-initialization", ctx->step, mm_base_modem_get_device (MM_BASE_MODEM (self)));
+
     switch (ctx->step) {
     case INITIALIZATION_STEP_FIRST:
         /* Load device if not done before */
@@ -4903,17 +5216,8 @@ interface_initialization_step (GTask *task)
         ctx->step++;
 
     case INITIALIZATION_STEP_CARRIER_CONFIG:
-        /* Current carrier config is meant to be loaded only once during the whole
-         * lifetime of the modem. Therefore, if we already have them loaded,
-         * don't try to load them again. */
-        if (mm_gdbus_modem_get_carrier_configuration (ctx->skeleton) == NULL &&
-            MM_IFACE_MODEM_GET_INTERFACE (self)->load_carrier_config &&
-            MM_IFACE_MODEM_GET_INTERFACE (self)->load_carrier_config_finish) {
-            MM_IFACE_MODEM_GET_INTERFACE (self)->load_carrier_config (self,
-                                                                      (GAsyncReadyCallback)load_carrier_config_ready,
-                                                                      task);
+        if (!mm_identity_cache_enabled () && load_carrier_config (task))
             return;
-        }
         /* Fall down to next step */
         ctx->step++;
 
@@ -4949,6 +5253,15 @@ interface_initialization_step (GTask *task)
         /* Fall down to next step */
         ctx->step++;
 
+    case INITIALIZATION_STEP_CARRIER_CONFIG_IDENTITY_CACHE:
+        /* When the identity cache is in use, the carrier config is loaded once
+         * the equipment ID is known, as the list of configs is cached per IMEI
+         * and firmware revision */
+        if (mm_identity_cache_enabled () && load_carrier_config (task))
+            return;
+        /* Fall down to next step */
+        ctx->step++;
+
     case INITIALIZATION_STEP_DEVICE_ID:
         /* Device ID is meant to be loaded only once during the whole
          * lifetime of the modem. Therefore, if we already have them loaded,
@@ -4981,6 +5294,16 @@ interface_initialization_step (GTask *task)
                 mode = &g_array_index (supported_modes, MMModemModeCombination, 0);
             if (supported_modes->len == 0 ||
                 (mode && mode->allowed == MM_MODEM_MODE_ANY && mode->preferred == MM_MODEM_MODE_NONE)) {
+                /* If this modem was already seen with the same firmware, the
+                 * supported modes may be taken from the identity cache */
+                if (identity_cache_load_supported_modes (self, ctx->skeleton)) {
+                    ctx->supported_modes_from_identity_cache = TRUE;
+                    ctx->step++;
+                    g_array_unref (supported_modes);
+                    interface_initialization_step (task);
+                    return;
+                }
+
                 MM_IFACE_MODEM_GET_INTERFACE (self)->load_supported_modes (
                     self,
                     (GAsyncReadyCallback)load_supported_modes_ready,
@@ -5005,6 +5328,16 @@ interface_initialization_step (GTask *task)
          * don't try to load them again. */
         if (supported_bands->len == 0 ||
             g_array_index (supported_bands, MMModemBand, 0)  == MM_MODEM_BAND_UNKNOWN) {
+            /* Same for the supported bands */
+            if (MM_IFACE_MODEM_GET_INTERFACE (self)->load_supported_bands &&
+                identity_cache_load_supported_bands (self, ctx->skeleton)) {
+                ctx->supported_bands_from_identity_cache = TRUE;
+                ctx->step++;
+                g_array_unref (supported_bands);
+                interface_initialization_step (task);
+                return;
+            }
+
             if (MM_IFACE_MODEM_GET_INTERFACE (self)->load_supported_bands &&
                 MM_IFACE_MODEM_GET_INTERFACE (self)->load_supported_bands_finish) {
                 MM_IFACE_MODEM_GET_INTERFACE (self)->load_supported_bands (
@@ -5249,6 +5582,14 @@ interface_initialization_step (GTask *task)
     }
 
     case INITIALIZATION_STEP_LAST:
+        if (ctx->supported_modes_from_identity_cache || ctx->supported_bands_from_identity_cache)
+            identity_cache_refresh (self,
+                                    ctx->skeleton,
+                                    ctx->supported_modes_from_identity_cache,
+                                    ctx->supported_bands_from_identity_cache);
+        else
+            identity_cache_store (self, ctx->skeleton);
+
         /* Setup all method handlers */
         g_object_connect (ctx->skeleton,
                           "signal::handle-set-current-capabilities", G_CALLBACK (handle_set_current_capabilities), self,
@@ -5688,6 +6029,14 @@ iface_modem_init (gpointer g_iface)
                                FALSE,
                                G_PARAM_READWRITE));
 
+    g_object_interface_install_property
+        (g_iface,
+         g_param_spec_boolean (MM_IFACE_MODEM_IDENTITY_CACHE_SUPPORTED,
+                               "Identity cache supported",
+                               "Whether the supported modes and bands may be taken from the identity cache.",
+                               FALSE,
+                               G_PARAM_READWRITE));
+
     g_object_interface_install_property
         (g_iface,
          g_param_spec_boolean (MM_IFACE_MODEM_PERIODIC_SIGNAL_CHECK_DISABLED,
@@ -40,6 +40,7 @@
 #define MM_IFACE_MODEM_SIM_HOT_SWAP_CONFIGURED "iface-modem-sim-hot-swap-configured"
 #define MM_IFACE_MODEM_PERIODIC_SIGNAL_CHECK_DISABLED "iface-modem-periodic-signal-check-disabled"
 #define MM_IFACE_MODEM_CARRIER_CONFIG_MAPPING  "iface-modem-carrier-config-mapping"
+#define MM_IFACE_MODEM_IDENTITY_CACHE_SUPPORTED "iface-modem-identity-cache-supported"
 
 typedef struct _MMIfaceModem MMIfaceModem;
 
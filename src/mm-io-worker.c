@@ -0,0 +1,625 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib-unix.h>
+
+#include "mm-io-worker.h"
+#include "mm-log.h"
+
+/* Size of each read() */
+#define READ_CHUNK_SIZE 2048
+/* Max number of reads per wakeup, so that a port spewing data doesn't
+ * starve the rest of ports handled by the same worker */
+#define MAX_READS_PER_WAKEUP 32
+
+typedef struct {
+    GThread      *thread;
+    GMainContext *context;
+    GMainLoop    *loop;
+    /* Only accessed from the main context; watches, or paced writes in the
+     * writer */
+    guint         n_watches;
+} Worker;
+
+static Worker *workers;
+static guint   n_workers;
+
+typedef struct {
+    GIOCondition  condition;
+    GByteArray   *data;
+} Event;
+
+struct _MMIoWorkerWatch {
+    volatile gint        ref_count;
+    gint                 fd;
+    Worker              *worker;
+    GMainContext        *main_context;
+    MMIoWorkerWatchFunc  callback;
+    gpointer             user_data;
+
+    /* Everything below is protected by the mutex */
+    GMutex               mutex;
+    gboolean             cancelled;
+    GSource             *fd_source;
+    GSource             *dispatch_source;
+    GQueue               events;
+};
+
+/*****************************************************************************/
+
+static void
+event_free (Event *event)
+{
+    if (event->data)
+        g_byte_array_unref (event->data);
+    g_slice_free (Event, event);
+}
+
+static MMIoWorkerWatch *
+watch_ref (MMIoWorkerWatch *watch)
+{
+    g_atomic_int_inc (&watch->ref_count);
+    return watch;
+}
+
+static void
+watch_unref (MMIoWorkerWatch *watch)
+{
+    if (g_atomic_int_dec_and_test (&watch->ref_count)) {
+        g_assert (watch->fd_source == NULL);
+        g_assert (watch->dispatch_source == NULL);
+        g_queue_foreach (&watch->events, (GFunc) event_free, NULL);
+        g_queue_clear (&watch->events);
+        g_mutex_clear (&watch->mutex);
+        g_main_context_unref (watch->main_context);
+        g_slice_free (MMIoWorkerWatch, watch);
+    }
+}
+
+/*****************************************************************************/
+/* Main context side */
+
+static gboolean
+watch_dispatch (MMIoWorkerWatch *watch)
+{
+    GQueue  events;
+    Event  *event;
+
+    g_mutex_lock (&watch->mutex);
+    {
+        g_clear_pointer (&watch->dispatch_source, g_source_unref);
+        events = watch->events;
+        g_queue_init (&watch->events);
+    }
+    g_mutex_unlock (&watch->mutex);
+
+    /* The callback may free the watch, but we still hold the reference of
+     * the dispatch source until we return. The cancelled flag is only ever
+     * set from this same context, so no need to lock to check it. */
+    while ((event = g_queue_pop_head (&events)) != NULL) {
+        if (!watch->cancelled)
+            watch->callback (event->condition,
+                             event->data ? event->data->data : NULL,
+                             event->data ? event->data->len : 0,
+                             watch->user_data);
+        event_free (event);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/*****************************************************************************/
+/* Worker side */
+
+static void
+watch_post_unlocked (MMIoWorkerWatch *watch,
+                     GIOCondition     condition,
+                     GByteArray      *data)
+{
+    Event *last;
+
+    /* Coalesce with the last event not yet dispatched, if possible */
+    last = g_queue_peek_tail (&watch->events);
+    if (last && last->condition == condition) {
+        if (data) {
+            g_byte_array_append (last->data, data->data, data->len);
+            g_byte_array_unref (data);
+        }
+    } else {
+        Event *event;
+
+        event = g_slice_new (Event);
+        event->condition = condition;
+        event->data = data;
+        g_queue_push_tail (&watch->events, event);
+    }
+
+    if (!watch->dispatch_source) {
+        watch->dispatch_source = g_idle_source_new ();
+        g_source_set_priority (watch->dispatch_source, G_PRIORITY_DEFAULT);
+        g_source_set_callback (watch->dispatch_source,
+                               (GSourceFunc) watch_dispatch,
+                               watch_ref (watch),
+                               (GDestroyNotify) watch_unref);
+        g_source_attach (watch->dispatch_source, watch->main_context);
+    }
+}
+
+static gboolean
+watch_fd_ready (gint             fd,
+                GIOCondition     condition,
+                MMIoWorkerWatch *watch)
+{
+    GByteArray *data = NULL;
+    gboolean    keep_source = G_SOURCE_CONTINUE;
+    guint       n_reads;
+
+    g_mutex_lock (&watch->mutex);
+
+    if (watch->cancelled) {
+        keep_source = G_SOURCE_REMOVE;
+        goto out;
+    }
+
+    /* A hangup is final, any pending data is discarded */
+    if (condition & G_IO_HUP) {
+        watch_post_unlocked (watch, G_IO_HUP, NULL);
+        keep_source = G_SOURCE_REMOVE;
+        goto out;
+    }
+
+    if (condition & G_IO_ERR) {
+        watch_post_unlocked (watch, G_IO_ERR, NULL);
+        goto out;
+    }
+
+    /* Drain the fd */
+    data = g_byte_array_sized_new (READ_CHUNK_SIZE);
+    for (n_reads = 0; n_reads < MAX_READS_PER_WAKEUP; n_reads++) {
+        guint   offset;
+        gssize  r;
+
+        offset = data->len;
+        g_byte_array_set_size (data, offset + READ_CHUNK_SIZE);
+        r = read (fd, data->data + offset, READ_CHUNK_SIZE);
+        g_byte_array_set_size (data, offset + (r > 0 ? r : 0));
+
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+            mm_dbg ("(fd %d) read error: %s", fd, g_strerror (errno));
+        if (r < READ_CHUNK_SIZE)
+            break;
+    }
+
+    if (data->len > 0) {
+        watch_post_unlocked (watch, G_IO_IN, data);
+        data = NULL;
+    }
+
+out:
+    if (keep_source == G_SOURCE_REMOVE)
+        g_clear_pointer (&watch->fd_source, g_source_unref);
+    g_mutex_unlock (&watch->mutex);
+    if (data)
+        g_byte_array_unref (data);
+    return keep_source;
+}
+
+/*****************************************************************************/
+
+MMIoWorkerWatch *
+mm_io_worker_watch_new (gint                fd,
+                        MMIoWorkerWatchFunc callback,
+                        gpointer            user_data)
+{
+    MMIoWorkerWatch *watch;
+    Worker          *worker;
+    guint            i;
+
+    g_return_val_if_fail (n_workers > 0, NULL);
+    g_return_val_if_fail (fd >= 0, NULL);
+    g_return_val_if_fail (callback != NULL, NULL);
+
+    /* Pick the least loaded worker */
+    worker = &workers[0];
+    for (i = 1; i < n_workers; i++) {
+        if (workers[i].n_watches < worker->n_watches)
+            worker = &workers[i];
+    }
+    worker->n_watches++;
+
+    watch = g_slice_new0 (MMIoWorkerWatch);
+    watch->ref_count = 1;
+    watch->fd = fd;
+    watch->worker = worker;
+    watch->main_context = g_main_context_ref_thread_default ();
+    watch->callback = callback;
+    watch->user_data = user_data;
+    g_mutex_init (&watch->mutex);
+    g_queue_init (&watch->events);
+
+    g_mutex_lock (&watch->mutex);
+    {
+        watch->fd_source = g_unix_fd_source_new (fd, G_IO_IN | G_IO_ERR | G_IO_HUP);
+        g_source_set_callback (watch->fd_source,
+                               (GSourceFunc) watch_fd_ready,
+                               watch_ref (watch),
+                               (GDestroyNotify) watch_unref);
+        g_source_attach (watch->fd_source, worker->context);
+    }
+    g_mutex_unlock (&watch->mutex);
+
+    return watch;
+}
+
+void
+mm_io_worker_watch_free (MMIoWorkerWatch *watch)
+{
+    g_return_if_fail (watch != NULL);
+
+    /* Once we hold the lock the worker is not reading from the fd, and it
+     * will not do it again after seeing the cancelled flag */
+    g_mutex_lock (&watch->mutex);
+    {
+        watch->cancelled = TRUE;
+        if (watch->fd_source) {
+            g_source_destroy (watch->fd_source);
+            g_clear_pointer (&watch->fd_source, g_source_unref);
+        }
+        if (watch->dispatch_source) {
+            g_source_destroy (watch->dispatch_source);
+            g_clear_pointer (&watch->dispatch_source, g_source_unref);
+        }
+        g_queue_foreach (&watch->events, (GFunc) event_free, NULL);
+        g_queue_clear (&watch->events);
+    }
+    g_mutex_unlock (&watch->mutex);
+
+    watch->worker->n_watches--;
+    watch_unref (watch);
+}
+
+/*****************************************************************************/
+
+static gpointer
+worker_thread_func (Worker *worker)
+{
+    g_main_context_push_thread_default (worker->context);
+    g_main_loop_run (worker->loop);
+    g_main_context_pop_thread_default (worker->context);
+    return NULL;
+}
+
+static gboolean
+worker_quit_cb (Worker *worker)
+{
+    g_main_loop_quit (worker->loop);
+    return G_SOURCE_REMOVE;
+}
+
+/*****************************************************************************/
+/* Paced writes
+ *
+ * Each byte is written from the writer thread when the ready time of the
+ * write source is reached. The ready time is set to absolute deadlines with
+ * microsecond precision, so that the spacing doesn't drift with the latency
+ * of each wakeup. Only the final result is handed over to the main context.
+ */
+
+/* Only started and stopped from the main context */
+static Worker   writer;
+static gboolean writer_running;
+
+struct _MMIoWorkerWrite {
+    volatile gint        ref_count;
+    gint                 fd;
+    guint8              *data;
+    gsize                len;
+    guint64              delay_us;
+    guint64              eagain_timeout_us;
+    GMainContext        *main_context;
+    MMIoWorkerWriteFunc  callback;
+    gpointer             user_data;
+
+    /* Only accessed from the writer thread */
+    gsize                idx;
+    gint64               deadline;
+    gint64               eagain_limit;
+
+    /* Everything below is protected by the mutex */
+    GMutex               mutex;
+    gboolean             cancelled;
+    GSource             *write_source;
+    GSource             *dispatch_source;
+    gint                 result;
+};
+
+static MMIoWorkerWrite *
+paced_write_ref (MMIoWorkerWrite *paced)
+{
+    g_atomic_int_inc (&paced->ref_count);
+    return paced;
+}
+
+static void
+paced_write_unref (MMIoWorkerWrite *paced)
+{
+    if (g_atomic_int_dec_and_test (&paced->ref_count)) {
+        g_assert (paced->write_source == NULL);
+        g_assert (paced->dispatch_source == NULL);
+        g_mutex_clear (&paced->mutex);
+        g_main_context_unref (paced->main_context);
+        g_free (paced->data);
+        g_slice_free (MMIoWorkerWrite, paced);
+    }
+}
+
+static gboolean
+paced_write_dispatch (MMIoWorkerWrite *paced)
+{
+    gint result;
+
+    g_mutex_lock (&paced->mutex);
+    {
+        g_clear_pointer (&paced->dispatch_source, g_source_unref);
+        result = paced->result;
+    }
+    g_mutex_unlock (&paced->mutex);
+
+    /* The cancelled flag is only ever set from this same context */
+    if (!paced->cancelled)
+        paced->callback (result, paced->user_data);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+paced_write_post_unlocked (MMIoWorkerWrite *paced,
+                           gint             result)
+{
+    g_assert (!paced->dispatch_source);
+
+    paced->result = result;
+    paced->dispatch_source = g_idle_source_new ();
+    g_source_set_priority (paced->dispatch_source, G_PRIORITY_DEFAULT);
+    g_source_set_callback (paced->dispatch_source,
+                           (GSourceFunc) paced_write_dispatch,
+                           paced_write_ref (paced),
+                           (GDestroyNotify) paced_write_unref);
+    g_source_attach (paced->dispatch_source, paced->main_context);
+}
+
+static gboolean
+paced_write_ready (MMIoWorkerWrite *paced)
+{
+    gboolean keep_source = G_SOURCE_CONTINUE;
+    gssize   written;
+    gint     errsv;
+    gint64   now;
+
+    g_mutex_lock (&paced->mutex);
+
+    if (paced->cancelled) {
+        keep_source = G_SOURCE_REMOVE;
+        goto out;
+    }
+
+    written = write (paced->fd, &paced->data[paced->idx], 1);
+    errsv = errno;
+    now = g_get_monotonic_time ();
+
+    if (written == 1) {
+        paced->idx++;
+        paced->eagain_limit = 0;
+
+        if (paced->idx < paced->len) {
+            /* Wait until it's time for the next byte */
+            paced->deadline += paced->delay_us;
+            g_source_set_ready_time (paced->write_source, MAX (paced->deadline, now));
+            goto out;
+        }
+
+        paced_write_post_unlocked (paced, 0);
+        keep_source = G_SOURCE_REMOVE;
+        goto out;
+    }
+
+    if (written < 0 && errsv == EINTR) {
+        g_source_set_ready_time (paced->write_source, 0);
+        goto out;
+    }
+
+    if (written == 0 || errsv == EAGAIN || errsv == EWOULDBLOCK) {
+        if (!paced->eagain_limit)
+            paced->eagain_limit = now + paced->eagain_timeout_us;
+
+        if (now < paced->eagain_limit) {
+            /* Retry after a full delay, and keep the spacing from then on */
+            paced->deadline = now + paced->delay_us;
+            g_source_set_ready_time (paced->write_source, paced->deadline);
+            goto out;
+        }
+
+        errsv = EAGAIN;
+    }
+
+    paced_write_post_unlocked (paced, errsv);
+    keep_source = G_SOURCE_REMOVE;
+
+out:
+    if (keep_source == G_SOURCE_REMOVE)
+        g_clear_pointer (&paced->write_source, g_source_unref);
+    g_mutex_unlock (&paced->mutex);
+    return keep_source;
+}
+
+static gboolean
+paced_write_source_dispatch (GSource     *source,
+                             GSourceFunc  callback,
+                             gpointer     user_data)
+{
+    return callback (user_data);
+}
+
+static GSourceFuncs paced_write_source_funcs = {
+    NULL, /* prepare, ready time only */
+    NULL, /* check, ready time only */
+    paced_write_source_dispatch,
+    NULL
+};
+
+MMIoWorkerWrite *
+mm_io_worker_write_new (gint                 fd,
+                        const guint8        *data,
+                        gsize                len,
+                        guint64              delay_us,
+                        guint64              eagain_timeout_us,
+                        MMIoWorkerWriteFunc  callback,
+                        gpointer             user_data)
+{
+    MMIoWorkerWrite *paced;
+
+    g_return_val_if_fail (fd >= 0, NULL);
+    g_return_val_if_fail (data != NULL && len > 0, NULL);
+    g_return_val_if_fail (callback != NULL, NULL);
+
+    if (!writer_running) {
+        writer.context = g_main_context_new ();
+        writer.loop = g_main_loop_new (writer.context, FALSE);
+        writer.thread = g_thread_new ("mm-io-writer", (GThreadFunc) worker_thread_func, &writer);
+        writer_running = TRUE;
+        mm_dbg ("paced port writes handled by a writer thread");
+    }
+    writer.n_watches++;
+
+    paced = g_slice_new0 (MMIoWorkerWrite);
+    paced->ref_count = 1;
+    paced->fd = fd;
+    paced->data = g_memdup (data, len);
+    paced->len = len;
+    paced->delay_us = delay_us;
+    paced->eagain_timeout_us = eagain_timeout_us;
+    paced->main_context = g_main_context_ref_thread_default ();
+    paced->callback = callback;
+    paced->user_data = user_data;
+    g_mutex_init (&paced->mutex);
+
+    g_mutex_lock (&paced->mutex);
+    {
+        /* First byte right away */
+        paced->deadline = g_get_monotonic_time ();
+        paced->write_source = g_source_new (&paced_write_source_funcs, sizeof (GSource));
+        g_source_set_callback (paced->write_source,
+                               (GSourceFunc) paced_write_ready,
+                               paced_write_ref (paced),
+                               (GDestroyNotify) paced_write_unref);
+        g_source_set_ready_time (paced->write_source, 0);
+        g_source_attach (paced->write_source, writer.context);
+    }
+    g_mutex_unlock (&paced->mutex);
+
+    return paced;
+}
+
+void
+mm_io_worker_write_free (MMIoWorkerWrite *paced)
+{
+    g_return_if_fail (paced != NULL);
+
+    /* Once we hold the lock the writer is not writing to the fd, and it
+     * will not do it again after seeing the cancelled flag */
+    g_mutex_lock (&paced->mutex);
+    {
+        paced->cancelled = TRUE;
+        if (paced->write_source) {
+            g_source_destroy (paced->write_source);
+            g_clear_pointer (&paced->write_source, g_source_unref);
+        }
+        if (paced->dispatch_source) {
+            g_source_destroy (paced->dispatch_source);
+            g_clear_pointer (&paced->dispatch_source, g_source_unref);
+        }
+    }
+    g_mutex_unlock (&paced->mutex);
+
+    writer.n_watches--;
+    paced_write_unref (paced);
+}
+
+/*****************************************************************************/
+
+gboolean
+mm_io_worker_enabled (void)
+{
+    return n_workers > 0;
+}
+
+void
+mm_io_worker_setup (guint n)
+{
+    guint i;
+
+    g_return_if_fail (n_workers == 0);
+
+    if (!n)
+        return;
+
+    workers = g_new0 (Worker, n);
+    for (i = 0; i < n; i++) {
+        gchar *name;
+
+        workers[i].context = g_main_context_new ();
+        workers[i].loop = g_main_loop_new (workers[i].context, FALSE);
+        name = g_strdup_printf ("mm-io-%u", i);
+        workers[i].thread = g_thread_new (name, (GThreadFunc) worker_thread_func, &workers[i]);
+        g_free (name);
+    }
+    n_workers = n;
+
+    mm_dbg ("port I/O handled by %u worker threads", n_workers);
+}
+
+void
+mm_io_worker_shutdown (void)
+{
+    guint i;
+
+    for (i = 0; i < n_workers; i++) {
+        g_warn_if_fail (workers[i].n_watches == 0);
+        g_main_context_invoke (workers[i].context, (GSourceFunc) worker_quit_cb, &workers[i]);
+        g_thread_join (workers[i].thread);
+        g_main_loop_unref (workers[i].loop);
+        g_main_context_unref (workers[i].context);
+    }
+    g_clear_pointer (&workers, g_free);
+    n_workers = 0;
+
+    if (writer_running) {
+        g_warn_if_fail (writer.n_watches == 0);
+        g_main_context_invoke (writer.context, (GSourceFunc) worker_quit_cb, &writer);
+        g_thread_join (writer.thread);
+        g_main_loop_unref (writer.loop);
+        g_main_context_unref (writer.context);
+        memset (&writer, 0, sizeof (writer));
+        writer_running = FALSE;
+    }
+}
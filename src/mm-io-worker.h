@@ -0,0 +1,79 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+#ifndef MM_IO_WORKER_H
+#define MM_IO_WORKER_H
+
+#include <glib.h>
+
+/* Port I/O worker threads.
+ *
+ * When enabled, reading from port file descriptors is done in a small pool
+ * of worker threads, each running its own main context. Each wakeup drains
+ * the fd and hands the whole chunk over to the main context where the watch
+ * was created, so that a slow handler in the main loop never delays reads
+ * on other ports. Response parsing is still done by the port in the main
+ * context.
+ *
+ * Writes paced with a delay between bytes are done in a separate writer
+ * thread, which is started on first use even if no read workers are
+ * enabled. */
+
+/* Setup and shutdown of the worker pool; with no workers, nothing is
+ * enabled and ports keep on reading from the main context. */
+void         mm_io_worker_setup    (guint n_workers);
+void         mm_io_worker_shutdown (void);
+gboolean     mm_io_worker_enabled  (void);
+
+typedef struct _MMIoWorkerWatch MMIoWorkerWatch;
+
+/* Called in the main context with either G_IO_IN and the data read, or with
+ * G_IO_HUP/G_IO_ERR and no data. The watch may be freed from within. */
+typedef void (* MMIoWorkerWatchFunc) (GIOCondition  condition,
+                                      const guint8 *data,
+                                      gsize         len,
+                                      gpointer      user_data);
+
+MMIoWorkerWatch *mm_io_worker_watch_new  (gint                 fd,
+                                          MMIoWorkerWatchFunc  callback,
+                                          gpointer             user_data);
+
+/* Once this returns the fd is no longer used by the worker, and the callback
+ * will not be called again; so the fd may be closed right away. */
+void             mm_io_worker_watch_free (MMIoWorkerWatch     *watch);
+
+typedef struct _MMIoWorkerWrite MMIoWorkerWrite;
+
+/* Called once in the main context, with 0 if the whole buffer was written,
+ * EAGAIN if the fd wasn't writable for @eagain_timeout_us, or the errno of
+ * the failed write() otherwise. The write may be freed from within. */
+typedef void (* MMIoWorkerWriteFunc) (gint     errsv,
+                                      gpointer user_data);
+
+/* Writes @data one byte at a time, with @delay_us between bytes. The main
+ * context is only woken up once, after the last byte. */
+MMIoWorkerWrite *mm_io_worker_write_new  (gint                 fd,
+                                          const guint8        *data,
+                                          gsize                len,
+                                          guint64              delay_us,
+                                          guint64              eagain_timeout_us,
+                                          MMIoWorkerWriteFunc  callback,
+                                          gpointer             user_data);
+
+/* Once this returns the fd is no longer used by the writer, and the callback
+ * will not be called; so the fd may be closed right away. */
+void             mm_io_worker_write_free (MMIoWorkerWrite     *paced);
+
+#endif /* MM_IO_WORKER_H */
@@ -20,6 +20,7 @@
 #include <mm-errors-types.h>
 
 #include "mm-modem-helpers-qmi.h"
+#include "mm-identity-cache.h"
 #include "mm-enums-types.h"
 #include "mm-log.h"
 
@@ -1618,3 +1619,155 @@ mm_error_from_qmi_loc_indication_status (QmiLocIndicationStatus   status,
         return FALSE;
     }
 }
+
+/*****************************************************************************/
+
+void
+mm_qmi_config_info_clear (MMQmiConfigInfo *config_info)
+{
+    g_array_unref (config_info->id);
+    g_free (config_info->description);
+}
+
+static gchar *
+build_config_list_hash (GArray *configs)
+{
+    GChecksum *checksum;
+    gchar     *hash;
+    guint      i;
+
+    checksum = g_checksum_new (G_CHECKSUM_SHA256);
+    for (i = 0; i < configs->len; i++) {
+        QmiIndicationPdcListConfigsOutputConfigsElement *element;
+        guint8                                           header[2];
+
+        element = &g_array_index (configs, QmiIndicationPdcListConfigsOutputConfigsElement, i);
+        header[0] = (guint8) element->config_type;
+        header[1] = (guint8) element->id->len;
+        g_checksum_update (checksum, header, sizeof (header));
+        g_checksum_update (checksum, (const guchar *) element->id->data, element->id->len);
+    }
+    hash = g_strdup (g_checksum_get_string (checksum));
+    g_checksum_free (checksum);
+    return hash;
+}
+
+/* Fill in the config details from the identity cache, if the same list is
+ * found there */
+static gboolean
+config_list_load_from_cache (GArray      *config_list,
+                             const gchar *imei,
+                             const gchar *revision,
+                             const gchar *list_hash)
+{
+    GVariant     *configs = NULL;
+    GVariantIter  iter;
+    GVariant     *id;
+    guint32       config_type;
+    guint32       version;
+    guint32       total_size;
+    const gchar  *description;
+    guint         i = 0;
+
+    if (!mm_identity_cache_lookup_carrier_configs (imei, revision, list_hash, &configs))
+        return FALSE;
+
+    if (g_variant_n_children (configs) != config_list->len) {
+        g_variant_unref (configs);
+        return FALSE;
+    }
+
+    g_variant_iter_init (&iter, configs);
+    while (g_variant_iter_next (&iter, "(@ayuuu&s)", &id, &config_type, &version, &total_size, &description)) {
+        MMQmiConfigInfo *config;
+        gconstpointer    id_data;
+        gsize            id_len;
+
+        config = &g_array_index (config_list, MMQmiConfigInfo, i++);
+        id_data = g_variant_get_fixed_array (id, &id_len, sizeof (guint8));
+        if (config->config_type != config_type ||
+            config->id->len != id_len ||
+            memcmp (config->id->data, id_data, id_len) != 0) {
+            g_variant_unref (id);
+            g_variant_unref (configs);
+            return FALSE;
+        }
+        g_variant_unref (id);
+
+        config->version = version;
+        config->total_size = total_size;
+        config->description = g_strdup (description);
+    }
+
+    g_variant_unref (configs);
+    return TRUE;
+}
+
+GArray *
+mm_qmi_config_list_new (GArray       *configs,
+                        const gchar  *imei,
+                        const gchar  *revision,
+                        guint        *token,
+                        gchar       **list_hash,
+                        gboolean     *from_cache)
+{
+    GArray *config_list;
+    guint   i;
+
+    config_list = g_array_sized_new (FALSE, TRUE, sizeof (MMQmiConfigInfo), configs->len);
+    g_array_set_size (config_list, configs->len);
+    g_array_set_clear_func (config_list, (GDestroyNotify) mm_qmi_config_info_clear);
+
+    for (i = 0; i < configs->len; i++) {
+        MMQmiConfigInfo                                 *current_info;
+        QmiIndicationPdcListConfigsOutputConfigsElement *element;
+
+        element = &g_array_index (configs, QmiIndicationPdcListConfigsOutputConfigsElement, i);
+        current_info              = &g_array_index (config_list, MMQmiConfigInfo, i);
+        current_info->token       = (*token)++;
+        current_info->id          = g_array_ref (element->id);
+        current_info->config_type = element->config_type;
+    }
+
+    *list_hash = NULL;
+    *from_cache = FALSE;
+
+    /* The list is only cached for modems reporting both IMEI and revision */
+    if (!mm_identity_cache_enabled () || !imei || !imei[0] || !revision || !revision[0])
+        return config_list;
+
+    /* If the same list was already seen, skip loading the details */
+    *list_hash = build_config_list_hash (configs);
+    *from_cache = config_list_load_from_cache (config_list, imei, revision, *list_hash);
+    return config_list;
+}
+
+void
+mm_qmi_config_list_store (GArray      *config_list,
+                          const gchar *imei,
+                          const gchar *revision,
+                          const gchar *list_hash)
+{
+    GVariantBuilder  builder;
+    GVariant        *configs;
+    guint            i;
+
+    if (!list_hash)
+        return;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ayuuus)"));
+    for (i = 0; i < config_list->len; i++) {
+        MMQmiConfigInfo *config;
+
+        config = &g_array_index (config_list, MMQmiConfigInfo, i);
+        g_variant_builder_add (&builder, "(@ayuuus)",
+                               g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE, config->id->data, config->id->len, sizeof (guint8)),
+                               (guint32) config->config_type,
+                               config->version,
+                               config->total_size,
+                               config->description);
+    }
+    configs = g_variant_ref_sink (g_variant_builder_end (&builder));
+    mm_identity_cache_store_carrier_configs (imei, revision, list_hash, configs);
+    g_variant_unref (configs);
+}
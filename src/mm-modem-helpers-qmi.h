@@ -138,4 +138,33 @@ typedef struct {
 
 MMModemCapability mm_modem_capability_from_qmi_capabilities_context (MMQmiCapabilitiesContext *ctx);
 
+/*****************************************************************************/
+/* Carrier configurations installed in the modem */
+
+typedef struct {
+    GArray                  *id;
+    QmiPdcConfigurationType  config_type;
+    guint32                  token;
+    guint32                  version;
+    gchar                   *description;
+    guint32                  total_size;
+} MMQmiConfigInfo;
+
+void mm_qmi_config_info_clear (MMQmiConfigInfo *config_info);
+
+/* Builds the list of MMQmiConfigInfo from the configs reported in a PDC
+ * "List Configs" indication, giving a new token to each. If the identity
+ * cache knows the same list for the given IMEI and revision, the details are
+ * also filled in and @from_cache is set. */
+GArray *mm_qmi_config_list_new (GArray       *configs,
+                                const gchar  *imei,
+                                const gchar  *revision,
+                                guint        *token,
+                                gchar       **list_hash,
+                                gboolean     *from_cache);
+void    mm_qmi_config_list_store (GArray      *config_list,
+                                  const gchar *imei,
+                                  const gchar *revision,
+                                  const gchar *list_hash);
+
 #endif  /* MM_MODEM_HELPERS_QMI_H */
@@ -0,0 +1,291 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include <glib-unix.h>
+
+#include "mm-netlink-monitor.h"
+#include "mm-log.h"
+
+#define RECV_BUFFER_SIZE 8192
+
+struct _MMNetlinkMonitorWatch {
+    gchar                *ifname;
+    guint                 ifindex;
+    MMNetlinkMonitorFunc  callback;
+    gpointer              user_data;
+    /* Carrier loss is only reported once it has been seen up */
+    gboolean              lower_up_seen;
+};
+
+static gint      netlink_fd = -1;
+static guint     netlink_source_id;
+static GList    *watches;
+static gboolean  dispatching;
+
+/*****************************************************************************/
+
+static void
+netlink_close (void)
+{
+    if (netlink_source_id) {
+        g_source_remove (netlink_source_id);
+        netlink_source_id = 0;
+    }
+    if (netlink_fd >= 0) {
+        close (netlink_fd);
+        netlink_fd = -1;
+    }
+}
+
+static MMNetlinkMonitorWatch *
+lookup_watch (guint ifindex)
+{
+    GList *l;
+
+    for (l = watches; l; l = g_list_next (l)) {
+        MMNetlinkMonitorWatch *watch = l->data;
+
+        if (watch->ifindex == ifindex)
+            return watch;
+    }
+    return NULL;
+}
+
+static void
+notify_all (MMNetlinkMonitorEvent event)
+{
+    GList *copy;
+    GList *l;
+
+    /* Watches may be freed from within the callbacks */
+    copy = g_list_copy (watches);
+    for (l = copy; l; l = g_list_next (l)) {
+        if (g_list_find (watches, l->data)) {
+            MMNetlinkMonitorWatch *watch = l->data;
+
+            watch->callback (event, watch->user_data);
+        }
+    }
+    g_list_free (copy);
+}
+
+static void
+process_message (const struct nlmsghdr *hdr)
+{
+    MMNetlinkMonitorWatch *watch;
+
+    switch (hdr->nlmsg_type) {
+    case RTM_NEWLINK:
+    case RTM_DELLINK: {
+        const struct ifinfomsg *ifi;
+
+        if (hdr->nlmsg_len < NLMSG_LENGTH (sizeof (struct ifinfomsg)))
+            return;
+        ifi = NLMSG_DATA (hdr);
+        watch = lookup_watch ((guint) ifi->ifi_index);
+        if (!watch)
+            return;
+
+        if (hdr->nlmsg_type == RTM_DELLINK) {
+            mm_dbg ("(%s) network interface removed", watch->ifname);
+            watch->callback (MM_NETLINK_MONITOR_EVENT_LINK_REMOVED, watch->user_data);
+            return;
+        }
+
+        if (ifi->ifi_flags & IFF_LOWER_UP) {
+            watch->lower_up_seen = TRUE;
+            return;
+        }
+
+        /* Only report carrier loss if not administratively down, as that
+         * would be the connection manager tearing down the interface */
+        if (watch->lower_up_seen && (ifi->ifi_flags & IFF_UP)) {
+            mm_dbg ("(%s) carrier lost", watch->ifname);
+            watch->lower_up_seen = FALSE;
+            watch->callback (MM_NETLINK_MONITOR_EVENT_CARRIER_LOST, watch->user_data);
+        }
+        return;
+    }
+    case RTM_DELADDR: {
+        const struct ifaddrmsg *ifa;
+
+        if (hdr->nlmsg_len < NLMSG_LENGTH (sizeof (struct ifaddrmsg)))
+            return;
+        ifa = NLMSG_DATA (hdr);
+        watch = lookup_watch ((guint) ifa->ifa_index);
+        if (!watch)
+            return;
+
+        mm_dbg ("(%s) IPv%c address removed", watch->ifname, ifa->ifa_family == AF_INET6 ? '6' : '4');
+        watch->callback (MM_NETLINK_MONITOR_EVENT_ADDRESS_REMOVED, watch->user_data);
+        return;
+    }
+    default:
+        return;
+    }
+}
+
+static gboolean
+netlink_ready (gint          fd,
+               GIOCondition  condition,
+               gpointer      user_data)
+{
+    static guint8 buffer[RECV_BUFFER_SIZE];
+
+    dispatching = TRUE;
+
+    /* Stop as soon as the last watch is gone */
+    while (watches) {
+        const struct nlmsghdr *hdr;
+        struct sockaddr_nl     sender;
+        struct iovec           iov = { buffer, sizeof (buffer) };
+        struct msghdr          msg = { &sender, sizeof (sender), &iov, 1, NULL, 0, 0 };
+        gssize                 len;
+
+        len = recvmsg (fd, &msg, 0);
+        if (len < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == ENOBUFS) {
+                mm_dbg ("netlink monitor overrun, some events were lost");
+                notify_all (MM_NETLINK_MONITOR_EVENT_OVERRUN);
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                mm_warn ("couldn't read from netlink socket: %s", g_strerror (errno));
+            break;
+        }
+
+        /* Only trust messages from the kernel */
+        if (msg.msg_namelen != sizeof (sender) || sender.nl_pid != 0)
+            continue;
+
+        for (hdr = (const struct nlmsghdr *) buffer;
+             NLMSG_OK (hdr, (guint) len) && watches;
+             hdr = NLMSG_NEXT (hdr, len))
+            process_message (hdr);
+    }
+
+    dispatching = FALSE;
+
+    /* Removes this same source */
+    if (!watches) {
+        netlink_close ();
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+netlink_open (void)
+{
+    struct sockaddr_nl addr;
+    gint               fd;
+
+    if (netlink_fd >= 0)
+        return TRUE;
+
+    fd = socket (AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0) {
+        mm_dbg ("couldn't create netlink socket: %s", g_strerror (errno));
+        return FALSE;
+    }
+
+    memset (&addr, 0, sizeof (addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+    if (bind (fd, (struct sockaddr *) &addr, sizeof (addr)) < 0) {
+        mm_dbg ("couldn't bind netlink socket: %s", g_strerror (errno));
+        close (fd);
+        return FALSE;
+    }
+
+    netlink_fd = fd;
+    netlink_source_id = g_unix_fd_add (fd, G_IO_IN, netlink_ready, NULL);
+    return TRUE;
+}
+
+/*****************************************************************************/
+
+static gboolean
+read_carrier (const gchar *ifname)
+{
+    gchar    *path;
+    gchar    *contents = NULL;
+    gboolean  carrier = FALSE;
+
+    /* Reading carrier fails if the interface is down */
+    path = g_strdup_printf ("/sys/class/net/%s/carrier", ifname);
+    if (g_file_get_contents (path, &contents, NULL, NULL))
+        carrier = (contents[0] == '1');
+    g_free (contents);
+    g_free (path);
+    return carrier;
+}
+
+MMNetlinkMonitorWatch *
+mm_netlink_monitor_watch_new (const gchar          *ifname,
+                              MMNetlinkMonitorFunc  callback,
+                              gpointer              user_data)
+{
+    MMNetlinkMonitorWatch *watch;
+    guint                  ifindex;
+
+    g_return_val_if_fail (ifname != NULL, NULL);
+    g_return_val_if_fail (callback != NULL, NULL);
+
+    ifindex = if_nametoindex (ifname);
+    if (!ifindex) {
+        mm_dbg ("(%s) couldn't get network interface index: %s", ifname, g_strerror (errno));
+        return NULL;
+    }
+
+    if (!netlink_open ())
+        return NULL;
+
+    watch = g_slice_new0 (MMNetlinkMonitorWatch);
+    watch->ifname = g_strdup (ifname);
+    watch->ifindex = ifindex;
+    watch->callback = callback;
+    watch->user_data = user_data;
+    watch->lower_up_seen = read_carrier (ifname);
+    watches = g_list_prepend (watches, watch);
+
+    return watch;
+}
+
+void
+mm_netlink_monitor_watch_free (MMNetlinkMonitorWatch *watch)
+{
+    g_return_if_fail (watch != NULL);
+
+    watches = g_list_remove (watches, watch);
+    g_free (watch->ifname);
+    g_slice_free (MMNetlinkMonitorWatch, watch);
+
+    /* If dispatching, the socket is closed once done */
+    if (!watches && !dispatching)
+        netlink_close ();
+}
@@ -0,0 +1,51 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+#ifndef MM_NETLINK_MONITOR_H
+#define MM_NETLINK_MONITOR_H
+
+#include <glib.h>
+
+/* Kernel network interface monitoring.
+ *
+ * A single rtnetlink socket subscribed to link and address events is shared
+ * by all watches, and only kept open while there is at least one. Events are
+ * dispatched in the main context. */
+
+typedef enum {
+    /* The interface is up, but carrier was lost after having been seen */
+    MM_NETLINK_MONITOR_EVENT_CARRIER_LOST,
+    /* The interface went away */
+    MM_NETLINK_MONITOR_EVENT_LINK_REMOVED,
+    /* An IPv4 or IPv6 address was removed from the interface */
+    MM_NETLINK_MONITOR_EVENT_ADDRESS_REMOVED,
+    /* Events were dropped by the kernel, so any of the above may be lost */
+    MM_NETLINK_MONITOR_EVENT_OVERRUN,
+} MMNetlinkMonitorEvent;
+
+typedef struct _MMNetlinkMonitorWatch MMNetlinkMonitorWatch;
+
+/* The watch may be freed from within */
+typedef void (* MMNetlinkMonitorFunc) (MMNetlinkMonitorEvent event,
+                                       gpointer              user_data);
+
+/* Returns NULL if the interface doesn't exist or if the netlink socket
+ * cannot be used */
+MMNetlinkMonitorWatch *mm_netlink_monitor_watch_new  (const gchar           *ifname,
+                                                      MMNetlinkMonitorFunc   callback,
+                                                      gpointer               user_data);
+void                   mm_netlink_monitor_watch_free (MMNetlinkMonitorWatch *watch);
+
+#endif /* MM_NETLINK_MONITOR_H */
@@ -0,0 +1,468 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+#include <config.h>
+
+#include "mm-poll-scheduler.h"
+#include "mm-port-serial.h"
+#include "mm-utils.h"
+#include "mm-context.h"
+#include "mm-log.h"
+
+G_DEFINE_TYPE (MMPollScheduler, mm_poll_scheduler, G_TYPE_OBJECT)
+
+/* Max number of polls run in the same tick, for all modems */
+#define POLL_MAX_PER_TICK 8
+/* Default max number of polls run in the same tick, per modem */
+#define POLL_DEFAULT_MODEM_BUDGET 1
+/* Max number of times a poll is deferred because the port is busy */
+#define POLL_MAX_BUSY_DEFERRALS 5
+/* Polls with intervals at least this long get a per-modem jitter applied */
+#define POLL_JITTER_MIN_INTERVAL_SECS 10
+
+typedef struct {
+    guint        id;
+    MMBaseModem *modem;
+    gchar       *name;
+    guint        interval_secs;
+    gint64       next_due_secs;
+    guint        n_busy_deferrals;
+    GSourceFunc  callback;
+    gpointer     user_data;
+} PollEntry;
+
+typedef struct {
+    MMPollSchedulerStats stats;
+    guint                n_polls_in_tick;
+} ModemBudget;
+
+struct _MMPollSchedulerPrivate {
+    /* guint id -> PollEntry */
+    GHashTable *entries;
+    /* MMBaseModem (weak) -> ModemBudget */
+    GHashTable *budgets;
+    guint       next_id;
+    /* Single timeout to the earliest due poll */
+    guint       tick_id;
+    gint64      tick_due_secs;
+};
+
+static void modem_gone (MMPollScheduler *self,
+                        GObject         *where_the_modem_was);
+
+/*****************************************************************************/
+
+static gint64
+now_secs (void)
+{
+    return g_get_monotonic_time () / G_USEC_PER_SEC;
+}
+
+static void
+poll_entry_free (PollEntry *entry)
+{
+    g_free (entry->name);
+    g_slice_free (PollEntry, entry);
+}
+
+static void
+modem_budget_free (ModemBudget *budget)
+{
+    g_slice_free (ModemBudget, budget);
+}
+
+static ModemBudget *
+get_modem_budget (MMPollScheduler *self,
+                  MMBaseModem     *modem)
+{
+    ModemBudget *budget;
+
+    budget = g_hash_table_lookup (self->priv->budgets, modem);
+    if (!budget) {
+        budget = g_slice_new0 (ModemBudget);
+        budget->stats.budget = mm_context_get_poll_budget ();
+        if (!budget->stats.budget)
+            budget->stats.budget = POLL_DEFAULT_MODEM_BUDGET;
+        g_hash_table_insert (self->priv->budgets, modem, budget);
+        g_object_weak_ref (G_OBJECT (modem), (GWeakNotify) modem_gone, self);
+    }
+    return budget;
+}
+
+static gboolean
+remove_if_modem (gpointer  key,
+                 PollEntry *entry,
+                 gpointer  modem)
+{
+    return ((gpointer) entry->modem == modem);
+}
+
+static void
+modem_gone (MMPollScheduler *self,
+            GObject         *where_the_modem_was)
+{
+    ModemBudget *budget;
+
+    budget = g_hash_table_lookup (self->priv->budgets, where_the_modem_was);
+    if (budget)
+        mm_dbg ("[poll-scheduler] modem %p gone: %u polls, %u deferred (busy), %u deferred (load), %u skipped (fresh)",
+                where_the_modem_was,
+                budget->stats.n_polls,
+                budget->stats.n_deferred_busy,
+                budget->stats.n_deferred_load,
+                budget->stats.n_skipped_fresh);
+
+    /* Entries should have been removed already by their owners, but don't
+     * leave dangling ones around in any case */
+    g_hash_table_foreach_remove (self->priv->entries, (GHRFunc) remove_if_modem, where_the_modem_was);
+    g_hash_table_remove (self->priv->budgets, where_the_modem_was);
+}
+
+/*****************************************************************************/
+
+static gboolean tick_cb (MMPollScheduler *self);
+
+static void
+find_earliest (gpointer   key,
+               PollEntry *entry,
+               gint64    *earliest)
+{
+    if (*earliest == 0 || entry->next_due_secs < *earliest)
+        *earliest = entry->next_due_secs;
+}
+
+static void
+schedule_tick (MMPollScheduler *self)
+{
+    gint64 earliest = 0;
+    gint64 now;
+
+    g_hash_table_foreach (self->priv->entries, (GHFunc) find_earliest, &earliest);
+
+    /* Nothing to poll? */
+    if (!earliest) {
+        if (self->priv->tick_id) {
+            g_source_remove (self->priv->tick_id);
+            self->priv->tick_id = 0;
+        }
+        return;
+    }
+
+    /* Already scheduled at the right time? */
+    if (self->priv->tick_id && self->priv->tick_due_secs == earliest)
+        return;
+
+    if (self->priv->tick_id)
+        g_source_remove (self->priv->tick_id);
+
+    /* Seconds-based timeouts are aligned by GLib to whole seconds, so all
+     * polls due around the same time are run in the same wakeup */
+    now = now_secs ();
+    self->priv->tick_due_secs = earliest;
+    self->priv->tick_id = g_timeout_add_seconds ((guint) MAX (earliest - now, 1),
+                                                 (GSourceFunc) tick_cb,
+                                                 self);
+}
+
+static void
+collect_due (gpointer   key,
+             PollEntry *entry,
+             gpointer  *user_data)
+{
+    GList  **due = user_data[0];
+    gint64  *now = user_data[1];
+
+    if (entry->next_due_secs <= *now)
+        *due = g_list_prepend (*due, entry);
+}
+
+static gint
+entry_cmp_due (const PollEntry *a,
+               const PollEntry *b)
+{
+    if (a->next_due_secs != b->next_due_secs)
+        return (a->next_due_secs < b->next_due_secs ? -1 : 1);
+    return (a->id < b->id ? -1 : (a->id > b->id ? 1 : 0));
+}
+
+static void
+reset_budget_tick (gpointer     key,
+                   ModemBudget *budget)
+{
+    budget->n_polls_in_tick = 0;
+}
+
+static gboolean
+modem_port_busy (MMBaseModem *modem)
+{
+    MMPortSerialAt *primary;
+
+    primary = mm_base_modem_peek_port_primary (modem);
+    return (primary && mm_port_serial_is_busy (MM_PORT_SERIAL (primary)));
+}
+
+static gboolean
+tick_cb (MMPollScheduler *self)
+{
+    GList    *due = NULL;
+    GList    *ids = NULL;
+    GList    *l;
+    gint64    now;
+    guint     n_run = 0;
+    gpointer  collect_data[2];
+
+    self->priv->tick_id = 0;
+    now = now_secs ();
+
+    g_hash_table_foreach (self->priv->budgets, (GHFunc) reset_budget_tick, NULL);
+
+    /* Oldest due first, so that deferred polls don't starve */
+    collect_data[0] = &due;
+    collect_data[1] = &now;
+    g_hash_table_foreach (self->priv->entries, (GHFunc) collect_due, collect_data);
+    due = g_list_sort (due, (GCompareFunc) entry_cmp_due);
+
+    /* Entries may be removed while running other callbacks, so keep ids only */
+    for (l = due; l; l = g_list_next (l))
+        ids = g_list_prepend (ids, GUINT_TO_POINTER (((PollEntry *) l->data)->id));
+    ids = g_list_reverse (ids);
+    g_list_free (due);
+
+    g_object_ref (self);
+    for (l = ids; l; l = g_list_next (l)) {
+        PollEntry   *entry;
+        ModemBudget *budget;
+        GSourceFunc  callback;
+        gpointer     user_data;
+        guint        id;
+
+        id = GPOINTER_TO_UINT (l->data);
+        entry = g_hash_table_lookup (self->priv->entries, l->data);
+        if (!entry)
+            continue;
+
+        budget = get_modem_budget (self, entry->modem);
+
+        /* Spread load: if too many polls already run in this tick, or if
+         * this modem already used its budget, retry in the next tick */
+        if (n_run >= POLL_MAX_PER_TICK || budget->n_polls_in_tick >= budget->stats.budget) {
+            budget->stats.n_deferred_load++;
+            entry->next_due_secs = now + 1;
+            continue;
+        }
+
+        /* Don't queue more commands in a port that is already busy, unless
+         * we have been waiting for it for too long already */
+        if (entry->n_busy_deferrals < POLL_MAX_BUSY_DEFERRALS && modem_port_busy (entry->modem)) {
+            mm_dbg ("[poll-scheduler] deferring '%s' poll: port busy", entry->name);
+            budget->stats.n_deferred_busy++;
+            entry->n_busy_deferrals++;
+            entry->next_due_secs = now + 1;
+            continue;
+        }
+
+        entry->n_busy_deferrals = 0;
+        budget->n_polls_in_tick++;
+        budget->stats.n_polls++;
+        n_run++;
+
+        /* Note: the modem and budget may be gone after the callback */
+        callback  = entry->callback;
+        user_data = entry->user_data;
+        if (!callback (user_data)) {
+            g_hash_table_remove (self->priv->entries, GUINT_TO_POINTER (id));
+            continue;
+        }
+
+        entry = g_hash_table_lookup (self->priv->entries, GUINT_TO_POINTER (id));
+        if (entry)
+            entry->next_due_secs = now + entry->interval_secs;
+    }
+    g_list_free (ids);
+
+    schedule_tick (self);
+    g_object_unref (self);
+
+    return G_SOURCE_REMOVE;
+}
+
+/*****************************************************************************/
+
+guint
+mm_poll_scheduler_add (MMPollScheduler *self,
+                       MMBaseModem     *modem,
+                       const gchar     *name,
+                       guint            interval_secs,
+                       GSourceFunc      callback,
+                       gpointer         user_data)
+{
+    PollEntry *entry;
+    guint      jitter = 0;
+
+    g_return_val_if_fail (MM_IS_POLL_SCHEDULER (self), 0);
+    g_return_val_if_fail (MM_IS_BASE_MODEM (modem), 0);
+    g_return_val_if_fail (callback != NULL, 0);
+
+    entry = g_slice_new0 (PollEntry);
+    entry->id = ++self->priv->next_id;
+    if (G_UNLIKELY (!entry->id))
+        entry->id = ++self->priv->next_id;
+    entry->modem = modem;
+    entry->name = g_strdup (name);
+    entry->interval_secs = MAX (interval_secs, 1);
+    entry->callback = callback;
+    entry->user_data = user_data;
+
+    /* Long intervals get a per-modem offset, so that modems enabled at the
+     * same time (e.g. after boot) don't end up polling all in lockstep */
+    if (entry->interval_secs >= POLL_JITTER_MIN_INTERVAL_SECS) {
+        const gchar *device;
+
+        device = mm_base_modem_get_device (modem);
+        jitter = (device ? g_str_hash (device) : GPOINTER_TO_UINT (modem)) % (entry->interval_secs / 4 + 1);
+    }
+    entry->next_due_secs = now_secs () + entry->interval_secs + jitter;
+
+    /* Make sure the budget exists, so that we get notified when the modem
+     * goes away */
+    get_modem_budget (self, modem);
+
+    g_hash_table_insert (self->priv->entries, GUINT_TO_POINTER (entry->id), entry);
+    schedule_tick (self);
+
+    return entry->id;
+}
+
+void
+mm_poll_scheduler_remove (MMPollScheduler *self,
+                          guint            id)
+{
+    g_return_if_fail (MM_IS_POLL_SCHEDULER (self));
+
+    /* Removing an already gone entry is allowed */
+    if (g_hash_table_remove (self->priv->entries, GUINT_TO_POINTER (id)))
+        schedule_tick (self);
+}
+
+void
+mm_poll_scheduler_notify_fresh (MMPollScheduler *self,
+                                guint            id)
+{
+    PollEntry   *entry;
+    ModemBudget *budget;
+
+    g_return_if_fail (MM_IS_POLL_SCHEDULER (self));
+
+    entry = g_hash_table_lookup (self->priv->entries, GUINT_TO_POINTER (id));
+    if (!entry)
+        return;
+
+    budget = get_modem_budget (self, entry->modem);
+    budget->stats.n_skipped_fresh++;
+    entry->next_due_secs = now_secs () + entry->interval_secs;
+    schedule_tick (self);
+}
+
+void
+mm_poll_scheduler_set_budget (MMPollScheduler *self,
+                              MMBaseModem     *modem,
+                              guint            budget)
+{
+    g_return_if_fail (MM_IS_POLL_SCHEDULER (self));
+    g_return_if_fail (MM_IS_BASE_MODEM (modem));
+
+    get_modem_budget (self, modem)->stats.budget = MAX (budget, 1);
+}
+
+gboolean
+mm_poll_scheduler_get_stats (MMPollScheduler      *self,
+                             MMBaseModem          *modem,
+                             MMPollSchedulerStats *stats)
+{
+    ModemBudget *budget;
+
+    g_return_val_if_fail (MM_IS_POLL_SCHEDULER (self), FALSE);
+    g_return_val_if_fail (stats != NULL, FALSE);
+
+    budget = g_hash_table_lookup (self->priv->budgets, modem);
+    if (!budget)
+        return FALSE;
+
+    *stats = budget->stats;
+    return TRUE;
+}
+
+/*****************************************************************************/
+
+static void
+mm_poll_scheduler_init (MMPollScheduler *self)
+{
+    self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
+                                              MM_TYPE_POLL_SCHEDULER,
+                                              MMPollSchedulerPrivate);
+
+    self->priv->entries = g_hash_table_new_full (g_direct_hash,
+                                                 g_direct_equal,
+                                                 NULL,
+                                                 (GDestroyNotify) poll_entry_free);
+    self->priv->budgets = g_hash_table_new_full (g_direct_hash,
+                                                 g_direct_equal,
+                                                 NULL,
+                                                 (GDestroyNotify) modem_budget_free);
+}
+
+static void
+weak_unref_modem (GObject         *modem,
+                  ModemBudget     *budget,
+                  MMPollScheduler *self)
+{
+    g_object_weak_unref (modem, (GWeakNotify) modem_gone, self);
+}
+
+static void
+dispose (GObject *object)
+{
+    MMPollScheduler *self = MM_POLL_SCHEDULER (object);
+
+    if (self->priv->tick_id) {
+        g_source_remove (self->priv->tick_id);
+        self->priv->tick_id = 0;
+    }
+
+    if (self->priv->budgets) {
+        g_hash_table_foreach (self->priv->budgets, (GHFunc) weak_unref_modem, self);
+        g_hash_table_destroy (self->priv->budgets);
+        self->priv->budgets = NULL;
+    }
+
+    if (self->priv->entries) {
+        g_hash_table_destroy (self->priv->entries);
+        self->priv->entries = NULL;
+    }
+
+    G_OBJECT_CLASS (mm_poll_scheduler_parent_class)->dispose (object);
+}
+
+static void
+mm_poll_scheduler_class_init (MMPollSchedulerClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    g_type_class_add_private (object_class, sizeof (MMPollSchedulerPrivate));
+
+    object_class->dispose = dispose;
+}
+
+MM_DEFINE_SINGLETON_GETTER (MMPollScheduler, mm_poll_scheduler_get, MM_TYPE_POLL_SCHEDULER);
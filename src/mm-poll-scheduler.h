@@ -0,0 +1,87 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+#ifndef MM_POLL_SCHEDULER_H
+#define MM_POLL_SCHEDULER_H
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include "mm-base-modem.h"
+
+#define MM_TYPE_POLL_SCHEDULER            (mm_poll_scheduler_get_type ())
+#define MM_POLL_SCHEDULER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), MM_TYPE_POLL_SCHEDULER, MMPollScheduler))
+#define MM_POLL_SCHEDULER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  MM_TYPE_POLL_SCHEDULER, MMPollSchedulerClass))
+#define MM_IS_POLL_SCHEDULER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), MM_TYPE_POLL_SCHEDULER))
+#define MM_IS_POLL_SCHEDULER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  MM_TYPE_POLL_SCHEDULER))
+#define MM_POLL_SCHEDULER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  MM_TYPE_POLL_SCHEDULER, MMPollSchedulerClass))
+
+typedef struct _MMPollScheduler MMPollScheduler;
+typedef struct _MMPollSchedulerClass MMPollSchedulerClass;
+typedef struct _MMPollSchedulerPrivate MMPollSchedulerPrivate;
+
+struct _MMPollScheduler {
+    GObject parent;
+    MMPollSchedulerPrivate *priv;
+};
+
+struct _MMPollSchedulerClass {
+    GObjectClass parent;
+};
+
+GType mm_poll_scheduler_get_type (void);
+
+/* The poll scheduler is a singleton owning all periodic modem queries
+ * (signal quality, registration, call list...). All polls are run from a
+ * single 1s tick, so that the daemon wakes up once for all modems instead of
+ * once per modem and per poll type. */
+MMPollScheduler *mm_poll_scheduler_get (void);
+
+/* Per-modem poll counters */
+typedef struct {
+    guint budget;          /* max polls run per tick for this modem */
+    guint n_polls;         /* polls run */
+    guint n_deferred_busy; /* polls deferred because the port was busy */
+    guint n_deferred_load; /* polls deferred because of tick/modem budget */
+    guint n_skipped_fresh; /* polls skipped because fresh data was reported */
+} MMPollSchedulerStats;
+
+/* Schedule a poll in the given number of seconds. The semantics of the
+ * callback return value are the same as for g_timeout_add_seconds():
+ * G_SOURCE_CONTINUE reschedules the poll after @interval_secs, and
+ * G_SOURCE_REMOVE removes it. */
+guint    mm_poll_scheduler_add            (MMPollScheduler *self,
+                                           MMBaseModem     *modem,
+                                           const gchar     *name,
+                                           guint            interval_secs,
+                                           GSourceFunc      callback,
+                                           gpointer         user_data);
+void     mm_poll_scheduler_remove         (MMPollScheduler *self,
+                                           guint            id);
+
+/* Report that the data the poll would query was just received by other means
+ * (e.g. an unsolicited message), so that the next poll is delayed by a full
+ * interval. */
+void     mm_poll_scheduler_notify_fresh   (MMPollScheduler *self,
+                                           guint            id);
+
+void     mm_poll_scheduler_set_budget     (MMPollScheduler      *self,
+                                           MMBaseModem          *modem,
+                                           guint                 budget);
+gboolean mm_poll_scheduler_get_stats      (MMPollScheduler      *self,
+                                           MMBaseModem          *modem,
+                                           MMPollSchedulerStats *stats);
+
+#endif /* MM_POLL_SCHEDULER_H */
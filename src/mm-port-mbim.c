@@ -27,11 +27,13 @@
 
 #include "mm-port-mbim.h"
 #include "mm-log.h"
+#include "mm-trace.h"
 
 G_DEFINE_TYPE (MMPortMbim, mm_port_mbim, MM_TYPE_PORT)
 
 struct _MMPortMbimPrivate {
     gboolean    in_progress;
+    gint64      open_start_time;
     MbimDevice *mbim_device;
 #if defined WITH_QMI && QMI_MBIM_QMUX_SUPPORTED
     QmiDevice  *qmi_device;
@@ -241,10 +243,25 @@ mbim_device_open_ready (MbimDevice   *mbim_device,
 {
     GError     *error = NULL;
     MMPortMbim *self;
+    gboolean    success;
 
     self = g_task_get_source_object (task);
 
-    if (!mbim_device_open_full_finish (mbim_device, res, &error)) {
+    /* MBIM requests go straight through the MbimDevice, so the open sequence
+     * is what we can account for in the port */
+    success = mbim_device_open_full_finish (mbim_device, res, &error);
+    mm_port_stats_record (mm_port_peek_stats (MM_PORT (self)),
+                          "open",
+                          MM_PORT_STATS_PHASE_RESPONSE,
+                          g_get_monotonic_time () - self->priv->open_start_time);
+    mm_port_stats_record_result (mm_port_peek_stats (MM_PORT (self)),
+                                 "open",
+                                 (success ? MM_PORT_STATS_RESULT_OK :
+                                  (g_error_matches (error, MBIM_CORE_ERROR, MBIM_CORE_ERROR_TIMEOUT) ?
+                                   MM_PORT_STATS_RESULT_TIMEOUT : MM_PORT_STATS_RESULT_ERROR)));
+    mm_trace_transaction_end (task, "mbim", "open", success ? "ok" : error->message);
+
+    if (!success) {
         g_clear_object (&self->priv->mbim_device);
         self->priv->in_progress = FALSE;
         g_task_return_error (task, error);
@@ -288,6 +305,7 @@ mbim_device_new_ready (GObject      *unused,
     self = g_task_get_source_object (task);
     self->priv->mbim_device = mbim_device_new_finish (res, &error);
     if (!self->priv->mbim_device) {
+        mm_trace_transaction_end (task, "mbim", "open", error->message);
         g_task_return_error (task, error);
         g_object_unref (task);
         return;
@@ -344,6 +362,8 @@ mm_port_mbim_open (MMPortMbim          *self,
 #endif
 
     self->priv->in_progress = TRUE;
+    self->priv->open_start_time = g_get_monotonic_time ();
+    mm_trace_transaction_begin (task, "mbim", "open", mm_port_get_device (MM_PORT (self)));
     mbim_device_new (file,
                      cancellable,
                      (GAsyncReadyCallback)mbim_device_new_ready,
@@ -23,28 +23,49 @@
 
 #include "mm-port-qmi.h"
 #include "mm-log.h"
+#include "mm-trace.h"
 
 G_DEFINE_TYPE (MMPortQmi, mm_port_qmi, MM_TYPE_PORT)
 
+/* Clients without leases are released after this time, unless pinned */
+#define CLIENT_IDLE_TIMEOUT_SECS 300
+
 typedef struct {
     QmiService service;
     QmiClient *client;
     MMPortQmiFlag flag;
+    /* Pinned clients are kept until the port is closed */
+    gboolean pinned;
+    guint n_leases;
+    guint idle_timeout_id;
+    /* Not owned */
+    MMPortQmi *self;
 } ServiceInfo;
 
 struct _MMPortQmiPrivate {
     gboolean opening;
     QmiDevice *qmi_device;
     GList *services;
+    /* Allocations in progress, as GTasks */
+    GList *allocations;
     gboolean llp_is_raw_ip;
 };
 
 /*****************************************************************************/
 
-QmiClient *
-mm_port_qmi_peek_client (MMPortQmi *self,
-                         QmiService service,
-                         MMPortQmiFlag flag)
+static void
+service_info_free (ServiceInfo *info)
+{
+    if (info->idle_timeout_id)
+        g_source_remove (info->idle_timeout_id);
+    g_clear_object (&info->client);
+    g_free (info);
+}
+
+static ServiceInfo *
+lookup_service_info (MMPortQmi *self,
+                     QmiService service,
+                     MMPortQmiFlag flag)
 {
     GList *l;
 
@@ -53,12 +74,23 @@ mm_port_qmi_peek_client (MMPortQmi *self,
 
         if (info->service == service &&
             info->flag == flag)
-            return info->client;
+            return info;
     }
 
     return NULL;
 }
 
+QmiClient *
+mm_port_qmi_peek_client (MMPortQmi *self,
+                         QmiService service,
+                         MMPortQmiFlag flag)
+{
+    ServiceInfo *info;
+
+    info = lookup_service_info (self, service, flag);
+    return (info ? info->client : NULL);
+}
+
 QmiClient *
 mm_port_qmi_get_client (MMPortQmi *self,
                         QmiService service,
@@ -84,11 +116,17 @@ mm_port_qmi_peek_device (MMPortQmi *self)
 
 typedef struct {
     ServiceInfo *info;
+    gint64       start_time;
+    /* Requests for the same client received meanwhile */
+    GList       *waiters;
 } AllocateClientContext;
 
+static void service_info_schedule_idle_release (ServiceInfo *info);
+
 static void
 allocate_client_context_free (AllocateClientContext *ctx)
 {
+    g_assert (ctx->waiters == NULL);
     if (ctx->info) {
         g_assert (ctx->info->client == NULL);
         g_free (ctx->info);
@@ -96,6 +134,25 @@ allocate_client_context_free (AllocateClientContext *ctx)
     g_free (ctx);
 }
 
+static GTask *
+lookup_allocation (MMPortQmi *self,
+                   QmiService service,
+                   MMPortQmiFlag flag)
+{
+    GList *l;
+
+    for (l = self->priv->allocations; l; l = g_list_next (l)) {
+        AllocateClientContext *ctx;
+
+        ctx = g_task_get_task_data (G_TASK (l->data));
+        if (ctx->info->service == service &&
+            ctx->info->flag == flag)
+            return G_TASK (l->data);
+    }
+
+    return NULL;
+}
+
 gboolean
 mm_port_qmi_allocate_client_finish (MMPortQmi *self,
                                     GAsyncResult *res,
@@ -112,35 +169,81 @@ allocate_client_ready (QmiDevice *qmi_device,
     MMPortQmi *self;
     AllocateClientContext *ctx;
     GError *error = NULL;
+    gchar *stats_key;
 
     self = g_task_get_source_object (task);
     ctx = g_task_get_task_data (task);
     ctx->info->client = qmi_device_allocate_client_finish (qmi_device, res, &error);
+    self->priv->allocations = g_list_remove (self->priv->allocations, task);
+
+    /* Individual service requests go straight through the QmiClient, so the
+     * CTL round-trips are what we can account for in the port */
+    stats_key = g_strdup_printf ("ctl-allocate-%s", qmi_service_get_string (ctx->info->service));
+    mm_port_stats_record (mm_port_peek_stats (MM_PORT (self)),
+                          stats_key,
+                          MM_PORT_STATS_PHASE_RESPONSE,
+                          g_get_monotonic_time () - ctx->start_time);
+    mm_port_stats_record_result (mm_port_peek_stats (MM_PORT (self)),
+                                 stats_key,
+                                 (ctx->info->client ? MM_PORT_STATS_RESULT_OK :
+                                  (g_error_matches (error, QMI_CORE_ERROR, QMI_CORE_ERROR_TIMEOUT) ?
+                                   MM_PORT_STATS_RESULT_TIMEOUT : MM_PORT_STATS_RESULT_ERROR)));
+    mm_trace_transaction_end (task, "qmi", stats_key, ctx->info->client ? "ok" : error->message);
+    g_free (stats_key);
+
+    /* If the port was closed meanwhile, the client is useless */
+    if (ctx->info->client && self->priv->qmi_device != qmi_device) {
+        g_clear_object (&ctx->info->client);
+        error = g_error_new (MM_CORE_ERROR, MM_CORE_ERROR_WRONG_STATE,
+                             "Port closed while allocating client");
+    }
+
     if (!ctx->info->client) {
         g_prefix_error (&error,
                         "Couldn't create client for service '%s': ",
                         qmi_service_get_string (ctx->info->service));
-        g_task_return_error (task, error);
     } else {
-        /* Move the service info to our internal list */
+        /* Move the service info to our internal list; until leased, it is
+         * idle already */
+        ctx->info->self = self;
         self->priv->services = g_list_prepend (self->priv->services, ctx->info);
+        service_info_schedule_idle_release (ctx->info);
         ctx->info = NULL;
-        g_task_return_boolean (task, TRUE);
     }
 
+    /* Complete all requests with the same outcome */
+    while (ctx->waiters) {
+        GTask *waiter;
+
+        waiter = G_TASK (ctx->waiters->data);
+        ctx->waiters = g_list_delete_link (ctx->waiters, ctx->waiters);
+        if (error)
+            g_task_return_error (waiter, g_error_copy (error));
+        else
+            g_task_return_boolean (waiter, TRUE);
+        g_object_unref (waiter);
+    }
+
+    if (error)
+        g_task_return_error (task, error);
+    else
+        g_task_return_boolean (task, TRUE);
     g_object_unref (task);
 }
 
-void
-mm_port_qmi_allocate_client (MMPortQmi *self,
-                             QmiService service,
-                             MMPortQmiFlag flag,
-                             GCancellable *cancellable,
-                             GAsyncReadyCallback callback,
-                             gpointer user_data)
+static void
+allocate_client (MMPortQmi *self,
+                 QmiService service,
+                 MMPortQmiFlag flag,
+                 gboolean pinned,
+                 GCancellable *cancellable,
+                 GAsyncReadyCallback callback,
+                 gpointer user_data)
 {
     AllocateClientContext *ctx;
+    ServiceInfo *info;
     GTask *task;
+    GTask *allocation;
 
     task = g_task_new (self, cancellable, callback, user_data);
 
@@ -151,29 +254,228 @@ mm_port_qmi_allocate_client (MMPortQmi *self,
         return;
     }
 
-    if (!!mm_port_qmi_peek_client (self, service, flag)) {
-        g_task_return_new_error (task, MM_CORE_ERROR, MM_CORE_ERROR_EXISTS,
-                                 "Client for service '%s' already allocated",
-                                 qmi_service_get_string (service));
+    info = lookup_service_info (self, service, flag);
+    if (info) {
+        if (info->pinned) {
+            g_task_return_new_error (task, MM_CORE_ERROR, MM_CORE_ERROR_EXISTS,
+                                     "Client for service '%s' already allocated",
+                                     qmi_service_get_string (service));
+            g_object_unref (task);
+            return;
+        }
+
+        /* Client in the pool (leased or idle): take it over, and make sure
+         * it is no longer released when idle */
+        mm_dbg ("Reusing pooled client for service '%s'...", qmi_service_get_string (service));
+        mm_port_stats_record_event (mm_port_peek_stats (MM_PORT (self)), "qmi-client-reused");
+        if (pinned) {
+            info->pinned = TRUE;
+            if (info->idle_timeout_id) {
+                g_source_remove (info->idle_timeout_id);
+                info->idle_timeout_id = 0;
+            }
+        }
+        g_task_return_boolean (task, TRUE);
         g_object_unref (task);
         return;
     }
 
+    /* If the same client is already being allocated (e.g. by another bearer
+     * connecting at the same time), just wait for it */
+    allocation = lookup_allocation (self, service, flag);
+    if (allocation) {
+        mm_dbg ("Client for service '%s' already being allocated, waiting...",
+                qmi_service_get_string (service));
+        mm_port_stats_record_event (mm_port_peek_stats (MM_PORT (self)), "qmi-client-joined");
+        ctx = g_task_get_task_data (allocation);
+        ctx->info->pinned |= pinned;
+        ctx->waiters = g_list_append (ctx->waiters, task);
+        return;
+    }
+
     ctx = g_new0 (AllocateClientContext, 1);
     ctx->info = g_new0 (ServiceInfo, 1);
     ctx->info->service = service;
     ctx->info->flag = flag;
+    ctx->info->pinned = pinned;
+    ctx->start_time = g_get_monotonic_time ();
     g_task_set_task_data (task, ctx, (GDestroyNotify)allocate_client_context_free);
 
+    if (mm_trace_enabled ()) {
+        gchar *name;
+
+        name = g_strdup_printf ("ctl-allocate-%s", qmi_service_get_string (service));
+        _mm_trace_transaction_begin (task, "qmi", name, mm_port_get_device (MM_PORT (self)));
+        g_free (name);
+    }
+
+    /* The allocation is shared with the requests joining it, so it is never
+     * cancelled; a cancelled request is still completed with an error, and
+     * the client is kept for later use */
+    self->priv->allocations = g_list_prepend (self->priv->allocations, task);
     qmi_device_allocate_client (self->priv->qmi_device,
                                 service,
                                 QMI_CID_NONE,
                                 10,
-                                cancellable,
+                                NULL,
                                 (GAsyncReadyCallback)allocate_client_ready,
                                 task);
 }
 
+void
+mm_port_qmi_allocate_client (MMPortQmi *self,
+                             QmiService service,
+                             MMPortQmiFlag flag,
+                             GCancellable *cancellable,
+                             GAsyncReadyCallback callback,
+                             gpointer user_data)
+{
+    allocate_client (self, service, flag, TRUE, cancellable, callback, user_data);
+}
+
+/*****************************************************************************/
+/* Client leases */
+
+static gboolean
+idle_release_cb (ServiceInfo *info)
+{
+    MMPortQmi *self;
+
+    info->idle_timeout_id = 0;
+    self = info->self;
+
+    g_assert (info->n_leases == 0 && !info->pinned);
+    mm_dbg ("Releasing idle client for service '%s'...", qmi_service_get_string (info->service));
+    mm_port_stats_record_event (mm_port_peek_stats (MM_PORT (self)), "qmi-client-idle-released");
+
+    self->priv->services = g_list_remove (self->priv->services, info);
+    qmi_device_release_client (self->priv->qmi_device,
+                               info->client,
+                               QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID,
+                               3, NULL, NULL, NULL);
+    service_info_free (info);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+service_info_schedule_idle_release (ServiceInfo *info)
+{
+    if (info->pinned || info->n_leases > 0)
+        return;
+
+    g_assert (info->idle_timeout_id == 0);
+    info->idle_timeout_id = g_timeout_add_seconds (CLIENT_IDLE_TIMEOUT_SECS,
+                                                   (GSourceFunc) idle_release_cb,
+                                                   info);
+}
+
+static void
+service_info_lease (ServiceInfo *info)
+{
+    if (info->idle_timeout_id) {
+        g_source_remove (info->idle_timeout_id);
+        info->idle_timeout_id = 0;
+    }
+    info->n_leases++;
+}
+
+typedef struct {
+    QmiService service;
+    MMPortQmiFlag flag;
+} AcquireClientContext;
+
+QmiClient *
+mm_port_qmi_acquire_client_finish (MMPortQmi *self,
+                                   GAsyncResult *res,
+                                   GError **error)
+{
+    return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+static void
+acquire_allocate_client_ready (MMPortQmi *self,
+                               GAsyncResult *res,
+                               GTask *task)
+{
+    AcquireClientContext *ctx;
+    ServiceInfo *info;
+    GError *error = NULL;
+
+    if (!mm_port_qmi_allocate_client_finish (self, res, &error)) {
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    /* Still idle, so it can't be gone */
+    ctx = g_task_get_task_data (task);
+    info = lookup_service_info (self, ctx->service, ctx->flag);
+    g_assert (info);
+    service_info_lease (info);
+    g_task_return_pointer (task, g_object_ref (info->client), g_object_unref);
+    g_object_unref (task);
+}
+
+void
+mm_port_qmi_acquire_client (MMPortQmi *self,
+                            QmiService service,
+                            MMPortQmiFlag flag,
+                            GCancellable *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer user_data)
+{
+    AcquireClientContext *ctx;
+    ServiceInfo *info;
+    GTask *task;
+
+    task = g_task_new (self, cancellable, callback, user_data);
+
+    /* Reuse the client if already allocated */
+    info = lookup_service_info (self, service, flag);
+    if (info) {
+        mm_port_stats_record_event (mm_port_peek_stats (MM_PORT (self)), "qmi-client-reused");
+        service_info_lease (info);
+        g_task_return_pointer (task, g_object_ref (info->client), g_object_unref);
+        g_object_unref (task);
+        return;
+    }
+
+    ctx = g_new0 (AcquireClientContext, 1);
+    ctx->service = service;
+    ctx->flag = flag;
+    g_task_set_task_data (task, ctx, g_free);
+    allocate_client (self,
+                     service,
+                     flag,
+                     FALSE,
+                     cancellable,
+                     (GAsyncReadyCallback)acquire_allocate_client_ready,
+                     task);
+}
+
+void
+mm_port_qmi_release_client (MMPortQmi *self,
+                            QmiClient *client)
+{
+    GList *l;
+
+    g_return_if_fail (MM_IS_PORT_QMI (self));
+    g_return_if_fail (QMI_IS_CLIENT (client));
+
+    for (l = self->priv->services; l; l = g_list_next (l)) {
+        ServiceInfo *info = l->data;
+
+        if (info->client == client) {
+            g_return_if_fail (info->n_leases > 0);
+            info->n_leases--;
+            service_info_schedule_idle_release (info);
+            return;
+        }
+    }
+
+    /* Port closed since the client was acquired; nothing to do */
+}
+
 /*****************************************************************************/
 
 gboolean
@@ -592,11 +894,14 @@ mm_port_qmi_close (MMPortQmi *self)
                                    info->client,
                                    QMI_DEVICE_RELEASE_CLIENT_FLAGS_RELEASE_CID,
                                    3, NULL, NULL, NULL);
-        g_clear_object (&info->client);
     }
-    g_list_free_full (self->priv->services, g_free);
+    g_list_free_full (self->priv->services, (GDestroyNotify)service_info_free);
     self->priv->services = NULL;
 
+    /* Allocations in progress will fail once done */
+    g_list_free (self->priv->allocations);
+    self->priv->allocations = NULL;
+
     /* Close and release the device */
     if (!qmi_device_close (self->priv->qmi_device, &error)) {
         mm_warn ("Couldn't properly close QMI device: %s",
@@ -629,16 +934,9 @@ static void
 dispose (GObject *object)
 {
     MMPortQmi *self = MM_PORT_QMI (object);
-    GList *l;
 
     /* Deallocate all clients */
-    for (l = self->priv->services; l; l = g_list_next (l)) {
-        ServiceInfo *info = l->data;
-
-        if (info->client)
-            g_object_unref (info->client);
-    }
-    g_list_free_full (self->priv->services, g_free);
+    g_list_free_full (self->priv->services, (GDestroyNotify)service_info_free);
     self->priv->services = NULL;
 
     /* Clear device object */
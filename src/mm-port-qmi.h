@@ -75,6 +75,22 @@ gboolean mm_port_qmi_allocate_client_finish (MMPortQmi *self,
                                              GAsyncResult *res,
                                              GError **error);
 
+/* Leases on pooled clients: the client is allocated only if not already
+ * available, and once the last lease is released it is kept idle for a
+ * while before being released. Clients allocated with
+ * mm_port_qmi_allocate_client() are kept until the port is closed. */
+void       mm_port_qmi_acquire_client        (MMPortQmi *self,
+                                              QmiService service,
+                                              MMPortQmiFlag flag,
+                                              GCancellable *cancellable,
+                                              GAsyncReadyCallback callback,
+                                              gpointer user_data);
+QmiClient *mm_port_qmi_acquire_client_finish (MMPortQmi *self,
+                                              GAsyncResult *res,
+                                              GError **error);
+void       mm_port_qmi_release_client        (MMPortQmi *self,
+                                              QmiClient *client);
+
 QmiClient *mm_port_qmi_peek_client (MMPortQmi *self,
                                     QmiService service,
                                     MMPortQmiFlag flag);
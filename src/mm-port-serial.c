@@ -35,12 +35,15 @@
 
 #include "mm-port-serial.h"
 #include "mm-log.h"
+#include "mm-trace.h"
+#include "mm-io-worker.h"
 #include "mm-helper-enums-types.h"
 
 static gboolean port_serial_queue_process          (gpointer data);
 static void     port_serial_schedule_queue_process (MMPortSerial *self,
                                                     guint timeout_ms);
 static void     port_serial_close_force            (MMPortSerial *self);
+static void     parse_response_buffer              (MMPortSerial *self);
 static void     port_serial_reopen_cancel          (MMPortSerial *self);
 static void     port_serial_set_cached_reply       (MMPortSerial *self,
                                                     const GByteArray *command,
@@ -91,6 +94,8 @@ struct _MMPortSerialPrivate {
     GSocket *socket;
     GSource *socket_source;
 
+    /* When reading in an I/O worker thread, either iochannel or socket */
+    MMIoWorkerWatch *io_watch;
 
     guint baud;
     guint bits;
@@ -104,6 +109,14 @@ struct _MMPortSerialPrivate {
     guint queue_id;
     guint timeout_id;
 
+    /* Command being written byte by byte, when there is a send delay */
+    MMIoWorkerWrite *paced_write;
+
+    /* Port attributes to set once the port no longer reports EAGAIN */
+    struct termios tcsetattr_pending;
+    guint tcsetattr_retry_id;
+    guint tcsetattr_retries;
+
     GCancellable *cancellable;
     gulong cancellable_id;
 
@@ -130,6 +143,12 @@ typedef struct {
     guint32 idx;
     gboolean started;
     gboolean done;
+
+    /* Stats */
+    gchar *stats_key;
+    gint64 queued_time;
+    gint64 send_time;
+    gint64 sent_time;
 } CommandContext;
 
 static void
@@ -141,12 +160,62 @@ command_context_complete_and_free (CommandContext *ctx, gboolean idle)
         g_simple_async_result_complete (ctx->result);
     g_object_unref (ctx->result);
     g_byte_array_unref (ctx->command);
+    g_free (ctx->stats_key);
     if (ctx->cancellable)
         g_object_unref (ctx->cancellable);
     g_object_unref (ctx->self);
     g_slice_free (CommandContext, ctx);
 }
 
+#define STATS_KEY_MAX_LEN 16
+
+/* AT commands are keyed by the command name only (e.g. "+CSQ" for "AT+CSQ?",
+ * "E" for "ATE0", "D" for any dial command), so that the number of keys is
+ * bounded and no argument (dialed number, PIN...) is ever exposed. Binary
+ * commands (e.g. QCDM) are keyed by their first byte. */
+static gchar *
+command_get_stats_key (const GByteArray *command)
+{
+    const gchar *verb;
+    guint        max_len;
+    guint        verb_len;
+    guint        i;
+
+    if (command->len >= 2 && !g_ascii_strncasecmp ((const gchar *) command->data, "AT", 2)) {
+        verb = (const gchar *) &command->data[2];
+        max_len = MIN (command->len - 2, STATS_KEY_MAX_LEN);
+
+        if (max_len == 0 || !g_ascii_isgraph (verb[0]))
+            return g_strdup ("AT");
+
+        /* Dial commands: the number must never be part of the key */
+        if (g_ascii_tolower (verb[0]) == 'd')
+            return g_strdup ("D");
+
+        if (!g_ascii_isalpha (verb[0]) && verb[0] != '&') {
+            /* Extended commands: prefix plus alphanumeric name, e.g. "+CPIN" */
+            verb_len = 1;
+            while (verb_len < max_len && g_ascii_isalnum (verb[verb_len]))
+                verb_len++;
+        } else {
+            /* Basic commands: a single letter, optionally after '&', with
+             * numeric arguments, e.g. "E0", "&C1" or "S7=60" */
+            verb_len = (verb[0] == '&' ? 1 : 0);
+            if (verb_len < max_len && g_ascii_isalpha (verb[verb_len]))
+                verb_len++;
+        }
+        return g_ascii_strup (verb, verb_len);
+    }
+
+    for (i = 0; i < command->len; i++) {
+        /* Skip HDLC frame markers */
+        if (command->data[i] != 0x7E)
+            return g_strdup_printf ("0x%02x", command->data[i]);
+    }
+
+    return g_strdup ("unknown");
+}
+
 GByteArray *
 mm_port_serial_command_finish (MMPortSerial *self,
                                GAsyncResult *res,
@@ -184,12 +253,12 @@ mm_port_serial_command (MMPortSerial *self,
     ctx->allow_cached = allow_cached;
     ctx->timeout = timeout_seconds;
     ctx->cancellable = (cancellable ? g_object_ref (cancellable) : NULL);
+    ctx->stats_key = command_get_stats_key (command);
+    ctx->queued_time = g_get_monotonic_time ();
 
-    /* Only accept about 3 seconds of EAGAIN for this command */
-    if (self->priv->send_delay && mm_port_get_subsys (MM_PORT (self)) == MM_PORT_SUBSYS_TTY)
-        ctx->eagain_count = 3000000 / self->priv->send_delay;
-    else
-        ctx->eagain_count = 1000;
+    /* Only accept a limited amount of EAGAIN for this command; when there
+     * is a send delay, the paced write uses a time limit instead */
+    ctx->eagain_count = 1000;
 
     if (self->priv->open_count == 0) {
         g_simple_async_result_set_error (ctx->result,
@@ -211,6 +280,9 @@ mm_port_serial_command (MMPortSerial *self,
     else
         g_queue_push_tail (self->priv->queue, ctx);
 
+    mm_port_stats_record_queue_depth (mm_port_peek_stats (MM_PORT (self)),
+                                      g_queue_get_length (self->priv->queue));
+
     if (g_queue_get_length (self->priv->queue) == 1)
         port_serial_schedule_queue_process (self, 0);
 }
@@ -359,40 +431,17 @@ parse_stopbits (guint i)
     return stopbits;
 }
 
-static gboolean
-internal_tcsetattr (MMPortSerial          *self,
-                    gint                   fd,
-                    const struct termios  *options,
-                    GError               **error)
-{
-    guint          count;
-    struct termios other;
-
+/* Max number of EAGAIN retries when setting port attributes, and time
+ * between them */
 #define MAX_TCSETATTR_RETRIES 4
+#define TCSETATTR_RETRY_TIMEOUT_MS 100
 
-    for (count = 0; count < MAX_TCSETATTR_RETRIES; count++) {
-        /* try to set the new port attributes */
-        errno = 0;
-        if (tcsetattr (fd, TCSANOW, options) == 0)
-            break;
-
-        /* hard error if not EAGAIN */
-        if (errno != EAGAIN) {
-            g_set_error (error, MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
-                         "couldn't set serial port attributes: %s", g_strerror (errno));
-            return FALSE;
-        }
-
-        /* try a few times if EAGAIN */
-        g_usleep (100000);
-    }
-
-    /* too many retries? */
-    if (count == MAX_TCSETATTR_RETRIES) {
-        g_set_error (error, MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
-                     "couldn't set serial port attributes: too many retries (%u)", count);
-        return FALSE;
-    }
+static void
+tcsetattr_check (MMPortSerial         *self,
+                 gint                  fd,
+                 const struct termios *options)
+{
+    struct termios other;
 
     /* tcsetattr() returns 0 if any of the requested attributes could be set,
      * so we should double-check that all were set and log if not. Just with
@@ -406,9 +455,97 @@ internal_tcsetattr (MMPortSerial          *self,
     else if (memcmp (options, &other, sizeof (struct termios)) != 0)
         mm_dbg ("(%s): port attributes not fully set",
                 mm_port_get_device (MM_PORT (self)));
+}
+
+static void
+tcsetattr_retry_cancel (MMPortSerial *self)
+{
+    if (self->priv->tcsetattr_retry_id) {
+        g_source_remove (self->priv->tcsetattr_retry_id);
+        self->priv->tcsetattr_retry_id = 0;
+    }
+}
+
+static gboolean
+tcsetattr_retry_cb (MMPortSerial *self)
+{
+    g_assert (self->priv->fd >= 0);
+
+    errno = 0;
+    if (tcsetattr (self->priv->fd, TCSANOW, &self->priv->tcsetattr_pending) == 0) {
+        self->priv->tcsetattr_retry_id = 0;
+        mm_dbg ("(%s): serial port attributes set after %u retries",
+                mm_port_get_device (MM_PORT (self)), self->priv->tcsetattr_retries);
+        tcsetattr_check (self, self->priv->fd, &self->priv->tcsetattr_pending);
+
+        /* Commands were held until the port was setup */
+        if (!g_queue_is_empty (self->priv->queue))
+            port_serial_schedule_queue_process (self, 0);
+        return G_SOURCE_REMOVE;
+    }
 
-#undef MAX_TCSETATTR_RETRIES
+    if (errno == EAGAIN && ++self->priv->tcsetattr_retries < MAX_TCSETATTR_RETRIES)
+        return G_SOURCE_CONTINUE;
+
+    self->priv->tcsetattr_retry_id = 0;
+    mm_warn ("(%s): couldn't set serial port attributes: %s",
+             mm_port_get_device (MM_PORT (self)),
+             errno == EAGAIN ? "too many retries" : g_strerror (errno));
+    port_serial_close_force (self);
+    return G_SOURCE_REMOVE;
+}
 
+/* Gets the port attributes, including the ones not yet set due to EAGAIN */
+static gboolean
+internal_tcgetattr (MMPortSerial   *self,
+                    gint            fd,
+                    struct termios *options)
+{
+    if (self->priv->tcsetattr_retry_id) {
+        memcpy (options, &self->priv->tcsetattr_pending, sizeof (struct termios));
+        return TRUE;
+    }
+
+    return (tcgetattr (fd, options) == 0);
+}
+
+static gboolean
+internal_tcsetattr (MMPortSerial          *self,
+                    gint                   fd,
+                    const struct termios  *options,
+                    GError               **error)
+{
+    /* If already retrying, just update the attributes to set */
+    if (self->priv->tcsetattr_retry_id) {
+        memcpy (&self->priv->tcsetattr_pending, options, sizeof (struct termios));
+        return TRUE;
+    }
+
+    /* try to set the new port attributes */
+    errno = 0;
+    if (tcsetattr (fd, TCSANOW, options) == 0) {
+        tcsetattr_check (self, fd, options);
+        return TRUE;
+    }
+
+    /* hard error if not EAGAIN */
+    if (errno != EAGAIN) {
+        g_set_error (error, MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
+                     "couldn't set serial port attributes: %s", g_strerror (errno));
+        return FALSE;
+    }
+
+    /* Retry a few times if EAGAIN, without blocking the main loop; commands
+     * are not sent until the attributes are set, and if they can't be set
+     * the port gets forced to close. */
+    g_assert (fd == self->priv->fd);
+    mm_dbg ("(%s): couldn't set serial port attributes yet, will retry",
+            mm_port_get_device (MM_PORT (self)));
+    memcpy (&self->priv->tcsetattr_pending, options, sizeof (struct termios));
+    self->priv->tcsetattr_retries = 0;
+    self->priv->tcsetattr_retry_id = g_timeout_add (TCSETATTR_RETRY_TIMEOUT_MS,
+                                                    (GSourceFunc) tcsetattr_retry_cb,
+                                                    self);
     return TRUE;
 }
 
@@ -482,7 +619,7 @@ real_config_fd (MMPortSerial *self, int fd, GError **error)
     stopbits = parse_stopbits (self->priv->stopbits);
 
     memset (&stbuf, 0, sizeof (struct termios));
-    if (tcgetattr (fd, &stbuf) != 0) {
+    if (!internal_tcgetattr (self, fd, &stbuf)) {
         mm_warn ("(%s): tcgetattr() error: %d",
                  mm_port_get_device (MM_PORT (self)),
                  errno);
@@ -548,6 +685,97 @@ serial_debug (MMPortSerial *self, const char *prefix, const char *buf, gsize len
         MM_PORT_SERIAL_GET_CLASS (self)->debug_log (self, prefix, buf, len);
 }
 
+static void port_serial_got_response  (MMPortSerial   *self,
+                                       GByteArray     *parsed_response,
+                                       const GError   *error);
+static void port_serial_wait_response (MMPortSerial   *self,
+                                       CommandContext *ctx);
+
+static void
+port_serial_command_written (MMPortSerial   *self,
+                             CommandContext *ctx)
+{
+    ctx->done = TRUE;
+    ctx->sent_time = g_get_monotonic_time ();
+    mm_port_stats_record (mm_port_peek_stats (MM_PORT (self)),
+                          ctx->stats_key,
+                          MM_PORT_STATS_PHASE_SEND,
+                          ctx->sent_time - ctx->send_time);
+}
+
+/*****************************************************************************/
+/* Paced command write
+ *
+ * When a send delay is configured for a TTY, the command is written one byte
+ * at a time with that delay between bytes. The bytes are written from the
+ * I/O writer thread, and the main loop is only woken up once the whole
+ * command was written, or once writing it failed.
+ */
+
+/* Max time to wait for the port to become writable */
+#define PACED_WRITE_EAGAIN_TIMEOUT_US (3 * G_USEC_PER_SEC)
+
+static void
+port_serial_paced_write_cancel (MMPortSerial *self)
+{
+    if (self->priv->paced_write) {
+        mm_io_worker_write_free (self->priv->paced_write);
+        self->priv->paced_write = NULL;
+    }
+}
+
+static void
+paced_write_ready (gint          errsv,
+                   MMPortSerial *self)
+{
+    CommandContext *ctx;
+    GError *error = NULL;
+
+    port_serial_paced_write_cancel (self);
+
+    ctx = g_queue_peek_head (self->priv->queue);
+    g_assert (ctx && !ctx->done);
+
+    if (!errsv) {
+        ctx->idx = ctx->command->len;
+        port_serial_command_written (self, ctx);
+        /* Note: may complete last operation and unref the MMPortSerial */
+        port_serial_wait_response (self, ctx);
+        return;
+    }
+
+    if (errsv == EAGAIN) {
+        /* If we reach the limit of EAGAIN errors, treat as a timeout error. */
+        self->priv->n_consecutive_timeouts++;
+        g_signal_emit (self, signals[TIMED_OUT], 0, self->priv->n_consecutive_timeouts);
+        g_set_error (&error, MM_SERIAL_ERROR, MM_SERIAL_ERROR_SEND_FAILED,
+                     "Sending command failed: '%s'", g_strerror (EAGAIN));
+    } else
+        g_set_error (&error, MM_SERIAL_ERROR, MM_SERIAL_ERROR_SEND_FAILED,
+                     "Sending command failed: %s", g_strerror (errsv));
+
+    /* Note: may complete last operation and unref the MMPortSerial */
+    port_serial_got_response (self, NULL, error);
+    g_error_free (error);
+}
+
+static void
+port_serial_paced_write (MMPortSerial   *self,
+                         CommandContext *ctx)
+{
+    g_assert (self->priv->paced_write == NULL);
+
+    self->priv->paced_write = mm_io_worker_write_new (self->priv->fd,
+                                                      &ctx->command->data[ctx->idx],
+                                                      ctx->command->len - ctx->idx,
+                                                      self->priv->send_delay,
+                                                      PACED_WRITE_EAGAIN_TIMEOUT_US,
+                                                      (MMIoWorkerWriteFunc) paced_write_ready,
+                                                      self);
+}
+
+/*****************************************************************************/
+
 static gboolean
 port_serial_process_command (MMPortSerial *self,
                              CommandContext *ctx,
@@ -572,19 +800,25 @@ port_serial_process_command (MMPortSerial *self,
     /* Only print command the first time */
     if (ctx->started == FALSE) {
         ctx->started = TRUE;
+        ctx->send_time = g_get_monotonic_time ();
+        mm_port_stats_record (mm_port_peek_stats (MM_PORT (self)),
+                              ctx->stats_key,
+                              MM_PORT_STATS_PHASE_QUEUE_WAIT,
+                              ctx->send_time - ctx->queued_time);
+        mm_trace_transaction_begin (ctx, "serial", ctx->stats_key, mm_port_get_device (MM_PORT (self)));
         serial_debug (self, "-->", (const char *) ctx->command->data, ctx->command->len);
     }
 
-    if (self->priv->send_delay == 0 || mm_port_get_subsys (MM_PORT (self)) != MM_PORT_SUBSYS_TTY) {
-        /* Send the whole command in one write */
-        send_len = (gssize)ctx->command->len;
-        p = (gchar *)ctx->command->data;
-    } else {
-        /* Send just one byte of the command */
-        send_len = 1;
-        p = (gchar *)&ctx->command->data[ctx->idx];
+    /* With a send delay, write the command byte by byte from the writer thread */
+    if (self->priv->send_delay > 0 && self->priv->iochannel && mm_port_get_subsys (MM_PORT (self)) == MM_PORT_SUBSYS_TTY) {
+        port_serial_paced_write (self, ctx);
+        return TRUE;
     }
 
+    /* Send the remaining part of the command in one write */
+    send_len = (gssize)(ctx->command->len - ctx->idx);
+    p = (gchar *)&ctx->command->data[ctx->idx];
+
     /* GIOChannel based setup */
     if (self->priv->iochannel) {
         GIOStatus write_status;
@@ -664,7 +898,7 @@ port_serial_process_command (MMPortSerial *self,
         g_assert_not_reached ();
 
     if (ctx->idx >= ctx->command->len)
-        ctx->done = TRUE;
+        port_serial_command_written (self, ctx);
 
     return TRUE;
 }
@@ -709,12 +943,53 @@ port_serial_schedule_queue_process (MMPortSerial *self, guint timeout_ms)
         return;
     }
 
+    if (self->priv->paced_write) {
+        /* A command is being written */
+        return;
+    }
+
+    if (self->priv->tcsetattr_retry_id) {
+        /* Port attributes not set yet */
+        return;
+    }
+
     if (timeout_ms)
         self->priv->queue_id = g_timeout_add (timeout_ms, port_serial_queue_process, self);
     else
         self->priv->queue_id = g_idle_add (port_serial_queue_process, self);
 }
 
+static void
+port_serial_record_command_stats (MMPortSerial   *self,
+                                  CommandContext *ctx,
+                                  const GError   *error)
+{
+    MMPortStats       *stats;
+    MMPortStatsResult  result;
+
+    /* Nothing to record for commands replied from the cache */
+    if (!ctx->started)
+        return;
+
+    stats = mm_port_peek_stats (MM_PORT (self));
+    if (ctx->sent_time)
+        mm_port_stats_record (stats,
+                              ctx->stats_key,
+                              MM_PORT_STATS_PHASE_RESPONSE,
+                              g_get_monotonic_time () - ctx->sent_time);
+
+    if (!error)
+        result = MM_PORT_STATS_RESULT_OK;
+    else if (g_error_matches (error, MM_SERIAL_ERROR, MM_SERIAL_ERROR_RESPONSE_TIMEOUT))
+        result = MM_PORT_STATS_RESULT_TIMEOUT;
+    else
+        result = MM_PORT_STATS_RESULT_ERROR;
+    mm_port_stats_record_result (stats, ctx->stats_key, result);
+    mm_trace_transaction_end (ctx, "serial", ctx->stats_key,
+                              result == MM_PORT_STATS_RESULT_OK ? "ok" : error->message);
+    mm_port_stats_record_queue_depth (stats, g_queue_get_length (self->priv->queue));
+}
+
 static void
 port_serial_got_response (MMPortSerial *self,
                           GByteArray   *parsed_response,
@@ -747,6 +1022,8 @@ port_serial_got_response (MMPortSerial *self,
 
         ctx = (CommandContext *) g_queue_pop_head (self->priv->queue);
         if (ctx) {
+            port_serial_record_command_stats (self, ctx, error);
+
             /* Complete the command context with the appropriate result */
             if (error)
                 g_simple_async_result_set_from_error (ctx->result, error);
@@ -862,15 +1139,21 @@ port_serial_queue_process (gpointer data)
         return G_SOURCE_REMOVE;
     }
 
-    /* Schedule the next byte of the command to be sent */
+    /* Schedule the next write, unless already being written byte by byte */
     if (!ctx->done) {
-        port_serial_schedule_queue_process (self,
-                                            (mm_port_get_subsys (MM_PORT (self)) == MM_PORT_SUBSYS_TTY ?
-                                             self->priv->send_delay / 1000 :
-                                             0));
+        port_serial_schedule_queue_process (self, 0);
         return G_SOURCE_REMOVE;
     }
 
+    /* Note: may complete last operation and unref the MMPortSerial */
+    port_serial_wait_response (self, ctx);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+port_serial_wait_response (MMPortSerial   *self,
+                           CommandContext *ctx)
+{
     /* Setup the cancellable so that we can stop waiting for a response */
     if (ctx->cancellable) {
         gulong cancellable_id;
@@ -889,7 +1172,7 @@ port_serial_queue_process (gpointer data)
                                                 self,
                                                 NULL);
         if (!cancellable_id)
-            return G_SOURCE_REMOVE;
+            return;
 
         self->priv->cancellable_id = cancellable_id;
     }
@@ -898,7 +1181,12 @@ port_serial_queue_process (gpointer data)
     self->priv->timeout_id = g_timeout_add_seconds (ctx->timeout,
                                                     port_serial_timed_out,
                                                     self);
-    return G_SOURCE_REMOVE;
+
+    /* Input received while the command was being sent is kept in the
+     * buffer; parse it now.
+     * Note: may complete last operation and unref the MMPortSerial */
+    if (self->priv->response->len > 0)
+        parse_response_buffer (self);
 }
 
 static void
@@ -950,38 +1238,91 @@ parse_response_buffer (MMPortSerial *self)
 }
 
 static gboolean
-common_input_available (MMPortSerial *self,
-                        GIOCondition condition)
+port_serial_watching_input (MMPortSerial *self)
 {
-    char buf[SERIAL_BUF_SIZE + 1];
-    gsize bytes_read;
-    GIOStatus status = G_IO_STATUS_NORMAL;
-    CommandContext *ctx;
-    const char *device;
-    GError *error = NULL;
-    gboolean iterate = TRUE;
-    gboolean keep_source = G_SOURCE_CONTINUE;
+    return (self->priv->iochannel_id > 0 ||
+            self->priv->socket_source != NULL ||
+            self->priv->io_watch != NULL);
+}
 
+/* Returns TRUE if the condition was an error or a hangup, already processed */
+static gboolean
+common_input_condition (MMPortSerial *self,
+                        GIOCondition  condition)
+{
     if (condition & G_IO_HUP) {
-        device = mm_port_get_device (MM_PORT (self));
-        mm_dbg ("(%s) unexpected port hangup!", device);
+        mm_dbg ("(%s) unexpected port hangup!", mm_port_get_device (MM_PORT (self)));
 
         if (self->priv->response->len)
             g_byte_array_remove_range (self->priv->response, 0, self->priv->response->len);
         port_serial_close_force (self);
-        return G_SOURCE_REMOVE;
+        return TRUE;
     }
 
     if (condition & G_IO_ERR) {
         if (self->priv->response->len)
             g_byte_array_remove_range (self->priv->response, 0, self->priv->response->len);
-        return G_SOURCE_CONTINUE;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* Returns TRUE if we're still watching for input after processing it */
+static gboolean
+common_input_received (MMPortSerial *self,
+                       const guint8 *buf,
+                       gsize         bytes_read)
+{
+    gboolean watching;
+
+    g_assert (bytes_read > 0);
+    serial_debug (self, "<--", (const char *) buf, bytes_read);
+    g_byte_array_append (self->priv->response, buf, bytes_read);
+
+    /* Make sure the response doesn't grow too long */
+    if ((self->priv->response->len > SERIAL_BUF_SIZE) && self->priv->spew_control) {
+        /* Notify listeners and then trim the buffer */
+        g_signal_emit (self, signals[BUFFER_FULL], 0, self->priv->response);
+        g_byte_array_remove_range (self->priv->response, 0, (SERIAL_BUF_SIZE / 2));
     }
 
-    /* Don't read any input if the current command isn't done being sent yet */
+    /* See if we can parse anything. The response parsing may actually
+     * schedule the completion of a serial command, and that in turn may end
+     * up fully disposing this serial port object. In order to cope with
+     * that we make sure we have our own reference to the object while the
+     * response buffer operation is run, and then we check ourselves whether
+     * we should be keeping the input watch or not. */
+    g_object_ref (self);
+    {
+        parse_response_buffer (self);
+        watching = port_serial_watching_input (self);
+    }
+    g_object_unref (self);
+
+    return watching;
+}
+
+static gboolean
+common_input_available (MMPortSerial *self,
+                        GIOCondition condition)
+{
+    char buf[SERIAL_BUF_SIZE + 1];
+    gsize bytes_read;
+    GIOStatus status = G_IO_STATUS_NORMAL;
+    CommandContext *ctx;
+    GError *error = NULL;
+    gboolean iterate = TRUE;
+    gboolean keep_source = G_SOURCE_CONTINUE;
+    gboolean sending;
+
+    if (common_input_condition (self, condition))
+        return (condition & G_IO_HUP) ? G_SOURCE_REMOVE : G_SOURCE_CONTINUE;
+
+    /* Don't parse any input if the current command isn't done being sent yet,
+     * just keep it until it is */
     ctx = g_queue_peek_nth (self->priv->queue, 0);
-    if (ctx && (ctx->started == TRUE) && (ctx->done == FALSE))
-        return G_SOURCE_CONTINUE;
+    sending = (ctx && (ctx->started == TRUE) && (ctx->done == FALSE));
 
     while (iterate) {
         bytes_read = 0;
@@ -1028,43 +1369,56 @@ common_input_available (MMPortSerial *self,
         if (bytes_read == 0)
             break;
 
-        g_assert (bytes_read > 0);
-        serial_debug (self, "<--", buf, bytes_read);
-        g_byte_array_append (self->priv->response, (const guint8 *) buf, bytes_read);
-
-        /* Make sure the response doesn't grow too long */
-        if ((self->priv->response->len > SERIAL_BUF_SIZE) && self->priv->spew_control) {
-            /* Notify listeners and then trim the buffer */
-            g_signal_emit (self, signals[BUFFER_FULL], 0, self->priv->response);
-            g_byte_array_remove_range (self->priv->response, 0, (SERIAL_BUF_SIZE / 2));
+        if (sending) {
+            serial_debug (self, "<--", buf, bytes_read);
+            g_byte_array_append (self->priv->response, (const guint8 *) buf, bytes_read);
+            iterate = (bytes_read == SERIAL_BUF_SIZE || status == G_IO_STATUS_AGAIN);
+            continue;
         }
 
-        /* See if we can parse anything. The response parsing may actually
-         * schedule the completion of a serial command, and that in turn may end
-         * up fully disposing this serial port object. In order to cope with
-         * that we make sure we have our own reference to the object while the
-         * response buffer operation is run, and then we check ourselves whether
-         * we should be keeping this socket/iochannel source or not. */
-        g_object_ref (self);
-        {
-            parse_response_buffer (self);
-
-            /* If we didn't end up closing the iochannel/socket in the previous
-             * operation, we keep this source. */
-            keep_source = ((self->priv->iochannel_id > 0 || self->priv->socket_source != NULL) ?
-                           G_SOURCE_CONTINUE : G_SOURCE_REMOVE);
-
-            /* If we're keeping the source and we still may have bytes to read,
-             * iterate. */
-            iterate = ((keep_source == G_SOURCE_CONTINUE) &&
-                       (bytes_read == SERIAL_BUF_SIZE || status == G_IO_STATUS_AGAIN));
-        }
-        g_object_unref (self);
+        /* If we didn't end up closing the iochannel/socket while processing
+         * the input, we keep this source. */
+        keep_source = (common_input_received (self, (const guint8 *) buf, bytes_read) ?
+                       G_SOURCE_CONTINUE : G_SOURCE_REMOVE);
+
+        /* If we're keeping the source and we still may have bytes to read,
+         * iterate. */
+        iterate = ((keep_source == G_SOURCE_CONTINUE) &&
+                   (bytes_read == SERIAL_BUF_SIZE || status == G_IO_STATUS_AGAIN));
     }
 
     return keep_source;
 }
 
+static void
+worker_input_available (GIOCondition  condition,
+                        const guint8 *data,
+                        gsize         len,
+                        gpointer      user_data)
+{
+    MMPortSerial   *self = MM_PORT_SERIAL (user_data);
+    CommandContext *ctx;
+    gsize           offset;
+
+    if (common_input_condition (self, condition))
+        return;
+
+    /* The input has already been read by the worker, so if the current command
+     * isn't done being sent yet, just keep it until it is */
+    ctx = g_queue_peek_nth (self->priv->queue, 0);
+    if (ctx && (ctx->started == TRUE) && (ctx->done == FALSE)) {
+        serial_debug (self, "<--", (const char *) data, len);
+        g_byte_array_append (self->priv->response, data, len);
+        return;
+    }
+
+    /* Process the input in the same chunk sizes used when reading ourselves */
+    for (offset = 0; offset < len; offset += SERIAL_BUF_SIZE) {
+        if (!common_input_received (self, data + offset, MIN (SERIAL_BUF_SIZE, len - offset)))
+            break;
+    }
+}
+
 static gboolean
 iochannel_input_available (GIOChannel *iochannel,
                            GIOCondition condition,
@@ -1084,6 +1438,13 @@ socket_input_available (GSocket *socket,
 static void
 data_watch_enable (MMPortSerial *self, gboolean enable)
 {
+    if (self->priv->io_watch) {
+        if (enable)
+            g_warn_if_fail (self->priv->io_watch == NULL);
+        mm_io_worker_watch_free (self->priv->io_watch);
+        self->priv->io_watch = NULL;
+    }
+
     if (self->priv->iochannel_id) {
         if (enable)
             g_warn_if_fail (self->priv->iochannel_id == 0);
@@ -1100,7 +1461,13 @@ data_watch_enable (MMPortSerial *self, gboolean enable)
     }
 
     if (enable) {
-        if (self->priv->iochannel) {
+        if (mm_io_worker_enabled () && (self->priv->iochannel || self->priv->socket)) {
+            self->priv->io_watch = mm_io_worker_watch_new (self->priv->iochannel ?
+                                                           self->priv->fd :
+                                                           g_socket_get_fd (self->priv->socket),
+                                                           worker_input_available,
+                                                           self);
+        } else if (self->priv->iochannel) {
             self->priv->iochannel_id = g_io_add_watch (self->priv->iochannel,
                                                        G_IO_IN | G_IO_ERR | G_IO_HUP,
                                                        iochannel_input_available,
@@ -1336,6 +1703,8 @@ success:
 error:
     mm_warn ("(%s) failed to open serial device", device);
 
+    tcsetattr_retry_cancel (self);
+
     if (self->priv->iochannel) {
         g_io_channel_unref (self->priv->iochannel);
         self->priv->iochannel = NULL;
@@ -1364,6 +1733,14 @@ mm_port_serial_is_open (MMPortSerial *self)
     return !!self->priv->open_count;
 }
 
+gboolean
+mm_port_serial_is_busy (MMPortSerial *self)
+{
+    g_return_val_if_fail (MM_IS_PORT_SERIAL (self), FALSE);
+
+    return !g_queue_is_empty (self->priv->queue);
+}
+
 static void
 _close_internal (MMPortSerial *self, gboolean force)
 {
@@ -1395,6 +1772,8 @@ _close_internal (MMPortSerial *self, gboolean force)
     }
 
     mm_port_serial_flash_cancel (self);
+    port_serial_paced_write_cancel (self);
+    tcsetattr_retry_cancel (self);
 
     if (self->priv->iochannel || self->priv->socket) {
         GTimeVal tv_start, tv_end;
@@ -1470,6 +1849,8 @@ _close_internal (MMPortSerial *self, gboolean force)
                                          MM_SERIAL_ERROR,
                                          MM_SERIAL_ERROR_SEND_FAILED,
                                          "Serial port is now closed");
+        if (ctx->started)
+            mm_trace_transaction_end (ctx, "serial", ctx->stats_key, "Serial port is now closed");
         command_context_complete_and_free (ctx, TRUE);
     }
     g_queue_clear (self->priv->queue);
@@ -1676,7 +2057,7 @@ get_speed (MMPortSerial *self, speed_t *speed, GError **error)
     g_assert (self->priv->fd >= 0);
 
     memset (&options, 0, sizeof (struct termios));
-    if (tcgetattr (self->priv->fd, &options) != 0) {
+    if (!internal_tcgetattr (self, self->priv->fd, &options)) {
         g_set_error (error,
                      MM_CORE_ERROR,
                      MM_CORE_ERROR_FAILED,
@@ -1697,7 +2078,7 @@ set_speed (MMPortSerial *self, speed_t speed, GError **error)
     g_assert (self->priv->fd >= 0);
 
     memset (&options, 0, sizeof (struct termios));
-    if (tcgetattr (self->priv->fd, &options) != 0) {
+    if (!internal_tcgetattr (self, self->priv->fd, &options)) {
         g_set_error (error,
                      MM_CORE_ERROR,
                      MM_CORE_ERROR_FAILED,
@@ -1877,7 +2258,7 @@ mm_port_serial_set_flow_control (MMPortSerial   *self,
 
     /* retrieve current settings */
     memset (&options, 0, sizeof (struct termios));
-    if (tcgetattr (self->priv->fd, &options) != 0) {
+    if (!internal_tcgetattr (self, self->priv->fd, &options)) {
         inner_error = g_error_new (MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
                                    "couldn't get serial port attributes: %s", g_strerror (errno));
         goto out;
@@ -2084,6 +2465,9 @@ finalize (GObject *object)
     g_assert (self->priv->iochannel_id  == 0);
     g_assert (self->priv->socket        == NULL);
     g_assert (self->priv->socket_source == NULL);
+    g_assert (self->priv->io_watch      == NULL);
+    g_assert (self->priv->paced_write        == NULL);
+    g_assert (self->priv->tcsetattr_retry_id == 0);
 
     if (self->priv->timeout_id)
         g_source_remove (self->priv->timeout_id);
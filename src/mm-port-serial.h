@@ -116,6 +116,9 @@ MMPortSerial *mm_port_serial_new (const char *name, MMPortType ptype);
 
 gboolean mm_port_serial_is_open           (MMPortSerial *self);
 
+/* TRUE if there are commands queued or waiting for a response */
+gboolean mm_port_serial_is_busy           (MMPortSerial *self);
+
 gboolean mm_port_serial_open              (MMPortSerial *self,
                                            GError  **error);
 
@@ -0,0 +1,258 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+#include <config.h>
+
+#include "mm-port-stats.h"
+
+static const guint bucket_limits_ms[MM_PORT_STATS_N_BUCKETS] = {
+    1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 5000, G_MAXUINT
+};
+
+static const gchar *phase_names[MM_PORT_STATS_PHASE_LAST] = {
+    [MM_PORT_STATS_PHASE_QUEUE_WAIT] = "queue-wait",
+    [MM_PORT_STATS_PHASE_SEND]       = "send",
+    [MM_PORT_STATS_PHASE_RESPONSE]   = "response",
+};
+
+typedef struct {
+    guint  buckets[MM_PORT_STATS_N_BUCKETS];
+    gint64 total_us;
+    gint64 max_us;
+} Histogram;
+
+typedef struct {
+    Histogram phases[MM_PORT_STATS_PHASE_LAST];
+    guint     n_ok;
+    guint     n_errors;
+    guint     n_timeouts;
+} Entry;
+
+/* Not thread-safe: all updates and reads happen in the main context, where
+ * the port responses are parsed */
+struct _MMPortStats {
+    /* key -> Entry */
+    GHashTable *entries;
+    /* name -> guint counter */
+    GHashTable *events;
+    guint       queue_depth;
+    guint       queue_depth_max;
+};
+
+/*****************************************************************************/
+
+const guint *
+mm_port_stats_get_bucket_limits (void)
+{
+    return bucket_limits_ms;
+}
+
+static Entry *
+get_entry (MMPortStats *self,
+           const gchar *key)
+{
+    Entry *entry;
+
+    entry = g_hash_table_lookup (self->entries, key);
+    if (!entry) {
+        entry = g_slice_new0 (Entry);
+        g_hash_table_insert (self->entries, g_strdup (key), entry);
+    }
+    return entry;
+}
+
+void
+mm_port_stats_record (MMPortStats      *self,
+                      const gchar      *key,
+                      MMPortStatsPhase  phase,
+                      gint64            duration_us)
+{
+    Histogram *histogram;
+    guint      i;
+
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (key != NULL);
+    g_return_if_fail (phase < MM_PORT_STATS_PHASE_LAST);
+
+    if (duration_us < 0)
+        duration_us = 0;
+
+    histogram = &(get_entry (self, key)->phases[phase]);
+    for (i = 0; i < MM_PORT_STATS_N_BUCKETS - 1; i++) {
+        if (duration_us < (gint64) bucket_limits_ms[i] * 1000)
+            break;
+    }
+    histogram->buckets[i]++;
+    histogram->total_us += duration_us;
+    if (duration_us > histogram->max_us)
+        histogram->max_us = duration_us;
+}
+
+void
+mm_port_stats_record_result (MMPortStats       *self,
+                             const gchar       *key,
+                             MMPortStatsResult  result)
+{
+    Entry *entry;
+
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (key != NULL);
+
+    entry = get_entry (self, key);
+    switch (result) {
+    case MM_PORT_STATS_RESULT_OK:
+        entry->n_ok++;
+        break;
+    case MM_PORT_STATS_RESULT_ERROR:
+        entry->n_errors++;
+        break;
+    case MM_PORT_STATS_RESULT_TIMEOUT:
+        entry->n_timeouts++;
+        break;
+    default:
+        g_assert_not_reached ();
+    }
+}
+
+void
+mm_port_stats_record_queue_depth (MMPortStats *self,
+                                  guint        depth)
+{
+    g_return_if_fail (self != NULL);
+
+    self->queue_depth = depth;
+    if (depth > self->queue_depth_max)
+        self->queue_depth_max = depth;
+}
+
+void
+mm_port_stats_record_event (MMPortStats *self,
+                            const gchar *name)
+{
+    guint *counter;
+
+    g_return_if_fail (self != NULL);
+    g_return_if_fail (name != NULL);
+
+    counter = g_hash_table_lookup (self->events, name);
+    if (!counter) {
+        counter = g_new0 (guint, 1);
+        g_hash_table_insert (self->events, g_strdup (name), counter);
+    }
+    (*counter)++;
+}
+
+/*****************************************************************************/
+
+static GVariant *
+histogram_build_variant (Histogram *histogram)
+{
+    GVariantBuilder builder;
+    guint           i;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("au"));
+    for (i = 0; i < MM_PORT_STATS_N_BUCKETS; i++)
+        g_variant_builder_add (&builder, "u", histogram->buckets[i]);
+    return g_variant_builder_end (&builder);
+}
+
+static GVariant *
+entry_build_variant (const gchar *key,
+                     Entry       *entry)
+{
+    GVariantBuilder builder;
+    guint           i;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+    g_variant_builder_add (&builder, "{sv}", "key",      g_variant_new_string (key));
+    g_variant_builder_add (&builder, "{sv}", "ok",       g_variant_new_uint32 (entry->n_ok));
+    g_variant_builder_add (&builder, "{sv}", "errors",   g_variant_new_uint32 (entry->n_errors));
+    g_variant_builder_add (&builder, "{sv}", "timeouts", g_variant_new_uint32 (entry->n_timeouts));
+    for (i = 0; i < MM_PORT_STATS_PHASE_LAST; i++) {
+        gchar *name;
+
+        g_variant_builder_add (&builder, "{sv}", phase_names[i], histogram_build_variant (&entry->phases[i]));
+        name = g_strdup_printf ("%s-total-us", phase_names[i]);
+        g_variant_builder_add (&builder, "{sv}", name, g_variant_new_uint64 ((guint64) entry->phases[i].total_us));
+        g_free (name);
+        name = g_strdup_printf ("%s-max-us", phase_names[i]);
+        g_variant_builder_add (&builder, "{sv}", name, g_variant_new_uint64 ((guint64) entry->phases[i].max_us));
+        g_free (name);
+    }
+    return g_variant_builder_end (&builder);
+}
+
+GVariant *
+mm_port_stats_get_dictionary (MMPortStats *self)
+{
+    GVariantBuilder builder;
+    GVariantBuilder commands;
+    GVariantBuilder events;
+    GHashTableIter  iter;
+    gpointer        key;
+    gpointer        value;
+
+    g_return_val_if_fail (self != NULL, NULL);
+
+    g_variant_builder_init (&commands, G_VARIANT_TYPE ("aa{sv}"));
+    g_hash_table_iter_init (&iter, self->entries);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+        g_variant_builder_add_value (&commands, entry_build_variant ((const gchar *) key, (Entry *) value));
+
+    g_variant_builder_init (&events, G_VARIANT_TYPE ("a{sv}"));
+    g_hash_table_iter_init (&iter, self->events);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+        g_variant_builder_add (&events, "{sv}", (const gchar *) key,
+                               g_variant_new_uint32 (*((guint *) value)));
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+    g_variant_builder_add (&builder, "{sv}", "queue-depth",
+                           g_variant_new_uint32 (self->queue_depth));
+    g_variant_builder_add (&builder, "{sv}", "queue-depth-max",
+                           g_variant_new_uint32 (self->queue_depth_max));
+    g_variant_builder_add (&builder, "{sv}", "commands", g_variant_builder_end (&commands));
+    g_variant_builder_add (&builder, "{sv}", "events", g_variant_builder_end (&events));
+    return g_variant_builder_end (&builder);
+}
+
+/*****************************************************************************/
+
+static void
+entry_free (Entry *entry)
+{
+    g_slice_free (Entry, entry);
+}
+
+MMPortStats *
+mm_port_stats_new (void)
+{
+    MMPortStats *self;
+
+    self = g_slice_new0 (MMPortStats);
+    self->entries = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) entry_free);
+    self->events = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    return self;
+}
+
+void
+mm_port_stats_free (MMPortStats *self)
+{
+    if (!self)
+        return;
+
+    g_hash_table_unref (self->entries);
+    g_hash_table_unref (self->events);
+    g_slice_free (MMPortStats, self);
+}
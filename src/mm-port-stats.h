@@ -0,0 +1,68 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+#ifndef MM_PORT_STATS_H
+#define MM_PORT_STATS_H
+
+#include <glib.h>
+
+/* Per-port command latency statistics.
+ *
+ * Each command key (e.g. the AT command verb, or the QMI service) gets one
+ * fixed-bucket histogram per phase. No locking is done: stats must only be
+ * recorded and read in the main context, which is where port responses are
+ * parsed. */
+
+#define MM_PORT_STATS_N_BUCKETS 12
+
+typedef enum {
+    MM_PORT_STATS_PHASE_QUEUE_WAIT,
+    MM_PORT_STATS_PHASE_SEND,
+    MM_PORT_STATS_PHASE_RESPONSE,
+    MM_PORT_STATS_PHASE_LAST
+} MMPortStatsPhase;
+
+typedef enum {
+    MM_PORT_STATS_RESULT_OK,
+    MM_PORT_STATS_RESULT_ERROR,
+    MM_PORT_STATS_RESULT_TIMEOUT,
+} MMPortStatsResult;
+
+typedef struct _MMPortStats MMPortStats;
+
+MMPortStats *mm_port_stats_new                (void);
+void         mm_port_stats_free               (MMPortStats       *self);
+
+/* Upper limit of each bucket, in milliseconds; the last one is unbounded */
+const guint *mm_port_stats_get_bucket_limits  (void);
+
+void         mm_port_stats_record             (MMPortStats       *self,
+                                               const gchar       *key,
+                                               MMPortStatsPhase   phase,
+                                               gint64             duration_us);
+void         mm_port_stats_record_result      (MMPortStats       *self,
+                                               const gchar       *key,
+                                               MMPortStatsResult  result);
+void         mm_port_stats_record_queue_depth (MMPortStats       *self,
+                                               guint              depth);
+
+/* Plain event counters, e.g. for client reuse */
+void         mm_port_stats_record_event       (MMPortStats       *self,
+                                               const gchar       *name);
+
+/* Build a floating a{sv} dictionary with all the stats */
+GVariant    *mm_port_stats_get_dictionary     (MMPortStats       *self);
+
+#endif /* MM_PORT_STATS_H */
@@ -0,0 +1,461 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+#include <config.h>
+#include <string.h>
+
+#include "mm-qmi-indication-router.h"
+#include "mm-log.h"
+
+#define ROUTER_TAG "qmi-indication-router-tag"
+static GQuark router_quark;
+
+typedef struct {
+    guint                    id;
+    MMQmiIndication          indication;
+    MMQmiIndicationCallback  callback;
+    gpointer                 user_data;
+} Subscriber;
+
+typedef struct {
+    gulong      handler_id;
+    guint       n_subscribers;
+    /* Fingerprint of the last dispatched state */
+    GByteArray *last;
+    gint64      last_dispatch_time;
+    /* Counters */
+    guint       n_received;
+    guint       n_dispatched;
+    guint       n_suppressed;
+} Route;
+
+typedef struct {
+    QmiClient *client;
+    GList     *subscribers;
+    guint      dispatching;
+    gboolean   pending_removals;
+    Route      routes[MM_QMI_INDICATION_LAST];
+} Router;
+
+static const gchar *indication_names[MM_QMI_INDICATION_LAST] = {
+    [MM_QMI_INDICATION_NAS_SIGNAL_STRENGTH]       = "event-report",
+#if defined WITH_NEWEST_QMI_COMMANDS
+    [MM_QMI_INDICATION_NAS_SIGNAL_INFO]           = "signal-info",
+    [MM_QMI_INDICATION_NAS_SYSTEM_INFO]           = "system-info",
+#endif
+    [MM_QMI_INDICATION_NAS_SERVING_SYSTEM]        = "serving-system",
+    [MM_QMI_INDICATION_WDS_PACKET_SERVICE_STATUS] = "packet-service-status",
+};
+
+/* Subscriber ids are unique across all routers */
+static guint next_subscriber_id;
+
+/*****************************************************************************/
+/* Dispatching */
+
+static void
+subscriber_free (Subscriber *subscriber)
+{
+    g_slice_free (Subscriber, subscriber);
+}
+
+static void
+router_purge_subscribers (Router *router)
+{
+    GList *l;
+    GList *next;
+
+    for (l = router->subscribers; l; l = next) {
+        Subscriber *subscriber = l->data;
+
+        next = g_list_next (l);
+        if (!subscriber->callback) {
+            router->subscribers = g_list_delete_link (router->subscribers, l);
+            subscriber_free (subscriber);
+        }
+    }
+    router->pending_removals = FALSE;
+}
+
+static void
+router_dispatch (Router          *router,
+                 MMQmiIndication  indication,
+                 gconstpointer    data,
+                 gconstpointer    fingerprint,
+                 gsize            fingerprint_len)
+{
+    Route  *route;
+    gint64  now;
+    GList  *l;
+
+    route = &router->routes[indication];
+    route->n_received++;
+
+    /* Suppress unchanged values, unless it's time to refresh them */
+    now = g_get_monotonic_time ();
+    if (fingerprint) {
+        if (route->last &&
+            route->last->len == fingerprint_len &&
+            memcmp (route->last->data, fingerprint, fingerprint_len) == 0 &&
+            (now - route->last_dispatch_time) < (MM_QMI_INDICATION_ROUTER_REFRESH_SECS * G_USEC_PER_SEC)) {
+            route->n_suppressed++;
+            return;
+        }
+
+        if (!route->last)
+            route->last = g_byte_array_sized_new (fingerprint_len);
+        g_byte_array_set_size (route->last, 0);
+        g_byte_array_append (route->last, fingerprint, fingerprint_len);
+    }
+    route->last_dispatch_time = now;
+    route->n_dispatched++;
+
+    /* Subscribers may unsubscribe while being notified; they're just
+     * flagged and removed once the dispatching is over */
+    router->dispatching++;
+    for (l = router->subscribers; l; l = g_list_next (l)) {
+        Subscriber *subscriber = l->data;
+
+        if (subscriber->indication == indication && subscriber->callback)
+            subscriber->callback (router->client, data, subscriber->user_data);
+    }
+    router->dispatching--;
+
+    if (!router->dispatching && router->pending_removals)
+        router_purge_subscribers (router);
+}
+
+/*****************************************************************************/
+/* Indication parsers */
+
+static void
+nas_event_report_cb (QmiClientNas                      *client,
+                     QmiIndicationNasEventReportOutput *output,
+                     Router                            *router)
+{
+    MMQmiNasSignalStrength state;
+
+    memset (&state, 0, sizeof (state));
+    if (!qmi_indication_nas_event_report_output_get_signal_strength (
+            output,
+            &state.strength,
+            &state.radio_interface,
+            NULL)) {
+        router->routes[MM_QMI_INDICATION_NAS_SIGNAL_STRENGTH].n_received++;
+        return;
+    }
+
+    router_dispatch (router, MM_QMI_INDICATION_NAS_SIGNAL_STRENGTH, &state, &state, sizeof (state));
+}
+
+#if defined WITH_NEWEST_QMI_COMMANDS
+
+static void
+nas_signal_info_cb (QmiClientNas                     *client,
+                    QmiIndicationNasSignalInfoOutput *output,
+                    Router                           *router)
+{
+    MMQmiNasSignalInfo state;
+
+    memset (&state, 0, sizeof (state));
+    qmi_indication_nas_signal_info_output_get_cdma_signal_strength (output, &state.cdma1x_rssi, NULL, NULL);
+    qmi_indication_nas_signal_info_output_get_hdr_signal_strength (output, &state.evdo_rssi, NULL, NULL, NULL, NULL);
+    qmi_indication_nas_signal_info_output_get_gsm_signal_strength (output, &state.gsm_rssi, NULL);
+    qmi_indication_nas_signal_info_output_get_wcdma_signal_strength (output, &state.wcdma_rssi, NULL, NULL);
+    qmi_indication_nas_signal_info_output_get_lte_signal_strength (output, &state.lte_rssi, NULL, NULL, NULL, NULL);
+
+    router_dispatch (router, MM_QMI_INDICATION_NAS_SIGNAL_INFO, &state, &state, sizeof (state));
+}
+
+static void
+nas_system_info_cb (QmiClientNas                     *client,
+                    QmiIndicationNasSystemInfoOutput *output,
+                    Router                           *router)
+{
+    router_dispatch (router, MM_QMI_INDICATION_NAS_SYSTEM_INFO, output, NULL, 0);
+}
+
+#endif /* WITH_NEWEST_QMI_COMMANDS */
+
+static void
+fingerprint_append_array (GByteArray *fingerprint,
+                          GArray     *array)
+{
+    guint len;
+
+    len = array ? array->len : 0;
+    g_byte_array_append (fingerprint, (const guint8 *)&len, sizeof (len));
+    if (len)
+        g_byte_array_append (fingerprint,
+                             (const guint8 *)array->data,
+                             len * g_array_get_element_size (array));
+}
+
+#define FINGERPRINT_APPEND(fingerprint, value) \
+    g_byte_array_append (fingerprint, (const guint8 *)&(value), sizeof (value))
+
+static void
+nas_serving_system_cb (QmiClientNas                        *client,
+                       QmiIndicationNasServingSystemOutput *output,
+                       Router                              *router)
+{
+    GByteArray                   *fingerprint;
+    QmiNasRegistrationState       registration_state = 0;
+    QmiNasAttachState             cs_attach_state = 0;
+    QmiNasAttachState             ps_attach_state = 0;
+    QmiNasNetworkType             selected_network = 0;
+    GArray                       *radio_interfaces = NULL;
+    GArray                       *data_service_capabilities = NULL;
+    GArray                       *roaming_indicators = NULL;
+    QmiNasRoamingIndicatorStatus  roaming = 0;
+    guint16                       mcc = 0;
+    guint16                       mnc = 0;
+    const gchar                  *description = NULL;
+    gboolean                      has_pcs_digit = FALSE;
+    guint16                       lac = 0;
+    guint16                       tac = 0;
+    guint32                       cid = 0;
+    guint16                       sid = 0;
+    guint16                       nid = 0;
+    guint16                       bs_id = 0;
+    gint32                        bs_latitude = 0;
+    gint32                        bs_longitude = 0;
+
+    /* Fingerprint all the fields processed by the 3GPP and CDMA interfaces */
+    qmi_indication_nas_serving_system_output_get_serving_system (output,
+                                                                 &registration_state,
+                                                                 &cs_attach_state,
+                                                                 &ps_attach_state,
+                                                                 &selected_network,
+                                                                 &radio_interfaces,
+                                                                 NULL);
+    qmi_indication_nas_serving_system_output_get_data_service_capability (output, &data_service_capabilities, NULL);
+    qmi_indication_nas_serving_system_output_get_roaming_indicator (output, &roaming, NULL);
+    qmi_indication_nas_serving_system_output_get_roaming_indicator_list (output, &roaming_indicators, NULL);
+    qmi_indication_nas_serving_system_output_get_current_plmn (output, &mcc, &mnc, &description, NULL);
+    qmi_indication_nas_serving_system_output_get_mnc_pcs_digit_include_status (output, &mcc, &mnc, &has_pcs_digit, NULL);
+    qmi_indication_nas_serving_system_output_get_lac_3gpp (output, &lac, NULL);
+    qmi_indication_nas_serving_system_output_get_lte_tac (output, &tac, NULL);
+    qmi_indication_nas_serving_system_output_get_cid_3gpp (output, &cid, NULL);
+    qmi_indication_nas_serving_system_output_get_cdma_system_id (output, &sid, &nid, NULL);
+    qmi_indication_nas_serving_system_output_get_cdma_base_station_info (output, &bs_id, &bs_latitude, &bs_longitude, NULL);
+
+    fingerprint = g_byte_array_sized_new (64);
+    FINGERPRINT_APPEND (fingerprint, registration_state);
+    FINGERPRINT_APPEND (fingerprint, cs_attach_state);
+    FINGERPRINT_APPEND (fingerprint, ps_attach_state);
+    FINGERPRINT_APPEND (fingerprint, selected_network);
+    fingerprint_append_array (fingerprint, radio_interfaces);
+    fingerprint_append_array (fingerprint, data_service_capabilities);
+    fingerprint_append_array (fingerprint, roaming_indicators);
+    FINGERPRINT_APPEND (fingerprint, roaming);
+    FINGERPRINT_APPEND (fingerprint, mcc);
+    FINGERPRINT_APPEND (fingerprint, mnc);
+    FINGERPRINT_APPEND (fingerprint, has_pcs_digit);
+    FINGERPRINT_APPEND (fingerprint, lac);
+    FINGERPRINT_APPEND (fingerprint, tac);
+    FINGERPRINT_APPEND (fingerprint, cid);
+    FINGERPRINT_APPEND (fingerprint, sid);
+    FINGERPRINT_APPEND (fingerprint, nid);
+    FINGERPRINT_APPEND (fingerprint, bs_id);
+    FINGERPRINT_APPEND (fingerprint, bs_latitude);
+    FINGERPRINT_APPEND (fingerprint, bs_longitude);
+    if (description)
+        g_byte_array_append (fingerprint, (const guint8 *)description, strlen (description) + 1);
+
+    router_dispatch (router, MM_QMI_INDICATION_NAS_SERVING_SYSTEM, output, fingerprint->data, fingerprint->len);
+    g_byte_array_unref (fingerprint);
+}
+
+#undef FINGERPRINT_APPEND
+
+static void
+wds_packet_service_status_cb (QmiClientWds                              *client,
+                              QmiIndicationWdsPacketServiceStatusOutput *output,
+                              Router                                    *router)
+{
+    MMQmiWdsPacketServiceStatus state;
+
+    memset (&state, 0, sizeof (state));
+    if (!qmi_indication_wds_packet_service_status_output_get_connection_status (
+            output,
+            &state.connection_status,
+            &state.reconfiguration_required,
+            NULL)) {
+        router->routes[MM_QMI_INDICATION_WDS_PACKET_SERVICE_STATUS].n_received++;
+        return;
+    }
+
+    state.has_call_end_reason =
+        qmi_indication_wds_packet_service_status_output_get_call_end_reason (
+            output,
+            &state.call_end_reason,
+            NULL);
+    state.has_verbose_call_end_reason =
+        qmi_indication_wds_packet_service_status_output_get_verbose_call_end_reason (
+            output,
+            &state.verbose_call_end_reason_type,
+            &state.verbose_call_end_reason,
+            NULL);
+
+    router_dispatch (router, MM_QMI_INDICATION_WDS_PACKET_SERVICE_STATUS, &state, NULL, 0);
+}
+
+static GCallback
+indication_get_handler (MMQmiIndication indication)
+{
+    switch (indication) {
+    case MM_QMI_INDICATION_NAS_SIGNAL_STRENGTH:
+        return G_CALLBACK (nas_event_report_cb);
+#if defined WITH_NEWEST_QMI_COMMANDS
+    case MM_QMI_INDICATION_NAS_SIGNAL_INFO:
+        return G_CALLBACK (nas_signal_info_cb);
+    case MM_QMI_INDICATION_NAS_SYSTEM_INFO:
+        return G_CALLBACK (nas_system_info_cb);
+#endif
+    case MM_QMI_INDICATION_NAS_SERVING_SYSTEM:
+        return G_CALLBACK (nas_serving_system_cb);
+    case MM_QMI_INDICATION_WDS_PACKET_SERVICE_STATUS:
+        return G_CALLBACK (wds_packet_service_status_cb);
+    case MM_QMI_INDICATION_LAST:
+    default:
+        g_assert_not_reached ();
+        return NULL;
+    }
+}
+
+/*****************************************************************************/
+
+static void
+router_free (Router *router)
+{
+    guint i;
+
+    /* Signal handlers are already gone with the client */
+    for (i = 0; i < MM_QMI_INDICATION_LAST; i++) {
+        Route *route = &router->routes[i];
+
+        if (route->n_received)
+            mm_dbg ("QMI '%s' indications: %u received, %u dispatched, %u suppressed",
+                    indication_names[i],
+                    route->n_received,
+                    route->n_dispatched,
+                    route->n_suppressed);
+        if (route->last)
+            g_byte_array_unref (route->last);
+    }
+    g_list_free_full (router->subscribers, (GDestroyNotify)subscriber_free);
+    g_slice_free (Router, router);
+}
+
+static Router *
+router_get (QmiClient *client,
+            gboolean   create)
+{
+    Router *router;
+
+    if (G_UNLIKELY (!router_quark))
+        router_quark = g_quark_from_static_string (ROUTER_TAG);
+
+    router = g_object_get_qdata (G_OBJECT (client), router_quark);
+    if (!router && create) {
+        router = g_slice_new0 (Router);
+        router->client = client;
+        g_object_set_qdata_full (G_OBJECT (client), router_quark, router, (GDestroyNotify)router_free);
+    }
+    return router;
+}
+
+guint
+mm_qmi_indication_router_subscribe (QmiClient               *client,
+                                    MMQmiIndication          indication,
+                                    MMQmiIndicationCallback  callback,
+                                    gpointer                 user_data)
+{
+    Router     *router;
+    Route      *route;
+    Subscriber *subscriber;
+
+    g_return_val_if_fail (QMI_IS_CLIENT (client), 0);
+    g_return_val_if_fail (indication < MM_QMI_INDICATION_LAST, 0);
+    g_return_val_if_fail (callback != NULL, 0);
+
+    router = router_get (client, TRUE);
+    route = &router->routes[indication];
+
+    /* Connect to the client signal only once, when the first subscriber
+     * for this indication comes */
+    if (!route->n_subscribers) {
+        g_assert (!route->handler_id);
+        route->handler_id = g_signal_connect (client,
+                                              indication_names[indication],
+                                              indication_get_handler (indication),
+                                              router);
+        /* Make sure the first indication is always dispatched */
+        if (route->last)
+            g_byte_array_set_size (route->last, 0);
+    }
+    route->n_subscribers++;
+
+    subscriber = g_slice_new0 (Subscriber);
+    subscriber->id = ++next_subscriber_id;
+    if (G_UNLIKELY (!subscriber->id))
+        subscriber->id = ++next_subscriber_id;
+    subscriber->indication = indication;
+    subscriber->callback = callback;
+    subscriber->user_data = user_data;
+    router->subscribers = g_list_append (router->subscribers, subscriber);
+
+    return subscriber->id;
+}
+
+void
+mm_qmi_indication_router_unsubscribe (QmiClient *client,
+                                      guint      id)
+{
+    Router *router;
+    GList  *l;
+
+    g_return_if_fail (QMI_IS_CLIENT (client));
+
+    router = router_get (client, FALSE);
+    if (!router)
+        return;
+
+    for (l = router->subscribers; l; l = g_list_next (l)) {
+        Subscriber *subscriber = l->data;
+        Route      *route;
+
+        if (subscriber->id != id || !subscriber->callback)
+            continue;
+
+        route = &router->routes[subscriber->indication];
+        g_assert (route->n_subscribers > 0);
+        route->n_subscribers--;
+        if (!route->n_subscribers) {
+            g_signal_handler_disconnect (client, route->handler_id);
+            route->handler_id = 0;
+        }
+
+        if (router->dispatching) {
+            subscriber->callback = NULL;
+            router->pending_removals = TRUE;
+        } else {
+            router->subscribers = g_list_delete_link (router->subscribers, l);
+            subscriber_free (subscriber);
+        }
+        return;
+    }
+}
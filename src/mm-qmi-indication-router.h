@@ -0,0 +1,88 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+#ifndef MM_QMI_INDICATION_ROUTER_H
+#define MM_QMI_INDICATION_ROUTER_H
+
+#include <glib.h>
+#include <libqmi-glib.h>
+
+/* Shared indication router. There is one router per QmiClient, connected
+ * once to each indication signal of the client regardless of how many
+ * subscribers there are. Each indication is parsed once, and the decoded
+ * state is dispatched to all subscribers. Indications reporting the same
+ * values as the last dispatched one are suppressed, except that a repeated
+ * value is still dispatched every MM_QMI_INDICATION_ROUTER_REFRESH_SECS so
+ * that subscribers relying on periodic updates (e.g. signal quality
+ * expiration) keep working. */
+
+#define MM_QMI_INDICATION_ROUTER_REFRESH_SECS 30
+
+typedef enum {
+    /* NAS "Event Report", signal strength: MMQmiNasSignalStrength */
+    MM_QMI_INDICATION_NAS_SIGNAL_STRENGTH,
+#if defined WITH_NEWEST_QMI_COMMANDS
+    /* NAS "Signal Info": MMQmiNasSignalInfo */
+    MM_QMI_INDICATION_NAS_SIGNAL_INFO,
+    /* NAS "System Info": QmiIndicationNasSystemInfoOutput, never suppressed */
+    MM_QMI_INDICATION_NAS_SYSTEM_INFO,
+#endif
+    /* NAS "Serving System": QmiIndicationNasServingSystemOutput */
+    MM_QMI_INDICATION_NAS_SERVING_SYSTEM,
+    /* WDS "Packet Service Status": MMQmiWdsPacketServiceStatus, never
+     * suppressed as each bearer tracks its own connection */
+    MM_QMI_INDICATION_WDS_PACKET_SERVICE_STATUS,
+    MM_QMI_INDICATION_LAST
+} MMQmiIndication;
+
+typedef struct {
+    gint8                strength;
+    QmiNasRadioInterface radio_interface;
+} MMQmiNasSignalStrength;
+
+#if defined WITH_NEWEST_QMI_COMMANDS
+typedef struct {
+    gint8 cdma1x_rssi;
+    gint8 evdo_rssi;
+    gint8 gsm_rssi;
+    gint8 wcdma_rssi;
+    gint8 lte_rssi;
+} MMQmiNasSignalInfo;
+#endif
+
+typedef struct {
+    QmiWdsConnectionStatus          connection_status;
+    gboolean                        reconfiguration_required;
+    gboolean                        has_call_end_reason;
+    QmiWdsCallEndReason             call_end_reason;
+    gboolean                        has_verbose_call_end_reason;
+    QmiWdsVerboseCallEndReasonType  verbose_call_end_reason_type;
+    gint16                          verbose_call_end_reason;
+} MMQmiWdsPacketServiceStatus;
+
+/* @data is the decoded state or the indication output, as given for each
+ * indication type above */
+typedef void (* MMQmiIndicationCallback) (QmiClient     *client,
+                                          gconstpointer  data,
+                                          gpointer       user_data);
+
+guint mm_qmi_indication_router_subscribe   (QmiClient               *client,
+                                            MMQmiIndication          indication,
+                                            MMQmiIndicationCallback  callback,
+                                            gpointer                 user_data);
+void  mm_qmi_indication_router_unsubscribe (QmiClient               *client,
+                                            guint                    id);
+
+#endif /* MM_QMI_INDICATION_ROUTER_H */
@@ -26,6 +26,7 @@
 #include <libqmi-glib.h>
 
 #include "mm-log.h"
+#include "mm-identity-cache.h"
 #include "mm-iface-modem.h"
 #include "mm-iface-modem-3gpp.h"
 #include "mm-iface-modem-location.h"
@@ -50,22 +51,6 @@ typedef enum {
     FEATURE_SUPPORTED,
 } Feature;
 
-typedef struct {
-    GArray                  *id;
-    QmiPdcConfigurationType  config_type;
-    guint32                  token;
-    guint32                  version;
-    gchar                   *description;
-    guint32                  total_size;
-} ConfigInfo;
-
-static void
-config_info_clear (ConfigInfo *config_info)
-{
-    g_array_unref (config_info->id);
-    g_free (config_info->description);
-}
-
 typedef struct {
     /* Capabilities & modes helpers */
     MMModemCapability  current_capabilities;
@@ -1883,6 +1868,25 @@ mm_shared_qmi_set_current_bands (MMIfaceModem        *self,
 
     /* Handle ANY separately */
     if (bands_array->len == 1 && g_array_index (bands_array, MMModemBand, 0) == MM_MODEM_BAND_ANY) {
+        /* The supported bands may have been taken from the identity cache,
+         * and not be loaded from the device yet */
+        if (!priv->supported_bands) {
+            MmGdbusModem *skeleton = NULL;
+
+            g_object_get (self,
+                          MM_IFACE_MODEM_DBUS_SKELETON, &skeleton,
+                          NULL);
+            if (skeleton) {
+                GArray *supported_bands;
+
+                supported_bands = mm_common_bands_variant_to_garray (mm_gdbus_modem_get_supported_bands (skeleton));
+                if (supported_bands->len > 0 && g_array_index (supported_bands, MMModemBand, 0) != MM_MODEM_BAND_UNKNOWN)
+                    priv->supported_bands = supported_bands;
+                else
+                    g_array_unref (supported_bands);
+                g_object_unref (skeleton);
+            }
+        }
         if (!priv->supported_bands) {
             g_task_return_new_error (task, MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
                                      "Cannot handle 'ANY' if supported bands are unknown");
@@ -2337,13 +2341,13 @@ select_newest_carrier_config (MMSharedQmi *self,
                               gint         config_a_i,
                               gint         config_b_i)
 {
-    Private    *priv;
-    ConfigInfo *config_a;
-    ConfigInfo *config_b;
+    Private         *priv;
+    MMQmiConfigInfo *config_a;
+    MMQmiConfigInfo *config_b;
 
     priv = get_private (self);
-    config_a = &g_array_index (priv->config_list, ConfigInfo, config_a_i);
-    config_b = &g_array_index (priv->config_list, ConfigInfo, config_b_i);
+    config_a = &g_array_index (priv->config_list, MMQmiConfigInfo, config_a_i);
+    config_b = &g_array_index (priv->config_list, MMQmiConfigInfo, config_b_i);
 
     g_assert (!g_strcmp0 (config_a->description, config_b->description));
 
@@ -2400,9 +2404,9 @@ find_requested_carrier_config (GTask *task)
         guint i;
 
         for (i = 0; i < priv->config_list->len; i++) {
-            ConfigInfo *config;
+            MMQmiConfigInfo *config;
 
-            config = &g_array_index (priv->config_list, ConfigInfo, i);
+            config = &g_array_index (priv->config_list, MMQmiConfigInfo, i);
             if (ctx->config_requested && !g_strcmp0 (ctx->config_requested, config->description)) {
                 mm_dbg ("Requested carrier configuration '%s' is available (version 0x%08x, size %u bytes)",
                         config->description, config->version, config->total_size);
@@ -2433,11 +2437,11 @@ find_requested_carrier_config (GTask *task)
     /* If the mapping expects a given config, but the config isn't installed,
      * we fallback to generic */
     if (ctx->config_requested_i < 0) {
-        ConfigInfo *config;
+        MMQmiConfigInfo *config;
 
         g_assert (config_fallback_i >= 0);
 
-        config = &g_array_index (priv->config_list, ConfigInfo, config_fallback_i);
+        config = &g_array_index (priv->config_list, MMQmiConfigInfo, config_fallback_i);
         mm_info ("Using fallback carrier configuration '%s' (version 0x%08x, size %u bytes)",
                         config->description, config->version, config->total_size);
 
@@ -2446,9 +2450,9 @@ find_requested_carrier_config (GTask *task)
         ctx->config_requested_i = config_fallback_i;
         config_fallback = NULL;
     } else {
-        ConfigInfo *config;
+        MMQmiConfigInfo *config;
 
-        config = &g_array_index (priv->config_list, ConfigInfo, ctx->config_requested_i);
+        config = &g_array_index (priv->config_list, MMQmiConfigInfo, ctx->config_requested_i);
         mm_dbg ("Using requested carrier configuration '%s' (version 0x%08x, size %u bytes)",
                 config->description, config->version, config->total_size);
     }
@@ -2494,12 +2498,12 @@ setup_carrier_config_step (GTask *task)
 
     case SETUP_CARRIER_CONFIG_STEP_UPDATE_CURRENT: {
         QmiMessagePdcSetSelectedConfigInput *input;
-        ConfigInfo                          *requested_config;
-        ConfigInfo                          *active_config;
+        MMQmiConfigInfo                     *requested_config;
+        MMQmiConfigInfo                     *active_config;
         QmiConfigTypeAndId                   type_and_id;
 
-        requested_config = &g_array_index (priv->config_list, ConfigInfo, ctx->config_requested_i);
-        active_config = (priv->config_active_default ? NULL : &g_array_index (priv->config_list, ConfigInfo, priv->config_active_i));
+        requested_config = &g_array_index (priv->config_list, MMQmiConfigInfo, ctx->config_requested_i);
+        active_config = (priv->config_active_default ? NULL : &g_array_index (priv->config_list, MMQmiConfigInfo, priv->config_active_i));
         mm_warn ("Carrier config switching needed: '%s' -> '%s'",
                  active_config ? active_config->description : DEFAULT_CONFIG_DESCRIPTION, requested_config->description);
 
@@ -2521,9 +2525,9 @@ setup_carrier_config_step (GTask *task)
 
     case SETUP_CARRIER_CONFIG_STEP_ACTIVATE_CURRENT: {
         QmiMessagePdcActivateConfigInput *input;
-        ConfigInfo                       *requested_config;
+        MMQmiConfigInfo                  *requested_config;
 
-        requested_config = &g_array_index (priv->config_list, ConfigInfo, ctx->config_requested_i);
+        requested_config = &g_array_index (priv->config_list, MMQmiConfigInfo, ctx->config_requested_i);
 
         input = qmi_message_pdc_activate_config_input_new ();
         qmi_message_pdc_activate_config_input_set_config_type (input, requested_config->config_type, NULL);
@@ -2621,6 +2625,14 @@ typedef struct {
     gulong        list_configs_indication_id;
     gulong        get_selected_config_indication_id;
     gulong        get_config_info_indication_id;
+
+    /* Identity cache key; the config details are only requested to the
+     * modem if the list isn't found in the cache */
+    gchar        *imei;
+    gchar        *revision;
+    gchar        *list_hash;
+    gboolean      from_cache;
+    gint64        start_time;
 } LoadCarrierConfigContext;
 
 /* Allow to cleanup action load right away, without being tied
@@ -2654,6 +2666,9 @@ load_carrier_config_context_free (LoadCarrierConfigContext *ctx)
     if (ctx->config_list)
         g_array_unref (ctx->config_list);
     g_clear_object (&ctx->client);
+    g_free (ctx->imei);
+    g_free (ctx->revision);
+    g_free (ctx->list_hash);
     g_slice_free (LoadCarrierConfigContext, ctx);
 }
 
@@ -2673,9 +2688,9 @@ mm_shared_qmi_load_carrier_config_finish (MMIfaceModem  *self,
     g_assert (priv->config_active_i >= 0 || priv->config_active_default);
 
     if (priv->config_active_i >= 0) {
-        ConfigInfo *config;
+        MMQmiConfigInfo *config;
 
-        config = &g_array_index (priv->config_list, ConfigInfo, priv->config_active_i);
+        config = &g_array_index (priv->config_list, MMQmiConfigInfo, priv->config_active_i);
         *carrier_config_name = g_strdup (config->description);
         *carrier_config_revision = g_strdup_printf ("%08X", config->version);
     } else if (priv->config_active_default) {
@@ -2753,9 +2768,9 @@ get_selected_config_indication (QmiClientPdc                            *client,
     g_assert (ctx->config_list->len);
 
     for (i = 0; i < ctx->config_list->len; i++) {
-        ConfigInfo *config;
+        MMQmiConfigInfo *config;
 
-        config = &g_array_index (ctx->config_list, ConfigInfo, i);
+        config = &g_array_index (ctx->config_list, MMQmiConfigInfo, i);
         if ((config->id->len == active_id->len) &&
             !memcmp (config->id->data, active_id->data, active_id->len)) {
             ctx->config_active_i = i;
@@ -2814,7 +2829,7 @@ get_config_info_indication (QmiClientPdc                        *client,
 {
     LoadCarrierConfigContext *ctx;
     GError                   *error = NULL;
-    ConfigInfo               *current_config = NULL;
+    MMQmiConfigInfo          *current_config = NULL;
     guint32                   token;
     const gchar              *description;
     int                       i;
@@ -2841,7 +2856,7 @@ get_config_info_indication (QmiClientPdc                        *client,
 
     /* Look for the current config in the list, match by token */
     for (i = 0; i < ctx->config_list->len; i++) {
-        current_config = &g_array_index (ctx->config_list, ConfigInfo, i);
+        current_config = &g_array_index (ctx->config_list, MMQmiConfigInfo, i);
         if (current_config->token == token)
             break;
     }
@@ -2913,11 +2928,22 @@ list_configs_indication (QmiClientPdc                      *client,
         return;
     }
 
-    /* Preallocate config list and request details for each */
+    /* Preallocate config list and request details for each, unless the same
+     * list was already seen */
     mm_dbg ("found %u carrier configurations...", configs->len);
-    ctx->config_list = g_array_sized_new (FALSE, TRUE, sizeof (ConfigInfo), configs->len);
-    g_array_set_size (ctx->config_list, configs->len);
-    g_array_set_clear_func (ctx->config_list, (GDestroyNotify) config_info_clear);
+    ctx->config_list = mm_qmi_config_list_new (configs,
+                                               ctx->imei,
+                                               ctx->revision,
+                                               &ctx->token,
+                                               &ctx->list_hash,
+                                               &ctx->from_cache);
+    if (ctx->from_cache) {
+        mm_dbg ("carrier configuration details loaded from identity cache");
+        load_carrier_config_context_cleanup_action (ctx);
+        ctx->step++;
+        load_carrier_config_step (task);
+        return;
+    }
 
     ctx->get_config_info_indication_id = g_signal_connect (ctx->client,
                                                            "get-config-info",
@@ -2925,20 +2951,14 @@ list_configs_indication (QmiClientPdc                      *client,
                                                            task);
 
     for (i = 0; i < configs->len; i++) {
-        ConfigInfo                                      *current_info;
-        QmiIndicationPdcListConfigsOutputConfigsElement *element;
-        QmiConfigTypeAndId                               type_with_id;
-        QmiMessagePdcGetConfigInfoInput                 *input;
-
-        element = &g_array_index (configs, QmiIndicationPdcListConfigsOutputConfigsElement, i);
+        MMQmiConfigInfo                 *current_info;
+        QmiConfigTypeAndId               type_with_id;
+        QmiMessagePdcGetConfigInfoInput *input;
 
-        current_info              = &g_array_index (ctx->config_list, ConfigInfo, i);
-        current_info->token       = ctx->token++;
-        current_info->id          = g_array_ref (element->id);
-        current_info->config_type = element->config_type;
+        current_info = &g_array_index (ctx->config_list, MMQmiConfigInfo, i);
 
         input = qmi_message_pdc_get_config_info_input_new ();
-        type_with_id.config_type = element->config_type;
+        type_with_id.config_type = current_info->config_type;
         type_with_id.id = current_info->id;
         qmi_message_pdc_get_config_info_input_set_type_with_id (input, &type_with_id, NULL);
         qmi_message_pdc_get_config_info_input_set_token (input, current_info->token, NULL);
@@ -3031,6 +3051,14 @@ load_carrier_config_step (GTask *task)
         priv->config_active_i = ctx->config_active_i;
         priv->config_active_default = ctx->config_active_default;
 
+        if (ctx->config_list && !ctx->from_cache)
+            mm_qmi_config_list_store (ctx->config_list, ctx->imei, ctx->revision, ctx->list_hash);
+
+        mm_dbg ("carrier configuration loaded in %" G_GINT64_FORMAT " ms (%u configs%s)",
+                (g_get_monotonic_time () - ctx->start_time) / 1000,
+                ctx->config_list ? ctx->config_list->len : 0,
+                ctx->from_cache ? ", details from identity cache" : "");
+
         g_task_return_boolean (task, TRUE);
         g_object_unref (task);
         break;
@@ -3051,8 +3079,24 @@ mm_shared_qmi_load_carrier_config (MMIfaceModem        *self,
     ctx = g_slice_new0 (LoadCarrierConfigContext);
     ctx->step = LOAD_CARRIER_CONFIG_STEP_FIRST;
     ctx->config_active_i = -1;
+    ctx->start_time = g_get_monotonic_time ();
     g_task_set_task_data (task, ctx, (GDestroyNotify)load_carrier_config_context_free);
 
+    /* Revision and equipment identifier are loaded earlier when the identity
+     * cache is in use */
+    if (mm_identity_cache_enabled ()) {
+        MmGdbusModem *skeleton = NULL;
+
+        g_object_get (self,
+                      MM_IFACE_MODEM_DBUS_SKELETON, &skeleton,
+                      NULL);
+        if (skeleton) {
+            ctx->imei = g_strdup (mm_gdbus_modem_get_equipment_identifier (skeleton));
+            ctx->revision = g_strdup (mm_gdbus_modem_get_revision (skeleton));
+        }
+        g_clear_object (&skeleton);
+    }
+
     /* Load PDC client */
     client = mm_shared_qmi_peek_client (MM_SHARED_QMI (self),
                                         QMI_SERVICE_PDC,
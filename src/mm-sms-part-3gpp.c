@@ -234,8 +234,8 @@ sms_encoding_type (int dcs)
     return scheme;
 }
 
-static char *
-sms_decode_text (const guint8 *text, int len, MMSmsEncoding encoding, int bit_offset)
+static gchar *
+sms_decode_text (const guint8 *text, guint len, MMSmsEncoding encoding, guint bit_offset)
 {
     char *utf8;
     guint8 *unpacked;
@@ -337,27 +337,41 @@ validity_to_relative (guint validity)
     return 255; /* 63 weeks */
 }
 
+/* Enough for any 3GPP PDU (TPDU plus SMSC address) */
+#define PDU_BUFFER_SIZE 256
+
 MMSmsPart *
 mm_sms_part_3gpp_new_from_pdu (guint index,
                                const gchar *hexpdu,
                                GError **error)
 {
-    gsize pdu_len;
-    guint8 *pdu;
+    guint8 pdu_buffer[PDU_BUFFER_SIZE];
+    guint8 *pdu = pdu_buffer;
+    gsize pdu_size = sizeof (pdu_buffer);
+    gsize hexpdu_len;
+    gsize pdu_len = 0;
     MMSmsPart *part;
 
-    /* Convert PDU from hex to binary */
-    pdu = (guint8 *) mm_utils_hexstr2bin (hexpdu, &pdu_len);
-    if (!pdu) {
+    /* Convert PDU from hex to binary; PDUs read from the modem normally fit
+     * in the stack buffer, so no allocation is needed */
+    hexpdu_len = strlen (hexpdu);
+    if (hexpdu_len / 2 > pdu_size) {
+        pdu_size = hexpdu_len / 2;
+        pdu = g_malloc (pdu_size);
+    }
+    if (!mm_utils_hexstr2bin_buf (hexpdu, hexpdu_len, pdu, pdu_size, &pdu_len)) {
         g_set_error_literal (error,
                              MM_CORE_ERROR,
                              MM_CORE_ERROR_FAILED,
                              "Couldn't convert 3GPP PDU from hex to binary");
+        if (pdu != pdu_buffer)
+            g_free (pdu);
         return NULL;
     }
 
     part = mm_sms_part_3gpp_new_from_binary_pdu (index, pdu, pdu_len, error);
-    g_free (pdu);
+    if (pdu != pdu_buffer)
+        g_free (pdu);
 
     return part;
 }
@@ -713,14 +727,15 @@ mm_sms_part_3gpp_new_from_binary_pdu (guint index,
         switch (user_data_encoding) {
         case MM_SMS_ENCODING_GSM7:
         case MM_SMS_ENCODING_UCS2:
-            /* Otherwise if it's 7-bit or UCS2 we can decode it */
-            mm_dbg ("Decoding SMS text with '%u' elements", tp_user_data_size_elements);
-            mm_sms_part_take_text (sms_part,
-                                   sms_decode_text (&pdu[tp_user_data_offset],
-                                                    tp_user_data_size_elements,
-                                                    user_data_encoding,
-                                                    bit_offset));
-            g_warn_if_fail (mm_sms_part_get_text (sms_part) != NULL);
+            /* Otherwise if it's 7-bit or UCS2 we can decode it, but only
+             * once the text is actually requested. The user data is the last
+             * field in the PDU, so just keep from its start until the end. */
+            mm_dbg ("SMS text with '%u' elements to be decoded on demand", tp_user_data_size_elements);
+            mm_sms_part_take_pdu_text (sms_part,
+                                       g_bytes_new (&pdu[tp_user_data_offset], pdu_len - tp_user_data_offset),
+                                       tp_user_data_size_elements,
+                                       bit_offset,
+                                       sms_decode_text);
             break;
 
         default:
@@ -242,21 +242,54 @@ read_bits (const guint8 *bytes,
            guint8 o_bits,
            guint8 n_bits)
 {
-    guint8 bits_in_first;
-    guint8 bits_in_second;
+    guint16 word;
 
     g_assert (o_bits < 8);
     g_assert (n_bits <= 8);
     g_assert (o_bits + n_bits <= 16);
 
-    /* Read only from the first byte */
-    if (o_bits + n_bits <= 8)
-        return (bytes[0] >> (8 - o_bits - n_bits)) & ((1 << n_bits) - 1);
+    /* Read the second byte only if needed */
+    word = bytes[0] << 8;
+    if (o_bits + n_bits > 8)
+        word |= bytes[1];
 
-    /* Read (8 - o_bits) from the first byte and (n_bits - (8 - o_bits)) from the second byte */
-    bits_in_first = 8 - o_bits;
-    bits_in_second = n_bits - bits_in_first;
-    return (read_bits (&bytes[0], o_bits, bits_in_first) << bits_in_second) | read_bits (&bytes[1], 0, bits_in_second);
+    return (word >> (16 - o_bits - n_bits)) & ((1 << n_bits) - 1);
+}
+
+/* Read n_fields consecutive fields of n_bits each; o_bits < 8; n_bits <= 8 */
+static void
+read_bits_array (const guint8 *bytes,
+                 guint8 o_bits,
+                 guint8 n_bits,
+                 guint8 *out,
+                 guint n_fields)
+{
+    guint32 acc;
+    guint acc_bits;
+    guint i;
+
+    g_assert (o_bits < 8);
+    g_assert (n_bits > 0 && n_bits <= 8);
+
+    if (!n_fields)
+        return;
+
+    /* Byte aligned octets are just copied */
+    if (!o_bits && n_bits == 8) {
+        memcpy (out, bytes, n_fields);
+        return;
+    }
+
+    acc = *bytes++ & (0xFF >> o_bits);
+    acc_bits = 8 - o_bits;
+    for (i = 0; i < n_fields; i++) {
+        if (acc_bits < n_bits) {
+            acc = (acc << 8) | *bytes++;
+            acc_bits += 8;
+        }
+        acc_bits -= n_bits;
+        out[i] = (acc >> acc_bits) & ((1 << n_bits) - 1);
+    }
 }
 
 /*****************************************************************************/
@@ -311,27 +344,41 @@ cause_code_to_delivery_state (guint8 error_class,
 
 /*****************************************************************************/
 
+/* PDUs longer than this are decoded in the heap */
+#define PDU_BUFFER_SIZE 256
+
 MMSmsPart *
 mm_sms_part_cdma_new_from_pdu (guint index,
                                const gchar *hexpdu,
                                GError **error)
 {
-    gsize pdu_len;
-    guint8 *pdu;
+    guint8 pdu_buffer[PDU_BUFFER_SIZE];
+    guint8 *pdu = pdu_buffer;
+    gsize pdu_size = sizeof (pdu_buffer);
+    gsize hexpdu_len;
+    gsize pdu_len = 0;
     MMSmsPart *part;
 
-    /* Convert PDU from hex to binary */
-    pdu = (guint8 *) mm_utils_hexstr2bin (hexpdu, &pdu_len);
-    if (!pdu) {
+    /* Convert PDU from hex to binary; PDUs read from the modem normally fit
+     * in the stack buffer, so no allocation is needed */
+    hexpdu_len = strlen (hexpdu);
+    if (hexpdu_len / 2 > pdu_size) {
+        pdu_size = hexpdu_len / 2;
+        pdu = g_malloc (pdu_size);
+    }
+    if (!mm_utils_hexstr2bin_buf (hexpdu, hexpdu_len, pdu, pdu_size, &pdu_len)) {
         g_set_error_literal (error,
                              MM_CORE_ERROR,
                              MM_CORE_ERROR_FAILED,
                              "Couldn't convert CDMA PDU from hex to binary");
+        if (pdu != pdu_buffer)
+            g_free (pdu);
         return NULL;
     }
 
     part = mm_sms_part_cdma_new_from_binary_pdu (index, pdu, pdu_len, error);
-    g_free (pdu);
+    if (pdu != pdu_buffer)
+        g_free (pdu);
 
     return part;
 }
@@ -817,16 +864,12 @@ read_bearer_data_user_data (MMSmsPart *sms_part,
     switch (message_encoding) {
     case ENCODING_OCTET: {
         GByteArray *data;
-        guint i;
 
         SUBPARAMETER_SIZE_CHECK (byte_offset + 1 + ((bit_offset + (num_fields * 8)) / 8));
 
         data = g_byte_array_sized_new (num_fields);
         g_byte_array_set_size (data, num_fields);
-        for (i = 0; i < num_fields; i++) {
-            data->data[i] = read_bits (&subparameter->parameter_value[byte_offset], bit_offset, 8);
-            OFFSETS_UPDATE (8);
-        }
+        read_bits_array (&subparameter->parameter_value[byte_offset], bit_offset, 8, data->data, num_fields);
 
         mm_dbg ("            data: (%u bytes)", num_fields);
         mm_sms_part_take_data (sms_part, data);
@@ -835,16 +878,12 @@ read_bearer_data_user_data (MMSmsPart *sms_part,
 
     case ENCODING_ASCII_7BIT: {
         gchar *text;
-        guint i;
 
         SUBPARAMETER_SIZE_CHECK (byte_offset + 1 + ((bit_offset + (num_fields * 7)) / 8));
 
         text = g_malloc (num_fields + 1);
-        for (i = 0; i < num_fields; i++) {
-            text[i] = read_bits (&subparameter->parameter_value[byte_offset], bit_offset, 7);
-            OFFSETS_UPDATE (7);
-        }
-        text[i] = '\0';
+        read_bits_array (&subparameter->parameter_value[byte_offset], bit_offset, 7, (guint8 *) text, num_fields);
+        text[num_fields] = '\0';
 
         mm_dbg ("            text: '%s'", text);
         mm_sms_part_take_text (sms_part, text);
@@ -854,16 +893,12 @@ read_bearer_data_user_data (MMSmsPart *sms_part,
     case ENCODING_LATIN: {
         gchar *latin;
         gchar *text;
-        guint i;
 
         SUBPARAMETER_SIZE_CHECK (byte_offset + 1 + ((bit_offset + (num_fields * 8)) / 8));
 
         latin = g_malloc (num_fields + 1);
-        for (i = 0; i < num_fields; i++) {
-            latin[i] = read_bits (&subparameter->parameter_value[byte_offset], bit_offset, 8);
-            OFFSETS_UPDATE (8);
-        }
-        latin[i] = '\0';
+        read_bits_array (&subparameter->parameter_value[byte_offset], bit_offset, 8, (guint8 *) latin, num_fields);
+        latin[num_fields] = '\0';
 
         text = g_convert (latin, -1, "UTF-8", "ISO−8859−1", NULL, NULL, NULL);
         if (!text) {
@@ -880,7 +915,6 @@ read_bearer_data_user_data (MMSmsPart *sms_part,
     case ENCODING_UNICODE: {
         gchar *utf16;
         gchar *text;
-        guint i;
         guint num_bytes;
 
         /* 2 bytes per field! */
@@ -889,10 +923,7 @@ read_bearer_data_user_data (MMSmsPart *sms_part,
         SUBPARAMETER_SIZE_CHECK (byte_offset + 1 + ((bit_offset + (num_bytes * 8)) / 8));
 
         utf16 = g_malloc (num_bytes);
-        for (i = 0; i < num_bytes; i++) {
-            utf16[i] = read_bits (&subparameter->parameter_value[byte_offset], bit_offset, 8);
-            OFFSETS_UPDATE (8);
-        }
+        read_bits_array (&subparameter->parameter_value[byte_offset], bit_offset, 8, (guint8 *) utf16, num_bytes);
 
         text = g_convert (utf16, num_bytes, "UTF-8", "UCS-2BE", NULL, NULL, NULL);
         if (!text) {
@@ -1171,25 +1202,51 @@ write_bits (guint8 *bytes,
             guint8 n_bits,
             guint8 bits)
 {
-    guint8 bits_in_first;
-    guint8 bits_in_second;
+    guint16 word;
 
     g_assert (o_bits < 8);
     g_assert (n_bits <= 8);
     g_assert (o_bits + n_bits <= 16);
 
-    /* Write only in the first byte */
-    if (o_bits + n_bits <= 8) {
-        bytes[0] |= (bits & ((1 << n_bits) - 1)) << (8 - o_bits - n_bits);
-        return;
-    }
+    /* Write in the second byte only if needed */
+    word = (bits & ((1 << n_bits) - 1)) << (16 - o_bits - n_bits);
+    bytes[0] |= word >> 8;
+    if (o_bits + n_bits > 8)
+        bytes[1] |= word & 0xFF;
+}
+
+/* Write n_fields consecutive fields of n_bits each; o_bits < 8; n_bits <= 8
+ *
+ * NOTE! The bits being set should be 0 initially.
+ */
+static void
+write_bits_array (guint8 *bytes,
+                  guint8 o_bits,
+                  guint8 n_bits,
+                  const guint8 *in,
+                  guint n_fields)
+{
+    guint32 acc;
+    guint acc_bits;
+    guint i;
 
-    /* Write (8 - o_bits) in the first byte and (n_bits - (8 - o_bits)) in the second byte */
-    bits_in_first = 8 - o_bits;
-    bits_in_second = n_bits - bits_in_first;
+    g_assert (o_bits < 8);
+    g_assert (n_bits > 0 && n_bits <= 8);
+
+    /* Keep the bits already written in the first byte */
+    acc = bytes[0] >> (8 - o_bits);
+    acc_bits = o_bits;
+    for (i = 0; i < n_fields; i++) {
+        acc = (acc << n_bits) | (in[i] & ((1 << n_bits) - 1));
+        acc_bits += n_bits;
+        if (acc_bits >= 8) {
+            acc_bits -= 8;
+            *bytes++ = acc >> acc_bits;
+        }
+    }
 
-    write_bits (&bytes[0], o_bits, bits_in_first, (bits >> bits_in_second));
-    write_bits (&bytes[1], 0, bits_in_second, bits);
+    if (acc_bits)
+        *bytes = acc << (8 - acc_bits);
 }
 
 /*****************************************************************************/
@@ -1425,7 +1482,6 @@ write_bearer_data_user_data (MMSmsPart *part,
     guint byte_offset = 0;
     guint num_fields;
     guint num_bits_per_field;
-    guint i;
     Encoding encoding;
     GByteArray *converted = NULL;
     const GByteArray *aux;
@@ -1493,10 +1549,10 @@ write_bearer_data_user_data (MMSmsPart *part,
     else
         mm_dbg ("            data: (%u bytes)", num_fields);
     num_bits_per_iter = num_bits_per_field < 8 ? num_bits_per_field : 8;
-    for (i = 0; i < aux->len; i++) {
-        write_bits (&pdu[byte_offset], bit_offset, num_bits_per_iter, aux->data[i]);
-        OFFSETS_UPDATE (num_bits_per_iter);
-    }
+    write_bits_array (&pdu[byte_offset], bit_offset, num_bits_per_iter, aux->data, aux->len);
+    bit_offset += aux->len * num_bits_per_iter;
+    byte_offset += bit_offset / 8;
+    bit_offset %= 8;
 
     if (converted)
         g_byte_array_unref (converted);
@@ -36,6 +36,12 @@ struct _MMSmsPart {
     gchar *number;
     gchar *text;
     MMSmsEncoding encoding;
+    /* Raw user data kept until the text is requested */
+    GBytes *pdu;
+    guint pdu_text_n_elements;
+    guint pdu_text_bit_offset;
+    MMSmsEncoding pdu_text_encoding;
+    MMSmsPartDecodeTextFunc pdu_decode_text;
     GByteArray *data;
     gint  class;
     guint validity_relative;
@@ -62,6 +68,8 @@ mm_sms_part_free (MMSmsPart *self)
     g_free (self->smsc);
     g_free (self->number);
     g_free (self->text);
+    if (self->pdu)
+        g_bytes_unref (self->pdu);
     if (self->data)
         g_byte_array_unref (self->data);
     g_slice_free (MMSmsPart, self);
@@ -115,8 +123,6 @@ PART_GET_FUNC (guint, concat_max)
 PART_SET_FUNC (guint, concat_max)
 PART_GET_FUNC (guint, concat_sequence)
 PART_SET_FUNC (guint, concat_sequence)
-PART_GET_FUNC (const gchar *, text)
-PART_SET_TAKE_STR_FUNC (text)
 PART_GET_FUNC (MMSmsEncoding, encoding)
 PART_SET_FUNC (MMSmsEncoding, encoding)
 PART_GET_FUNC (gint,  class)
@@ -160,6 +166,79 @@ mm_sms_part_take_data (MMSmsPart *self,
     self->data = value;
 }
 
+static void
+clear_pdu_text (MMSmsPart *self)
+{
+    if (self->pdu) {
+        g_bytes_unref (self->pdu);
+        self->pdu = NULL;
+    }
+    self->pdu_decode_text = NULL;
+}
+
+const gchar *
+mm_sms_part_get_text (MMSmsPart *self)
+{
+    if (!self->text && self->pdu_decode_text) {
+        self->text = self->pdu_decode_text (g_bytes_get_data (self->pdu, NULL),
+                                            self->pdu_text_n_elements,
+                                            self->pdu_text_encoding,
+                                            self->pdu_text_bit_offset);
+        clear_pdu_text (self);
+        /* mm_sms_part_has_text() already reported text for this part, so
+         * never go back on it */
+        if (!self->text) {
+            mm_warn ("Couldn't decode SMS part text: using empty text");
+            self->text = g_strdup ("");
+        }
+    }
+    return self->text;
+}
+
+void
+mm_sms_part_set_text (MMSmsPart *self,
+                      const gchar *value)
+{
+    clear_pdu_text (self);
+    g_free (self->text);
+    self->text = g_strdup (value);
+}
+
+void
+mm_sms_part_take_text (MMSmsPart *self,
+                       gchar *value)
+{
+    clear_pdu_text (self);
+    g_free (self->text);
+    self->text = value;
+}
+
+void
+mm_sms_part_take_pdu_text (MMSmsPart *self,
+                           GBytes *user_data,
+                           guint n_elements,
+                           guint bit_offset,
+                           MMSmsPartDecodeTextFunc decode_text)
+{
+    g_assert (decode_text != NULL);
+
+    clear_pdu_text (self);
+    g_free (self->text);
+    self->text = NULL;
+
+    self->pdu = user_data;
+    self->pdu_text_n_elements = n_elements;
+    self->pdu_text_bit_offset = bit_offset;
+    self->pdu_text_encoding = self->encoding;
+    self->pdu_decode_text = decode_text;
+}
+
+gboolean
+mm_sms_part_has_text (MMSmsPart *self)
+{
+    return (self->text || self->pdu_decode_text);
+}
+
 gboolean
 mm_sms_part_should_concat (MMSmsPart *self)
 {
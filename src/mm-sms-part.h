@@ -81,6 +81,20 @@ void              mm_sms_part_set_text               (MMSmsPart *part,
 void              mm_sms_part_take_text              (MMSmsPart *part,
                                                       gchar *text);
 
+/* Text decoded on demand out of the user data of the PDU, using the
+ * encoding of the part when the user data is given. Once the user data is
+ * given, the part has text: it decodes to an empty string at worst */
+typedef gchar *(* MMSmsPartDecodeTextFunc) (const guint8 *user_data,
+                                            guint n_elements,
+                                            MMSmsEncoding encoding,
+                                            guint bit_offset);
+void              mm_sms_part_take_pdu_text          (MMSmsPart *part,
+                                                      GBytes *user_data,
+                                                      guint n_elements,
+                                                      guint bit_offset,
+                                                      MMSmsPartDecodeTextFunc decode_text);
+gboolean          mm_sms_part_has_text               (MMSmsPart *part);
+
 const GByteArray *mm_sms_part_get_data               (MMSmsPart *part);
 void              mm_sms_part_set_data               (MMSmsPart *part,
                                                       GByteArray *data);
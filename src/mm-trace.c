@@ -0,0 +1,345 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <ModemManager.h>
+#include <mm-errors-types.h>
+
+#include "mm-trace.h"
+
+/* Step machine being traced */
+typedef struct {
+    gchar   *machine;
+    gchar   *context;
+    guint    tid;
+    guint    step;
+    gboolean step_open;
+} TaskTrace;
+
+static gboolean    enabled;
+static GMutex      trace_mutex;
+static FILE       *trace_fp;
+static gint64      trace_start;
+static pid_t       trace_pid;
+static GString    *trace_buf;
+/* context -> track id */
+static GHashTable *tracks;
+/* GTask -> TaskTrace */
+static GHashTable *tasks;
+
+/*****************************************************************************/
+
+gboolean
+mm_trace_enabled (void)
+{
+    return enabled;
+}
+
+static void
+append_json_string (GString     *str,
+                    const gchar *value)
+{
+    const gchar *p;
+
+    g_string_append_c (str, '"');
+    for (p = value ? value : ""; *p; p++) {
+        switch (*p) {
+        case '"':
+            g_string_append (str, "\\\"");
+            break;
+        case '\\':
+            g_string_append (str, "\\\\");
+            break;
+        case '\n':
+            g_string_append (str, "\\n");
+            break;
+        case '\r':
+            g_string_append (str, "\\r");
+            break;
+        case '\t':
+            g_string_append (str, "\\t");
+            break;
+        default:
+            if ((guchar)*p < 0x20)
+                g_string_append_printf (str, "\\u%04x", (guint)(guchar)*p);
+            else
+                g_string_append_c (str, *p);
+            break;
+        }
+    }
+    g_string_append_c (str, '"');
+}
+
+/* Must be called with the mutex held */
+static void
+write_event (const gchar   *phase,
+             const gchar   *category,
+             const gchar   *name,
+             gconstpointer  id,
+             guint          tid,
+             const gchar   *arg_name,
+             const gchar   *arg_value)
+{
+    g_string_truncate (trace_buf, 0);
+    g_string_append (trace_buf, "{\"name\":");
+    append_json_string (trace_buf, name);
+    g_string_append (trace_buf, ",\"cat\":");
+    append_json_string (trace_buf, category);
+    g_string_append_printf (trace_buf,
+                            ",\"ph\":\"%s\",\"ts\":%" G_GINT64_FORMAT ",\"pid\":%d,\"tid\":%u",
+                            phase,
+                            g_get_monotonic_time () - trace_start,
+                            (gint) trace_pid,
+                            tid);
+    if (id)
+        g_string_append_printf (trace_buf, ",\"id\":\"%p\"", id);
+    if (arg_name) {
+        g_string_append (trace_buf, ",\"args\":{");
+        append_json_string (trace_buf, arg_name);
+        g_string_append_c (trace_buf, ':');
+        append_json_string (trace_buf, arg_value);
+        g_string_append_c (trace_buf, '}');
+    }
+    g_string_append (trace_buf, "},\n");
+
+    fwrite (trace_buf->str, 1, trace_buf->len, trace_fp);
+}
+
+/* Must be called with the mutex held */
+static guint
+get_track (const gchar *context)
+{
+    gpointer tid;
+
+    if (!context)
+        context = "daemon";
+
+    tid = g_hash_table_lookup (tracks, context);
+    if (!tid) {
+        tid = GUINT_TO_POINTER (g_hash_table_size (tracks) + 1);
+        g_hash_table_insert (tracks, g_strdup (context), tid);
+        /* Name the track after the context, e.g. the modem device */
+        write_event ("M", "__metadata", "thread_name", NULL, GPOINTER_TO_UINT (tid), "name", context);
+    }
+    return GPOINTER_TO_UINT (tid);
+}
+
+/*****************************************************************************/
+/* Step machines */
+
+static gchar *
+build_step_name (TaskTrace *trace)
+{
+    return g_strdup_printf ("%s step %u", trace->machine, trace->step);
+}
+
+/* Must be called with the mutex held */
+static void
+task_trace_close_step (GTask     *task,
+                       TaskTrace *trace)
+{
+    gchar *name;
+
+    if (!trace->step_open)
+        return;
+
+    name = build_step_name (trace);
+    write_event ("e", "step", name, task, trace->tid, NULL, NULL);
+    g_free (name);
+    trace->step_open = FALSE;
+}
+
+/* Must be called with the mutex held */
+static void
+task_trace_close (GTask     *task,
+                  TaskTrace *trace)
+{
+    task_trace_close_step (task, trace);
+    write_event ("e", "step", trace->machine, task, trace->tid, NULL, NULL);
+}
+
+static void
+task_trace_free (TaskTrace *trace)
+{
+    g_free (trace->machine);
+    g_free (trace->context);
+    g_slice_free (TaskTrace, trace);
+}
+
+static void
+task_disposed (gpointer  unused,
+               GObject  *task)
+{
+    TaskTrace *trace;
+
+    g_mutex_lock (&trace_mutex);
+    if (tasks) {
+        trace = g_hash_table_lookup (tasks, task);
+        if (trace) {
+            task_trace_close ((GTask *)task, trace);
+            g_hash_table_remove (tasks, task);
+        }
+    }
+    g_mutex_unlock (&trace_mutex);
+}
+
+void
+_mm_trace_step (GTask       *task,
+                const gchar *machine,
+                guint        step,
+                const gchar *context)
+{
+    TaskTrace *trace;
+    gchar     *name;
+
+    g_mutex_lock (&trace_mutex);
+    if (!trace_fp)
+        goto out;
+
+    trace = g_hash_table_lookup (tasks, task);
+    if (trace && !g_str_equal (trace->machine, machine)) {
+        /* Same task driving a different step machine, close the old one */
+        task_trace_close (task, trace);
+        g_free (trace->machine);
+        trace->machine = g_strdup (machine);
+        write_event ("b", "step", trace->machine, task, trace->tid, "context", trace->context);
+    } else if (!trace) {
+        trace = g_slice_new0 (TaskTrace);
+        trace->machine = g_strdup (machine);
+        trace->context = g_strdup (context);
+        trace->tid = get_track (context);
+        g_hash_table_insert (tasks, task, trace);
+        g_object_weak_ref (G_OBJECT (task), task_disposed, NULL);
+        write_event ("b", "step", trace->machine, task, trace->tid, "context", trace->context);
+    } else if (trace->step_open && trace->step == step)
+        /* Re-entering the same step (e.g. retries), keep the span open */
+        goto out;
+
+    task_trace_close_step (task, trace);
+    trace->step = step;
+    trace->step_open = TRUE;
+    name = build_step_name (trace);
+    write_event ("b", "step", name, task, trace->tid, NULL, NULL);
+    g_free (name);
+
+out:
+    g_mutex_unlock (&trace_mutex);
+}
+
+/*****************************************************************************/
+/* Transactions */
+
+void
+_mm_trace_transaction_begin (gconstpointer  id,
+                             const gchar   *category,
+                             const gchar   *name,
+                             const gchar   *context)
+{
+    g_mutex_lock (&trace_mutex);
+    if (trace_fp)
+        write_event ("b", category, name, id, get_track (context), "context", context);
+    g_mutex_unlock (&trace_mutex);
+}
+
+void
+_mm_trace_transaction_end (gconstpointer  id,
+                           const gchar   *category,
+                           const gchar   *name,
+                           const gchar   *result)
+{
+    g_mutex_lock (&trace_mutex);
+    if (trace_fp)
+        write_event ("e", category, name, id, 0, result ? "result" : NULL, result);
+    g_mutex_unlock (&trace_mutex);
+}
+
+/*****************************************************************************/
+
+gboolean
+mm_trace_setup (const gchar  *trace_file,
+                GError      **error)
+{
+    if (!trace_file)
+        return TRUE;
+
+    g_assert (!trace_fp);
+
+    trace_fp = fopen (trace_file, "w");
+    if (!trace_fp) {
+        g_set_error (error,
+                     MM_CORE_ERROR,
+                     MM_CORE_ERROR_FAILED,
+                     "Couldn't open trace file '%s': %s",
+                     trace_file,
+                     strerror (errno));
+        return FALSE;
+    }
+
+    trace_start = g_get_monotonic_time ();
+    trace_pid = getpid ();
+    trace_buf = g_string_sized_new (256);
+    tracks = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    tasks = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)task_trace_free);
+
+    /* JSON array format; the closing bracket is optional, so the trace can
+     * still be loaded if the daemon doesn't exit cleanly */
+    fputs ("[\n", trace_fp);
+    write_event ("M", "__metadata", "process_name", NULL, 0, "name", "ModemManager");
+
+    enabled = TRUE;
+    return TRUE;
+}
+
+void
+mm_trace_shutdown (void)
+{
+    GHashTableIter iter;
+    gpointer       key;
+    gpointer       value;
+
+    if (!trace_fp)
+        return;
+
+    g_mutex_lock (&trace_mutex);
+
+    enabled = FALSE;
+
+    /* Close all spans of the step machines still around */
+    g_hash_table_iter_init (&iter, tasks);
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+        task_trace_close ((GTask *)key, (TaskTrace *)value);
+        g_object_weak_unref (G_OBJECT (key), task_disposed, NULL);
+        g_hash_table_iter_remove (&iter);
+    }
+
+    /* Last metadata event without trailing comma */
+    fprintf (trace_fp,
+             "{\"name\":\"trace_end\",\"cat\":\"__metadata\",\"ph\":\"M\",\"pid\":%d,\"tid\":0}\n]\n",
+             (gint) trace_pid);
+    fclose (trace_fp);
+    trace_fp = NULL;
+
+    g_clear_pointer (&tasks, g_hash_table_unref);
+    g_clear_pointer (&tracks, g_hash_table_unref);
+    g_string_free (trace_buf, TRUE);
+    trace_buf = NULL;
+
+    g_mutex_unlock (&trace_mutex);
+}
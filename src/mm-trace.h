@@ -0,0 +1,67 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+#ifndef MM_TRACE_H
+#define MM_TRACE_H
+
+#include <glib.h>
+#include <gio/gio.h>
+
+/* Profiler mode: when a trace file is given, step machine transitions and
+ * port transactions are written as Chrome trace-event JSON (array format),
+ * which can be loaded in chrome://tracing or in the Perfetto UI. */
+
+gboolean mm_trace_setup    (const gchar  *trace_file,
+                            GError      **error);
+void     mm_trace_shutdown (void);
+gboolean mm_trace_enabled  (void);
+
+/* The arguments of these macros are only evaluated when tracing is enabled,
+ * so that they can be used in hot paths. */
+
+/* Record that the step machine driven by @task enters @step. The whole
+ * step machine and each of its steps are reported as nested spans, which
+ * are closed when the next step is entered and when the task is disposed. */
+#define mm_trace_step(task, machine, step, context) G_STMT_START {    \
+        if (G_UNLIKELY (mm_trace_enabled ()))                        \
+            _mm_trace_step (task, machine, step, context);           \
+    } G_STMT_END
+
+/* Record begin/end of a transaction (e.g. an AT command) on a port. The
+ * @id just needs to be unique among the ongoing transactions. */
+#define mm_trace_transaction_begin(id, category, name, context) G_STMT_START { \
+        if (G_UNLIKELY (mm_trace_enabled ()))                                  \
+            _mm_trace_transaction_begin (id, category, name, context);         \
+    } G_STMT_END
+
+#define mm_trace_transaction_end(id, category, name, result) G_STMT_START { \
+        if (G_UNLIKELY (mm_trace_enabled ()))                               \
+            _mm_trace_transaction_end (id, category, name, result);         \
+    } G_STMT_END
+
+void _mm_trace_step              (GTask         *task,
+                                  const gchar   *machine,
+                                  guint          step,
+                                  const gchar   *context);
+void _mm_trace_transaction_begin (gconstpointer  id,
+                                  const gchar   *category,
+                                  const gchar   *name,
+                                  const gchar   *context);
+void _mm_trace_transaction_end   (gconstpointer  id,
+                                  const gchar   *category,
+                                  const gchar   *name,
+                                  const gchar   *result);
+
+#endif /* MM_TRACE_H */
@@ -0,0 +1,721 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+/*
+ * Microbenchmarks for the core parsing and encoding helpers, run with
+ * 'make bench'. Each benchmark runs one operation per item of a corpus of
+ * recorded modem responses, cycling through the corpus, and reports the
+ * average time and number of allocations per operation.
+ *
+ * Allocations are counted by interposing malloc(), calloc() and realloc(),
+ * so GSlice must be disabled (G_SLICE=always-malloc) for them to be
+ * accounted; 'make bench' takes care of that.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+
+#include <glib.h>
+#include <glib-object.h>
+
+#define _LIBMM_INSIDE_MM
+#include <libmm-glib.h>
+
+#include "mm-log.h"
+#include "mm-modem-helpers.h"
+#include "mm-serial-parsers.h"
+#include "mm-port-serial-at.h"
+#include "mm-sms-part-3gpp.h"
+#include "mm-sms-part-cdma.h"
+#include "mm-charsets.h"
+#include "libqcdm/src/utils.h"
+
+/*****************************************************************************/
+/* Allocation accounting */
+
+static gboolean counting;
+static guint64  n_allocs;
+static guint64  n_alloc_bytes;
+
+#if defined (__GLIBC__)
+
+extern void *__libc_malloc  (size_t size);
+extern void *__libc_calloc  (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+void *
+malloc (size_t size)
+{
+    if (counting) {
+        n_allocs++;
+        n_alloc_bytes += size;
+    }
+    return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb,
+        size_t size)
+{
+    if (counting) {
+        n_allocs++;
+        n_alloc_bytes += nmemb * size;
+    }
+    return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void   *ptr,
+         size_t  size)
+{
+    if (counting) {
+        n_allocs++;
+        n_alloc_bytes += size;
+    }
+    return __libc_realloc (ptr, size);
+}
+
+#define ALLOCS_ACCOUNTED TRUE
+#else
+#define ALLOCS_ACCOUNTED FALSE
+#endif
+
+/*****************************************************************************/
+/* Corpora */
+
+typedef struct {
+    const guint8 *data;
+    gsize         len;
+} BinaryItem;
+
+static const gchar *at_responses_corpus[] = {
+    "\r\nOK\r\n",
+    "\r\n+CSQ: 17,99\r\n\r\nOK\r\n",
+    "\r\n+CREG: 2,1,\"1234\",\"001122BB\"\r\n\r\nOK\r\n",
+    "\r\n+COPS: 0,2,\"21401\",2\r\n\r\nOK\r\n",
+    "\r\nERROR\r\n",
+    "\r\n+CME ERROR: 10\r\n",
+    "\r\n+CME ERROR: SIM not inserted\r\n",
+    "\r\n+CMS ERROR: 321\r\n",
+    "\r\nNO CARRIER\r\n",
+    "\r\nCONNECT 115200\r\n",
+    "\r\n+CGDCONT: 1,\"IP\",\"internet\",\"0.0.0.0\",0,0\r\n+CGDCONT: 2,\"IPV4V6\",\"ims\",\"0.0.0.0\",0,0\r\n\r\nOK\r\n",
+    "\r\nManufacturer: Dummy vendor\r\nModel: Dummy model\r\nRevision: Dummy revision\r\n",
+};
+
+static const gchar *at_unsolicited_corpus[] = {
+    "\r\n+CREG: 1\r\n",
+    "\r\n+CREG: 5,\"1234\",\"001122BB\"\r\n",
+    "\r\n+CGREG: 1,\"31C5\",\"0083F7CD\",7\r\n",
+    "\r\n+CEREG: 1,\"31C5\",\"0083F7CD\",7\r\n",
+    "\r\n+CMTI: \"SM\",3\r\n",
+    "\r\n+CIEV: 2,4\r\n",
+    "\r\n+CUSD: 0,\"Your balance is 10.00\",15\r\n",
+    "\r\n+CGEV: NW DEACT \"IP\",\"10.0.0.1\",1\r\n",
+    "\r\n+CSQ: 17,99\r\n\r\nOK\r\n",
+    "\r\nRING\r\n",
+};
+
+static const gchar *creg_corpus[] = {
+    "+CREG: 1",
+    "+CREG: 2,1",
+    "+CREG: 2,5,\"1234\",\"001122BB\"",
+    "+CREG: 2,1,\"1234\",\"001122BB\",7",
+    "+CGREG: 2,1,\"31C5\",\"0083F7CD\",2",
+    "+CEREG: 2,1,\"31C5\",\"0083F7CD\",7",
+    "+CREG: 0,1,3ae6,d15d,2",
+};
+
+static const gchar *cops_test_corpus[] = {
+    "+COPS: (2,\"\",\"T-Mobile\",\"31026\",0),(2,\"T - Mobile\",\"T - Mobile\",\"310260\",2),(1,\"AT&T\",\"AT&T\",\"310410\",0)",
+    "+COPS: (2,\"T-Mobile US\",\"TMO US\",\"31026\",0),(1,\"AT&T\",\"AT&T\",\"310410\",2),(1,\"AT&T\",\"AT&T\",\"310410\",0),,(0, 1,)",
+    "+COPS: (2,\"T-Mobile\",\"TMO\",\"31026\",0),(1,\"Cingular\",\"Cinglr\",\"310410\",2),(1,\"Cingular\",\"Cinglr\",\"310410\",0),,)",
+};
+
+static const gchar *cops_read_corpus[] = {
+    "+COPS: 0,2,\"21401\",2",
+    "+COPS: 0,0,\"vodafone ES\",7",
+    "+COPS: 1,1,\"Movistar\"",
+    "+COPS: 0",
+};
+
+static const gchar *cgdcont_read_corpus[] = {
+    "+CGDCONT: 1,\"IP\",\"internet\",\"0.0.0.0\",0,0\r\n"
+    "+CGDCONT: 2,\"IPV6\",\"ims\",\"0.0.0.0.0.0.0.0.0.0.0.0.0.0.0.0\",0,0\r\n"
+    "+CGDCONT: 3,\"IPV4V6\",\"sos\",\"0.0.0.0\",0,0\r\n",
+    "+CGDCONT: 1,\"IP\",\"ac.vodafone.es\",\"\",0,0",
+};
+
+static const gchar *cgdcont_test_corpus[] = {
+    "+CGDCONT: (1-11),\"IP\",,,(0-2),(0-3)\r\n"
+    "+CGDCONT: (1-11),\"IPV6\",,,(0-2),(0-3)\r\n"
+    "+CGDCONT: (1-11),\"IPV4V6\",,,(0-2),(0-3)\r\n"
+    "+CGDCONT: (1-11),\"PPP\",,,(0-2),(0-3)",
+};
+
+static const gchar *cmgl_corpus[] = {
+    "+CMGL: 0,1,,147\r\n07914306073011F00405812261F700003130916191314095C27"
+    "4D96D2FBBD3E437280CB2BEC961F3DB5D76818EF2F0381D9E83E06F39A8CC2E9FD372F"
+    "77BEE0249CBE37A594E0E83E2F532085E2F93CB73D0B93CA7A7DFEEB01C447F93DF731"
+    "0BD3E07CDCB727B7A9C7ECF41E432C8FC96B7C32079189E26874179D0F8DD7E93C3A0B"
+    "21B246AA641D637396C7EBBCB22D0FD7E77B5D376B3AB3C07",
+};
+
+static const gchar *cesq_corpus[] = {
+    "+CESQ: 99,99,255,255,20,80",
+    "+CESQ: 99,99,95,95,255,255",
+    "+CESQ: 5,3,255,255,255,255",
+};
+
+static const gchar *sms_3gpp_corpus[] = {
+    /* GSM 7-bit, with extended characters */
+    "07912104442961F4040B916171957291F800001120821105050A6AC8B2BC7C9A83C220F6"
+    "DB7D2ECB41EDF27C1E3E97411BDE06754FD3D1A0F9BB5D0695F1F4B29B5C2683C6E8B03C"
+    "3CA697E5F34D6AE303D1D1F2F7DD0D4ABB59A0797D8C0685E7A00028EC26832A960B28EC"
+    "2683BE6050780EBA97D96C17",
+    /* UCS2 */
+    "07919730071111F10414D04937BD2C7797E9D3E614000811309291024061080442043504"
+    "410442",
+    /* 8-bit data */
+    "07912143658709F1040B918100551512F20004111010214365000AE8329BFD4697D9EC37"
+    "DE",
+    /* GSM 7-bit, with user data header */
+    "07911356131313F64004850120390011609232239180A006080400100201D7327BFD6EB3"
+    "40E2321BF46E83EA7790F59D1E97DBE1341B442F83C465763D3DA797E56537C81D0ECB41"
+    "AB59CC1693C16031D96C064241E5656838AF03A96230982A269BCD462917C8FA4E8FCBED"
+    "709A0D7ABBE9F6B0FB5C7683D27350984D4FABC9A0B33C4C4FCF5D20EBFB2D079DCB6279"
+    "3DBD06D9C36E50FB2D4E97D9A0B49B5E96BBCB",
+    /* GSM 7-bit, concatenated (both parts) */
+    "07912160130320F5440B916171056429F5000021405291650569A00500034C0201A9E8F41C949E"
+    "83C2207B599E07B1DFEE33885E9ED341E4F23C7D7697C920FA1B54C697E5E3F4BC0C6AD7D9F434"
+    "081E96D341E3303C2C4EB3D3F4BC0B94A483E6E8779D4D06CDD1EF3BA80E0785E7A0B7BB0C6A97"
+    "E7F3F0B9CC02B9DF7450780EA2DFDF2C50780EA2A3CBA0BA9B5C96B3F369F71954768FDFE4B4FB"
+    "0C9297E1F2F2BCECA6CF41",
+    "07912160130320F6440B916171056429F5000021405291651569320500034C0202E9E8301D4447"
+    "9741F0B09C3E0785E56590BCCC0ED3CB6410FD0D7ABBCBA0B0FB4D4797E52E10",
+};
+
+static const guint8 sms_cdma_pdu1[] = {
+    0x00, 0x00, 0x02, 0x10, 0x02, 0x02, 0x07, 0x02, 0x8C, 0xE9, 0x5D, 0xCC,
+    0x65, 0x80, 0x06, 0x01, 0xFC, 0x08, 0x15, 0x00, 0x03, 0x16, 0x8D, 0x30,
+    0x01, 0x06, 0x10, 0x24, 0x18, 0x30, 0x60, 0x80, 0x03, 0x06, 0x10, 0x10,
+    0x04, 0x04, 0x48, 0x47
+};
+
+/* Latin encoding, not byte aligned */
+static const guint8 sms_cdma_pdu2[] = {
+    0x00, 0x00, 0x02, 0x10, 0x02, 0x02, 0x07, 0x02, 0x8C, 0xE9, 0x5D, 0xCC,
+    0x65, 0x80, 0x06, 0x01, 0xFC, 0x08, 0x39, 0x00, 0x03, 0x13, 0x8D, 0x20,
+    0x01, 0x27, 0x41, 0x29, 0x19, 0x22, 0xE1, 0x19, 0x1A, 0xE1, 0x1A, 0x01,
+    0x19, 0xA1, 0x19, 0xA1, 0xA9, 0xB1, 0xB9, 0xE9, 0x53, 0x4B, 0x23, 0xAB,
+    0x53, 0x23, 0xAB, 0x23, 0x2B, 0xAB, 0xAB, 0x2B, 0x23, 0xAB, 0x53, 0x23,
+    0x2B, 0xAB, 0x53, 0xAB, 0x20, 0x03, 0x06, 0x13, 0x10, 0x23, 0x20, 0x06,
+    0x37, 0x08, 0x01, 0x00
+};
+
+static const BinaryItem sms_cdma_corpus[] = {
+    { sms_cdma_pdu1, sizeof (sms_cdma_pdu1) },
+    { sms_cdma_pdu2, sizeof (sms_cdma_pdu2) },
+};
+
+static const gchar *ucs2_hex_corpus[] = {
+    "004D006F00640065006D004D0061006E0061006700650072",
+    "0048006F006C0061002C0020003F007100750065002000740061006C003F",
+    "00480065006C006C006F00200077006F0072006C0064",
+};
+
+static const gchar *utf8_corpus[] = {
+    "ModemManager",
+    "Here's a longer message [{with some extended characters}] thrown in, such as £ and ΩΠΨ and §¿ as well.",
+    "Hola, ¿qué tal estás?",
+};
+
+static const guint8 qcdm_cmd_version_info[] = { 0x00 };
+static const guint8 qcdm_cmd_nv_read[] = {
+    0x26, 0x47, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x7e, 0x7d, 0x5e, 0x00,
+};
+
+static const BinaryItem qcdm_corpus[] = {
+    { qcdm_cmd_version_info, sizeof (qcdm_cmd_version_info) },
+    { qcdm_cmd_nv_read,      sizeof (qcdm_cmd_nv_read)      },
+};
+
+/*****************************************************************************/
+/* Benchmarks */
+
+static gpointer        serial_parser;
+static GString        *serial_response;
+static MMPortSerialAt *at_port;
+static GByteArray     *at_buffer;
+static GPtrArray      *creg_regexes;
+static GByteArray     *qcdm_framed[G_N_ELEMENTS (qcdm_corpus)];
+static GByteArray     *gsm_packed[G_N_ELEMENTS (utf8_corpus)];
+
+static void
+unsolicited_noop (MMPortSerialAt *port,
+                  GMatchInfo     *match_info,
+                  gpointer        user_data)
+{
+}
+
+static void
+setup (void)
+{
+    GRegex *regex;
+    guint   i;
+
+    serial_parser = mm_serial_parser_v1_new ();
+    serial_response = g_string_sized_new (512);
+
+    /* Register the same URC handlers the generic 3GPP modem uses */
+    at_port = mm_port_serial_at_new ("bench", MM_PORT_SUBSYS_TTY);
+    at_buffer = g_byte_array_sized_new (512);
+    creg_regexes = mm_3gpp_creg_regex_get (FALSE);
+    for (i = 0; i < creg_regexes->len; i++)
+        mm_port_serial_at_add_unsolicited_msg_handler (at_port, g_ptr_array_index (creg_regexes, i),
+                                                       unsolicited_noop, NULL, NULL);
+    mm_3gpp_creg_regex_destroy (creg_regexes);
+
+#define ADD_HANDLER(getter) do {                                                                \
+        regex = getter ();                                                                      \
+        mm_port_serial_at_add_unsolicited_msg_handler (at_port, regex, unsolicited_noop, NULL, NULL); \
+        g_regex_unref (regex);                                                                  \
+    } while (0)
+    ADD_HANDLER (mm_3gpp_ciev_regex_get);
+    ADD_HANDLER (mm_3gpp_cgev_regex_get);
+    ADD_HANDLER (mm_3gpp_cusd_regex_get);
+    ADD_HANDLER (mm_3gpp_cmti_regex_get);
+    ADD_HANDLER (mm_3gpp_cds_regex_get);
+    ADD_HANDLER (mm_voice_ring_regex_get);
+    ADD_HANDLER (mm_voice_clip_regex_get);
+#undef ADD_HANDLER
+
+    creg_regexes = mm_3gpp_creg_regex_get (TRUE);
+
+    /* Pre-frame the QCDM commands so that decapsulation can be measured alone */
+    for (i = 0; i < G_N_ELEMENTS (qcdm_corpus); i++) {
+        gchar  in[256];
+        gsize  len;
+
+        qcdm_framed[i] = g_byte_array_sized_new (512);
+        g_byte_array_set_size (qcdm_framed[i], 512);
+        memcpy (in, qcdm_corpus[i].data, qcdm_corpus[i].len);
+        len = dm_encapsulate_buffer (in, qcdm_corpus[i].len, sizeof (in),
+                                     (gchar *) qcdm_framed[i]->data, qcdm_framed[i]->len);
+        g_assert (len > 0);
+        g_byte_array_set_size (qcdm_framed[i], len);
+    }
+
+    /* Pre-pack the GSM 7-bit texts so that unpacking can be measured alone */
+    for (i = 0; i < G_N_ELEMENTS (utf8_corpus); i++) {
+        guint8  *unpacked;
+        guint8  *packed;
+        guint32  unpacked_len, packed_len;
+
+        unpacked = mm_charset_utf8_to_unpacked_gsm (utf8_corpus[i], &unpacked_len);
+        packed = mm_charset_gsm_pack (unpacked, unpacked_len, 0, &packed_len);
+        gsm_packed[i] = g_byte_array_new_take (packed, packed_len);
+        g_free (unpacked);
+    }
+}
+
+static void
+teardown (void)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (utf8_corpus); i++)
+        g_byte_array_unref (gsm_packed[i]);
+    for (i = 0; i < G_N_ELEMENTS (qcdm_corpus); i++)
+        g_byte_array_unref (qcdm_framed[i]);
+    mm_3gpp_creg_regex_destroy (creg_regexes);
+    g_byte_array_unref (at_buffer);
+    g_object_unref (at_port);
+    g_string_free (serial_response, TRUE);
+    mm_serial_parser_v1_destroy (serial_parser);
+}
+
+static void
+bench_serial_parser_v1_parse (gconstpointer item)
+{
+    GError *error = NULL;
+
+    g_string_assign (serial_response, (const gchar *) item);
+    mm_serial_parser_v1_parse (serial_parser, serial_response, &error);
+    if (error)
+        g_error_free (error);
+}
+
+static void
+bench_at_parse_unsolicited (gconstpointer item)
+{
+    g_byte_array_set_size (at_buffer, 0);
+    g_byte_array_append (at_buffer, (const guint8 *) item, strlen ((const gchar *) item));
+    MM_PORT_SERIAL_GET_CLASS (at_port)->parse_unsolicited (MM_PORT_SERIAL (at_port), at_buffer);
+}
+
+static void
+bench_3gpp_parse_creg (gconstpointer item)
+{
+    guint i;
+
+    for (i = 0; i < creg_regexes->len; i++) {
+        GMatchInfo *info = NULL;
+
+        if (g_regex_match ((GRegex *) g_ptr_array_index (creg_regexes, i), (const gchar *) item, 0, &info)) {
+            MMModem3gppRegistrationState state;
+            MMModemAccessTechnology      act;
+            gulong                       lac, ci;
+            gboolean                     cgreg, cereg;
+
+            mm_3gpp_parse_creg_response (info, &state, &lac, &ci, &act, &cgreg, &cereg, NULL);
+            g_match_info_free (info);
+            return;
+        }
+        g_match_info_free (info);
+    }
+}
+
+static void
+bench_3gpp_parse_cops_test (gconstpointer item)
+{
+    mm_3gpp_network_info_list_free (mm_3gpp_parse_cops_test_response ((const gchar *) item, NULL));
+}
+
+static void
+bench_3gpp_parse_cops_read (gconstpointer item)
+{
+    guint                    mode, format;
+    gchar                   *operator = NULL;
+    MMModemAccessTechnology  act;
+
+    mm_3gpp_parse_cops_read_response ((const gchar *) item, &mode, &format, &operator, &act, NULL);
+    g_free (operator);
+}
+
+static void
+bench_3gpp_parse_cgdcont_read (gconstpointer item)
+{
+    mm_3gpp_pdp_context_list_free (mm_3gpp_parse_cgdcont_read_response ((const gchar *) item, NULL));
+}
+
+static void
+bench_3gpp_parse_cgdcont_test (gconstpointer item)
+{
+    mm_3gpp_pdp_context_format_list_free (mm_3gpp_parse_cgdcont_test_response ((const gchar *) item, NULL));
+}
+
+static void
+bench_3gpp_parse_pdu_cmgl (gconstpointer item)
+{
+    mm_3gpp_pdu_info_list_free (mm_3gpp_parse_pdu_cmgl_response ((const gchar *) item, NULL));
+}
+
+static void
+bench_3gpp_parse_cesq (gconstpointer item)
+{
+    guint rxlev, ber, rscp, ecn0, rsrq, rsrp;
+
+    mm_3gpp_parse_cesq_response ((const gchar *) item, &rxlev, &ber, &rscp, &ecn0, &rsrq, &rsrp, NULL);
+}
+
+static void
+bench_sms_part_3gpp_new_from_pdu (gconstpointer item)
+{
+    MMSmsPart *part;
+
+    part = mm_sms_part_3gpp_new_from_pdu (0, (const gchar *) item, NULL);
+    g_assert (part);
+    mm_sms_part_free (part);
+}
+
+static void
+bench_sms_part_3gpp_new_from_pdu_text (gconstpointer item)
+{
+    MMSmsPart *part;
+
+    /* Text is decoded on demand, so this accounts for it as well */
+    part = mm_sms_part_3gpp_new_from_pdu (0, (const gchar *) item, NULL);
+    g_assert (part);
+    mm_sms_part_get_text (part);
+    mm_sms_part_free (part);
+}
+
+static void
+bench_sms_part_cdma_new_from_binary_pdu (gconstpointer item)
+{
+    const BinaryItem *bin = item;
+    MMSmsPart        *part;
+
+    part = mm_sms_part_cdma_new_from_binary_pdu (0, bin->data, bin->len, NULL);
+    g_assert (part);
+    mm_sms_part_free (part);
+}
+
+static void
+bench_charset_ucs2_hex_to_utf8 (gconstpointer item)
+{
+    g_free (mm_modem_charset_hex_to_utf8 ((const gchar *) item, MM_MODEM_CHARSET_UCS2));
+}
+
+static void
+bench_charset_utf8_to_ucs2_hex (gconstpointer item)
+{
+    g_free (mm_modem_charset_utf8_to_hex ((const gchar *) item, MM_MODEM_CHARSET_UCS2));
+}
+
+static void
+bench_charset_gsm_roundtrip (gconstpointer item)
+{
+    guint8  *unpacked;
+    guint8  *packed;
+    guint8  *septets;
+    guint32  unpacked_len, packed_len, septets_len;
+
+    unpacked = mm_charset_utf8_to_unpacked_gsm ((const gchar *) item, &unpacked_len);
+    packed = mm_charset_gsm_pack (unpacked, unpacked_len, 0, &packed_len);
+    septets = mm_charset_gsm_unpack (packed, unpacked_len, 0, &septets_len);
+    g_free (mm_charset_gsm_unpacked_to_utf8 (septets, septets_len));
+    g_free (septets);
+    g_free (packed);
+    g_free (unpacked);
+}
+
+static void
+bench_charset_gsm_unpack (gconstpointer item)
+{
+    const GByteArray *packed = item;
+    guint32           unpacked_len;
+
+    g_free (mm_charset_gsm_unpack (packed->data, (packed->len * 8) / 7, 0, &unpacked_len));
+}
+
+static void
+bench_hexstr2bin (gconstpointer item)
+{
+    gsize len;
+
+    g_free (mm_utils_hexstr2bin ((const gchar *) item, &len));
+}
+
+static void
+bench_hexstr2bin_buf (gconstpointer item)
+{
+    guint8 buffer[256];
+    gsize  len;
+
+    mm_utils_hexstr2bin_buf ((const gchar *) item, strlen ((const gchar *) item), buffer, sizeof (buffer), &len);
+}
+
+static void
+bench_bin2hexstr (gconstpointer item)
+{
+    const BinaryItem *bin = item;
+
+    g_free (mm_utils_bin2hexstr (bin->data, bin->len));
+}
+
+static void
+bench_qcdm_encapsulate (gconstpointer item)
+{
+    const BinaryItem *bin = item;
+    gchar             in[256];
+    gchar             out[512];
+
+    memcpy (in, bin->data, bin->len);
+    dm_encapsulate_buffer (in, bin->len, sizeof (in), out, sizeof (out));
+}
+
+static void
+bench_qcdm_decapsulate (gconstpointer item)
+{
+    const GByteArray *framed = item;
+    gchar             out[512];
+    gsize             decap_len = 0;
+    gsize             used = 0;
+    qcdmbool          more = FALSE;
+
+    dm_decapsulate_buffer ((const gchar *) framed->data, framed->len, out, sizeof (out), &decap_len, &used, &more);
+}
+
+/*****************************************************************************/
+
+typedef void (* BenchFunc) (gconstpointer item);
+
+typedef struct {
+    const gchar   *name;
+    BenchFunc      func;
+    gconstpointer  corpus;
+    gsize          item_size;
+    guint          n_items;
+    gboolean       indirect;
+} Benchmark;
+
+/* Corpora of pointers (e.g. strings) pass each pointer to the benchmark,
+ * corpora of structs pass a pointer to each struct */
+#define POINTER_CORPUS(c) (c), sizeof ((c)[0]), G_N_ELEMENTS (c), TRUE
+#define STRUCT_CORPUS(c)  (c), sizeof ((c)[0]), G_N_ELEMENTS (c), FALSE
+
+static const Benchmark benchmarks[] = {
+    { "serial-parser-v1/parse",            bench_serial_parser_v1_parse,            POINTER_CORPUS (at_responses_corpus)   },
+    { "port-serial-at/parse-unsolicited",  bench_at_parse_unsolicited,              POINTER_CORPUS (at_unsolicited_corpus) },
+    { "3gpp/creg",                         bench_3gpp_parse_creg,                   POINTER_CORPUS (creg_corpus)           },
+    { "3gpp/cops-test",                    bench_3gpp_parse_cops_test,              POINTER_CORPUS (cops_test_corpus)      },
+    { "3gpp/cops-read",                    bench_3gpp_parse_cops_read,              POINTER_CORPUS (cops_read_corpus)      },
+    { "3gpp/cgdcont-read",                 bench_3gpp_parse_cgdcont_read,           POINTER_CORPUS (cgdcont_read_corpus)   },
+    { "3gpp/cgdcont-test",                 bench_3gpp_parse_cgdcont_test,           POINTER_CORPUS (cgdcont_test_corpus)   },
+    { "3gpp/cmgl",                         bench_3gpp_parse_pdu_cmgl,               POINTER_CORPUS (cmgl_corpus)           },
+    { "3gpp/cesq",                         bench_3gpp_parse_cesq,                   POINTER_CORPUS (cesq_corpus)           },
+    { "sms-part-3gpp/new-from-pdu",        bench_sms_part_3gpp_new_from_pdu,        POINTER_CORPUS (sms_3gpp_corpus)       },
+    { "sms-part-3gpp/new-from-pdu-text",   bench_sms_part_3gpp_new_from_pdu_text,   POINTER_CORPUS (sms_3gpp_corpus)       },
+    { "sms-part-cdma/new-from-binary-pdu", bench_sms_part_cdma_new_from_binary_pdu, STRUCT_CORPUS (sms_cdma_corpus)        },
+    { "charsets/ucs2-hex-to-utf8",         bench_charset_ucs2_hex_to_utf8,          POINTER_CORPUS (ucs2_hex_corpus)       },
+    { "charsets/utf8-to-ucs2-hex",         bench_charset_utf8_to_ucs2_hex,          POINTER_CORPUS (utf8_corpus)           },
+    { "charsets/gsm-roundtrip",            bench_charset_gsm_roundtrip,             POINTER_CORPUS (utf8_corpus)           },
+    { "charsets/gsm-unpack",               bench_charset_gsm_unpack,                POINTER_CORPUS (gsm_packed)            },
+    { "hex/hexstr2bin",                    bench_hexstr2bin,                        POINTER_CORPUS (sms_3gpp_corpus)       },
+    { "hex/hexstr2bin-buf",                bench_hexstr2bin_buf,                    POINTER_CORPUS (sms_3gpp_corpus)       },
+    { "hex/bin2hexstr",                    bench_bin2hexstr,                        STRUCT_CORPUS (sms_cdma_corpus)        },
+    { "qcdm/encapsulate",                  bench_qcdm_encapsulate,                  STRUCT_CORPUS (qcdm_corpus)            },
+    { "qcdm/decapsulate",                  bench_qcdm_decapsulate,                  POINTER_CORPUS (qcdm_framed)           },
+};
+
+/*****************************************************************************/
+
+static gchar    *filter;
+static gint      min_time_ms = 200;
+static gboolean  json;
+
+static GOptionEntry main_entries[] = {
+    { "filter", 'f', 0, G_OPTION_ARG_STRING, &filter,
+      "Only run the benchmarks whose name contains the given string",
+      "[STRING]"
+    },
+    { "min-time", 't', 0, G_OPTION_ARG_INT, &min_time_ms,
+      "Minimum time to run each benchmark, in ms (default: 200)",
+      "[MS]"
+    },
+    { "json", 'j', 0, G_OPTION_ARG_NONE, &json,
+      "Report results as one JSON object per line",
+      NULL
+    },
+    { NULL }
+};
+
+static gconstpointer
+benchmark_get_item (const Benchmark *bench,
+                    guint            i)
+{
+    const guint8 *item;
+
+    item = (const guint8 *) bench->corpus + (i % bench->n_items) * bench->item_size;
+    return bench->indirect ? *(gconstpointer const *) item : (gconstpointer) item;
+}
+
+static void
+benchmark_run (const Benchmark *bench)
+{
+    guint64 iterations = bench->n_items;
+    gint64  elapsed_us;
+    guint64 i;
+
+    /* Warm up, so that lazily initialized state is not accounted */
+    for (i = 0; i < bench->n_items; i++)
+        bench->func (benchmark_get_item (bench, i));
+
+    /* Grow the number of iterations until the minimum time is reached */
+    for (;;) {
+        gint64 start;
+
+        n_allocs = 0;
+        n_alloc_bytes = 0;
+        counting = TRUE;
+        start = g_get_monotonic_time ();
+        for (i = 0; i < iterations; i++)
+            bench->func (benchmark_get_item (bench, i));
+        elapsed_us = g_get_monotonic_time () - start;
+        counting = FALSE;
+
+        if (elapsed_us >= (gint64) min_time_ms * 1000)
+            break;
+        iterations *= (elapsed_us < (gint64) min_time_ms * 100) ? 10 : 2;
+    }
+
+    if (json)
+        printf ("{\"name\":\"%s\",\"iterations\":%" G_GUINT64_FORMAT ",\"ns_per_op\":%.1f,"
+                "\"allocs_per_op\":%.2f,\"bytes_per_op\":%.1f}\n",
+                bench->name, iterations,
+                (gdouble) elapsed_us * 1000.0 / iterations,
+                (gdouble) n_allocs / iterations,
+                (gdouble) n_alloc_bytes / iterations);
+    else
+        printf ("%-36s %12" G_GUINT64_FORMAT " %12.1f %12.2f %12.1f\n",
+                bench->name, iterations,
+                (gdouble) elapsed_us * 1000.0 / iterations,
+                (gdouble) n_allocs / iterations,
+                (gdouble) n_alloc_bytes / iterations);
+    fflush (stdout);
+}
+
+/*****************************************************************************/
+
+void
+_mm_log (const char *loc,
+         const char *func,
+         guint32 level,
+         const char *fmt,
+         ...)
+{
+    /* No logging while benchmarking */
+}
+
+int main (int argc, char **argv)
+{
+    GOptionContext *context;
+    GError         *error = NULL;
+    guint           i;
+
+    setlocale (LC_ALL, "");
+
+    context = g_option_context_new ("- ModemManager helpers microbenchmarks");
+    g_option_context_add_main_entries (context, main_entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        g_printerr ("error: %s\n", error->message);
+        return EXIT_FAILURE;
+    }
+    g_option_context_free (context);
+
+    if (!ALLOCS_ACCOUNTED || g_strcmp0 (g_getenv ("G_SLICE"), "always-malloc") != 0)
+        g_printerr ("warning: allocations may not be fully accounted, "
+                    "run with G_SLICE=always-malloc on a glibc based system\n");
+
+    setup ();
+
+    if (!json)
+        printf ("# %-34s %12s %12s %12s %12s\n", "name", "iterations", "ns/op", "allocs/op", "bytes/op");
+    for (i = 0; i < G_N_ELEMENTS (benchmarks); i++) {
+        if (!filter || strstr (benchmarks[i].name, filter))
+            benchmark_run (&benchmarks[i]);
+    }
+
+    teardown ();
+    g_free (filter);
+    return EXIT_SUCCESS;
+}
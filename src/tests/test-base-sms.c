@@ -0,0 +1,246 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+#include <glib.h>
+#include <string.h>
+#include <locale.h>
+
+#include <ModemManager.h>
+#define _LIBMM_INSIDE_MM
+#include <libmm-glib.h>
+
+#include "mm-broadband-modem.h"
+#include "mm-base-sms.h"
+#include "mm-sms-part-3gpp.h"
+#include "mm-log.h"
+
+/* Single part, GSM-7: "hellohello" */
+#define TEST_HEXPDU                                                     \
+    "07912143658709F1040B918100551512F20000111010214365000AE8329BFD4697D9EC37"
+
+/* Two parts with reference 0x4C, GSM-7 */
+#define TEST_HEXPDU_MULTIPART_1                                                     \
+    "07912160130320F5440B916171056429F5000021405291650569A00500034C0201A9E8F41C949E" \
+    "83C2207B599E07B1DFEE33885E9ED341E4F23C7D7697C920FA1B54C697E5E3F4BC0C6AD7D9F434" \
+    "081E96D341E3303C2C4EB3D3F4BC0B94A483E6E8779D4D06CDD1EF3BA80E0785E7A0B7BB0C6A97" \
+    "E7F3F0B9CC02B9DF7450780EA2DFDF2C50780EA2A3CBA0BA9B5C96B3F369F71954768FDFE4B4FB" \
+    "0C9297E1F2F2BCECA6CF41"
+#define TEST_HEXPDU_MULTIPART_2                                                     \
+    "07912160130320F6440B916171056429F5000021405291651569320500034C0202E9E8301D4447" \
+    "9741F0B09C3E0785E56590BCCC0ED3CB6410FD0D7ABBCBA0B0FB4D4797E52E10"
+#define TEST_TEXT_MULTIPART                                                             \
+    "This is a very long test designed to exercise multi part capability. It should "   \
+    "show up as one message, not as two, as the underlying encoding represents "        \
+    "that the parts are related to one another. "
+
+/*****************************************************************************/
+
+static MMBaseModem *
+test_modem_new (void)
+{
+    const gchar *drivers[] = { "virtual", NULL };
+
+    return MM_BASE_MODEM (g_object_new (MM_TYPE_BROADBAND_MODEM,
+                                        MM_BASE_MODEM_DEVICE,     "/virtual/test",
+                                        MM_BASE_MODEM_DRIVERS,    drivers,
+                                        MM_BASE_MODEM_PLUGIN,     "test",
+                                        MM_BASE_MODEM_VENDOR_ID,  0,
+                                        MM_BASE_MODEM_PRODUCT_ID, 0,
+                                        NULL));
+}
+
+static MMSmsPart *
+test_part_new (const gchar *hexpdu)
+{
+    MMSmsPart *part;
+    GError    *error = NULL;
+
+    part = mm_sms_part_3gpp_new_from_pdu (0, hexpdu, &error);
+    g_assert_no_error (error);
+    g_assert (part != NULL);
+    return part;
+}
+
+static MMBaseSms *
+test_sms_new (MMBaseModem *modem)
+{
+    MMBaseSms *sms;
+    GError    *error = NULL;
+
+    sms = mm_base_sms_singlepart_new (modem,
+                                      MM_SMS_STATE_RECEIVED,
+                                      MM_SMS_STORAGE_ME,
+                                      test_part_new (TEST_HEXPDU),
+                                      &error);
+    g_assert_no_error (error);
+    g_assert (sms != NULL);
+    mm_base_sms_export (sms);
+
+    /* Assembled and exported, but the text is not decoded until read */
+    g_assert (mm_gdbus_sms_get_text (MM_GDBUS_SMS (sms)) == NULL);
+    g_assert (mm_gdbus_sms_get_data (MM_GDBUS_SMS (sms)) != NULL);
+    return sms;
+}
+
+/*****************************************************************************/
+
+static void
+test_text_on_get (void)
+{
+    MMBaseModem          *modem;
+    MMBaseSms            *sms;
+    GDBusInterfaceVTable *vtable;
+    GVariant             *value;
+    GError               *error = NULL;
+
+    modem = test_modem_new ();
+    sms = test_sms_new (modem);
+
+    /* Reading another property doesn't decode the text */
+    vtable = g_dbus_interface_skeleton_get_vtable (G_DBUS_INTERFACE_SKELETON (sms));
+    value = vtable->get_property (NULL, NULL, mm_base_sms_get_path (sms),
+                                  "org.freedesktop.ModemManager1.Sms", "Number",
+                                  &error, sms);
+    g_assert_no_error (error);
+    g_assert_cmpstr (g_variant_get_string (value, NULL), ==, "+18005551212");
+    g_variant_unref (value);
+    g_assert (mm_gdbus_sms_get_text (MM_GDBUS_SMS (sms)) == NULL);
+
+    /* Reading the text assembles it */
+    value = vtable->get_property (NULL, NULL, mm_base_sms_get_path (sms),
+                                  "org.freedesktop.ModemManager1.Sms", "Text",
+                                  &error, sms);
+    g_assert_no_error (error);
+    g_assert_cmpstr (g_variant_get_string (value, NULL), ==, "hellohello");
+    g_variant_unref (value);
+    g_assert_cmpstr (mm_gdbus_sms_get_text (MM_GDBUS_SMS (sms)), ==, "hellohello");
+
+    g_object_unref (sms);
+    g_object_unref (modem);
+}
+
+static void
+test_text_on_get_all (void)
+{
+    MMBaseModem *modem;
+    MMBaseSms   *sms;
+    GVariant    *properties;
+    const gchar *text = NULL;
+
+    modem = test_modem_new ();
+    sms = test_sms_new (modem);
+
+    properties = g_dbus_interface_skeleton_get_properties (G_DBUS_INTERFACE_SKELETON (sms));
+    g_assert (g_variant_lookup (properties, "Text", "&s", &text));
+    g_assert_cmpstr (text, ==, "hellohello");
+    g_variant_unref (properties);
+    g_assert_cmpstr (mm_gdbus_sms_get_text (MM_GDBUS_SMS (sms)), ==, "hellohello");
+
+    g_object_unref (sms);
+    g_object_unref (modem);
+}
+
+static void
+test_text_multipart_exported (void)
+{
+    MMBaseModem *modem;
+    MMBaseSms   *sms;
+    MMSmsPart   *part;
+    GError      *error = NULL;
+
+    modem = test_modem_new ();
+
+    part = test_part_new (TEST_HEXPDU_MULTIPART_1);
+    sms = mm_base_sms_multipart_new (modem,
+                                     MM_SMS_STATE_RECEIVED,
+                                     MM_SMS_STORAGE_ME,
+                                     mm_sms_part_get_concat_reference (part),
+                                     mm_sms_part_get_concat_max (part),
+                                     part,
+                                     &error);
+    g_assert_no_error (error);
+    g_assert (sms != NULL);
+    mm_base_sms_export (sms);
+    g_assert (mm_gdbus_sms_get_text (MM_GDBUS_SMS (sms)) == NULL);
+
+    /* Completed once exported: the text is assembled right away, so that
+     * clients get notified */
+    g_assert (mm_base_sms_multipart_take_part (sms, test_part_new (TEST_HEXPDU_MULTIPART_2), &error));
+    g_assert_no_error (error);
+    g_assert_cmpstr (mm_gdbus_sms_get_text (MM_GDBUS_SMS (sms)), ==, TEST_TEXT_MULTIPART);
+
+    g_object_unref (sms);
+    g_object_unref (modem);
+}
+
+static void
+test_no_text_nor_data (void)
+{
+    MMBaseModem *modem;
+    MMBaseSms   *sms;
+    MMSmsPart   *part;
+    GError      *error = NULL;
+
+    modem = test_modem_new ();
+
+    part = mm_sms_part_new (0, MM_SMS_PDU_TYPE_DELIVER);
+    sms = mm_base_sms_singlepart_new (modem,
+                                      MM_SMS_STATE_RECEIVED,
+                                      MM_SMS_STORAGE_ME,
+                                      part,
+                                      &error);
+    g_assert_error (error, MM_CORE_ERROR, MM_CORE_ERROR_FAILED);
+    g_assert (sms == NULL);
+    g_error_free (error);
+    mm_sms_part_free (part);
+
+    g_object_unref (modem);
+}
+
+/*****************************************************************************/
+
+void
+_mm_log (const char *loc,
+         const char *func,
+         guint32 level,
+         const char *fmt,
+         ...)
+{
+#if defined ENABLE_TEST_MESSAGE_TRACES
+    /* Dummy log function */
+    va_list args;
+    gchar *msg;
+
+    va_start (args, fmt);
+    msg = g_strdup_vprintf (fmt, args);
+    va_end (args);
+    g_print ("%s\n", msg);
+    g_free (msg);
+#endif
+}
+
+int main (int argc, char **argv)
+{
+    setlocale (LC_ALL, "");
+
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/MM/base-sms/text/on-get",             test_text_on_get);
+    g_test_add_func ("/MM/base-sms/text/on-get-all",         test_text_on_get_all);
+    g_test_add_func ("/MM/base-sms/text/multipart-exported", test_text_multipart_exported);
+    g_test_add_func ("/MM/base-sms/no-text-nor-data",        test_no_text_nor_data);
+
+    return g_test_run ();
+}
@@ -174,6 +174,36 @@ test_gsm7_unpack_all_chars (void)
     g_free (unpacked);
 }
 
+static void
+test_gsm7_unpack_offsets (void)
+{
+    guint8 unpacked[148];
+    guint8 *packed;
+    guint8 *result;
+    guint32 packed_len = 0;
+    guint32 result_len = 0;
+    guint offset;
+    guint len;
+
+    for (len = 0; len < sizeof (unpacked); len++)
+        unpacked[len] = (len * 37) & 0x7F;
+
+    /* Covers both the aligned blocks of 8 septets and the septet by septet
+     * unpacking, for every bit offset and any number of trailing septets */
+    for (offset = 0; offset < 8; offset++) {
+        for (len = 1; len <= sizeof (unpacked); len++) {
+            packed = mm_charset_gsm_pack (unpacked, len, offset, &packed_len);
+            g_assert (packed);
+            result = mm_charset_gsm_unpack (packed, len, offset, &result_len);
+            g_assert (result);
+            g_assert_cmpuint (result_len, ==, len);
+            g_assert_cmpint (memcmp (result, unpacked, len), ==, 0);
+            g_free (result);
+            g_free (packed);
+        }
+    }
+}
+
 static void
 test_gsm7_pack_basic (void)
 {
@@ -442,6 +472,7 @@ int main (int argc, char **argv)
     g_test_add_func ("/MM/charsets/gsm7/unpack/basic",           test_gsm7_unpack_basic);
     g_test_add_func ("/MM/charsets/gsm7/unpack/7-chars",         test_gsm7_unpack_7_chars);
     g_test_add_func ("/MM/charsets/gsm7/unpack/all-chars",       test_gsm7_unpack_all_chars);
+    g_test_add_func ("/MM/charsets/gsm7/unpack/offsets",         test_gsm7_unpack_offsets);
     g_test_add_func ("/MM/charsets/gsm7/pack/basic",             test_gsm7_pack_basic);
     g_test_add_func ("/MM/charsets/gsm7/pack/7-chars",           test_gsm7_pack_7_chars);
     g_test_add_func ("/MM/charsets/gsm7/pack/all-chars",         test_gsm7_pack_all_chars);
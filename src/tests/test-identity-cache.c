@@ -0,0 +1,279 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <locale.h>
+
+#include "mm-identity-cache.h"
+#include "mm-log.h"
+
+#define TEST_IMEI     "359881234567890"
+#define TEST_REVISION "SWI9X30C_02.24.05.06"
+#define TEST_ICCID    "89330140000000000001"
+
+static gchar *
+setup_cache_file (void)
+{
+    gchar  *dir;
+    gchar  *path;
+    GError *error = NULL;
+
+    dir = g_dir_make_tmp ("mm-identity-cache-XXXXXX", &error);
+    g_assert_no_error (error);
+    path = g_build_filename (dir, "identity-cache", NULL);
+    g_free (dir);
+    return path;
+}
+
+static void
+cleanup_cache_file (gchar *path)
+{
+    gchar *dir;
+
+    mm_identity_cache_shutdown ();
+    dir = g_path_get_dirname (path);
+    g_unlink (path);
+    g_rmdir (dir);
+    g_free (dir);
+    g_free (path);
+}
+
+static void
+test_modem (void)
+{
+    gchar    *path;
+    GVariant *modes;
+    GVariant *bands;
+    GVariant *cached_modes = NULL;
+    GVariant *cached_bands = NULL;
+    GError   *error = NULL;
+    gboolean  found;
+
+    path = setup_cache_file ();
+    g_assert (mm_identity_cache_setup (path, &error));
+    g_assert_no_error (error);
+
+    modes = g_variant_ref_sink (g_variant_new_parsed ("[(uint32 14, uint32 8), (uint32 14, uint32 4), (uint32 12, uint32 0)]"));
+    bands = g_variant_ref_sink (g_variant_new_parsed ("[uint32 31, 32, 33, 121]"));
+
+    found = mm_identity_cache_lookup_modem (TEST_IMEI, TEST_REVISION, &cached_modes, &cached_bands);
+    g_assert (!found);
+
+    mm_identity_cache_store_modem (TEST_IMEI, TEST_REVISION, modes, bands);
+
+    /* Reload from disk */
+    g_assert (mm_identity_cache_setup (path, &error));
+    g_assert_no_error (error);
+
+    found = mm_identity_cache_lookup_modem (TEST_IMEI, TEST_REVISION, &cached_modes, &cached_bands);
+    g_assert (found);
+    g_assert (g_variant_equal (modes, cached_modes));
+    g_assert (g_variant_equal (bands, cached_bands));
+    g_variant_unref (cached_modes);
+    g_variant_unref (cached_bands);
+
+    /* A different firmware revision is a different entry */
+    found = mm_identity_cache_lookup_modem (TEST_IMEI, "SWI9X30C_02.30.01.01", &cached_modes, &cached_bands);
+    g_assert (!found);
+
+    g_variant_unref (modes);
+    g_variant_unref (bands);
+    cleanup_cache_file (path);
+}
+
+static void
+test_sim (void)
+{
+    gchar    *path;
+    gchar    *imsi = NULL;
+    gchar    *operator_identifier = NULL;
+    gchar    *operator_name = NULL;
+    GError   *error = NULL;
+    gboolean  found;
+
+    path = setup_cache_file ();
+    g_assert (mm_identity_cache_setup (path, &error));
+    g_assert_no_error (error);
+
+    /* Incomplete information is not stored */
+    mm_identity_cache_store_sim (TEST_IMEI, TEST_ICCID, NULL, "21401", NULL);
+    found = mm_identity_cache_lookup_sim (TEST_IMEI, TEST_ICCID, &imsi, &operator_identifier, &operator_name);
+    g_assert (!found);
+
+    mm_identity_cache_store_sim (TEST_IMEI, TEST_ICCID, "214010123456789", "21401", NULL);
+
+    /* Reload from disk */
+    g_assert (mm_identity_cache_setup (path, &error));
+    g_assert_no_error (error);
+
+    found = mm_identity_cache_lookup_sim (TEST_IMEI, TEST_ICCID, &imsi, &operator_identifier, &operator_name);
+    g_assert (found);
+    g_assert_cmpstr (imsi, ==, "214010123456789");
+    g_assert_cmpstr (operator_identifier, ==, "21401");
+    g_assert (operator_name == NULL);
+    g_free (imsi);
+    g_free (operator_identifier);
+
+    /* Same SIM in a different modem is a different entry */
+    found = mm_identity_cache_lookup_sim ("359880000000000", TEST_ICCID, &imsi, &operator_identifier, &operator_name);
+    g_assert (!found);
+
+    cleanup_cache_file (path);
+}
+
+static void
+test_carrier_configs (void)
+{
+    gchar    *path;
+    GVariant *configs;
+    GVariant *cached_configs = NULL;
+    GError   *error = NULL;
+    gboolean  found;
+
+    path = setup_cache_file ();
+    g_assert (mm_identity_cache_setup (path, &error));
+    g_assert_no_error (error);
+
+    configs = g_variant_ref_sink (g_variant_new_parsed ("[([byte 0x01, 0x02, 0x03], uint32 0, uint32 0x05010820, uint32 40124, 'VoLTE-ATT'), "
+                                                        " ([byte 0x04, 0x05], uint32 0, uint32 0x05800D32, uint32 35678, 'ROW_Generic')]"));
+
+    found = mm_identity_cache_lookup_carrier_configs (TEST_IMEI, TEST_REVISION, "1234abcd", &cached_configs);
+    g_assert (!found);
+
+    mm_identity_cache_store_carrier_configs (TEST_IMEI, TEST_REVISION, "1234abcd", configs);
+
+    /* Reload from disk */
+    g_assert (mm_identity_cache_setup (path, &error));
+    g_assert_no_error (error);
+
+    found = mm_identity_cache_lookup_carrier_configs (TEST_IMEI, TEST_REVISION, "1234abcd", &cached_configs);
+    g_assert (found);
+    g_assert (g_variant_equal (configs, cached_configs));
+    g_variant_unref (cached_configs);
+
+    /* A different list of configs is a different entry */
+    found = mm_identity_cache_lookup_carrier_configs (TEST_IMEI, TEST_REVISION, "5678ef01", &cached_configs);
+    g_assert (!found);
+
+    g_variant_unref (configs);
+    cleanup_cache_file (path);
+}
+
+static void
+test_version_mismatch (void)
+{
+    gchar    *path;
+    gchar    *imsi = NULL;
+    gchar    *operator_identifier = NULL;
+    gchar    *operator_name = NULL;
+    gchar    *contents;
+    GError   *error = NULL;
+    gboolean  found;
+
+    path = setup_cache_file ();
+    g_assert (mm_identity_cache_setup (path, &error));
+    g_assert_no_error (error);
+    mm_identity_cache_store_sim (TEST_IMEI, TEST_ICCID, "214010123456789", NULL, NULL);
+    mm_identity_cache_shutdown ();
+
+    /* Pretend the cache was written by a different version */
+    g_assert (g_file_get_contents (path, &contents, NULL, NULL));
+    g_assert (strstr (contents, "version=1") != NULL);
+    memcpy (strstr (contents, "version=1"), "version=0", strlen ("version=0"));
+    g_assert (g_file_set_contents (path, contents, -1, NULL));
+    g_free (contents);
+
+    g_assert (mm_identity_cache_setup (path, &error));
+    g_assert_no_error (error);
+    found = mm_identity_cache_lookup_sim (TEST_IMEI, TEST_ICCID, &imsi, &operator_identifier, &operator_name);
+    g_assert (!found);
+
+    cleanup_cache_file (path);
+}
+
+static void
+test_delayed_write (void)
+{
+    gchar    *path;
+    gchar    *imsi = NULL;
+    gchar    *operator_identifier = NULL;
+    gchar    *operator_name = NULL;
+    GError   *error = NULL;
+    GStatBuf  st;
+    gboolean  found;
+
+    path = setup_cache_file ();
+    g_assert (mm_identity_cache_setup (path, &error));
+    g_assert_no_error (error);
+
+    /* Stores are not written right away */
+    mm_identity_cache_store_sim (TEST_IMEI, TEST_ICCID, "214010123456789", "21401", NULL);
+    mm_identity_cache_store_sim ("359880000000000", TEST_ICCID, "214010123456789", "21401", NULL);
+    g_assert (!g_file_test (path, G_FILE_TEST_EXISTS));
+
+    /* But never lost on shutdown */
+    mm_identity_cache_shutdown ();
+    g_assert (g_stat (path, &st) == 0);
+    g_assert_cmpuint (st.st_mode & 0777, ==, 0600);
+
+    g_assert (mm_identity_cache_setup (path, &error));
+    g_assert_no_error (error);
+    found = mm_identity_cache_lookup_sim ("359880000000000", TEST_ICCID, &imsi, &operator_identifier, &operator_name);
+    g_assert (found);
+    g_assert_cmpstr (imsi, ==, "214010123456789");
+    g_free (imsi);
+    g_free (operator_identifier);
+
+    cleanup_cache_file (path);
+}
+
+/**************************************************************/
+
+void
+_mm_log (const char *loc,
+         const char *func,
+         guint32 level,
+         const char *fmt,
+         ...)
+{
+#if defined ENABLE_TEST_MESSAGE_TRACES
+    /* Dummy log function */
+    va_list args;
+    gchar *msg;
+
+    va_start (args, fmt);
+    msg = g_strdup_vprintf (fmt, args);
+    va_end (args);
+    g_print ("%s\n", msg);
+    g_free (msg);
+#endif
+}
+
+int main (int argc, char **argv)
+{
+    setlocale (LC_ALL, "");
+
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/MM/identity-cache/modem",            test_modem);
+    g_test_add_func ("/MM/identity-cache/sim",              test_sim);
+    g_test_add_func ("/MM/identity-cache/carrier-configs",  test_carrier_configs);
+    g_test_add_func ("/MM/identity-cache/version-mismatch", test_version_mismatch);
+    g_test_add_func ("/MM/identity-cache/delayed-write",    test_delayed_write);
+
+    return g_test_run ();
+}
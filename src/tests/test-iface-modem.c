@@ -0,0 +1,446 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <locale.h>
+
+#include <ModemManager.h>
+#define _LIBMM_INSIDE_MM
+#include <libmm-glib.h>
+
+#include "mm-broadband-modem.h"
+#include "mm-iface-modem.h"
+#include "mm-identity-cache.h"
+#include "mm-kernel-device-generic.h"
+#include "mm-log.h"
+
+#define TEST_IMEI     "359881234567890"
+#define TEST_REVISION "SWI9X30C_02.24.05.06"
+
+/*****************************************************************************/
+/* Fake modem: all the generic AT-based loaders are removed, and only the ones
+ * needed to exercise the identity cache are implemented, with canned results */
+
+static const MMModemModeCombination fake_supported_modes[] = {
+    { MM_MODEM_MODE_3G | MM_MODEM_MODE_4G, MM_MODEM_MODE_NONE },
+    { MM_MODEM_MODE_4G,                    MM_MODEM_MODE_NONE },
+};
+
+static struct {
+    const MMModemBand *supported_bands; /* NULL to fail loading them */
+    guint              n_supported_bands;
+    guint              n_supported_modes_loads;
+    guint              n_supported_bands_loads;
+} fake;
+
+typedef MMBroadbandModem      TestModem;
+typedef MMBroadbandModemClass TestModemClass;
+
+static void iface_modem_init (MMIfaceModem *iface);
+
+G_DEFINE_TYPE_EXTENDED (TestModem, test_modem, MM_TYPE_BROADBAND_MODEM, 0,
+                        G_IMPLEMENT_INTERFACE (MM_TYPE_IFACE_MODEM, iface_modem_init))
+
+static MMModemCapability
+load_current_capabilities_finish (MMIfaceModem  *self,
+                                  GAsyncResult  *res,
+                                  GError       **error)
+{
+    return (MMModemCapability) g_task_propagate_int (G_TASK (res), error);
+}
+
+static void
+load_current_capabilities (MMIfaceModem        *self,
+                           GAsyncReadyCallback  callback,
+                           gpointer             user_data)
+{
+    GTask *task;
+
+    task = g_task_new (self, NULL, callback, user_data);
+    g_task_return_int (task, MM_MODEM_CAPABILITY_GSM_UMTS | MM_MODEM_CAPABILITY_LTE);
+    g_object_unref (task);
+}
+
+static gchar *
+load_string_finish (MMIfaceModem  *self,
+                    GAsyncResult  *res,
+                    GError       **error)
+{
+    return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+static void
+load_revision (MMIfaceModem        *self,
+               GAsyncReadyCallback  callback,
+               gpointer             user_data)
+{
+    GTask *task;
+
+    task = g_task_new (self, NULL, callback, user_data);
+    g_task_return_pointer (task, g_strdup (TEST_REVISION), g_free);
+    g_object_unref (task);
+}
+
+static void
+load_equipment_identifier (MMIfaceModem        *self,
+                           GAsyncReadyCallback  callback,
+                           gpointer             user_data)
+{
+    GTask *task;
+
+    task = g_task_new (self, NULL, callback, user_data);
+    g_task_return_pointer (task, g_strdup (TEST_IMEI), g_free);
+    g_object_unref (task);
+}
+
+static GArray *
+load_array_finish (MMIfaceModem  *self,
+                   GAsyncResult  *res,
+                   GError       **error)
+{
+    return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+static void
+load_supported_modes (MMIfaceModem        *self,
+                      GAsyncReadyCallback  callback,
+                      gpointer             user_data)
+{
+    GTask  *task;
+    GArray *combinations;
+
+    fake.n_supported_modes_loads++;
+
+    combinations = g_array_sized_new (FALSE, FALSE, sizeof (MMModemModeCombination), G_N_ELEMENTS (fake_supported_modes));
+    g_array_append_vals (combinations, fake_supported_modes, G_N_ELEMENTS (fake_supported_modes));
+
+    task = g_task_new (self, NULL, callback, user_data);
+    g_task_return_pointer (task, combinations, (GDestroyNotify) g_array_unref);
+    g_object_unref (task);
+}
+
+static void
+load_supported_bands (MMIfaceModem        *self,
+                      GAsyncReadyCallback  callback,
+                      gpointer             user_data)
+{
+    GTask  *task;
+    GArray *bands;
+
+    fake.n_supported_bands_loads++;
+
+    task = g_task_new (self, NULL, callback, user_data);
+    if (!fake.supported_bands) {
+        g_task_return_new_error (task, MM_CORE_ERROR, MM_CORE_ERROR_UNSUPPORTED,
+                                 "Loading supported bands is not supported");
+        g_object_unref (task);
+        return;
+    }
+
+    bands = g_array_sized_new (FALSE, FALSE, sizeof (MMModemBand), fake.n_supported_bands);
+    g_array_append_vals (bands, fake.supported_bands, fake.n_supported_bands);
+    g_task_return_pointer (task, bands, (GDestroyNotify) g_array_unref);
+    g_object_unref (task);
+}
+
+static void
+test_modem_init (TestModem *self)
+{
+}
+
+static void
+iface_modem_init (MMIfaceModem *iface)
+{
+    /* Drop everything inherited from the generic modem */
+    memset ((guint8 *) iface + sizeof (GTypeInterface), 0, sizeof (MMIfaceModem) - sizeof (GTypeInterface));
+
+    iface->load_current_capabilities = load_current_capabilities;
+    iface->load_current_capabilities_finish = load_current_capabilities_finish;
+    iface->load_revision = load_revision;
+    iface->load_revision_finish = load_string_finish;
+    iface->load_equipment_identifier = load_equipment_identifier;
+    iface->load_equipment_identifier_finish = load_string_finish;
+    iface->load_supported_modes = load_supported_modes;
+    iface->load_supported_modes_finish = load_array_finish;
+    iface->load_supported_bands = load_supported_bands;
+    iface->load_supported_bands_finish = load_array_finish;
+}
+
+static void
+test_modem_class_init (TestModemClass *klass)
+{
+}
+
+/*****************************************************************************/
+
+static MMBaseModem *
+test_modem_new (void)
+{
+    MMBaseModem             *modem;
+    MMKernelEventProperties *properties;
+    MMKernelDevice          *kernel_device;
+    GError                  *error = NULL;
+    const gchar             *drivers[] = { "virtual", NULL };
+
+    modem = g_object_new (test_modem_get_type (),
+                          MM_BASE_MODEM_DEVICE,     "/virtual/test",
+                          MM_BASE_MODEM_DRIVERS,    drivers,
+                          MM_BASE_MODEM_PLUGIN,     "test",
+                          MM_BASE_MODEM_VENDOR_ID,  0,
+                          MM_BASE_MODEM_PRODUCT_ID, 0,
+                          MM_IFACE_MODEM_IDENTITY_CACHE_SUPPORTED, TRUE,
+                          NULL);
+
+    properties = mm_kernel_event_properties_new ();
+    mm_kernel_event_properties_set_action (properties, "add");
+    mm_kernel_event_properties_set_subsystem (properties, "virtual");
+    mm_kernel_event_properties_set_name (properties, "test0");
+    kernel_device = mm_kernel_device_generic_new_with_rules (properties, NULL, &error);
+    g_assert_no_error (error);
+    g_object_unref (properties);
+
+    g_assert (mm_base_modem_grab_port (modem, kernel_device, MM_PORT_TYPE_AT, MM_PORT_SERIAL_AT_FLAG_NONE, &error));
+    g_assert_no_error (error);
+    g_object_unref (kernel_device);
+
+    g_assert (mm_base_modem_organize_ports (modem, &error));
+    g_assert_no_error (error);
+
+    return modem;
+}
+
+static void
+initialize_ready (MMIfaceModem *self,
+                  GAsyncResult *res,
+                  gboolean     *done)
+{
+    GError *error = NULL;
+
+    g_assert (mm_iface_modem_initialize_finish (self, res, &error));
+    g_assert_no_error (error);
+    *done = TRUE;
+}
+
+static MmGdbusModem *
+test_modem_initialize (MMBaseModem *modem)
+{
+    MmGdbusModem *skeleton = NULL;
+    gboolean      done = FALSE;
+
+    mm_iface_modem_initialize (MM_IFACE_MODEM (modem), NULL, (GAsyncReadyCallback) initialize_ready, &done);
+    while (!done)
+        g_main_context_iteration (NULL, TRUE);
+
+    g_object_get (modem,
+                  MM_IFACE_MODEM_DBUS_SKELETON, &skeleton,
+                  NULL);
+    g_assert (skeleton);
+    return skeleton;
+}
+
+/* Lets the background refresh triggered by a cache hit finish */
+static void
+run_pending (void)
+{
+    while (g_main_context_pending (NULL))
+        g_main_context_iteration (NULL, FALSE);
+}
+
+static void
+assert_bands (GVariant          *variant,
+              const MMModemBand *expected,
+              guint              n_expected)
+{
+    GArray *bands;
+    guint   i;
+
+    bands = mm_common_bands_variant_to_garray (variant);
+    g_assert_cmpuint (bands->len, ==, n_expected);
+    for (i = 0; i < n_expected; i++)
+        g_assert_cmpuint (g_array_index (bands, MMModemBand, i), ==, expected[i]);
+    g_array_unref (bands);
+}
+
+static gchar *
+setup_cache_file (void)
+{
+    gchar  *dir;
+    gchar  *path;
+    GError *error = NULL;
+
+    dir = g_dir_make_tmp ("mm-iface-modem-XXXXXX", &error);
+    g_assert_no_error (error);
+    path = g_build_filename (dir, "identity-cache", NULL);
+    g_free (dir);
+
+    g_assert (mm_identity_cache_setup (path, &error));
+    g_assert_no_error (error);
+    return path;
+}
+
+static void
+cleanup_cache_file (gchar *path)
+{
+    gchar *dir;
+
+    mm_identity_cache_shutdown ();
+    dir = g_path_get_dirname (path);
+    g_unlink (path);
+    g_rmdir (dir);
+    g_free (dir);
+    g_free (path);
+}
+
+/*****************************************************************************/
+
+static void
+test_identity_cache_modes_and_bands (void)
+{
+    static const MMModemBand bands[]         = { MM_MODEM_BAND_EUTRAN_1, MM_MODEM_BAND_EUTRAN_3 };
+    static const MMModemBand updated_bands[] = { MM_MODEM_BAND_EUTRAN_1, MM_MODEM_BAND_EUTRAN_3, MM_MODEM_BAND_EUTRAN_7 };
+    gchar        *path;
+    MMBaseModem  *modem;
+    MmGdbusModem *skeleton;
+    GVariant     *cached_modes = NULL;
+    GVariant     *cached_bands = NULL;
+
+    path = setup_cache_file ();
+
+    /* First time: everything loaded from the modem and stored */
+    memset (&fake, 0, sizeof (fake));
+    fake.supported_bands = bands;
+    fake.n_supported_bands = G_N_ELEMENTS (bands);
+
+    modem = test_modem_new ();
+    skeleton = test_modem_initialize (modem);
+    g_assert_cmpuint (fake.n_supported_modes_loads, ==, 1);
+    g_assert_cmpuint (fake.n_supported_bands_loads, ==, 1);
+    assert_bands (mm_gdbus_modem_get_supported_bands (skeleton), bands, G_N_ELEMENTS (bands));
+
+    g_assert (mm_identity_cache_lookup_modem (TEST_IMEI, TEST_REVISION, &cached_modes, &cached_bands));
+    g_assert (g_variant_equal (cached_modes, mm_gdbus_modem_get_supported_modes (skeleton)));
+    g_assert (g_variant_equal (cached_bands, mm_gdbus_modem_get_supported_bands (skeleton)));
+    g_variant_unref (cached_modes);
+    g_variant_unref (cached_bands);
+
+    g_object_unref (skeleton);
+    g_object_unref (modem);
+
+    /* Same modem again, after a change in the reported bands: initialization
+     * completes with the cached values, fixed by the background refresh */
+    memset (&fake, 0, sizeof (fake));
+    fake.supported_bands = updated_bands;
+    fake.n_supported_bands = G_N_ELEMENTS (updated_bands);
+
+    modem = test_modem_new ();
+    skeleton = test_modem_initialize (modem);
+    assert_bands (mm_gdbus_modem_get_supported_bands (skeleton), bands, G_N_ELEMENTS (bands));
+
+    run_pending ();
+    g_assert_cmpuint (fake.n_supported_modes_loads, ==, 1);
+    g_assert_cmpuint (fake.n_supported_bands_loads, ==, 1);
+    assert_bands (mm_gdbus_modem_get_supported_bands (skeleton), updated_bands, G_N_ELEMENTS (updated_bands));
+
+    g_assert (mm_identity_cache_lookup_modem (TEST_IMEI, TEST_REVISION, NULL, &cached_bands));
+    assert_bands (cached_bands, updated_bands, G_N_ELEMENTS (updated_bands));
+    g_variant_unref (cached_bands);
+
+    g_object_unref (skeleton);
+    g_object_unref (modem);
+
+    cleanup_cache_file (path);
+}
+
+static void
+test_identity_cache_modes_only (void)
+{
+    gchar        *path;
+    MMBaseModem  *modem;
+    MmGdbusModem *skeleton;
+    GVariant     *cached_modes = NULL;
+    GVariant     *cached_bands = NULL;
+
+    path = setup_cache_file ();
+
+    /* Supported bands cannot be loaded, only the modes are stored */
+    memset (&fake, 0, sizeof (fake));
+
+    modem = test_modem_new ();
+    skeleton = test_modem_initialize (modem);
+    g_assert_cmpuint (fake.n_supported_modes_loads, ==, 1);
+    g_assert_cmpuint (fake.n_supported_bands_loads, ==, 1);
+
+    g_assert (mm_identity_cache_lookup_modem (TEST_IMEI, TEST_REVISION, &cached_modes, &cached_bands));
+    g_assert (cached_modes);
+    g_assert (!cached_bands);
+    g_assert (g_variant_equal (cached_modes, mm_gdbus_modem_get_supported_modes (skeleton)));
+    g_variant_unref (cached_modes);
+
+    g_object_unref (skeleton);
+    g_object_unref (modem);
+
+    /* Same modem again: the modes are only loaded by the background refresh,
+     * the bands are loaded during initialization and never refreshed */
+    memset (&fake, 0, sizeof (fake));
+
+    modem = test_modem_new ();
+    skeleton = test_modem_initialize (modem);
+    g_assert_cmpuint (fake.n_supported_bands_loads, ==, 1);
+
+    run_pending ();
+    g_assert_cmpuint (fake.n_supported_modes_loads, ==, 1);
+    g_assert_cmpuint (fake.n_supported_bands_loads, ==, 1);
+
+    g_object_unref (skeleton);
+    g_object_unref (modem);
+
+    cleanup_cache_file (path);
+}
+
+/*****************************************************************************/
+
+void
+_mm_log (const char *loc,
+         const char *func,
+         guint32 level,
+         const char *fmt,
+         ...)
+{
+#if defined ENABLE_TEST_MESSAGE_TRACES
+    /* Dummy log function */
+    va_list args;
+    gchar *msg;
+
+    va_start (args, fmt);
+    msg = g_strdup_vprintf (fmt, args);
+    va_end (args);
+    g_print ("%s\n", msg);
+    g_free (msg);
+#endif
+}
+
+int main (int argc, char **argv)
+{
+    setlocale (LC_ALL, "");
+
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/MM/iface-modem/identity-cache/modes-and-bands", test_identity_cache_modes_and_bands);
+    g_test_add_func ("/MM/iface-modem/identity-cache/modes-only",      test_identity_cache_modes_only);
+
+    return g_test_run ();
+}
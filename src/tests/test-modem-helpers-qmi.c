@@ -14,6 +14,7 @@
  */
 
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <glib-object.h>
 #include <string.h>
 #include <stdlib.h>
@@ -21,6 +22,7 @@
 
 #include "mm-enums-types.h"
 #include "mm-modem-helpers-qmi.h"
+#include "mm-identity-cache.h"
 #include "mm-log.h"
 
 static void
@@ -307,6 +309,122 @@ test_gobi3k_cdma (void)
     test_capabilities_expected (&ctx, MM_MODEM_CAPABILITY_CDMA_EVDO);
 }
 
+/*****************************************************************************/
+/* Carrier config list, with details from the identity cache */
+
+#define TEST_IMEI     "359881234567890"
+#define TEST_REVISION "SWI9X30C_02.24.05.06"
+
+static GArray *
+build_list_configs (guint n_configs)
+{
+    GArray *configs;
+    guint   i;
+
+    configs = g_array_new (FALSE, TRUE, sizeof (QmiIndicationPdcListConfigsOutputConfigsElement));
+    for (i = 0; i < n_configs; i++) {
+        QmiIndicationPdcListConfigsOutputConfigsElement element;
+        guint8                                          id[4] = { 0x05, 0x01, 0x08, i };
+
+        element.config_type = QMI_PDC_CONFIGURATION_TYPE_SOFTWARE;
+        element.id = g_array_new (FALSE, FALSE, sizeof (guint8));
+        g_array_append_vals (element.id, id, sizeof (id));
+        g_array_append_val (configs, element);
+    }
+    return configs;
+}
+
+static void
+free_list_configs (GArray *configs)
+{
+    guint i;
+
+    for (i = 0; i < configs->len; i++)
+        g_array_unref (g_array_index (configs, QmiIndicationPdcListConfigsOutputConfigsElement, i).id);
+    g_array_unref (configs);
+}
+
+static void
+test_config_list_identity_cache (void)
+{
+    gchar           *dir;
+    gchar           *path;
+    GError          *error = NULL;
+    GArray          *configs;
+    GArray          *config_list;
+    gchar           *list_hash = NULL;
+    gboolean         from_cache = FALSE;
+    guint            token = 1;
+    guint            i;
+    MMQmiConfigInfo *config;
+
+    dir = g_dir_make_tmp ("mm-modem-helpers-qmi-XXXXXX", &error);
+    g_assert_no_error (error);
+    path = g_build_filename (dir, "identity-cache", NULL);
+    g_assert (mm_identity_cache_setup (path, &error));
+    g_assert_no_error (error);
+
+    configs = build_list_configs (3);
+
+    /* Not known yet: details need to be loaded from the modem */
+    config_list = mm_qmi_config_list_new (configs, TEST_IMEI, TEST_REVISION, &token, &list_hash, &from_cache);
+    g_assert (!from_cache);
+    g_assert (list_hash);
+    g_assert_cmpuint (config_list->len, ==, 3);
+    g_assert_cmpuint (token, ==, 4);
+    for (i = 0; i < config_list->len; i++) {
+        config = &g_array_index (config_list, MMQmiConfigInfo, i);
+        g_assert_cmpuint (config->token, ==, i + 1);
+        g_assert (!config->description);
+        config->version = 0x05010800 + i;
+        config->total_size = 1000 + i;
+        config->description = g_strdup_printf ("config-%u", i);
+    }
+    mm_qmi_config_list_store (config_list, TEST_IMEI, TEST_REVISION, list_hash);
+    g_array_unref (config_list);
+    g_clear_pointer (&list_hash, g_free);
+
+    /* Same list again: details taken from the cache */
+    config_list = mm_qmi_config_list_new (configs, TEST_IMEI, TEST_REVISION, &token, &list_hash, &from_cache);
+    g_assert (from_cache);
+    g_assert_cmpuint (config_list->len, ==, 3);
+    for (i = 0; i < config_list->len; i++) {
+        gchar *description;
+
+        config = &g_array_index (config_list, MMQmiConfigInfo, i);
+        description = g_strdup_printf ("config-%u", i);
+        g_assert_cmpstr (config->description, ==, description);
+        g_assert_cmpuint (config->version, ==, 0x05010800 + i);
+        g_assert_cmpuint (config->total_size, ==, 1000 + i);
+        g_free (description);
+    }
+    g_array_unref (config_list);
+    g_clear_pointer (&list_hash, g_free);
+
+    /* Modems without IMEI don't use the cache */
+    config_list = mm_qmi_config_list_new (configs, "", TEST_REVISION, &token, &list_hash, &from_cache);
+    g_assert (!from_cache);
+    g_assert (!list_hash);
+    g_array_unref (config_list);
+
+    free_list_configs (configs);
+
+    /* A new config installed: details need to be loaded again */
+    configs = build_list_configs (4);
+    config_list = mm_qmi_config_list_new (configs, TEST_IMEI, TEST_REVISION, &token, &list_hash, &from_cache);
+    g_assert (!from_cache);
+    g_assert (list_hash);
+    g_array_unref (config_list);
+    g_clear_pointer (&list_hash, g_free);
+    free_list_configs (configs);
+
+    mm_identity_cache_shutdown ();
+    g_unlink (path);
+    g_rmdir (dir);
+    g_free (path);
+    g_free (dir);
+}
+
 /*****************************************************************************/
 
 void
@@ -344,5 +462,7 @@ int main (int argc, char **argv)
     g_test_add_func ("/MM/QMI/Current-Capabilities/Gobi3k/GSM",  test_gobi3k_gsm);
     g_test_add_func ("/MM/QMI/Current-Capabilities/Gobi3k/CDMA", test_gobi3k_cdma);
 
+    g_test_add_func ("/MM/QMI/Carrier-Config/List/Identity-Cache", test_config_list_identity_cache);
+
     return g_test_run ();
 }
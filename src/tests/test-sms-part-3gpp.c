@@ -68,8 +68,12 @@ common_test_part_from_hexpdu (const gchar *hexpdu,
         g_assert_cmpstr (expected_number, ==, mm_sms_part_get_number (part));
     if (expected_timestamp)
         g_assert_cmpstr (expected_timestamp, ==, mm_sms_part_get_timestamp (part));
-    if (expected_text)
+    if (expected_text) {
+        /* Text is decoded on demand, and then kept */
+        g_assert (mm_sms_part_has_text (part));
         g_assert_cmpstr (expected_text, ==, mm_sms_part_get_text (part));
+        g_assert (mm_sms_part_get_text (part) == mm_sms_part_get_text (part));
+    }
     g_assert_cmpuint (expected_multipart, ==, mm_sms_part_should_concat (part));
 
     if (expected_data) {
@@ -0,0 +1,1012 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ *
+ * Copyright (C) 2019 The ModemManager authors
+ */
+
+/*
+ * Virtual modem load generator.
+ *
+ * Spawns N virtual AT modems served over abstract unix sockets, registers
+ * them in the daemon through the Test interface (the daemon must be running
+ * with --test-enable), enables them all, and keeps them generating
+ * unsolicited messages at the configured rates while periodically reporting
+ * daemon CPU and memory usage, time-to-enabled, D-Bus signal rates and the
+ * latency between each +CREG message and the registration state update.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib-unix.h>
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+#include <libmm-glib.h>
+
+#include "mm-gdbus-test.h"
+
+#define PROGRAM_NAME    "mmloadgen"
+#define PROGRAM_VERSION PACKAGE_VERSION
+
+#define BUFFER_SIZE 1024
+
+/* Context */
+static gint      n_modems         = 16;
+static gchar    *plugin_str;
+static gchar    *profile_str;
+static gint      creg_interval_ms = 5000;
+static gint      csq_interval_ms  = 2000;
+static gint      cmti_interval_ms;
+static gint      report_interval  = 5;
+static gint      duration;
+static gboolean  no_enable_flag;
+static gboolean  session_flag;
+static gboolean  version_flag;
+
+static GOptionEntry main_entries[] = {
+    { "modems", 'n', 0, G_OPTION_ARG_INT, &n_modems,
+      "Number of virtual modems to create (default: 16)",
+      "[N]"
+    },
+    { "plugin", 'p', 0, G_OPTION_ARG_STRING, &plugin_str,
+      "Plugin to use for the virtual modems (default: Generic)",
+      "[PLUGIN]"
+    },
+    { "profile", 'f', 0, G_OPTION_ARG_FILENAME, &profile_str,
+      "File with the AT command/response table to use",
+      "[FILE]"
+    },
+    { "creg-interval", 0, 0, G_OPTION_ARG_INT, &creg_interval_ms,
+      "Interval between +CREG unsolicited messages, in ms (default: 5000, 0 disables)",
+      "[MS]"
+    },
+    { "csq-interval", 0, 0, G_OPTION_ARG_INT, &csq_interval_ms,
+      "Interval between +CSQ unsolicited messages, in ms (default: 2000, 0 disables)",
+      "[MS]"
+    },
+    { "cmti-interval", 0, 0, G_OPTION_ARG_INT, &cmti_interval_ms,
+      "Interval between +CMTI unsolicited messages, in ms (default: 0, disabled)",
+      "[MS]"
+    },
+    { "report-interval", 'r', 0, G_OPTION_ARG_INT, &report_interval,
+      "Interval between reports, in seconds (default: 5)",
+      "[SECONDS]"
+    },
+    { "duration", 'd', 0, G_OPTION_ARG_INT, &duration,
+      "Stop after the given number of seconds (default: 0, run until interrupted)",
+      "[SECONDS]"
+    },
+    { "no-enable", 0, 0, G_OPTION_ARG_NONE, &no_enable_flag,
+      "Don't enable the modems once exported",
+      NULL
+    },
+    { "session", 0, 0, G_OPTION_ARG_NONE, &session_flag,
+      "Use the session bus instead of the system bus",
+      NULL
+    },
+    { "version", 'V', 0, G_OPTION_ARG_NONE, &version_flag,
+      "Print version",
+      NULL
+    },
+    { NULL }
+};
+
+/* Default command table, same format as plugins/tests/gsm-port.conf. The
+ * AT+CREG?, AT+CGREG? and AT+CSQ responses are built from the per-modem
+ * state instead, so that they are consistent with the unsolicited messages. */
+static const gchar *default_commands[][2] = {
+    { "AT",                  "\\r\\nOK\\r\\n" },
+    { "ATE0",                "\\r\\nOK\\r\\n" },
+    { "ATV1",                "\\r\\nOK\\r\\n" },
+    { "AT+CMEE=1",           "\\r\\nOK\\r\\n" },
+    { "ATX4",                "\\r\\nOK\\r\\n" },
+    { "AT&C1",               "\\r\\nOK\\r\\n" },
+    { "AT+IFC=1,1",          "\\r\\nOK\\r\\n" },
+    { "AT+GCAP",             "\\r\\n+GCAP: +CGSM +DS +ES\\r\\n\\r\\nOK\\r\\n" },
+    { "ATI",                 "\\r\\nManufacturer: Virtual vendor\\r\\nModel: Virtual model\\r\\nRevision: Virtual revision\\r\\n\\r\\nOK\\r\\n" },
+    { "AT+WS46=?",           "\\r\\n+WS46: (12,22)\\r\\n\\r\\nOK\\r\\n" },
+    { "AT+CGMI",             "\\r\\nVirtual vendor\\r\\n\\r\\nOK\\r\\n" },
+    { "AT+CGMM",             "\\r\\nVirtual model\\r\\n\\r\\nOK\\r\\n" },
+    { "AT+CGMR",             "\\r\\nVirtual revision\\r\\n\\r\\nOK\\r\\n" },
+    { "AT+CIMI",             "\\r\\n998899889988997\\r\\n\\r\\nOK\\r\\n" },
+    { "AT+CLCK=?",           "\\r\\n+CLCK: (\"SC\",\"FD\",\"PS\")\\r\\n\\r\\nOK\\r\\n" },
+    { "AT+CLCK=\"SC\",2",    "\\r\\n+CLCK: 0\\r\\n\\r\\nOK\\r\\n" },
+    { "AT+CLCK=\"FD\",2",    "\\r\\n+CLCK: 0\\r\\n\\r\\nOK\\r\\n" },
+    { "AT+CLCK=\"PS\",2",    "\\r\\n+CLCK: 0\\r\\n\\r\\nOK\\r\\n" },
+    { "AT+CFUN?",            "\\r\\n+CFUN: 1\\r\\n\\r\\nOK\\r\\n" },
+    { "AT+CFUN=1",           "\\r\\nOK\\r\\n" },
+    { "AT+CFUN=4",           "\\r\\nOK\\r\\n" },
+    { "AT+CSCS=?",           "\\r\\n+CSCS: (\"IRA\",\"GSM\")\\r\\n\\r\\nOK\\r\\n" },
+    { "AT+CSCS=\"GSM\"",     "\\r\\nOK\\r\\n" },
+    { "AT+CSCS?",            "\\r\\n+CSCS: \"GSM\"\\r\\n\\r\\nOK\\r\\n" },
+    { "AT+CREG=2",           "\\r\\nOK\\r\\n" },
+    { "AT+CGREG=2",          "\\r\\nOK\\r\\n" },
+    { "AT+CREG=0",           "\\r\\nOK\\r\\n" },
+    { "AT+CGREG=0",          "\\r\\nOK\\r\\n" },
+    { "AT+COPS=3,2;+COPS?",  "\\r\\n+COPS: 0,2,\"21401\",2\\r\\n\\r\\nOK\\r\\n" },
+    { "AT+COPS=3,0;+COPS?",  "\\r\\n+COPS: 0,0,\"Virtual\"\\r\\n\\r\\nOK\\r\\n" },
+    { "AT+COPS=0",           "\\r\\nOK\\r\\n" },
+    { "AT+CPIN?",            "\\r\\n+CPIN: READY\\r\\n\\r\\nOK\\r\\n" },
+    { "AT+CMGF=?",           "\\r\\n+CMGF: (0,1)\\r\\n\\r\\nOK\\r\\n" },
+    { "AT+CMGF=0",           "\\r\\nOK\\r\\n" },
+};
+
+typedef struct _VirtualModem VirtualModem;
+
+typedef struct {
+    VirtualModem      *modem;
+    GSocketConnection *connection;
+    GSource           *readable_source;
+    GByteArray        *buffer;
+} Client;
+
+struct _VirtualModem {
+    guint           index;
+    gchar          *id;
+    gchar          *device;
+    gchar          *port;
+    GSocket        *socket;
+    GSocketService *service;
+    GList          *clients;
+
+    /* Stateful values reported both in responses and unsolicited messages */
+    guint           creg_stat;
+    guint           csq;
+    guint           cmti_index;
+
+    guint           creg_timeout_id;
+    guint           csq_timeout_id;
+    guint           cmti_timeout_id;
+
+    MMModem        *object;
+    MMModem3gpp    *object_3gpp;
+    gboolean        enable_requested;
+    gint64          creg_time;
+    gint64          registered_time;
+    gint64          enabled_time;
+};
+
+/* Globals */
+static GMainLoop       *loop;
+static GHashTable      *commands;
+static VirtualModem   **modems;
+static GHashTable      *modems_by_device;
+static MMManager       *manager;
+static MmGdbusTest     *test_proxy;
+
+/* Statistics */
+static guint            n_registered;
+static guint            n_register_failed;
+static guint            n_exported;
+static guint            n_enabled;
+static guint            n_enable_failed;
+static guint64          n_unsolicited;
+static guint64          n_commands;
+static guint64          n_signals;
+static guint64          n_signals_last;
+static guint            n_urc_latency;
+static gint64           urc_latency_total_us;
+static gint64           urc_latency_min_us;
+static gint64           urc_latency_max_us;
+static guint            daemon_pid;
+static guint64          daemon_ticks_last;
+static gint64           report_time_last;
+static gint64           start_time;
+
+static gboolean
+signals_handler (void)
+{
+    if (loop && g_main_loop_is_running (loop)) {
+        g_printerr ("%s\n",
+                    "cancelling the main loop...\n");
+        g_main_loop_quit (loop);
+    }
+    return TRUE;
+}
+
+static void
+print_version_and_exit (void)
+{
+    g_print ("\n"
+             PROGRAM_NAME " " PROGRAM_VERSION "\n"
+             "Copyright (2019) The ModemManager authors\n"
+             "License GPLv2+: GNU GPL version 2 or later <http://gnu.org/licenses/gpl-2.0.html>\n"
+             "This is free software: you are free to change and redistribute it.\n"
+             "There is NO WARRANTY, to the extent permitted by law.\n"
+             "\n");
+    exit (EXIT_SUCCESS);
+}
+
+/*****************************************************************************/
+/* Command table */
+
+static void
+commands_load_defaults (void)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (default_commands); i++)
+        g_hash_table_replace (commands,
+                              g_strdup (default_commands[i][0]),
+                              g_strcompress (default_commands[i][1]));
+}
+
+static gboolean
+commands_load_file (const gchar  *file,
+                    GError      **error)
+{
+    gchar *contents;
+    gchar *current;
+
+    if (!g_file_get_contents (file, &contents, NULL, error))
+        return FALSE;
+
+    current = contents;
+    while (current) {
+        gchar *next;
+        gchar *response;
+
+        next = strchr (current, '\n');
+        if (next) {
+            *next = '\0';
+            next++;
+        }
+
+        g_strstrip (current);
+        if (current[0] == '\0' || current[0] == '#') {
+            current = next;
+            continue;
+        }
+
+        response = strchr (current, ' ');
+        if (!response) {
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                         "Command '%s' has no response", current);
+            g_free (contents);
+            return FALSE;
+        }
+        *response++ = '\0';
+        while (*response == ' ')
+            response++;
+
+        g_hash_table_replace (commands, g_strdup (current), g_strcompress (response));
+        current = next;
+    }
+
+    g_free (contents);
+    return TRUE;
+}
+
+/*****************************************************************************/
+/* Virtual modem AT port */
+
+static void
+client_write (Client      *client,
+              const gchar *data)
+{
+    GError *error = NULL;
+
+    if (!g_output_stream_write_all (g_io_stream_get_output_stream (G_IO_STREAM (client->connection)),
+                                    data,
+                                    strlen (data),
+                                    NULL, /* bytes_written */
+                                    NULL, /* cancellable */
+                                    &error)) {
+        g_printerr ("[%s] cannot write to client: %s\n", client->modem->id, error->message);
+        g_error_free (error);
+    }
+}
+
+static void
+modem_write_unsolicited (VirtualModem *modem,
+                         const gchar  *data)
+{
+    GList *l;
+
+    for (l = modem->clients; l; l = g_list_next (l))
+        client_write ((Client *) l->data, data);
+    if (modem->clients)
+        n_unsolicited++;
+}
+
+static gchar *
+modem_build_response (VirtualModem *modem,
+                      const gchar  *command)
+{
+    const gchar *response;
+
+    if (g_str_equal (command, "AT+CREG?"))
+        return g_strdup_printf ("\r\n+CREG: 2,%u,\"1234\",\"001122BB\"\r\n\r\nOK\r\n", modem->creg_stat);
+    if (g_str_equal (command, "AT+CGREG?"))
+        return g_strdup_printf ("\r\n+CGREG: 2,%u,\"31C5\",\"0083F7CD\"\r\n\r\nOK\r\n", modem->creg_stat);
+    if (g_str_equal (command, "AT+CSQ"))
+        return g_strdup_printf ("\r\n+CSQ: %u,99\r\n\r\nOK\r\n", modem->csq);
+    if (g_str_equal (command, "AT+CGSN"))
+        return g_strdup_printf ("\r\n%015u\r\n\r\nOK\r\n", 350000000 + modem->index);
+
+    response = g_hash_table_lookup (commands, command);
+    return g_strdup (response ? response : "\r\nERROR\r\n");
+}
+
+static void
+client_parse_request (Client *client)
+{
+    while (client->buffer->len > 0) {
+        gchar *command;
+        gchar *response;
+        guint  i = 0;
+
+        /* Find command end */
+        while (i < client->buffer->len && client->buffer->data[i] != '\r' && client->buffer->data[i] != '\n')
+            i++;
+        if (i == client->buffer->len)
+            return;
+
+        command = g_strndup ((const gchar *) client->buffer->data, i);
+        while (i < client->buffer->len && (client->buffer->data[i] == '\r' || client->buffer->data[i] == '\n'))
+            i++;
+        g_byte_array_remove_range (client->buffer, 0, i);
+
+        if (command[0] != '\0') {
+            response = modem_build_response (client->modem, command);
+            client_write (client, response);
+            n_commands++;
+            g_free (response);
+        }
+        g_free (command);
+    }
+}
+
+static void
+client_free (Client *client)
+{
+    g_source_destroy (client->readable_source);
+    g_source_unref (client->readable_source);
+    g_io_stream_close (G_IO_STREAM (client->connection), NULL, NULL);
+    g_byte_array_unref (client->buffer);
+    g_object_unref (client->connection);
+    g_slice_free (Client, client);
+}
+
+static gboolean
+client_readable_cb (GSocket      *socket,
+                    GIOCondition  condition,
+                    Client       *client)
+{
+    guint8  buffer[BUFFER_SIZE];
+    GError *error = NULL;
+    gssize  r;
+
+    if (condition & (G_IO_HUP | G_IO_ERR))
+        goto close;
+
+    if (!(condition & (G_IO_IN | G_IO_PRI)))
+        return G_SOURCE_CONTINUE;
+
+    r = g_input_stream_read (g_io_stream_get_input_stream (G_IO_STREAM (client->connection)),
+                             buffer,
+                             BUFFER_SIZE,
+                             NULL,
+                             &error);
+    if (r < 0) {
+        g_printerr ("[%s] cannot read from client: %s\n", client->modem->id, error->message);
+        g_error_free (error);
+        goto close;
+    }
+    if (r == 0)
+        goto close;
+
+    g_byte_array_append (client->buffer, buffer, r);
+    client_parse_request (client);
+    return G_SOURCE_CONTINUE;
+
+close:
+    client->modem->clients = g_list_remove (client->modem->clients, client);
+    client_free (client);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+incoming_cb (GSocketService    *service,
+             GSocketConnection *connection,
+             GObject           *unused,
+             VirtualModem      *modem)
+{
+    Client *client;
+
+    client = g_slice_new0 (Client);
+    client->modem = modem;
+    client->connection = g_object_ref (connection);
+    client->buffer = g_byte_array_sized_new (BUFFER_SIZE);
+    client->readable_source = g_socket_create_source (g_socket_connection_get_socket (connection),
+                                                      G_IO_IN | G_IO_PRI | G_IO_ERR | G_IO_HUP,
+                                                      NULL);
+    g_source_set_callback (client->readable_source,
+                           (GSourceFunc) client_readable_cb,
+                           client,
+                           NULL);
+    g_source_attach (client->readable_source, NULL);
+
+    modem->clients = g_list_append (modem->clients, client);
+}
+
+/*****************************************************************************/
+/* Virtual modem unsolicited messages */
+
+static gboolean
+creg_timeout_cb (VirtualModem *modem)
+{
+    gchar *str;
+
+    /* Toggle between home and roaming, so that every message is a change */
+    modem->creg_stat = (modem->creg_stat == 1 ? 5 : 1);
+    str = g_strdup_printf ("\r\n+CREG: %u,\"1234\",\"001122BB\"\r\n", modem->creg_stat);
+    modem_write_unsolicited (modem, str);
+    modem->creg_time = g_get_monotonic_time ();
+    g_free (str);
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+csq_timeout_cb (VirtualModem *modem)
+{
+    gchar *str;
+
+    modem->csq = (guint) g_random_int_range (5, 32);
+    str = g_strdup_printf ("\r\n+CSQ: %u,99\r\n", modem->csq);
+    modem_write_unsolicited (modem, str);
+    g_free (str);
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+cmti_timeout_cb (VirtualModem *modem)
+{
+    gchar *str;
+
+    str = g_strdup_printf ("\r\n+CMTI: \"SM\",%u\r\n", modem->cmti_index++);
+    modem_write_unsolicited (modem, str);
+    g_free (str);
+    return G_SOURCE_CONTINUE;
+}
+
+static guint
+schedule_unsolicited (gint        interval_ms,
+                      GSourceFunc callback,
+                      gpointer    user_data)
+{
+    if (interval_ms <= 0)
+        return 0;
+
+    /* Add some jitter so that all modems don't fire at the same time */
+    return g_timeout_add (interval_ms + g_random_int_range (0, interval_ms / 4 + 1), callback, user_data);
+}
+
+static void
+modem_start_unsolicited (VirtualModem *modem)
+{
+    g_assert (!modem->creg_timeout_id && !modem->csq_timeout_id && !modem->cmti_timeout_id);
+
+    modem->creg_timeout_id = schedule_unsolicited (creg_interval_ms, (GSourceFunc) creg_timeout_cb, modem);
+    modem->csq_timeout_id  = schedule_unsolicited (csq_interval_ms,  (GSourceFunc) csq_timeout_cb,  modem);
+    modem->cmti_timeout_id = schedule_unsolicited (cmti_interval_ms, (GSourceFunc) cmti_timeout_cb, modem);
+}
+
+/*****************************************************************************/
+/* Virtual modem lifecycle */
+
+static void
+virtual_modem_free (VirtualModem *modem)
+{
+    if (modem->creg_timeout_id)
+        g_source_remove (modem->creg_timeout_id);
+    if (modem->csq_timeout_id)
+        g_source_remove (modem->csq_timeout_id);
+    if (modem->cmti_timeout_id)
+        g_source_remove (modem->cmti_timeout_id);
+    g_list_free_full (modem->clients, (GDestroyNotify) client_free);
+    if (modem->service) {
+        g_socket_service_stop (modem->service);
+        g_object_unref (modem->service);
+    }
+    if (modem->socket) {
+        g_socket_close (modem->socket, NULL);
+        g_object_unref (modem->socket);
+    }
+    if (modem->object_3gpp)
+        g_object_unref (modem->object_3gpp);
+    if (modem->object)
+        g_object_unref (modem->object);
+    g_free (modem->port);
+    g_free (modem->device);
+    g_free (modem->id);
+    g_slice_free (VirtualModem, modem);
+}
+
+static VirtualModem *
+virtual_modem_new (guint    index,
+                   GError **error)
+{
+    VirtualModem   *modem;
+    GSocketAddress *address;
+
+    modem = g_slice_new0 (VirtualModem);
+    modem->index = index;
+    modem->id = g_strdup_printf ("mmloadgen-%u", index);
+    modem->device = g_strdup_printf ("/virtual/%s", modem->id);
+    modem->port = g_strdup_printf ("abstract:mmloadgen%u:%ld", index, (glong) getpid ());
+    modem->creg_stat = 1;
+    modem->csq = 17;
+    modem->cmti_index = 1;
+
+    modem->socket = g_socket_new (G_SOCKET_FAMILY_UNIX,
+                                  G_SOCKET_TYPE_STREAM,
+                                  G_SOCKET_PROTOCOL_DEFAULT,
+                                  error);
+    if (!modem->socket)
+        goto failed;
+
+    address = g_unix_socket_address_new_with_type (modem->port, -1, G_UNIX_SOCKET_ADDRESS_ABSTRACT);
+    if (!g_socket_bind (modem->socket, address, TRUE, error)) {
+        g_object_unref (address);
+        goto failed;
+    }
+    g_object_unref (address);
+
+    if (!g_socket_listen (modem->socket, error))
+        goto failed;
+
+    modem->service = g_socket_service_new ();
+    g_signal_connect (modem->service, "incoming", G_CALLBACK (incoming_cb), modem);
+    if (!g_socket_listener_add_socket (G_SOCKET_LISTENER (modem->service), modem->socket, NULL, error))
+        goto failed;
+    g_socket_service_start (modem->service);
+
+    return modem;
+
+failed:
+    virtual_modem_free (modem);
+    return NULL;
+}
+
+/*****************************************************************************/
+/* Daemon interaction */
+
+static void
+modem_enable_ready (MMModem      *object,
+                    GAsyncResult *res,
+                    VirtualModem *modem)
+{
+    GError *error = NULL;
+
+    if (!mm_modem_enable_finish (object, res, &error)) {
+        g_printerr ("[%s] couldn't enable modem: %s\n", modem->id, error->message);
+        n_enable_failed++;
+        g_error_free (error);
+    }
+}
+
+static void
+modem_state_updated (MMModem      *object,
+                     GParamSpec   *pspec,
+                     VirtualModem *modem)
+{
+    MMModemState state;
+
+    state = mm_modem_get_state (object);
+
+    if (!modem->enable_requested && !no_enable_flag && state == MM_MODEM_STATE_DISABLED) {
+        modem->enable_requested = TRUE;
+        mm_modem_enable (object, NULL, (GAsyncReadyCallback) modem_enable_ready, modem);
+        return;
+    }
+
+    if (!modem->enabled_time && state >= MM_MODEM_STATE_ENABLED) {
+        modem->enabled_time = g_get_monotonic_time ();
+        n_enabled++;
+    }
+}
+
+static void
+modem_3gpp_registration_state_updated (MMModem3gpp  *object,
+                                       GParamSpec   *pspec,
+                                       VirtualModem *modem)
+{
+    MMModem3gppRegistrationState expected;
+    gint64                       latency;
+
+    /* Measure the time between the +CREG URC and the property update */
+    if (!modem->creg_time)
+        return;
+
+    expected = (modem->creg_stat == 5 ?
+                MM_MODEM_3GPP_REGISTRATION_STATE_ROAMING :
+                MM_MODEM_3GPP_REGISTRATION_STATE_HOME);
+    if (mm_modem_3gpp_get_registration_state (object) != expected)
+        return;
+
+    latency = g_get_monotonic_time () - modem->creg_time;
+    modem->creg_time = 0;
+
+    if (!n_urc_latency || latency < urc_latency_min_us)
+        urc_latency_min_us = latency;
+    if (!n_urc_latency || latency > urc_latency_max_us)
+        urc_latency_max_us = latency;
+    urc_latency_total_us += latency;
+    n_urc_latency++;
+}
+
+static void
+object_added (MMManager *_manager,
+              MMObject  *object)
+{
+    VirtualModem *modem;
+    MMModem      *modem_object;
+
+    modem_object = mm_object_get_modem (object);
+    if (!modem_object)
+        return;
+
+    modem = g_hash_table_lookup (modems_by_device, mm_modem_get_device (modem_object));
+    if (!modem || modem->object) {
+        g_object_unref (modem_object);
+        return;
+    }
+
+    modem->object = modem_object;
+    modem->object_3gpp = mm_object_get_modem_3gpp (object);
+    if (modem->object_3gpp)
+        g_signal_connect (modem->object_3gpp, "notify::registration-state",
+                          G_CALLBACK (modem_3gpp_registration_state_updated), modem);
+    n_exported++;
+    g_signal_connect (modem->object, "notify::state", G_CALLBACK (modem_state_updated), modem);
+    modem_state_updated (modem->object, NULL, modem);
+}
+
+static void
+set_profile_ready (MmGdbusTest  *proxy,
+                   GAsyncResult *res,
+                   VirtualModem *modem)
+{
+    GError *error = NULL;
+
+    if (!mm_gdbus_test_call_set_profile_finish (proxy, res, &error)) {
+        g_printerr ("[%s] couldn't register virtual modem: %s\n", modem->id, error->message);
+        n_register_failed++;
+        g_error_free (error);
+        return;
+    }
+
+    n_registered++;
+    modem_start_unsolicited (modem);
+}
+
+static void
+register_modems (void)
+{
+    gint i;
+
+    for (i = 0; i < n_modems; i++) {
+        const gchar *ports[] = { modems[i]->port, NULL };
+
+        modems[i]->registered_time = g_get_monotonic_time ();
+        mm_gdbus_test_call_set_profile (test_proxy,
+                                        modems[i]->id,
+                                        plugin_str ? plugin_str : "Generic",
+                                        ports,
+                                        NULL,
+                                        (GAsyncReadyCallback) set_profile_ready,
+                                        modems[i]);
+    }
+}
+
+static void
+signal_received (GDBusConnection *connection,
+                 const gchar     *sender_name,
+                 const gchar     *object_path,
+                 const gchar     *interface_name,
+                 const gchar     *signal_name,
+                 GVariant        *parameters,
+                 gpointer         user_data)
+{
+    n_signals++;
+}
+
+static guint
+get_daemon_pid (GDBusConnection *connection)
+{
+    GVariant *result;
+    guint     pid = 0;
+    GError   *error = NULL;
+
+    result = g_dbus_connection_call_sync (connection,
+                                          "org.freedesktop.DBus",
+                                          "/org/freedesktop/DBus",
+                                          "org.freedesktop.DBus",
+                                          "GetConnectionUnixProcessID",
+                                          g_variant_new ("(s)", MM_DBUS_SERVICE),
+                                          G_VARIANT_TYPE ("(u)"),
+                                          G_DBUS_CALL_FLAGS_NONE,
+                                          -1,
+                                          NULL,
+                                          &error);
+    if (!result) {
+        g_printerr ("warning: couldn't get daemon process id: %s\n", error->message);
+        g_error_free (error);
+        return 0;
+    }
+
+    g_variant_get (result, "(u)", &pid);
+    g_variant_unref (result);
+    return pid;
+}
+
+/*****************************************************************************/
+/* Reporting */
+
+static gboolean
+read_daemon_usage (guint64 *ticks,
+                   guint64 *rss_kb)
+{
+    gchar  *path;
+    gchar  *contents = NULL;
+    gchar  *p;
+    gchar **fields;
+    gboolean success = FALSE;
+
+    if (!daemon_pid)
+        return FALSE;
+
+    /* utime and stime are fields 14 and 15; skip the command name, as it
+     * may have spaces, and start counting from the state (field 3) */
+    path = g_strdup_printf ("/proc/%u/stat", daemon_pid);
+    if (g_file_get_contents (path, &contents, NULL, NULL) && (p = strrchr (contents, ')')) != NULL) {
+        fields = g_strsplit (p + 2, " ", 14);
+        if (g_strv_length (fields) >= 14) {
+            *ticks = g_ascii_strtoull (fields[11], NULL, 10) + g_ascii_strtoull (fields[12], NULL, 10);
+            success = TRUE;
+        }
+        g_strfreev (fields);
+    }
+    g_free (contents);
+    g_free (path);
+
+    if (!success)
+        return FALSE;
+
+    contents = NULL;
+    *rss_kb = 0;
+    path = g_strdup_printf ("/proc/%u/status", daemon_pid);
+    if (g_file_get_contents (path, &contents, NULL, NULL) && (p = strstr (contents, "VmRSS:")) != NULL)
+        *rss_kb = g_ascii_strtoull (p + strlen ("VmRSS:"), NULL, 10);
+    g_free (contents);
+    g_free (path);
+
+    return TRUE;
+}
+
+static void
+report (void)
+{
+    gint64  now;
+    gdouble elapsed;
+    gdouble min = 0.0, max = 0.0, total = 0.0;
+    guint   n = 0;
+    guint64 ticks;
+    guint64 rss_kb;
+    gint    i;
+
+    now = g_get_monotonic_time ();
+    elapsed = (gdouble) (now - report_time_last) / G_USEC_PER_SEC;
+
+    for (i = 0; i < n_modems; i++) {
+        gdouble t;
+
+        if (!modems[i]->enabled_time)
+            continue;
+        t = (gdouble) (modems[i]->enabled_time - modems[i]->registered_time) / G_USEC_PER_SEC;
+        if (!n || t < min)
+            min = t;
+        if (!n || t > max)
+            max = t;
+        total += t;
+        n++;
+    }
+
+    g_print ("[%7.1fs] modems: %u/%u registered (%u failed), %u exported, %u enabled (%u failed)\n",
+             (gdouble) (now - start_time) / G_USEC_PER_SEC,
+             n_registered, (guint) n_modems, n_register_failed, n_exported, n_enabled, n_enable_failed);
+    if (n)
+        g_print ("           time to enabled: min %.3fs, avg %.3fs, max %.3fs\n", min, total / n, max);
+    g_print ("           at: %" G_GUINT64_FORMAT " commands, %" G_GUINT64_FORMAT " unsolicited messages\n",
+             n_commands, n_unsolicited);
+    g_print ("           dbus: %" G_GUINT64_FORMAT " signals, %.1f signals/s\n",
+             n_signals, elapsed > 0 ? (gdouble) (n_signals - n_signals_last) / elapsed : 0.0);
+    if (n_urc_latency)
+        g_print ("           urc to dbus latency: min %.1fms, avg %.1fms, max %.1fms (%u samples)\n",
+                 (gdouble) urc_latency_min_us / 1000.0,
+                 (gdouble) urc_latency_total_us / n_urc_latency / 1000.0,
+                 (gdouble) urc_latency_max_us / 1000.0,
+                 n_urc_latency);
+
+    if (read_daemon_usage (&ticks, &rss_kb)) {
+        g_print ("           daemon: pid %u, cpu %.1f%%, rss %" G_GUINT64_FORMAT " kB\n",
+                 daemon_pid,
+                 (elapsed > 0 && daemon_ticks_last) ?
+                 100.0 * (gdouble) (ticks - daemon_ticks_last) / sysconf (_SC_CLK_TCK) / elapsed : 0.0,
+                 rss_kb);
+        daemon_ticks_last = ticks;
+    }
+
+    n_signals_last = n_signals;
+    report_time_last = now;
+}
+
+static gboolean
+report_timeout_cb (void)
+{
+    report ();
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+duration_timeout_cb (void)
+{
+    g_main_loop_quit (loop);
+    return G_SOURCE_REMOVE;
+}
+
+/*****************************************************************************/
+
+int main (int argc, char **argv)
+{
+    GOptionContext  *context;
+    GDBusConnection *connection;
+    gchar           *name_owner;
+    guint            signal_id;
+    guint64          rss_kb;
+    gint             i;
+    GError          *error = NULL;
+
+    setlocale (LC_ALL, "");
+
+    /* Setup option context, process it and destroy it */
+    context = g_option_context_new ("- ModemManager virtual modem load generator");
+    g_option_context_add_main_entries (context, main_entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        g_printerr ("error: %s\n", error->message);
+        exit (EXIT_FAILURE);
+    }
+    g_option_context_free (context);
+
+    if (version_flag)
+        print_version_and_exit ();
+
+    if (n_modems <= 0 || report_interval <= 0) {
+        g_printerr ("error: the number of modems and the report interval must be positive\n");
+        exit (EXIT_FAILURE);
+    }
+
+    /* Setup command table */
+    commands = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    if (profile_str) {
+        if (!commands_load_file (profile_str, &error)) {
+            g_printerr ("error: couldn't load profile: %s\n", error->message);
+            exit (EXIT_FAILURE);
+        }
+    } else
+        commands_load_defaults ();
+
+    /* Setup dbus connection to use */
+    connection = g_bus_get_sync (session_flag ? G_BUS_TYPE_SESSION : G_BUS_TYPE_SYSTEM, NULL, &error);
+    if (!connection) {
+        g_printerr ("error: couldn't get bus: %s\n",
+                    error ? error->message : "unknown error");
+        exit (EXIT_FAILURE);
+    }
+
+    manager = mm_manager_new_sync (connection,
+                                   G_DBUS_OBJECT_MANAGER_CLIENT_FLAGS_DO_NOT_AUTO_START,
+                                   NULL,
+                                   &error);
+    if (!manager) {
+        g_printerr ("error: couldn't create manager: %s\n",
+                    error ? error->message : "unknown error");
+        exit (EXIT_FAILURE);
+    }
+
+    name_owner = g_dbus_object_manager_client_get_name_owner (G_DBUS_OBJECT_MANAGER_CLIENT (manager));
+    if (!name_owner) {
+        g_printerr ("error: couldn't find the ModemManager process in the bus\n");
+        exit (EXIT_FAILURE);
+    }
+    g_free (name_owner);
+
+    test_proxy = mm_gdbus_test_proxy_new_sync (connection,
+                                               G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START,
+                                               MM_DBUS_SERVICE,
+                                               MM_DBUS_PATH,
+                                               NULL,
+                                               &error);
+    if (!test_proxy) {
+        g_printerr ("error: couldn't create test interface proxy: %s\n",
+                    error ? error->message : "unknown error");
+        exit (EXIT_FAILURE);
+    }
+
+    /* Setup virtual modems */
+    modems = g_new0 (VirtualModem *, n_modems);
+    modems_by_device = g_hash_table_new (g_str_hash, g_str_equal);
+    for (i = 0; i < n_modems; i++) {
+        modems[i] = virtual_modem_new (i, &error);
+        if (!modems[i]) {
+            g_printerr ("error: couldn't create virtual modem %d: %s\n", i, error->message);
+            exit (EXIT_FAILURE);
+        }
+        g_hash_table_insert (modems_by_device, modems[i]->device, modems[i]);
+    }
+
+    daemon_pid = get_daemon_pid (connection);
+    if (!read_daemon_usage (&daemon_ticks_last, &rss_kb))
+        daemon_ticks_last = 0;
+    else
+        g_print ("daemon: pid %u, rss %" G_GUINT64_FORMAT " kB before load\n", daemon_pid, rss_kb);
+
+    signal_id = g_dbus_connection_signal_subscribe (connection,
+                                                    MM_DBUS_SERVICE,
+                                                    NULL, /* interface */
+                                                    NULL, /* member */
+                                                    NULL, /* path */
+                                                    NULL, /* arg0 */
+                                                    G_DBUS_SIGNAL_FLAGS_NONE,
+                                                    signal_received,
+                                                    NULL,
+                                                    NULL);
+    g_signal_connect (manager, "object-added", G_CALLBACK (object_added), NULL);
+
+    g_unix_signal_add (SIGINT,  (GSourceFunc) signals_handler, NULL);
+    g_unix_signal_add (SIGHUP,  (GSourceFunc) signals_handler, NULL);
+    g_unix_signal_add (SIGTERM, (GSourceFunc) signals_handler, NULL);
+
+    start_time = report_time_last = g_get_monotonic_time ();
+    register_modems ();
+
+    g_timeout_add_seconds (report_interval, (GSourceFunc) report_timeout_cb, NULL);
+    if (duration > 0)
+        g_timeout_add_seconds (duration, (GSourceFunc) duration_timeout_cb, NULL);
+
+    /* Setup main loop and run */
+    loop = g_main_loop_new (NULL, FALSE);
+    g_main_loop_run (loop);
+
+    /* Final report */
+    report ();
+
+    /* Cleanup */
+    g_main_loop_unref (loop);
+    g_dbus_connection_signal_unsubscribe (connection, signal_id);
+    g_hash_table_unref (modems_by_device);
+    for (i = 0; i < n_modems; i++)
+        virtual_modem_free (modems[i]);
+    g_free (modems);
+    g_hash_table_unref (commands);
+    g_object_unref (test_proxy);
+    g_object_unref (manager);
+    g_object_unref (connection);
+    return EXIT_SUCCESS;
+}